@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "benchmark.h"
+#include "ptr_algorithm.h"
+#include "ptr_vector.h"
+#include "unique_ptr.h"
+
+/**
+ * Алгоритмы mem::algo над последовательностями объектов во владении против тех же алгоритмов над
+ * массивом сырых указателей: сортировка n объектов по ключу (по умолчанию 10^6, первый аргумент)
+ * и удаление половины объектов по предикату. Ключи одинаковы для всех вариантов, объекты каждого
+ * варианта создаются заново до начала замера.
+ */
+
+namespace {
+
+struct Item {
+    explicit Item(unsigned key): key(key) {}
+
+    bool operator<(const Item &other) const {
+        return key < other.key;
+    }
+
+    unsigned key;
+};
+
+struct ItemLess {
+    bool operator()(const Item *a, const Item *b) const {
+        return *a < *b;
+    }
+};
+
+struct IsOdd {
+    bool operator()(const Item &item) const {
+        return item.key % 2 != 0;
+    }
+};
+
+typedef mem::UniquePtr<Item> ItemPtr;
+
+/**
+ * @brief Ключи в псевдослучайном порядке (xorshift), одинаковые для всех вариантов.
+ */
+std::vector<unsigned> makeKeys(size_t count) {
+    std::vector<unsigned> keys(count);
+    unsigned state = 2463534242u;
+    for (size_t i = 0; i < count; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        keys[i] = state;
+    }
+    return keys;
+}
+
+struct RawItems {
+    explicit RawItems(const std::vector<unsigned> &keys):
+    items(keys.size()) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            items[i] = new Item(keys[i]);
+        }
+    }
+
+    ~RawItems() {
+        for (size_t i = 0; i < items.size(); ++i) {
+            delete items[i];
+        }
+    }
+
+    std::vector<Item *> items;
+};
+
+struct UniqueItems {
+    explicit UniqueItems(const std::vector<unsigned> &keys):
+    items(new ItemPtr[keys.size()]),
+    count(keys.size()) {
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = ItemPtr(new Item(keys[i])).move();
+        }
+    }
+
+    ~UniqueItems() {
+        delete[] items;
+    }
+
+    ItemPtr *items;
+    size_t count;
+};
+
+struct RvalueItems {
+    explicit RvalueItems(const std::vector<unsigned> &keys) {
+        items.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            items.push_back(ItemPtr(new Item(keys[i])).move());
+        }
+    }
+
+    std::vector<ItemPtr::RvalueUniquePtr> items;
+};
+
+struct VectorItems {
+    explicit VectorItems(const std::vector<unsigned> &keys) {
+        items.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            items.push_back(ItemPtr(new Item(keys[i])).move());
+        }
+    }
+
+    mem::PtrVector<Item> items;
+};
+
+struct SortRaw {
+    explicit SortRaw(RawItems *data): data(data) {}
+
+    void operator()(size_t) {
+        std::sort(data->items.begin(), data->items.end(), ItemLess());
+        bench::doNotOptimize(data->items.front());
+    }
+
+    RawItems *data;
+};
+
+struct SortUnique {
+    explicit SortUnique(UniqueItems *data): data(data) {}
+
+    void operator()(size_t) {
+        mem::algo::sort(data->items, data->items + data->count);
+        bench::doNotOptimize(data->items[0].get());
+    }
+
+    UniqueItems *data;
+};
+
+struct SortRvalue {
+    explicit SortRvalue(RvalueItems *data): data(data) {}
+
+    void operator()(size_t) {
+        mem::algo::sort(data->items.begin(), data->items.end());
+        bench::clobberMemory();
+    }
+
+    RvalueItems *data;
+};
+
+struct SortVector {
+    explicit SortVector(VectorItems *data): data(data) {}
+
+    void operator()(size_t) {
+        mem::algo::sort(data->items);
+        bench::doNotOptimize(data->items.get(0));
+    }
+
+    VectorItems *data;
+};
+
+/**
+ * @brief Лучший вариант для сырых указателей: один проход, удаляющий и сдвигающий.
+ */
+struct RemoveRaw {
+    explicit RemoveRaw(RawItems *data): data(data) {}
+
+    void operator()(size_t) {
+        std::vector<Item *> &items = data->items;
+        size_t kept = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (IsOdd()(*items[i])) {
+                delete items[i];
+            } else {
+                items[kept++] = items[i];
+            }
+        }
+        items.resize(kept);
+    }
+
+    RawItems *data;
+};
+
+struct RemoveUnique {
+    explicit RemoveUnique(UniqueItems *data): data(data) {}
+
+    void operator()(size_t) {
+        bench::doNotOptimize(mem::algo::removeIf(data->items, data->items + data->count, IsOdd()));
+    }
+
+    UniqueItems *data;
+};
+
+struct RemoveRvalue {
+    explicit RemoveRvalue(RvalueItems *data): data(data) {}
+
+    void operator()(size_t) {
+        std::vector<ItemPtr::RvalueUniquePtr> &items = data->items;
+        items.erase(mem::algo::removeIf(items.begin(), items.end(), IsOdd()), items.end());
+    }
+
+    RvalueItems *data;
+};
+
+struct RemoveVector {
+    explicit RemoveVector(VectorItems *data): data(data) {}
+
+    void operator()(size_t) {
+        bench::doNotOptimize(mem::algo::removeIf(data->items, IsOdd()));
+    }
+
+    VectorItems *data;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t count = bench::iterationsFromArgs(argc, argv, 1000000);
+    const std::vector<unsigned> keys = makeKeys(count);
+
+    std::printf("objects: %lu\n\n", static_cast<unsigned long>(count));
+    bench::printHeader();
+    {
+        RawItems data(keys);
+        bench::run("sort Item * (std::sort)", count, SortRaw(&data));
+        bench::run("removeIf Item * (delete + compact)", count, RemoveRaw(&data));
+    }
+    {
+        UniqueItems data(keys);
+        bench::run("sort UniquePtr<Item>[] (algo::sort)", count, SortUnique(&data));
+        bench::run("removeIf UniquePtr<Item>[] (algo::removeIf)", count, RemoveUnique(&data));
+    }
+    {
+        RvalueItems data(keys);
+        bench::run("sort vector<RvalueUniquePtr> (algo::sort)", count, SortRvalue(&data));
+        bench::run("removeIf vector<RvalueUniquePtr>", count, RemoveRvalue(&data));
+    }
+    {
+        VectorItems data(keys);
+        bench::run("sort PtrVector<Item> (algo::sort)", count, SortVector(&data));
+        bench::run("removeIf PtrVector<Item> (algo::removeIf)", count, RemoveVector(&data));
+    }
+
+    return 0;
+}
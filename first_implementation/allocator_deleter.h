@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "preprocessor.h"
+
+namespace mem {
+
+/**
+ * @brief Класс-функтор, возвращающий объект в аллокатор стандартного вида (концепция Allocator
+ * C++03): сначала destroy(), затем deallocate() на один элемент.
+ * @details Аллокатор хранится как приватная база, поэтому аллокатор без состояния (например,
+ * std::allocator) не занимает памяти и sizeof(UniquePtr<T, AllocatorDeleter<A> >) ==
+ * sizeof(T *). Аллокатор с состоянием занимает ровно свой размер.
+ * Преобразования в функтор для базового типа нет: deallocate() аллокатора базы освободил бы
+ * память под объект другого размера.
+ * @tparam A Тип аллокатора, A::value_type - тип объекта хранения, A::pointer - T *.
+ */
+template<class A>
+class AllocatorDeleter : private A {
+public:
+    //! Псевдоним для типа аллокатора.
+    typedef A Allocator;
+    //! Псевдоним для типа объекта хранения.
+    typedef typename A::value_type ValueType;
+
+    /**
+     * @brief Конструктор по умолчанию. Аллокатор создается конструктором по умолчанию.
+     */
+    AllocatorDeleter();
+
+    /**
+     * @brief Конструктор класса от аллокатора, из которого была выделена память.
+     * @param allocator Аллокатор, копия которого освободит объект.
+     */
+    explicit AllocatorDeleter(const Allocator &allocator);
+
+    /**
+     * @brief Разрушить объект через destroy() и вернуть его память через deallocate().
+     * @param ptr Указатель на объект хранения.
+     */
+    void operator()(ValueType *ptr);
+
+    /**
+     * @brief Получить аллокатор функтора.
+     */
+    Allocator &allocator();
+
+    /**
+     * @brief Получить аллокатор функтора.
+     */
+    const Allocator &allocator() const;
+};
+
+namespace detail {
+
+/**
+ * @brief Политика выделения памяти для makeUniqueWith поверх аллокатора стандартного вида.
+ * @tparam A Тип аллокатора, уже перепривязанный (rebind) к типу объекта.
+ */
+template<class A>
+class AllocatorPolicy {
+public:
+    typedef AllocatorDeleter<A> Deleter;
+
+    explicit AllocatorPolicy(const A &allocator):
+    allocator_(allocator) {
+    }
+
+    void *allocate() {
+        return allocator_.allocate(1);
+    }
+
+    void deallocate(void *memory) {
+        allocator_.deallocate(static_cast<typename A::pointer>(memory), 1);
+    }
+
+    Deleter deleter() const {
+        return Deleter(allocator_);
+    }
+
+private:
+    A allocator_; //!< Аллокатор, из которого выделяется память под объект.
+};
+
+/**
+ * @brief Тип аллокатора A, перепривязанного к типу T, и функтора для него.
+ */
+template<class T, class A>
+struct AllocatorRebind {
+    typedef typename A::template rebind<T>::other Allocator;
+    typedef AllocatorDeleter<Allocator> Deleter;
+};
+
+} // namespace detail
+
+/**
+ * Семейство фабрик allocateUnique для C++03.
+ *
+ * allocateUnique<T>(allocator, a1, ..., aN) выделяет память под один объект T из копии
+ * allocator, перепривязанной к T (rebind), конструирует в ней объект и возвращает
+ * RvalueUniquePtr с функтором AllocatorDeleter. Если конструктор бросает исключение, память
+ * возвращается в аллокатор. Объект конструируется размещающим new, а не construct(): в C++03
+ * construct() умеет только копировать.
+ *
+ * Аргументы передаются по константной ссылке (ограничение C++03), перегрузки сгенерированы
+ * для 0..MEM_MAKE_UNIQUE_MAX_ARITY аргументов.
+ */
+#define MEM_ALLOCATE_UNIQUE(n) \
+    template<class T, class A, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvalueUniquePtr<T, typename detail::AllocatorRebind<T, A>::Deleter> allocateUnique( \
+            const A &allocator, MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        typedef typename detail::AllocatorRebind<T, A>::Allocator Allocator; \
+        detail::AllocatorPolicy<Allocator> policy((Allocator(allocator))); \
+        return makeUniqueWith<T>(policy, MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+    }
+
+template<class T, class A>
+RvalueUniquePtr<T, typename detail::AllocatorRebind<T, A>::Deleter> allocateUnique(
+        const A &allocator) {
+    typedef typename detail::AllocatorRebind<T, A>::Allocator Allocator;
+    detail::AllocatorPolicy<Allocator> policy((Allocator(allocator)));
+    return makeUniqueWith<T>(policy);
+}
+
+MEM_ALLOCATE_UNIQUE(1)
+MEM_ALLOCATE_UNIQUE(2)
+MEM_ALLOCATE_UNIQUE(3)
+MEM_ALLOCATE_UNIQUE(4)
+MEM_ALLOCATE_UNIQUE(5)
+MEM_ALLOCATE_UNIQUE(6)
+MEM_ALLOCATE_UNIQUE(7)
+MEM_ALLOCATE_UNIQUE(8)
+MEM_ALLOCATE_UNIQUE(9)
+MEM_ALLOCATE_UNIQUE(10)
+
+#undef MEM_ALLOCATE_UNIQUE
+
+/**
+    template<class A>
+    class AllocatorDeleter
+ **/
+template<class A>
+AllocatorDeleter<A>::AllocatorDeleter():
+A() {
+}
+
+template<class A>
+AllocatorDeleter<A>::AllocatorDeleter(const Allocator &allocator):
+A(allocator) {
+}
+
+template<class A>
+void AllocatorDeleter<A>::operator()(ValueType *ptr) {
+    Allocator::destroy(ptr);
+    Allocator::deallocate(ptr, 1);
+}
+
+template<class A>
+typename AllocatorDeleter<A>::Allocator &AllocatorDeleter<A>::allocator() {
+    return *this;
+}
+
+template<class A>
+const typename AllocatorDeleter<A>::Allocator &AllocatorDeleter<A>::allocator() const {
+    return *this;
+}
+
+} // namespace mem
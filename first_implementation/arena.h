@@ -0,0 +1,396 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "make_unique.h"
+#include "preprocessor.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+/**
+ * @brief Метафункция, проверяющая, что деструктор типа тривиален.
+ * @details В C++03 нет std::is_trivially_destructible, поэтому используется встроенная функция
+ * компилятора. Без нее деструктор считается нетривиальным и всегда регистрируется.
+ */
+template<class T>
+struct HasTrivialDestructor {
+#if defined(__GNUC__) || defined(__clang__)
+    static const bool value = __has_trivial_destructor(T);
+#else
+    static const bool value = false;
+#endif
+};
+
+/**
+ * @brief Вспомогательная структура для вычисления выравнивания типа в C++03.
+ */
+template<class T>
+struct AlignmentHelper {
+    char c;
+    T t;
+};
+
+/**
+ * @brief Выравнивание типа T.
+ */
+template<class T>
+struct AlignOf {
+    static const size_t value = sizeof(AlignmentHelper<T>) - sizeof(T);
+};
+
+} // namespace detail
+
+/**
+ * @brief Класс-функтор, ничего не делающий при уничтожении умного указателя.
+ * @details Объекты из Arena уничтожаются все сразу в Arena::reset(), поэтому UniquePtr с этим
+ * функтором лишь обозначает владельца объекта внутри области жизни арены.
+ * @tparam T Тип объекта.
+ */
+template<class T>
+struct ArenaDeleter {
+    ArenaDeleter() {}
+
+    /**
+     * @brief Конструктор от функтора для производного типа.
+     */
+    template<class U>
+    ArenaDeleter(const ArenaDeleter<U> &) {}
+
+    void operator()(T *) {}
+};
+
+/**
+ * @brief Арена (bump allocator) с ростом блоками.
+ * @details Память выделяется сдвигом указателя внутри текущего блока, при нехватке места
+ * берется следующий блок. Деструкторы объектов с нетривиальным деструктором регистрируются
+ * в списке, который хранится в самой арене, и вызываются в обратном порядке в reset().
+ * Для тривиально разрушаемых типов список не используется (решается на этапе компиляции).
+ * reset() не освобождает блоки, а переиспользует их для следующих выделений.
+ */
+class Arena {
+public:
+    //! Размер блока по умолчанию.
+    static const size_t DefaultChunkSize = 64 * 1024;
+
+    /**
+     * @brief Конструктор класса. Блоки выделяются лениво, при первом выделении памяти.
+     * @param chunkSize Размер блока арены.
+     */
+    explicit Arena(size_t chunkSize = DefaultChunkSize);
+
+    /**
+     * @brief Деструктор класса. Вызывает reset() и освобождает все блоки.
+     */
+    ~Arena();
+
+    /**
+     * @brief Выделить память в арене.
+     * @throw std::bad_alloc Если не удалось выделить новый блок.
+     * @param size Размер памяти в байтах.
+     * @param alignment Выравнивание (степень двойки).
+     * @return Указатель на выровненную неинициализированную память.
+     */
+    void *allocate(size_t size, size_t alignment);
+
+    /**
+     * @brief Зарегистрировать деструктор объекта, созданного в памяти арены.
+     * @details Для тривиально разрушаемых типов ничего не делает.
+     * @param ptr Указатель на сконструированный объект.
+     */
+    template<class T>
+    void registerDestructor(T *ptr);
+
+    /**
+     * @brief Создать объект в арене.
+     * @details Если конструктор бросает исключение, память объекта вернется в арену только
+     * при reset(), деструктор при этом не регистрируется.
+     * @return Объект класса RvalueUniquePtr с функтором ArenaDeleter.
+     */
+    template<class T>
+    RvalueUniquePtr<T, ArenaDeleter<T> > make();
+
+#define MEM_ARENA_MAKE_DECLARATION(n) \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvalueUniquePtr<T, ArenaDeleter<T> > make(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM));
+
+    MEM_ARENA_MAKE_DECLARATION(1)
+    MEM_ARENA_MAKE_DECLARATION(2)
+    MEM_ARENA_MAKE_DECLARATION(3)
+    MEM_ARENA_MAKE_DECLARATION(4)
+    MEM_ARENA_MAKE_DECLARATION(5)
+    MEM_ARENA_MAKE_DECLARATION(6)
+    MEM_ARENA_MAKE_DECLARATION(7)
+    MEM_ARENA_MAKE_DECLARATION(8)
+    MEM_ARENA_MAKE_DECLARATION(9)
+    MEM_ARENA_MAKE_DECLARATION(10)
+
+#undef MEM_ARENA_MAKE_DECLARATION
+
+    /**
+     * @brief Вызвать зарегистрированные деструкторы и вернуть всю память арены разом.
+     * @details Все указатели на объекты арены после вызова становятся недействительными.
+     */
+    void reset();
+
+    /**
+     * @brief Количество байт, выделенных с последнего reset() (с учетом выравнивания).
+     */
+    size_t bytesUsed() const;
+
+    /**
+     * @brief Суммарный размер блоков арены.
+     */
+    size_t bytesReserved() const;
+
+    /**
+     * @brief Количество зарегистрированных деструкторов.
+     */
+    size_t destructorCount() const;
+
+private:
+    /**
+     * @brief Заголовок блока памяти. Данные блока следуют сразу за заголовком.
+     */
+    struct Chunk {
+        Chunk *next; //!< Следующий блок.
+        size_t size; //!< Размер данных блока.
+    };
+
+    /**
+     * @brief Узел списка деструкторов. Хранится в памяти арены.
+     */
+    struct DestructorNode {
+        void (*destroy)(void *); //!< Функция, вызывающая деструктор нужного типа.
+        void *object; //!< Указатель на объект.
+        DestructorNode *next; //!< Ранее зарегистрированный узел.
+    };
+
+    /**
+     * @brief Вызвать деструктор объекта типа T.
+     */
+    template<class T>
+    static void destroyObject(void *ptr);
+
+    /**
+     * @brief Зарезервировать узел списка деструкторов для объекта типа T.
+     * @details Узел выделяется до конструирования объекта: если выделение бросит исключение,
+     * сконструированный объект не останется без деструктора.
+     * @return Указатель на узел или NULL для тривиально разрушаемого T.
+     */
+    template<class T>
+    DestructorNode *reserveDestructor();
+
+    /**
+     * @brief Заполнить зарезервированный узел и добавить его в список деструкторов.
+     */
+    template<class T>
+    void linkDestructor(DestructorNode *node, T *ptr);
+
+    /**
+     * @brief Размер заголовка блока, выровненный по самому строгому фундаментальному типу.
+     */
+    static size_t chunkHeaderSize();
+
+    /**
+     * @brief Начало данных блока.
+     */
+    static char *chunkData(Chunk *chunk);
+
+    /**
+     * @brief Смещение первого адреса с выравниванием alignment в текущем блоке.
+     */
+    size_t alignedOffset(size_t alignment) const;
+
+    /**
+     * @brief Перейти к блоку, в котором поместится size байт с выравниванием alignment.
+     */
+    void nextChunk(size_t size, size_t alignment);
+
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    Arena(const Arena &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    Arena &operator=(const Arena &other);
+
+    size_t chunkSize_; //!< Размер блока по умолчанию.
+    Chunk *head_; //!< Первый блок.
+    Chunk *current_; //!< Текущий блок.
+    size_t offset_; //!< Смещение первого свободного байта в текущем блоке.
+    size_t used_; //!< Количество байт, выделенных в блоках до текущего.
+    DestructorNode *destructors_; //!< Список деструкторов, последний зарегистрированный первым.
+    size_t destructorCount_; //!< Количество зарегистрированных деструкторов.
+};
+
+inline Arena::Arena(size_t chunkSize):
+chunkSize_(chunkSize),
+head_(NULL),
+current_(NULL),
+offset_(0),
+used_(0),
+destructors_(NULL),
+destructorCount_(0) {
+}
+
+inline Arena::~Arena() {
+    reset();
+    while (head_ != NULL) {
+        Chunk *next = head_->next;
+        ::operator delete(head_);
+        head_ = next;
+    }
+}
+
+inline void *Arena::allocate(size_t size, size_t alignment) {
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    if (current_ == NULL || alignedOffset(alignment) + size > current_->size) {
+        nextChunk(size, alignment);
+    }
+
+    const size_t aligned = alignedOffset(alignment);
+    offset_ = aligned + size;
+    return chunkData(current_) + aligned;
+}
+
+template<class T>
+void Arena::registerDestructor(T *ptr) {
+    linkDestructor(reserveDestructor<T>(), ptr);
+}
+
+template<class T>
+RvalueUniquePtr<T, ArenaDeleter<T> > Arena::make() {
+    DestructorNode *node = reserveDestructor<T>();
+    T *ptr = new (allocate(sizeof(T), detail::AlignOf<T>::value)) T();
+    linkDestructor(node, ptr);
+    return detail::UniqueFactory::adopt(ptr, ArenaDeleter<T>());
+}
+
+#define MEM_ARENA_MAKE_DEFINITION(n) \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvalueUniquePtr<T, ArenaDeleter<T> > Arena::make(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        DestructorNode *node = reserveDestructor<T>(); \
+        T *ptr = new (allocate(sizeof(T), detail::AlignOf<T>::value)) \
+                T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+        linkDestructor(node, ptr); \
+        return detail::UniqueFactory::adopt(ptr, ArenaDeleter<T>()); \
+    }
+
+MEM_ARENA_MAKE_DEFINITION(1)
+MEM_ARENA_MAKE_DEFINITION(2)
+MEM_ARENA_MAKE_DEFINITION(3)
+MEM_ARENA_MAKE_DEFINITION(4)
+MEM_ARENA_MAKE_DEFINITION(5)
+MEM_ARENA_MAKE_DEFINITION(6)
+MEM_ARENA_MAKE_DEFINITION(7)
+MEM_ARENA_MAKE_DEFINITION(8)
+MEM_ARENA_MAKE_DEFINITION(9)
+MEM_ARENA_MAKE_DEFINITION(10)
+
+#undef MEM_ARENA_MAKE_DEFINITION
+
+inline void Arena::reset() {
+    for (DestructorNode *node = destructors_; node != NULL; node = node->next) {
+        node->destroy(node->object);
+    }
+    destructors_ = NULL;
+    destructorCount_ = 0;
+
+    current_ = head_;
+    offset_ = 0;
+    used_ = 0;
+}
+
+inline size_t Arena::bytesUsed() const {
+    return used_ + offset_;
+}
+
+inline size_t Arena::bytesReserved() const {
+    size_t reserved = 0;
+    for (Chunk *chunk = head_; chunk != NULL; chunk = chunk->next) {
+        reserved += chunk->size;
+    }
+    return reserved;
+}
+
+inline size_t Arena::destructorCount() const {
+    return destructorCount_;
+}
+
+template<class T>
+void Arena::destroyObject(void *ptr) {
+    static_cast<T *>(ptr)->~T();
+}
+
+template<class T>
+Arena::DestructorNode *Arena::reserveDestructor() {
+    if (detail::HasTrivialDestructor<T>::value) {
+        return NULL;
+    }
+    return static_cast<DestructorNode *>(allocate(sizeof(DestructorNode),
+                                                  detail::AlignOf<DestructorNode>::value));
+}
+
+template<class T>
+void Arena::linkDestructor(DestructorNode *node, T *ptr) {
+    if (node == NULL) {
+        return;
+    }
+    node->destroy = &destroyObject<T>;
+    node->object = ptr;
+    node->next = destructors_;
+    destructors_ = node;
+    ++destructorCount_;
+}
+
+inline size_t Arena::chunkHeaderSize() {
+    const size_t alignment = detail::AlignOf<long double>::value;
+    return (sizeof(Chunk) + alignment - 1) & ~(alignment - 1);
+}
+
+inline char *Arena::chunkData(Chunk *chunk) {
+    return reinterpret_cast<char *>(chunk) + chunkHeaderSize();
+}
+
+inline size_t Arena::alignedOffset(size_t alignment) const {
+    const size_t address = reinterpret_cast<size_t>(chunkData(current_) + offset_);
+    return offset_ + (((address + alignment - 1) & ~(alignment - 1)) - address);
+}
+
+inline void Arena::nextChunk(size_t size, size_t alignment) {
+    const size_t required = size + alignment;
+
+    if (current_ != NULL) {
+        used_ += offset_;
+        // После reset() следующие блоки уже выделены и переиспользуются, если подходят по размеру.
+        if (current_->next != NULL && current_->next->size >= required) {
+            current_ = current_->next;
+            offset_ = 0;
+            return;
+        }
+    }
+
+    const size_t dataSize = required > chunkSize_ ? required : chunkSize_;
+    Chunk *chunk = static_cast<Chunk *>(::operator new(chunkHeaderSize() + dataSize));
+    chunk->size = dataSize;
+
+    if (current_ == NULL) {
+        chunk->next = head_;
+        head_ = chunk;
+    } else {
+        chunk->next = current_->next;
+        current_->next = chunk;
+    }
+    current_ = chunk;
+    offset_ = 0;
+}
+
+} // namespace mem
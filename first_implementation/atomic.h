@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+
+#include <sched.h>
+
+/**
+ * Обертки над встроенными атомарными операциями GCC/Clang (__atomic_*). В отличие от
+ * std::atomic они доступны при сборке в C++03.
+ */
+
+namespace mem {
+
+namespace detail {
+
+//! Размер кэш-линии, по которому разносятся данные разных потоков.
+static const size_t CacheLineSize = 64;
+
+/**
+ * @brief Атомарное чтение с семантикой acquire.
+ */
+template<class T>
+inline T atomicLoad(const T *ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Атомарное чтение без упорядочивания.
+ */
+template<class T>
+inline T atomicLoadRelaxed(const T *ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Атомарная запись с семантикой release.
+ */
+template<class T>
+inline void atomicStore(T *ptr, T value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Атомарная запись без упорядочивания.
+ */
+template<class T>
+inline void atomicStoreRelaxed(T *ptr, T value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Атомарный обмен значения с семантикой acquire-release.
+ * @return Предыдущее значение.
+ */
+template<class T>
+inline T atomicExchange(T *ptr, T value) {
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Атомарное сравнение с обменом (strong) с семантикой acquire-release.
+ * @param ptr Указатель на атомарную переменную.
+ * @param expected Ожидаемое значение; при неудаче в него записывается текущее значение.
+ * @param desired Новое значение.
+ * @return true, если значение было заменено.
+ */
+template<class T>
+inline bool atomicCompareExchange(T *ptr, T &expected, T desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Атомарное прибавление с семантикой acquire-release.
+ * @return Предыдущее значение.
+ */
+template<class T>
+inline T atomicFetchAdd(T *ptr, T value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Атомарное прибавление без упорядочивания.
+ * @return Предыдущее значение.
+ */
+template<class T>
+inline T atomicFetchAddRelaxed(T *ptr, T value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Уступить процессор другим потокам при ожидании в цикле.
+ */
+inline void threadYield() {
+    sched_yield();
+}
+
+} // namespace detail
+
+} // namespace mem
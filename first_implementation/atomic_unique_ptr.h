@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+
+#include "atomic.h"
+#include "observer_ptr.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+/**
+ * @brief Уникальный умный указатель, владение которым можно атомарно публиковать и заменять.
+ * @details Предназначен для объектов, которые читаются на горячем пути и целиком заменяются
+ * писателем (конфигурация, таблицы маршрутизации). Все операции lock-free и построены на
+ * встроенных атомарных операциях, поэтому работают в C++03. Писатель получает вытесненный
+ * объект обратно в виде RvalueUniquePtr и сам решает, когда его освободить: класс не знает,
+ * закончили ли читатели работу с объектом, полученным через load().
+ * Все объекты освобождаются одним функтором D: конструктор от RvalueUniquePtr берет его функтор,
+ * функторы RvalueUniquePtr, переданных в store() и exchange(), не сохраняются.
+ * @tparam T Тип объекта хранения.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class T, class D = Deleter<T> >
+class AtomicUniquePtr {
+public:
+    //! Псевдоним для типа объекта хранения.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+    //! Псевдоним для типа умного указателя на объект хранения.
+    typedef UniquePtr<T, D> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на объект хранения.
+    typedef typename Pointer::RvalueUniquePtr RvalueUniquePtr;
+
+    /**
+     * @brief Конструктор по умолчанию. Создает пустой указатель.
+     */
+    AtomicUniquePtr();
+
+    /**
+     * @brief Конструктор класса от функтора для очистки данных.
+     * @param deleter Функтор, которым освобождаются объекты хранения.
+     */
+    explicit AtomicUniquePtr(const Deleter &deleter);
+
+    /**
+     * @brief Конструктор класса, забирающий владение и функтор очистки данных у rvalue.
+     * @param rvalue Объект класса RvalueUniquePtr, передающий владение.
+     */
+    explicit AtomicUniquePtr(RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Деструктор класса. Освобождает текущий объект.
+     * @details Подразумевает, что других потоков, работающих с указателем, уже нет.
+     */
+    ~AtomicUniquePtr();
+
+    /**
+     * @brief Атомарно получить невладеющий доступ к текущему объекту.
+     * @details Наблюдатель остается действительным, пока писатель не освободит вытесненный объект.
+     * @return Наблюдатель за текущим объектом.
+     */
+    ObserverPtr<ValueType> load() const;
+
+    /**
+     * @brief Атомарно заменить объект, сразу освободив вытесненный.
+     * @details Безопасно, только если никакой читатель не может держать вытесненный объект;
+     * иначе следует использовать exchange() и освобождать объект позже.
+     * @param rvalue Объект класса RvalueUniquePtr, передающий владение.
+     */
+    void store(RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Атомарно заменить объект.
+     * @param rvalue Объект класса RvalueUniquePtr, передающий владение.
+     * @return Объект класса RvalueUniquePtr, владеющий вытесненным объектом.
+     */
+    RvalueUniquePtr exchange(RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Атомарно заменить объект, если текущий объект совпадает с ожидаемым.
+     * @details При успехе desired отдает владение новым объектом и получает владение вытесненным.
+     * При неудаче desired не меняется, а в expected записывается текущий объект.
+     * @param expected Ожидаемый текущий объект.
+     * @param desired Объект класса RvalueUniquePtr с новым объектом.
+     * @return true, если объект был заменен.
+     */
+    bool compareExchange(ObserverPtr<ValueType> &expected, RvalueUniquePtr &desired);
+
+    /**
+     * @brief Получить функтор для освобождения данных.
+     */
+    Deleter &getDeleter();
+
+private:
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    AtomicUniquePtr(const AtomicUniquePtr &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    AtomicUniquePtr &operator=(const AtomicUniquePtr &other);
+
+    //! Указатель на объект хранения и функтор для очистки данных.
+    mutable detail::PtrStorage<ValueType, Deleter> storage_;
+};
+
+template<class T, class D>
+AtomicUniquePtr<T, D>::AtomicUniquePtr():
+storage_(NULL, Deleter()) {
+}
+
+template<class T, class D>
+AtomicUniquePtr<T, D>::AtomicUniquePtr(const Deleter &deleter):
+storage_(NULL, deleter) {
+}
+
+template<class T, class D>
+AtomicUniquePtr<T, D>::AtomicUniquePtr(RvalueUniquePtr rvalue):
+storage_(rvalue.release(), rvalue.getDeleter()) {
+}
+
+template<class T, class D>
+AtomicUniquePtr<T, D>::~AtomicUniquePtr() {
+    if (storage_.ptr() != NULL) {
+        storage_.deleter()(storage_.ptr());
+    }
+}
+
+template<class T, class D>
+ObserverPtr<typename AtomicUniquePtr<T, D>::ValueType> AtomicUniquePtr<T, D>::load() const {
+    return ObserverPtr<ValueType>(detail::atomicLoad(&storage_.ptr()));
+}
+
+template<class T, class D>
+void AtomicUniquePtr<T, D>::store(RvalueUniquePtr rvalue) {
+    Pointer displaced(exchange(rvalue));
+}
+
+template<class T, class D>
+typename AtomicUniquePtr<T, D>::RvalueUniquePtr
+        AtomicUniquePtr<T, D>::exchange(RvalueUniquePtr rvalue) {
+    ValueType *displaced = detail::atomicExchange(&storage_.ptr(), rvalue.release());
+    return Pointer(displaced, storage_.deleter()).move();
+}
+
+template<class T, class D>
+bool AtomicUniquePtr<T, D>::compareExchange(ObserverPtr<ValueType> &expected,
+                                            RvalueUniquePtr &desired) {
+    ValueType *current = expected.get();
+    if (!detail::atomicCompareExchange(&storage_.ptr(), current, desired.borrow().get())) {
+        expected = ObserverPtr<ValueType>(current);
+        return false;
+    }
+
+    desired.release();
+    desired = Pointer(current, storage_.deleter()).move();
+    return true;
+}
+
+template<class T, class D>
+typename AtomicUniquePtr<T, D>::Deleter &AtomicUniquePtr<T, D>::getDeleter() {
+    return storage_.deleter();
+}
+
+} // namespace mem
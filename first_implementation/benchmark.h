@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+/**
+ * @brief Минимальный каркас для микробенчмарков, собираемый в C++03.
+ * @details Заменяет глобальные operator new/delete на версии со счетчиками, поэтому заголовок
+ * должен подключаться ровно в одну единицу трансляции (исполняемый файл бенчмарка).
+ */
+namespace bench {
+
+/**
+ * @brief Счетчики выделений памяти через глобальный operator new.
+ */
+struct AllocStats {
+    size_t count; //!< Количество выделений.
+    size_t bytes; //!< Суммарный объем выделенной памяти в байтах.
+};
+
+inline AllocStats &allocStats() {
+    static AllocStats stats = {0, 0};
+    return stats;
+}
+
+/**
+ * @brief Текущее значение монотонных часов в наносекундах.
+ */
+inline double nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+}
+
+/**
+ * @brief Не дает компилятору выбросить вычисление значения.
+ */
+template<class T>
+inline void doNotOptimize(const T &value) {
+    __asm__ __volatile__("" : : "r"(&value) : "memory");
+}
+
+/**
+ * @brief Барьер, запрещающий компилятору переносить обращения к памяти через эту точку.
+ */
+inline void clobberMemory() {
+    __asm__ __volatile__("" : : : "memory");
+}
+
+/**
+ * @brief Печатает заголовок таблицы результатов.
+ */
+inline void printHeader() {
+    std::printf("%-44s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "bytes/op");
+}
+
+/**
+ * @brief Запускает функтор fn(iterations) и печатает время, число выделений и объем памяти на
+ * одну операцию.
+ * @tparam Fn Тип функтора, выполняющего iterations операций за один вызов.
+ * @param name Название бенчмарка.
+ * @param iterations Количество операций.
+ * @param fn Функтор бенчмарка.
+ */
+template<class Fn>
+void run(const char *name, size_t iterations, Fn fn) {
+    const AllocStats before = allocStats();
+    const double start = nowNs();
+    fn(iterations);
+    const double elapsed = nowNs() - start;
+    const AllocStats after = allocStats();
+
+    const double ops = static_cast<double>(iterations);
+    std::printf("%-44s %12.2f %12.2f %12.2f\n", name, elapsed / ops,
+                static_cast<double>(after.count - before.count) / ops,
+                static_cast<double>(after.bytes - before.bytes) / ops);
+}
+
+/**
+ * @brief Количество итераций из аргументов командной строки или значение по умолчанию.
+ */
+inline size_t iterationsFromArgs(int argc, char **argv, size_t defaultValue) {
+    if (argc > 1) {
+        const long value = std::atol(argv[1]);
+        if (value > 0) {
+            return static_cast<size_t>(value);
+        }
+    }
+    return defaultValue;
+}
+
+} // namespace bench
+
+#if __cplusplus >= 201103L
+#define BENCH_THROW_BAD_ALLOC
+#define BENCH_NOTHROW noexcept
+#else
+#define BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define BENCH_NOTHROW throw()
+#endif
+
+#define BENCH_NOINLINE __attribute__((noinline))
+
+namespace bench {
+
+/**
+ * @brief Выделяет память через malloc и учитывает выделение в allocStats().
+ */
+inline void *countedAllocate(size_t size) {
+    AllocStats &stats = allocStats();
+    ++stats.count;
+    stats.bytes += size;
+
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+} // namespace bench
+
+/*
+ * Все формы operator new выделяют память через malloc, поэтому заменяются и все парные им формы
+ * operator delete, включая размерные: иначе часть освобождений ушла бы в стандартный operator
+ * delete. Замены не встраиваются, как и библиотечные: иначе GCC видит free() на указателе из
+ * operator new и выдает -Wmismatched-new-delete.
+ */
+BENCH_NOINLINE void *operator new(size_t size) BENCH_THROW_BAD_ALLOC {
+    return bench::countedAllocate(size);
+}
+
+BENCH_NOINLINE void *operator new[](size_t size) BENCH_THROW_BAD_ALLOC {
+    return bench::countedAllocate(size);
+}
+
+BENCH_NOINLINE void operator delete(void *ptr) BENCH_NOTHROW {
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void *ptr) BENCH_NOTHROW {
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void *ptr, size_t) BENCH_NOTHROW {
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void *ptr, size_t) BENCH_NOTHROW {
+    std::free(ptr);
+}
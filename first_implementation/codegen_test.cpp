@@ -0,0 +1,112 @@
+#include <new>
+
+#include "unique_ptr.h"
+
+/**
+ * Горячие операции UniquePtr и их эквиваленты на сырых указателях. Файл компилируется с -O2
+ * -DNDEBUG дважды: как есть и с CODEGEN_RAW_POINTER, когда FooHandle - сырой указатель, а
+ * операции заменены ручным кодом. Тест codegen_test сравнивает дизассемблер двух объектных файлов:
+ * лишняя инструкция, вызов или загрузка из vtable в любом ядре ломает сборку теста.
+ * Ядра объявлены extern "C", чтобы имена символов не зависели от типа FooHandle. RvalueUniquePtr
+ * не выходит за пределы ядер: по значению он передается в памяти, а не в регистре, как T *.
+ */
+
+struct Foo {
+    int value;
+};
+
+struct Base {
+    virtual ~Base() {}
+    int value;
+};
+
+#ifdef CODEGEN_RAW_POINTER
+typedef Foo *FooHandle;
+typedef Foo *FooRvalue;
+typedef Base *BaseHandle;
+
+template<class T>
+T *moveOut(T *&ptr) {
+    T *result = ptr;
+    ptr = NULL;
+    return result;
+}
+
+template<class T>
+T *getOf(T *ptr) {
+    return ptr;
+}
+
+template<class T>
+T *releaseOf(T *&ptr) {
+    return moveOut(ptr);
+}
+
+template<class T>
+void destroy(T *&ptr) {
+    delete ptr;
+}
+#else
+typedef mem::UniquePtr<Foo> FooHandle;
+typedef FooHandle::RvalueUniquePtr FooRvalue;
+typedef mem::UniquePtr<Base> BaseHandle;
+
+template<class T>
+typename mem::UniquePtr<T>::RvalueUniquePtr moveOut(mem::UniquePtr<T> &ptr) {
+    return ptr.move();
+}
+
+template<class T>
+T *getOf(const mem::UniquePtr<T> &ptr) {
+    return ptr.get();
+}
+
+template<class T>
+T *releaseOf(mem::UniquePtr<T> &ptr) {
+    return ptr.release();
+}
+
+template<class T>
+void destroy(mem::UniquePtr<T> &ptr) {
+    ptr.~UniquePtr();
+}
+#endif
+
+extern "C" Foo *codegenGet(FooHandle &ptr) {
+    return getOf(ptr);
+}
+
+extern "C" int codegenArrow(FooHandle &ptr) {
+    return ptr->value;
+}
+
+extern "C" int codegenDereference(FooHandle &ptr) {
+    return (*ptr).value;
+}
+
+extern "C" void codegenStore(FooHandle &ptr, int value) {
+    ptr->value = value;
+}
+
+extern "C" Foo *codegenRelease(FooHandle &ptr) {
+    return releaseOf(ptr);
+}
+
+extern "C" int codegenMoveRoundTrip(FooHandle &ptr) {
+    FooRvalue rvalue(moveOut(ptr));
+    FooHandle local(rvalue);
+    ptr = moveOut(local);
+    return ptr->value;
+}
+
+extern "C" void codegenMoveInto(void *memory, FooHandle &source) {
+    new (memory) FooHandle(moveOut(source));
+}
+
+extern "C" void codegenDestroy(FooHandle &ptr) {
+    destroy(ptr);
+}
+
+extern "C" void codegenDestroyPolymorphic(BaseHandle &ptr) {
+    destroy(ptr);
+}
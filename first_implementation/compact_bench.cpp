@@ -0,0 +1,137 @@
+#include <cstdio>
+#include <vector>
+
+#include "benchmark.h"
+#include "arena.h"
+#include "compact_unique_ptr.h"
+#include "unique_ptr.h"
+
+/**
+ * Обход полного двоичного дерева (по умолчанию 2^20 - 1 узлов): узлы со ссылками UniquePtr
+ * против узлов с CompactUniquePtr. Оба дерева лежат в аренах, поэтому различаются только размером
+ * ссылок и, как следствие, плотностью узлов в кэше. Первый аргумент задает глубину дерева, второй -
+ * число проходов.
+ */
+
+namespace {
+
+struct Node {
+    explicit Node(int value): value(value) {}
+
+    mem::UniquePtr<Node, mem::ArenaDeleter<Node> > left;
+    mem::UniquePtr<Node, mem::ArenaDeleter<Node> > right;
+    int value;
+};
+
+struct CompactNodes {};
+
+typedef mem::CompactArena<CompactNodes> CompactNodeArena;
+
+struct CompactNode {
+    explicit CompactNode(int value): value(value) {}
+
+    mem::CompactUniquePtr<CompactNode, CompactNodeArena> left;
+    mem::CompactUniquePtr<CompactNode, CompactNodeArena> right;
+    int value;
+};
+
+/**
+ * @brief Построить дерево в ширину: соседние по уровню узлы лежат в арене рядом.
+ */
+template<class N, class Make>
+void buildTree(N *root, size_t depth, Make make) {
+    std::vector<N *> level(1, root);
+    int value = 1;
+    for (size_t i = 1; i < depth; ++i) {
+        std::vector<N *> next;
+        next.reserve(level.size() * 2);
+        for (size_t j = 0; j < level.size(); ++j) {
+            level[j]->left = make(value++);
+            level[j]->right = make(value++);
+            next.push_back(level[j]->left.get());
+            next.push_back(level[j]->right.get());
+        }
+        level.swap(next);
+    }
+}
+
+template<class N>
+size_t sumTree(const N &node) {
+    size_t sum = static_cast<size_t>(node.value);
+    if (node.left.get() != NULL) {
+        sum += sumTree(*node.left);
+    }
+    if (node.right.get() != NULL) {
+        sum += sumTree(*node.right);
+    }
+    return sum;
+}
+
+struct MakeNode {
+    explicit MakeNode(mem::Arena *arena): arena(arena) {}
+
+    mem::RvalueUniquePtr<Node, mem::ArenaDeleter<Node> > operator()(int value) const {
+        return arena->make<Node>(value);
+    }
+
+    mem::Arena *arena;
+};
+
+struct MakeCompactNode {
+    mem::RvalueCompactUniquePtr<CompactNode, CompactNodeArena> operator()(int value) const {
+        return CompactNodeArena::make<CompactNode>(value);
+    }
+};
+
+/**
+ * @brief n посещений узлов: полные проходы по дереву из count узлов.
+ */
+template<class N>
+struct TraverseTree {
+    TraverseTree(const N *root, size_t count): root(root), count(count) {}
+
+    void operator()(size_t n) const {
+        size_t sum = 0;
+        for (size_t pass = 0; pass < n / count; ++pass) {
+            sum += sumTree(*root);
+        }
+        bench::doNotOptimize(sum);
+    }
+
+    const N *root;
+    size_t count;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t depth = bench::iterationsFromArgs(argc, argv, 20);
+    const size_t passes = bench::iterationsFromArgs(argc - 1, argv + 1, 10);
+    const size_t count = (size_t(1) << depth) - 1;
+
+    mem::Arena arena(1024 * 1024);
+    mem::UniquePtr<Node, mem::ArenaDeleter<Node> > root(arena.make<Node>(0));
+    buildTree(root.get(), depth, MakeNode(&arena));
+
+    CompactNodeArena::reserve(count * sizeof(CompactNode) + 2 * CompactNodeArena::Alignment);
+    mem::CompactUniquePtr<CompactNode, CompactNodeArena> compactRoot(
+            CompactNodeArena::make<CompactNode>(0));
+    buildTree(compactRoot.get(), depth, MakeCompactNode());
+
+    std::printf("nodes: %lu, passes: %lu\n", static_cast<unsigned long>(count),
+                static_cast<unsigned long>(passes));
+    std::printf("sizeof(Node) = %lu (arena %lu bytes), sizeof(CompactNode) = %lu "
+                "(arena %lu bytes)\n\n",
+                static_cast<unsigned long>(sizeof(Node)),
+                static_cast<unsigned long>(arena.bytesUsed()),
+                static_cast<unsigned long>(sizeof(CompactNode)),
+                static_cast<unsigned long>(CompactNodeArena::bytesUsed()));
+
+    bench::printHeader();
+    bench::run("tree traversal mem::UniquePtr", count * passes,
+               TraverseTree<Node>(root.get(), count));
+    bench::run("tree traversal mem::CompactUniquePtr", count * passes,
+               TraverseTree<CompactNode>(compactRoot.get(), count));
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include "compact_unique_ptr.h"
+
+/**
+ * Этот файл не должен компилироваться: CompactUniquePtr<Derived> нельзя получить из rvalue
+ * объекта указателя на базовый тип Base. Цель собирается тестом с WILL_FAIL.
+ */
+
+struct Nodes {};
+
+typedef mem::CompactArena<Nodes> NodeArena;
+
+struct Base {
+    virtual ~Base() {}
+};
+
+struct Derived : public Base {
+    int d;
+};
+
+int main() {
+    NodeArena::reserve(4096);
+    mem::CompactUniquePtr<Base, NodeArena> base(NodeArena::make<Base>());
+    mem::CompactUniquePtr<Derived, NodeArena> derived(base.move());
+    return 0;
+}
@@ -0,0 +1,690 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "make_unique.h"
+#include "observer_ptr.h"
+#include "preprocessor.h"
+
+namespace mem {
+
+/**
+ * Уникальный указатель размером 32 бита: вместо адреса хранится смещение объекта от начала
+ * области памяти A. Требования к A (см. CompactArena):
+ * - static char *base() - начало области, все объекты лежат в [base(), base() + 4 ГиБ);
+ * - static const size_t Alignment - минимальное выравнивание объектов области;
+ * - template<class T> static void destroy(T *ptr) - уничтожение объекта, которым владел указатель.
+ * Нулевое смещение означает пустой указатель, поэтому первый байт области не выдается.
+ * Младшие TagBits бит смещения могут хранить тег (например, цвет узла красно-черного дерева):
+ * они всегда нулевые у выровненного адреса, поэтому 1 << TagBits не должно превышать
+ * A::Alignment.
+ */
+
+template<class T, class A, unsigned TagBits>
+class CompactUniquePtr;
+
+namespace detail {
+
+/**
+ * @brief Преобразования между адресом объекта и смещением с тегом.
+ */
+template<class A, unsigned TagBits>
+struct CompactOffset {
+    //! Маска бит тега.
+    static const uint32_t TagMask = (uint32_t(1) << TagBits) - 1;
+
+    //! Ошибка компиляции, если тег не помещается в младшие нулевые биты выровненного смещения.
+    typedef char TagFitsAlignment[(size_t(1) << TagBits) <= A::Alignment ? 1 : -1];
+
+    /**
+     * @brief Смещение объекта от начала области, 0 для NULL.
+     */
+    static uint32_t encode(const void *ptr) {
+        if (ptr == NULL) {
+            return 0;
+        }
+        const size_t offset = static_cast<size_t>(static_cast<const char *>(ptr) - A::base());
+        assert(offset != 0 && offset <= 0xffffffffu && (offset & TagMask) == 0);
+        return static_cast<uint32_t>(offset);
+    }
+
+    /**
+     * @brief Адрес объекта без проверки на пустой указатель: одно сложение (и маска тега).
+     */
+    static void *decode(uint32_t offset) {
+        return A::base() + (offset & ~TagMask);
+    }
+
+    /**
+     * @brief Адрес объекта или NULL для пустого указателя.
+     */
+    static void *pointer(uint32_t offset) {
+        return (offset & ~TagMask) == 0 ? NULL : decode(offset);
+    }
+};
+
+} // namespace detail
+
+/**
+ * @brief rvalue объект CompactUniquePtr: передает владение так же, как RvalueUniquePtr.
+ * @details Копия забирает владение у оригинала; тег передается вместе со смещением.
+ * Обычно используется через псевдоним CompactUniquePtr<T, A, TagBits>::RvalueUniquePtr.
+ * @tparam T Тип объекта хранения.
+ * @tparam A Область памяти, от начала которой отсчитывается смещение.
+ * @tparam TagBits Количество младших бит смещения под тег.
+ */
+template<class T, class A, unsigned TagBits = 0>
+class RvalueCompactUniquePtr {
+public:
+    //! Псевдоним для типа объекта хранения.
+    typedef T ValueType;
+    //! Псевдоним для типа области памяти.
+    typedef A ArenaType;
+
+    /**
+     * @brief Копирующий конструктор класса, забирающий владение у other.
+     */
+    RvalueCompactUniquePtr(const RvalueCompactUniquePtr &other);
+
+    /**
+     * @brief Конструктор от rvalue объекта указателя на производный тип или с другим числом бит
+     * тега.
+     * @details Для несвязанных типов не компилируется. Тег other должен помещаться в TagBits бит.
+     */
+    template<class U, unsigned B>
+    RvalueCompactUniquePtr(const RvalueCompactUniquePtr<U, A, B> &other);
+
+    /**
+     * @brief Деструктор класса. Уничтожает объект, если владение никто не забрал.
+     */
+    ~RvalueCompactUniquePtr();
+
+    /**
+     * @brief Оператор копирования, забирающий владение у other.
+     */
+    RvalueCompactUniquePtr &operator=(const RvalueCompactUniquePtr &other);
+
+    /**
+     * @brief Отказаться от владения объектом хранения без его уничтожения.
+     * @return Указатель на объект хранения.
+     */
+    ValueType *release();
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения.
+     */
+    ObserverPtr<ValueType> borrow() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения только для чтения.
+     */
+    ObserverPtr<const ValueType> borrowConst() const;
+
+private:
+    typedef detail::CompactOffset<A, TagBits> Offset;
+
+    template<class U, class E, unsigned B>
+    friend class CompactUniquePtr;
+
+    template<class U, class E, unsigned B>
+    friend class RvalueCompactUniquePtr;
+
+    /**
+     * @brief Приватный конструктор от смещения с тегом.
+     */
+    explicit RvalueCompactUniquePtr(uint32_t offset);
+
+    /**
+     * @brief Указатель на объект хранения или NULL.
+     */
+    ValueType *get() const;
+
+    /**
+     * @brief Метод для зануления смещения вместе с тегом.
+     */
+    void freeData() const;
+
+    mutable uint32_t offset_; //!< Смещение объекта хранения и тег в младших битах.
+};
+
+/**
+ * @brief Уникальный умный указатель, хранящий 32-битное смещение вместо адреса.
+ * @details Протокол владения тот же, что у UniquePtr: move() возвращает RvalueUniquePtr, от
+ * которого конструируется новый владелец. operator-> и operator* не проверяют указатель на NULL
+ * и сводятся к сложению смещения с началом области.
+ * @tparam T Тип объекта хранения.
+ * @tparam A Область памяти, от начала которой отсчитывается смещение.
+ * @tparam TagBits Количество младших бит смещения под тег.
+ */
+template<class T, class A, unsigned TagBits = 0>
+class CompactUniquePtr {
+public:
+    //! Псевдоним для типа объекта хранения.
+    typedef T ValueType;
+    //! Псевдоним для типа области памяти.
+    typedef A ArenaType;
+    //! Псевдоним для типа rvalue объекта этого умного указателя.
+    typedef RvalueCompactUniquePtr<T, A, TagBits> RvalueUniquePtr;
+
+    /**
+     * @brief Конструктор по умолчанию: пустой указатель с нулевым тегом.
+     */
+    CompactUniquePtr();
+
+    /**
+     * @brief Конструктор от указателя на объект, созданный в области A.
+     */
+    explicit CompactUniquePtr(ValueType *ptr);
+
+    /**
+     * @brief Конструктор от rvalue объекта этого умного указателя.
+     */
+    explicit CompactUniquePtr(const RvalueUniquePtr &rvalue);
+
+    /**
+     * @brief Конструктор от rvalue объекта указателя на производный тип или с другим числом бит
+     * тега.
+     */
+    template<class U, unsigned B>
+    explicit CompactUniquePtr(const RvalueCompactUniquePtr<U, A, B> &rvalue);
+
+    /**
+     * @brief Оператор копирования от rvalue объекта: текущий объект уничтожается.
+     */
+    CompactUniquePtr &operator=(const RvalueUniquePtr &rvalue);
+
+    /**
+     * @brief Оператор копирования от rvalue объекта указателя на производный тип.
+     */
+    template<class U, unsigned B>
+    CompactUniquePtr &operator=(const RvalueCompactUniquePtr<U, A, B> &rvalue);
+
+    /**
+     * @brief Деструктор класса. Уничтожает объект хранения через A::destroy().
+     */
+    ~CompactUniquePtr();
+
+    /**
+     * @brief Передать владение (вместе с тегом) объекту RvalueUniquePtr.
+     */
+    RvalueUniquePtr move();
+
+    /**
+     * @brief Отказаться от владения объектом хранения без его уничтожения. Тег обнуляется.
+     * @return Указатель на объект хранения.
+     */
+    ValueType *release();
+
+    /**
+     * @brief Оператор разыменования. Подразумевает, что указатель не пустой.
+     */
+    ValueType &operator*() const;
+
+    /**
+     * @brief Оператор ->. Подразумевает, что указатель не пустой.
+     */
+    ValueType *operator->() const;
+
+    /**
+     * @brief Получить указатель на объект хранения или NULL.
+     */
+    ValueType *get() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения.
+     */
+    ObserverPtr<ValueType> borrow() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения только для чтения.
+     */
+    ObserverPtr<const ValueType> borrowConst() const;
+
+    /**
+     * @brief Значение тега.
+     */
+    unsigned tag() const;
+
+    /**
+     * @brief Записать тег, не меняя объект хранения.
+     * @param tag Значение тега, меньшее 1 << TagBits.
+     */
+    void setTag(unsigned tag);
+
+private:
+    typedef detail::CompactOffset<A, TagBits> Offset;
+
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    CompactUniquePtr(const CompactUniquePtr &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    CompactUniquePtr &operator=(const CompactUniquePtr &other);
+
+    /**
+     * @brief Уничтожить объект хранения, если он есть.
+     */
+    void destroyData();
+
+    uint32_t offset_; //!< Смещение объекта хранения и тег в младших битах.
+};
+
+/**
+ * @brief Непрерывная область памяти для объектов CompactUniquePtr (bump allocator).
+ * @details Состояние области статическое, поэтому указатель не хранит ссылку на нее, а base()
+ * сводится к чтению одной глобальной переменной. Разные области различаются типом Region
+ * (например, struct TreeNodes {}; typedef CompactArena<TreeNodes> TreeArena;). Память
+ * резервируется одним блоком в reserve() и возвращается целиком в reset(); деструкторы объектов
+ * вызывают сами указатели. Не потокобезопасна.
+ * @tparam Region Тип-метка области.
+ * @tparam MinAlignment Минимальное выравнивание объектов (степень двойки). По умолчанию 4: узел
+ * из двух 32-битных ссылок и int занимает 12 байт без выравнивания до 16, а под тег остается 2 бита.
+ */
+template<class Region, size_t MinAlignment = 4>
+class CompactArena {
+public:
+    //! Минимальное выравнивание объектов: младшие биты смещения свободны под тег.
+    static const size_t Alignment = MinAlignment;
+    //! Наибольший размер области, адресуемый 32-битным смещением.
+    static const size_t MaxCapacity = 0xffffffffu;
+
+    /**
+     * @brief Выделить непрерывный блок памяти под область.
+     * @details Вызывается до первого выделения. Повторный вызов освобождает прежний блок, поэтому
+     * к этому моменту указателей на объекты области остаться не должно.
+     * @throw std::bad_alloc Если не удалось выделить блок.
+     * @param capacity Размер области в байтах, не больше MaxCapacity.
+     */
+    static void reserve(size_t capacity);
+
+    /**
+     * @brief Освободить блок памяти области.
+     */
+    static void release();
+
+    /**
+     * @brief Начало области.
+     */
+    static char *base();
+
+    /**
+     * @brief Выделить память в области.
+     * @throw std::bad_alloc Если в области не осталось места.
+     * @param size Размер памяти в байтах.
+     * @param alignment Выравнивание (степень двойки); не меньше Alignment.
+     */
+    static void *allocate(size_t size, size_t alignment);
+
+    /**
+     * @brief Создать объект в области.
+     * @details Если конструктор бросает исключение, память вернется в область только в reset().
+     * @return Объект класса RvalueCompactUniquePtr.
+     */
+    template<class T>
+    static RvalueCompactUniquePtr<T, CompactArena> make();
+
+#define MEM_COMPACT_MAKE_DECLARATION(n) \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    static RvalueCompactUniquePtr<T, CompactArena> make(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM));
+
+    MEM_COMPACT_MAKE_DECLARATION(1)
+    MEM_COMPACT_MAKE_DECLARATION(2)
+    MEM_COMPACT_MAKE_DECLARATION(3)
+    MEM_COMPACT_MAKE_DECLARATION(4)
+    MEM_COMPACT_MAKE_DECLARATION(5)
+    MEM_COMPACT_MAKE_DECLARATION(6)
+    MEM_COMPACT_MAKE_DECLARATION(7)
+    MEM_COMPACT_MAKE_DECLARATION(8)
+    MEM_COMPACT_MAKE_DECLARATION(9)
+    MEM_COMPACT_MAKE_DECLARATION(10)
+
+#undef MEM_COMPACT_MAKE_DECLARATION
+
+    /**
+     * @brief Вызвать деструктор объекта. Память возвращается в область только в reset().
+     */
+    template<class T>
+    static void destroy(T *ptr);
+
+    /**
+     * @brief Вернуть всю память области разом. Объектов области к этому моменту быть не должно.
+     */
+    static void reset();
+
+    /**
+     * @brief Количество байт, выделенных с последнего reset() (с учетом выравнивания).
+     */
+    static size_t bytesUsed();
+
+    /**
+     * @brief Размер области.
+     */
+    static size_t capacity();
+
+private:
+    /**
+     * @brief Состояние области. Инициализируется константой, поэтому не требует защиты
+     * при первом обращении.
+     */
+    struct State {
+        char *base; //!< Начало блока памяти.
+        size_t capacity; //!< Размер блока.
+        size_t offset; //!< Смещение первого свободного байта.
+    };
+
+    static State state_; //!< Состояние области.
+};
+
+/**
+    template<class T, class A, unsigned TagBits>
+    class RvalueCompactUniquePtr
+ **/
+template<class T, class A, unsigned TagBits>
+RvalueCompactUniquePtr<T, A, TagBits>::RvalueCompactUniquePtr(uint32_t offset):
+offset_(offset) {
+}
+
+template<class T, class A, unsigned TagBits>
+RvalueCompactUniquePtr<T, A, TagBits>::RvalueCompactUniquePtr(const RvalueCompactUniquePtr &other):
+offset_(other.offset_) {
+    other.freeData();
+}
+
+template<class T, class A, unsigned TagBits>
+template<class U, unsigned B>
+RvalueCompactUniquePtr<T, A, TagBits>::RvalueCompactUniquePtr(
+        const RvalueCompactUniquePtr<U, A, B> &other):
+offset_(0) {
+    ValueType *converted = other.get();
+    offset_ = Offset::encode(converted);
+    const uint32_t tag = other.offset_ & RvalueCompactUniquePtr<U, A, B>::Offset::TagMask;
+    assert((tag & ~Offset::TagMask) == 0);
+    offset_ |= tag;
+    other.freeData();
+}
+
+template<class T, class A, unsigned TagBits>
+RvalueCompactUniquePtr<T, A, TagBits>::~RvalueCompactUniquePtr() {
+    ValueType *ptr = get();
+    if (ptr != NULL) {
+        A::destroy(ptr);
+    }
+}
+
+template<class T, class A, unsigned TagBits>
+RvalueCompactUniquePtr<T, A, TagBits> &RvalueCompactUniquePtr<T, A, TagBits>::operator=(
+        const RvalueCompactUniquePtr &other) {
+    if (this == &other) {
+        return *this;
+    }
+    ValueType *ptr = get();
+    if (ptr != NULL) {
+        A::destroy(ptr);
+    }
+    offset_ = other.offset_;
+    other.freeData();
+
+    return *this;
+}
+
+template<class T, class A, unsigned TagBits>
+typename RvalueCompactUniquePtr<T, A, TagBits>::ValueType *
+        RvalueCompactUniquePtr<T, A, TagBits>::release() {
+    ValueType *ptr = get();
+    freeData();
+    return ptr;
+}
+
+template<class T, class A, unsigned TagBits>
+ObserverPtr<typename RvalueCompactUniquePtr<T, A, TagBits>::ValueType>
+        RvalueCompactUniquePtr<T, A, TagBits>::borrow() const {
+    return ObserverPtr<ValueType>(get());
+}
+
+template<class T, class A, unsigned TagBits>
+ObserverPtr<const typename RvalueCompactUniquePtr<T, A, TagBits>::ValueType>
+        RvalueCompactUniquePtr<T, A, TagBits>::borrowConst() const {
+    return ObserverPtr<const ValueType>(get());
+}
+
+template<class T, class A, unsigned TagBits>
+typename RvalueCompactUniquePtr<T, A, TagBits>::ValueType *
+        RvalueCompactUniquePtr<T, A, TagBits>::get() const {
+    return static_cast<ValueType *>(Offset::pointer(offset_));
+}
+
+template<class T, class A, unsigned TagBits>
+void RvalueCompactUniquePtr<T, A, TagBits>::freeData() const {
+    offset_ = 0;
+}
+
+/**
+    template<class T, class A, unsigned TagBits>
+    class CompactUniquePtr
+ **/
+template<class T, class A, unsigned TagBits>
+CompactUniquePtr<T, A, TagBits>::CompactUniquePtr():
+offset_(0) {
+}
+
+template<class T, class A, unsigned TagBits>
+CompactUniquePtr<T, A, TagBits>::CompactUniquePtr(ValueType *ptr):
+offset_(Offset::encode(ptr)) {
+}
+
+template<class T, class A, unsigned TagBits>
+CompactUniquePtr<T, A, TagBits>::CompactUniquePtr(const RvalueUniquePtr &rvalue):
+offset_(rvalue.offset_) {
+    rvalue.freeData();
+}
+
+template<class T, class A, unsigned TagBits>
+template<class U, unsigned B>
+CompactUniquePtr<T, A, TagBits>::CompactUniquePtr(const RvalueCompactUniquePtr<U, A, B> &rvalue):
+offset_(0) {
+    RvalueUniquePtr converted(rvalue);
+    offset_ = converted.offset_;
+    converted.freeData();
+}
+
+template<class T, class A, unsigned TagBits>
+CompactUniquePtr<T, A, TagBits> &CompactUniquePtr<T, A, TagBits>::operator=(
+        const RvalueUniquePtr &rvalue) {
+    if (Offset::pointer(offset_) != rvalue.get()) {
+        destroyData();
+    }
+    offset_ = rvalue.offset_;
+    rvalue.freeData();
+
+    return *this;
+}
+
+template<class T, class A, unsigned TagBits>
+template<class U, unsigned B>
+CompactUniquePtr<T, A, TagBits> &CompactUniquePtr<T, A, TagBits>::operator=(
+        const RvalueCompactUniquePtr<U, A, B> &rvalue) {
+    return *this = RvalueUniquePtr(rvalue);
+}
+
+template<class T, class A, unsigned TagBits>
+CompactUniquePtr<T, A, TagBits>::~CompactUniquePtr() {
+    destroyData();
+}
+
+template<class T, class A, unsigned TagBits>
+typename CompactUniquePtr<T, A, TagBits>::RvalueUniquePtr CompactUniquePtr<T, A, TagBits>::move() {
+    RvalueUniquePtr rvalue(offset_);
+    offset_ = 0;
+    return rvalue;
+}
+
+template<class T, class A, unsigned TagBits>
+typename CompactUniquePtr<T, A, TagBits>::ValueType *CompactUniquePtr<T, A, TagBits>::release() {
+    ValueType *ptr = get();
+    offset_ = 0;
+    return ptr;
+}
+
+template<class T, class A, unsigned TagBits>
+typename CompactUniquePtr<T, A, TagBits>::ValueType &
+        CompactUniquePtr<T, A, TagBits>::operator*() const {
+    return *static_cast<ValueType *>(Offset::decode(offset_));
+}
+
+template<class T, class A, unsigned TagBits>
+typename CompactUniquePtr<T, A, TagBits>::ValueType *
+        CompactUniquePtr<T, A, TagBits>::operator->() const {
+    return static_cast<ValueType *>(Offset::decode(offset_));
+}
+
+template<class T, class A, unsigned TagBits>
+typename CompactUniquePtr<T, A, TagBits>::ValueType *CompactUniquePtr<T, A, TagBits>::get() const {
+    return static_cast<ValueType *>(Offset::pointer(offset_));
+}
+
+template<class T, class A, unsigned TagBits>
+ObserverPtr<typename CompactUniquePtr<T, A, TagBits>::ValueType>
+        CompactUniquePtr<T, A, TagBits>::borrow() const {
+    return ObserverPtr<ValueType>(get());
+}
+
+template<class T, class A, unsigned TagBits>
+ObserverPtr<const typename CompactUniquePtr<T, A, TagBits>::ValueType>
+        CompactUniquePtr<T, A, TagBits>::borrowConst() const {
+    return ObserverPtr<const ValueType>(get());
+}
+
+template<class T, class A, unsigned TagBits>
+unsigned CompactUniquePtr<T, A, TagBits>::tag() const {
+    return offset_ & Offset::TagMask;
+}
+
+template<class T, class A, unsigned TagBits>
+void CompactUniquePtr<T, A, TagBits>::setTag(unsigned tag) {
+    assert((tag & ~Offset::TagMask) == 0);
+    offset_ = (offset_ & ~Offset::TagMask) | tag;
+}
+
+template<class T, class A, unsigned TagBits>
+void CompactUniquePtr<T, A, TagBits>::destroyData() {
+    ValueType *ptr = get();
+    if (ptr != NULL) {
+        A::destroy(ptr);
+    }
+}
+
+/**
+    template<class Region, size_t MinAlignment>
+    class CompactArena
+ **/
+template<class Region, size_t MinAlignment>
+const size_t CompactArena<Region, MinAlignment>::Alignment;
+
+template<class Region, size_t MinAlignment>
+const size_t CompactArena<Region, MinAlignment>::MaxCapacity;
+
+template<class Region, size_t MinAlignment>
+typename CompactArena<Region, MinAlignment>::State CompactArena<Region, MinAlignment>::state_ =
+        {NULL, 0, 0};
+
+template<class Region, size_t MinAlignment>
+void CompactArena<Region, MinAlignment>::reserve(size_t capacity) {
+    assert(capacity <= MaxCapacity);
+    release();
+    state_.base = static_cast<char *>(::operator new(capacity));
+    state_.capacity = capacity;
+    reset();
+}
+
+template<class Region, size_t MinAlignment>
+void CompactArena<Region, MinAlignment>::release() {
+    ::operator delete(state_.base);
+    state_.base = NULL;
+    state_.capacity = 0;
+    state_.offset = 0;
+}
+
+template<class Region, size_t MinAlignment>
+char *CompactArena<Region, MinAlignment>::base() {
+    return state_.base;
+}
+
+template<class Region, size_t MinAlignment>
+void *CompactArena<Region, MinAlignment>::allocate(size_t size, size_t alignment) {
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    if (alignment < Alignment) {
+        alignment = Alignment;
+    }
+
+    const size_t address = reinterpret_cast<size_t>(state_.base + state_.offset);
+    const size_t padding = ((address + alignment - 1) & ~(alignment - 1)) - address;
+    const size_t aligned = state_.offset + padding;
+    if (state_.base == NULL || aligned > state_.capacity || size > state_.capacity - aligned) {
+        throw std::bad_alloc();
+    }
+    state_.offset = aligned + size;
+    return state_.base + aligned;
+}
+
+template<class Region, size_t MinAlignment>
+template<class T>
+RvalueCompactUniquePtr<T, CompactArena<Region, MinAlignment> >
+        CompactArena<Region, MinAlignment>::make() {
+    T *ptr = new (allocate(sizeof(T), detail::AlignOf<T>::value)) T();
+    return CompactUniquePtr<T, CompactArena>(ptr).move();
+}
+
+#define MEM_COMPACT_MAKE_DEFINITION(n) \
+    template<class Region, size_t MinAlignment> \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvalueCompactUniquePtr<T, CompactArena<Region, MinAlignment> > \
+            CompactArena<Region, MinAlignment>::make(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        T *ptr = new (allocate(sizeof(T), detail::AlignOf<T>::value)) \
+                T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+        return CompactUniquePtr<T, CompactArena>(ptr).move(); \
+    }
+
+MEM_COMPACT_MAKE_DEFINITION(1)
+MEM_COMPACT_MAKE_DEFINITION(2)
+MEM_COMPACT_MAKE_DEFINITION(3)
+MEM_COMPACT_MAKE_DEFINITION(4)
+MEM_COMPACT_MAKE_DEFINITION(5)
+MEM_COMPACT_MAKE_DEFINITION(6)
+MEM_COMPACT_MAKE_DEFINITION(7)
+MEM_COMPACT_MAKE_DEFINITION(8)
+MEM_COMPACT_MAKE_DEFINITION(9)
+MEM_COMPACT_MAKE_DEFINITION(10)
+
+#undef MEM_COMPACT_MAKE_DEFINITION
+
+template<class Region, size_t MinAlignment>
+template<class T>
+void CompactArena<Region, MinAlignment>::destroy(T *ptr) {
+    ptr->~T();
+}
+
+template<class Region, size_t MinAlignment>
+void CompactArena<Region, MinAlignment>::reset() {
+    // Нулевое смещение зарезервировано под пустой указатель.
+    state_.offset = state_.base == NULL ? 0 : Alignment;
+}
+
+template<class Region, size_t MinAlignment>
+size_t CompactArena<Region, MinAlignment>::bytesUsed() {
+    return state_.offset;
+}
+
+template<class Region, size_t MinAlignment>
+size_t CompactArena<Region, MinAlignment>::capacity() {
+    return state_.capacity;
+}
+
+} // namespace mem
@@ -0,0 +1,40 @@
+# Usage: cmake -DOBJDUMP=<objdump> -DFIRST=<object> -DSECOND=<object> -P compare_disassembly.cmake
+# Fails if the disassembly of the two object files differs (the file name header is ignored) and
+# names the functions whose code differs.
+
+foreach(object FIRST SECOND)
+    execute_process(COMMAND ${OBJDUMP} -d --no-show-raw-insn ${${object}}
+                    OUTPUT_VARIABLE disassembly
+                    RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${OBJDUMP} failed on ${${object}}")
+    endif()
+    string(REGEX REPLACE "[^\n]*file format[^\n]*\n" "" disassembly "${disassembly}")
+    set(${object}_DISASSEMBLY "${disassembly}")
+
+    # One block per function: "<address> <name>:" followed by its instructions up to a blank line
+    string(REPLACE ";" "," escaped "${disassembly}")
+    string(REGEX MATCHALL "[0-9a-f]+ <[^>\n]+>:\n([^\n]+\n)*" blocks "${escaped}")
+    set(${object}_FUNCTIONS "")
+    foreach(block IN LISTS blocks)
+        string(REGEX MATCH "^[0-9a-f]+ <([^>\n]+)>:" header "${block}")
+        list(APPEND ${object}_FUNCTIONS "${CMAKE_MATCH_1}")
+        set("${object}_CODE_${CMAKE_MATCH_1}" "${block}")
+    endforeach()
+endforeach()
+
+if(NOT FIRST_DISASSEMBLY STREQUAL SECOND_DISASSEMBLY)
+    set(differing "")
+    foreach(function IN LISTS FIRST_FUNCTIONS SECOND_FUNCTIONS)
+        if(NOT "${FIRST_CODE_${function}}" STREQUAL "${SECOND_CODE_${function}}")
+            list(APPEND differing "${function}")
+        endif()
+    endforeach()
+    list(REMOVE_DUPLICATES differing)
+    string(REPLACE ";" ", " differing "${differing}")
+
+    file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/first.s "${FIRST_DISASSEMBLY}")
+    file(WRITE ${CMAKE_CURRENT_BINARY_DIR}/second.s "${SECOND_DISASSEMBLY}")
+    message(FATAL_ERROR "Disassembly differs in: ${differing}\n"
+                        "Compare first.s and second.s in ${CMAKE_CURRENT_BINARY_DIR}")
+endif()
@@ -0,0 +1,20 @@
+#include "unique_ptr.h"
+
+/**
+ * Этот файл не должен компилироваться: UniquePtr<Foo> нельзя получить из rvalue объекта
+ * умного указателя на несвязанный тип Bar. Цель собирается тестом с WILL_FAIL.
+ */
+
+struct Foo {
+    virtual ~Foo() {}
+};
+
+struct Bar {
+    virtual ~Bar() {}
+};
+
+int main() {
+    mem::UniquePtr<Bar> bar(new Bar());
+    mem::UniquePtr<Foo> foo(bar.move());
+    return 0;
+}
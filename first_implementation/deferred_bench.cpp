@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "benchmark.h"
+#include "deferred_deleter.h"
+#include "unique_ptr.h"
+
+/**
+ * Задержка освобождения UniquePtr во владеющем потоке: mem::Deleter против mem::DeferredDeleter
+ * для объектов из 1 и 20000 узлов. Печатается p50 и p99 по выборке (по умолчанию 200 замеров,
+ * первый аргумент). Отложенные объекты уничтожаются flushDeferred() после выборки, вне замера.
+ */
+
+namespace {
+
+struct Node {
+    explicit Node(size_t id): id(id) {}
+
+    size_t id;
+};
+
+struct Payload {
+    explicit Payload(size_t nodes) {
+        for (size_t i = 0; i < nodes; ++i) {
+            nodes_.push_back(new Node(i));
+        }
+    }
+
+    ~Payload() {
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            delete nodes_[i];
+        }
+    }
+
+    std::vector<Node *> nodes_;
+};
+
+/**
+ * @brief Замеряет освобождение UniquePtr<Payload, D> из nodes узлов и печатает p50 и p99.
+ */
+template<class D>
+void runRelease(const char *name, size_t nodes, size_t samples) {
+    std::vector<double> latencies;
+    latencies.reserve(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        double start = 0;
+        {
+            mem::UniquePtr<Payload, D> p(new Payload(nodes));
+            start = bench::nowNs();
+        }
+        latencies.push_back(bench::nowNs() - start);
+    }
+    mem::flushDeferred();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%-44s %10lu %12.0f %12.0f\n", name, static_cast<unsigned long>(nodes),
+                latencies[samples / 2], latencies[samples * 99 / 100]);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t samples = bench::iterationsFromArgs(argc, argv, 200);
+
+    std::printf("%-44s %10s %12s %12s\n", "benchmark", "nodes", "p50 ns", "p99 ns");
+    runRelease<mem::Deleter<Payload> >("release mem::Deleter", 1, samples);
+    runRelease<mem::Deleter<Payload> >("release mem::Deleter", 20000, samples);
+    runRelease<mem::DeferredDeleter<Payload> >("release mem::DeferredDeleter", 1, samples);
+    runRelease<mem::DeferredDeleter<Payload> >("release mem::DeferredDeleter", 20000, samples);
+    return 0;
+}
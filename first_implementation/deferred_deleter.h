@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cstddef>
+
+#include <pthread.h>
+
+#include "atomic.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+/**
+ * @brief Объект, ожидающий уничтожения, и функция, вызывающая его деструктор.
+ */
+struct DeferredItem {
+    void *ptr; //!< Указатель на объект.
+    void (*destroy)(void *); //!< Функция уничтожения объекта нужного типа.
+};
+
+/**
+ * @brief Пакет объектов, ожидающих уничтожения.
+ * @details Пока пакет заполняется, он принадлежит одному потоку и не требует синхронизации.
+ * Заполненный пакет целиком передается в общий список за один захват мьютекса.
+ */
+struct DeferredBatch {
+    DeferredBatch *next; //!< Следующий пакет в общем списке.
+    size_t size; //!< Количество объектов в пакете.
+    size_t capacity; //!< Вместимость пакета.
+    DeferredItem *items; //!< Объекты пакета.
+};
+
+/**
+ * @brief Общее состояние отложенного уничтожения.
+ */
+struct DeferredState {
+    pthread_mutex_t mutex; //!< Защищает submitted, pending и running.
+    pthread_cond_t wakeup; //!< Будит фоновый поток при передаче пакета.
+    DeferredBatch *submitted; //!< Пакеты, переданные на уничтожение.
+    size_t pending; //!< Количество объектов в переданных пакетах.
+    size_t batchSize; //!< Вместимость новых пакетов.
+    size_t highWater; //!< Порог pending, после которого поток уничтожает объекты сам.
+    bool running; //!< Запущен ли фоновый поток.
+    pthread_t reclaimer; //!< Фоновый поток.
+};
+
+inline DeferredState &deferredState() {
+    static DeferredState state = {
+        PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 256, 65536, false, pthread_t()
+    };
+    return state;
+}
+
+template<class T>
+void deferredDestroy(void *ptr) {
+    delete static_cast<T *>(ptr);
+}
+
+inline DeferredBatch *newDeferredBatch(size_t capacity) {
+    DeferredBatch *batch = new DeferredBatch;
+    batch->next = NULL;
+    batch->size = 0;
+    batch->capacity = capacity;
+    batch->items = new DeferredItem[capacity];
+    return batch;
+}
+
+inline void deleteDeferredBatch(DeferredBatch *batch) {
+    delete[] batch->items;
+    delete batch;
+}
+
+/**
+ * @brief Уничтожить все переданные пакеты в вызывающем потоке.
+ * @return true, если был уничтожен хотя бы один объект.
+ */
+inline bool drainDeferred() {
+    DeferredState &state = deferredState();
+    pthread_mutex_lock(&state.mutex);
+    DeferredBatch *batch = state.submitted;
+    state.submitted = NULL;
+    state.pending = 0;
+    pthread_mutex_unlock(&state.mutex);
+
+    const bool destroyed = batch != NULL;
+    while (batch != NULL) {
+        DeferredBatch *next = batch->next;
+        for (size_t i = 0; i < batch->size; ++i) {
+            batch->items[i].destroy(batch->items[i].ptr);
+        }
+        deleteDeferredBatch(batch);
+        batch = next;
+    }
+    return destroyed;
+}
+
+/**
+ * @brief Передать пакет на уничтожение.
+ * @details Если после этого ожидают уничтожения больше объектов, чем highWater, вызывающий поток
+ * уничтожает их сам, чтобы объем отложенной памяти оставался ограниченным.
+ */
+inline void submitDeferredBatch(DeferredBatch *batch) {
+    if (batch->size == 0) {
+        deleteDeferredBatch(batch);
+        return;
+    }
+
+    DeferredState &state = deferredState();
+    pthread_mutex_lock(&state.mutex);
+    batch->next = state.submitted;
+    state.submitted = batch;
+    state.pending += batch->size;
+    const bool overflow = state.pending > state.highWater;
+    pthread_cond_signal(&state.wakeup);
+    pthread_mutex_unlock(&state.mutex);
+
+    if (overflow) {
+        drainDeferred();
+    }
+}
+
+inline void submitDeferredBatchOnExit(void *batch) {
+    submitDeferredBatch(static_cast<DeferredBatch *>(batch));
+}
+
+inline pthread_key_t &deferredKeyStorage() {
+    static pthread_key_t key;
+    return key;
+}
+
+inline void createDeferredKey() {
+    pthread_key_create(&deferredKeyStorage(), submitDeferredBatchOnExit);
+}
+
+/**
+ * @brief Ключ, по которому хранится текущий пакет потока.
+ * @details При завершении потока незаполненный пакет передается на уничтожение.
+ */
+inline pthread_key_t deferredKey() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createDeferredKey);
+    return deferredKeyStorage();
+}
+
+/**
+ * @brief Передать на уничтожение текущий пакет потока, даже если он не заполнен.
+ */
+inline void submitCurrentDeferredBatch() {
+    DeferredBatch *batch = static_cast<DeferredBatch *>(pthread_getspecific(deferredKey()));
+    if (batch != NULL) {
+        pthread_setspecific(deferredKey(), NULL);
+        submitDeferredBatch(batch);
+    }
+}
+
+/**
+ * @brief Добавить объект в текущий пакет потока.
+ */
+inline void deferDestroy(void *ptr, void (*destroy)(void *)) {
+    const pthread_key_t key = deferredKey();
+    DeferredBatch *batch = static_cast<DeferredBatch *>(pthread_getspecific(key));
+    if (batch == NULL) {
+        batch = newDeferredBatch(atomicLoadRelaxed(&deferredState().batchSize));
+        pthread_setspecific(key, batch);
+    }
+
+    batch->items[batch->size].ptr = ptr;
+    batch->items[batch->size].destroy = destroy;
+    if (++batch->size == batch->capacity) {
+        pthread_setspecific(key, NULL);
+        submitDeferredBatch(batch);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Класс-функтор, откладывающий уничтожение объекта.
+ * @details Вместо вызова деструктора добавляет указатель и функцию уничтожения в пакет текущего
+ * потока, поэтому время освобождения UniquePtr не зависит от размера графа объектов. Пакеты
+ * уничтожаются фоновым потоком (startDeferredReclaimer()) или явным вызовом flushDeferred().
+ * Незаполненный пакет потока передается на уничтожение при flushDeferred() в этом потоке или при
+ * его завершении.
+ * @tparam T Тип объекта.
+ */
+template<class T>
+struct DeferredDeleter {
+    DeferredDeleter() {}
+
+    /**
+     * @brief Конструктор от функтора для производного типа.
+     */
+    template<class U>
+    DeferredDeleter(const DeferredDeleter<U> &) {}
+
+    /**
+     * @brief Конструктор от обычного функтора, чтобы принимать результат makeUnique().
+     */
+    template<class U>
+    DeferredDeleter(const Deleter<U> &) {}
+
+    void operator()(T *ptr) {
+        if (ptr != NULL) {
+            detail::deferDestroy(ptr, &detail::deferredDestroy<T>);
+        }
+    }
+};
+
+/**
+ * @brief Уничтожить в вызывающем потоке все объекты, переданные на отложенное уничтожение,
+ * включая незаполненный пакет этого потока.
+ * @details Объекты, отложенные деструкторами уничтожаемых объектов, тоже уничтожаются.
+ */
+inline void flushDeferred() {
+    do {
+        detail::submitCurrentDeferredBatch();
+    } while (detail::drainDeferred());
+}
+
+/**
+ * @brief Задать вместимость новых пакетов (количество объектов, после которого пакет потока
+ * передается на уничтожение).
+ */
+inline void setDeferredBatchSize(size_t size) {
+    detail::atomicStore(&detail::deferredState().batchSize, size == 0 ? 1 : size);
+}
+
+/**
+ * @brief Задать порог количества ожидающих объектов, после которого поток, передающий пакет,
+ * уничтожает их сам.
+ */
+inline void setDeferredHighWater(size_t highWater) {
+    detail::DeferredState &state = detail::deferredState();
+    pthread_mutex_lock(&state.mutex);
+    state.highWater = highWater;
+    pthread_mutex_unlock(&state.mutex);
+}
+
+/**
+ * @brief Количество объектов в переданных, но еще не уничтоженных пакетах.
+ */
+inline size_t deferredPending() {
+    detail::DeferredState &state = detail::deferredState();
+    pthread_mutex_lock(&state.mutex);
+    const size_t pending = state.pending;
+    pthread_mutex_unlock(&state.mutex);
+    return pending;
+}
+
+namespace detail {
+
+inline void *runDeferredReclaimer(void *) {
+    DeferredState &state = deferredState();
+    for (;;) {
+        pthread_mutex_lock(&state.mutex);
+        while (state.running && state.submitted == NULL) {
+            pthread_cond_wait(&state.wakeup, &state.mutex);
+        }
+        const bool running = state.running;
+        pthread_mutex_unlock(&state.mutex);
+
+        flushDeferred();
+        if (!running) {
+            return NULL;
+        }
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Запустить фоновый поток, уничтожающий переданные пакеты.
+ * @return false, если поток уже запущен или не удалось его создать.
+ */
+inline bool startDeferredReclaimer() {
+    detail::DeferredState &state = detail::deferredState();
+    pthread_mutex_lock(&state.mutex);
+    bool started = false;
+    if (!state.running) {
+        state.running = true;
+        started = pthread_create(&state.reclaimer, NULL, detail::runDeferredReclaimer, NULL) == 0;
+        state.running = started;
+    }
+    pthread_mutex_unlock(&state.mutex);
+    return started;
+}
+
+/**
+ * @brief Остановить фоновый поток, дождавшись уничтожения переданных пакетов.
+ */
+inline void stopDeferredReclaimer() {
+    detail::DeferredState &state = detail::deferredState();
+    pthread_mutex_lock(&state.mutex);
+    const bool running = state.running;
+    state.running = false;
+    pthread_cond_signal(&state.wakeup);
+    pthread_mutex_unlock(&state.mutex);
+
+    if (running) {
+        pthread_join(state.reclaimer, NULL);
+    }
+}
+
+} // namespace mem
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include <pthread.h>
+
+#include "atomic.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+/**
+ * @brief Домен безопасного освобождения памяти на основе эпох (epoch-based reclamation).
+ * @details Читатели обращаются к разделяемым объектам только внутри EpochDomain::Guard и
+ * объявляют эпоху, в которой вошли. Владелец, отказавшийся от объекта, передает его в retire():
+ * объект попадает в одну из трех корзин текущего потока, помеченную эпохой, и освобождается,
+ * только когда глобальная эпоха продвинется на две вперед, то есть когда все читатели, которые
+ * могли его видеть, вышли из своих эпох. Чтение не использует блокировок, retire() стоит O(1)
+ * амортизированно: эпоха продвигается раз в AdvanceInterval вызовов retire() в потоке.
+ * Корзины потока, завершившегося с неосвобожденными объектами, переходят к следующему
+ * зарегистрированному потоку или освобождаются в деструкторе домена.
+ */
+class EpochDomain {
+private:
+    struct Record;
+
+public:
+    //! Количество retire() в потоке между попытками продвинуть эпоху.
+    static const size_t AdvanceInterval = 64;
+
+    /**
+     * @brief Критическая секция читателя.
+     * @details Пока объект жив, объекты, полученные читателем из разделяемых структур, не будут
+     * освобождены. Секции могут быть вложенными.
+     */
+    class Guard {
+    public:
+        explicit Guard(EpochDomain &domain);
+        ~Guard();
+
+    private:
+        Guard(const Guard &other);
+        Guard &operator=(const Guard &other);
+
+        Record *record_; //!< Запись текущего потока.
+    };
+
+    EpochDomain();
+
+    /**
+     * @brief Деструктор класса. Освобождает все переданные в retire() объекты.
+     * @details Подразумевает, что ни один поток уже не находится внутри Guard.
+     */
+    ~EpochDomain();
+
+    /**
+     * @brief Передать объект на освобождение после выхода всех читателей из текущей эпохи.
+     * @param ptr Указатель на объект, уже недоступный новым читателям.
+     * @param destroy Функция уничтожения объекта.
+     */
+    void retire(void *ptr, void (*destroy)(void *));
+
+    /**
+     * @brief Передать объект типа T на освобождение через delete.
+     */
+    template<class T>
+    void retire(T *ptr);
+
+    /**
+     * @brief Попытаться продвинуть эпоху и освободить объекты текущего потока, которые уже
+     * не могут быть видны читателям.
+     */
+    void collect();
+
+    /**
+     * @brief Количество объектов текущего потока, ожидающих освобождения.
+     */
+    size_t pending();
+
+    /**
+     * @brief Текущая глобальная эпоха.
+     */
+    size_t epoch() const;
+
+private:
+    /**
+     * @brief Объект, ожидающий освобождения.
+     */
+    struct RetiredItem {
+        void *ptr; //!< Указатель на объект.
+        void (*destroy)(void *); //!< Функция уничтожения объекта.
+    };
+
+    /**
+     * @brief Объекты, переданные в retire() в одной эпохе.
+     */
+    struct Bag {
+        size_t epoch; //!< Эпоха, в которой объекты переданы в retire().
+        std::vector<RetiredItem> items; //!< Объекты корзины.
+    };
+
+    /**
+     * @brief Запись потока, зарегистрированного в домене.
+     * @details Записи не удаляются до уничтожения домена и переиспользуются новыми потоками.
+     */
+    struct Record {
+        size_t state; //!< Эпоха читателя, сдвинутая на бит, и признак активности в младшем бите.
+        char padding[detail::CacheLineSize]; //!< Отделяет state от данных владельца записи.
+        size_t depth; //!< Глубина вложенности Guard.
+        size_t retired; //!< Количество retire() с последней попытки продвинуть эпоху.
+        bool inUse; //!< Занята ли запись потоком.
+        Bag bags[3]; //!< Корзины для эпох с остатками 0, 1, 2 по модулю 3.
+        Record *next; //!< Следующая запись домена.
+        EpochDomain *domain; //!< Домен записи.
+    };
+
+    friend class Guard;
+
+    EpochDomain(const EpochDomain &other);
+    EpochDomain &operator=(const EpochDomain &other);
+
+    /**
+     * @brief Запись текущего потока (регистрирует поток при первом обращении).
+     */
+    Record *record();
+
+    /**
+     * @brief Продвинуть эпоху, если все активные читатели находятся в текущей.
+     */
+    void tryAdvance();
+
+    /**
+     * @brief Освободить корзины записи, объекты которых уже не видны читателям.
+     */
+    void reclaim(Record *record);
+
+    /**
+     * @brief Уничтожить объекты корзины.
+     */
+    static void freeBag(Bag &bag);
+
+    /**
+     * @brief Освободить запись потока при его завершении.
+     */
+    static void releaseRecord(void *record);
+
+    template<class T>
+    static void destroyObject(void *ptr);
+
+    size_t epoch_; //!< Глобальная эпоха.
+    Record *records_; //!< Записи потоков.
+    pthread_key_t key_; //!< Ключ, по которому поток хранит свою запись.
+    pthread_mutex_t mutex_; //!< Защищает регистрацию потоков.
+};
+
+/**
+ * @brief Класс-функтор, передающий объект в EpochDomain::retire().
+ * @details Позволяет UniquePtr и AtomicUniquePtr отдавать объекты, которые могут читать другие
+ * потоки: деструктор вызывается, только когда читателей объекта не осталось.
+ * @tparam T Тип объекта.
+ */
+template<class T>
+struct EpochDeleter {
+    EpochDeleter(): domain_(NULL) {}
+
+    explicit EpochDeleter(EpochDomain *domain): domain_(domain) {}
+
+    /**
+     * @brief Конструктор от функтора для производного типа.
+     */
+    template<class U>
+    EpochDeleter(const EpochDeleter<U> &other): domain_(other.domain()) {}
+
+    void operator()(T *ptr) {
+        if (ptr != NULL) {
+            assert(domain_ != NULL);
+            domain_->retire(ptr);
+        }
+    }
+
+    EpochDomain *domain() const {
+        return domain_;
+    }
+
+private:
+    EpochDomain *domain_; //!< Домен, в который передаются объекты.
+};
+
+/** class EpochDomain::Guard **/
+
+inline EpochDomain::Guard::Guard(EpochDomain &domain):
+record_(domain.record()) {
+    if (record_->depth++ == 0) {
+        detail::atomicStore(&record_->state, (detail::atomicLoad(&domain.epoch_) << 1) | 1);
+        // Объявление эпохи должно стать видимым до чтения разделяемых указателей.
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+inline EpochDomain::Guard::~Guard() {
+    if (--record_->depth == 0) {
+        detail::atomicStore(&record_->state, size_t(0));
+    }
+}
+
+/** class EpochDomain **/
+
+inline EpochDomain::EpochDomain():
+epoch_(0),
+records_(NULL) {
+    pthread_key_create(&key_, releaseRecord);
+    pthread_mutex_init(&mutex_, NULL);
+}
+
+inline EpochDomain::~EpochDomain() {
+    pthread_key_delete(key_);
+    while (records_ != NULL) {
+        Record *next = records_->next;
+        assert(records_->depth == 0);
+        for (size_t i = 0; i < 3; ++i) {
+            freeBag(records_->bags[i]);
+        }
+        delete records_;
+        records_ = next;
+    }
+    pthread_mutex_destroy(&mutex_);
+}
+
+inline void EpochDomain::retire(void *ptr, void (*destroy)(void *)) {
+    Record *current = record();
+
+    // Объект уже отсоединен от разделяемой структуры, эпоха читается после этого.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const size_t epoch = detail::atomicLoad(&epoch_);
+
+    // В корзине с тем же остатком лежат объекты эпохи не позже epoch - 3, они уже не видны.
+    Bag &bag = current->bags[epoch % 3];
+    if (bag.epoch != epoch) {
+        freeBag(bag);
+        bag.epoch = epoch;
+    }
+
+    RetiredItem item = {ptr, destroy};
+    bag.items.push_back(item);
+
+    if (++current->retired >= AdvanceInterval) {
+        current->retired = 0;
+        tryAdvance();
+        reclaim(current);
+    }
+}
+
+template<class T>
+void EpochDomain::retire(T *ptr) {
+    retire(ptr, &destroyObject<T>);
+}
+
+inline void EpochDomain::collect() {
+    Record *current = record();
+    tryAdvance();
+    reclaim(current);
+}
+
+inline size_t EpochDomain::pending() {
+    Record *current = record();
+    size_t count = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        count += current->bags[i].items.size();
+    }
+    return count;
+}
+
+inline size_t EpochDomain::epoch() const {
+    return detail::atomicLoad(&epoch_);
+}
+
+inline EpochDomain::Record *EpochDomain::record() {
+    Record *current = static_cast<Record *>(pthread_getspecific(key_));
+    if (current != NULL) {
+        return current;
+    }
+
+    pthread_mutex_lock(&mutex_);
+    for (current = records_; current != NULL; current = current->next) {
+        if (!current->inUse) {
+            break;
+        }
+    }
+    if (current == NULL) {
+        current = new Record;
+        current->state = 0;
+        current->depth = 0;
+        current->retired = 0;
+        for (size_t i = 0; i < 3; ++i) {
+            current->bags[i].epoch = 0;
+        }
+        current->domain = this;
+        current->next = records_;
+        detail::atomicStore(&records_, current);
+    }
+    current->inUse = true;
+    pthread_mutex_unlock(&mutex_);
+
+    pthread_setspecific(key_, current);
+    return current;
+}
+
+inline void EpochDomain::tryAdvance() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    size_t epoch = detail::atomicLoad(&epoch_);
+    for (Record *record = detail::atomicLoad(&records_); record != NULL; record = record->next) {
+        const size_t state = detail::atomicLoad(&record->state);
+        if ((state & 1) != 0 && (state >> 1) != epoch) {
+            return;
+        }
+    }
+    detail::atomicCompareExchange(&epoch_, epoch, epoch + 1);
+}
+
+inline void EpochDomain::reclaim(Record *record) {
+    const size_t epoch = detail::atomicLoad(&epoch_);
+    for (size_t i = 0; i < 3; ++i) {
+        Bag &bag = record->bags[i];
+        if (!bag.items.empty() && bag.epoch + 2 <= epoch) {
+            freeBag(bag);
+        }
+    }
+}
+
+inline void EpochDomain::freeBag(Bag &bag) {
+    // Деструкторы могут сами вызывать retire(), поэтому корзина очищается до их вызова.
+    std::vector<RetiredItem> items;
+    items.swap(bag.items);
+    for (size_t i = 0; i < items.size(); ++i) {
+        items[i].destroy(items[i].ptr);
+    }
+
+    // Память корзины переиспользуется, если за это время в нее ничего не добавили.
+    if (bag.items.empty()) {
+        items.clear();
+        items.swap(bag.items);
+    }
+}
+
+inline void EpochDomain::releaseRecord(void *record) {
+    Record *current = static_cast<Record *>(record);
+    EpochDomain *domain = current->domain;
+    pthread_mutex_lock(&domain->mutex_);
+    current->inUse = false;
+    pthread_mutex_unlock(&domain->mutex_);
+}
+
+template<class T>
+void EpochDomain::destroyObject(void *ptr) {
+    delete static_cast<T *>(ptr);
+}
+
+} // namespace mem
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "atomic.h"
+#include "ownership_event.h"
+
+/**
+ * Счетчики владения по типам объектов хранения. Подключаются к UniquePtr, RvalueUniquePtr и
+ * makeUnique(), если макрос MEM_INSTRUMENTATION определен для всей программы (например,
+ * -DMEM_INSTRUMENTATION). Без него точки учета в unique_ptr.h раскрываются в пустоту и
+ * сгенерированный код совпадает с кодом без них, что проверяет тест zero_cost_test.
+ * События считаются в блоке счетчиков текущего потока без синхронизации с другими потоками и
+ * суммируются только при snapshot(). Количество живых объектов и его пик хранятся общими для всех
+ * потоков, так как объект может быть создан в одном потоке, а освобожден в другом.
+ */
+
+#ifndef MEM_INSTRUMENTATION_MAX_TYPES
+//! Количество различаемых типов. События остальных типов учитываются в общей записи "<other>".
+#define MEM_INSTRUMENTATION_MAX_TYPES 256
+#endif
+
+namespace mem {
+
+namespace instrumentation {
+
+/**
+ * @brief Суммарные счетчики одного типа объекта хранения.
+ */
+struct TypeCounters {
+    std::string type; //!< Имя типа.
+    size_t events[EventCount]; //!< Количество событий каждого вида.
+    long live; //!< Количество объектов, которыми владеют указатели.
+    long peak; //!< Наибольшее значение live.
+};
+
+/**
+ * @brief Учесть событие для объекта типа T.
+ * @details Пустые указатели не учитываются.
+ */
+template<class T>
+void record(Event event, const void *ptr);
+
+/**
+ * @brief Учесть передачу владения объектом от указателя на U указателю на T.
+ */
+template<class U, class T>
+void recordConversion(const void *ptr);
+
+/**
+ * @brief Собрать счетчики всех потоков по всем типам, для которых было хотя бы одно событие.
+ */
+inline std::vector<TypeCounters> snapshot();
+
+/**
+ * @brief Собрать счетчики всех потоков для типа T.
+ */
+template<class T>
+TypeCounters counters();
+
+/**
+ * @brief Вывести snapshot() по одной строке на тип.
+ */
+inline void dumpText(std::ostream &out);
+
+/**
+ * @brief Вывести snapshot() массивом JSON-объектов.
+ */
+inline void dumpJson(std::ostream &out);
+
+} // namespace instrumentation
+
+namespace detail {
+
+static const size_t InstrumentationMaxTypes = MEM_INSTRUMENTATION_MAX_TYPES;
+
+/**
+ * @brief Общие счетчики типа.
+ */
+struct InstrumentedType {
+    std::string name; //!< Имя типа.
+    long live; //!< Количество живых объектов.
+    long peak; //!< Пик количества живых объектов.
+};
+
+/**
+ * @brief Счетчики событий одного потока.
+ * @details Пишутся только потоком-владельцем. Блоки не удаляются: при завершении потока его
+ * счетчики переносятся в общий итог, а блок переиспользуется следующим потоком.
+ */
+struct ThreadCounters {
+    size_t events[InstrumentationMaxTypes][instrumentation::EventCount]; //!< Счетчики по типам.
+    bool inUse; //!< Занят ли блок потоком.
+    ThreadCounters *next; //!< Следующий блок.
+};
+
+/**
+ * @brief Реестр типов и блоков счетчиков потоков.
+ */
+struct InstrumentationRegistry {
+    pthread_mutex_t mutex; //!< Защищает регистрацию типов, список блоков и retired.
+    size_t typeCount; //!< Количество зарегистрированных типов.
+    InstrumentedType types[InstrumentationMaxTypes]; //!< Зарегистрированные типы.
+    ThreadCounters *threads; //!< Блоки счетчиков потоков.
+    //! Счетчики завершившихся потоков.
+    size_t retired[InstrumentationMaxTypes][instrumentation::EventCount];
+};
+
+inline InstrumentationRegistry *newInstrumentationRegistry() {
+    InstrumentationRegistry *registry = new InstrumentationRegistry();
+    pthread_mutex_init(&registry->mutex, NULL);
+    return registry;
+}
+
+/**
+ * @brief Реестр программы. Не удаляется, так как используется при завершении потоков.
+ */
+inline InstrumentationRegistry &instrumentationRegistry() {
+    static InstrumentationRegistry *registry = newInstrumentationRegistry();
+    return *registry;
+}
+
+/**
+ * @brief Сигнатура функции, в которую компилятор подставляет имя типа T.
+ * @details В отличие от typeid работает и для неполных типов.
+ */
+template<class T>
+const char *instrumentedTypeSignature() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __PRETTY_FUNCTION__;
+#else
+    return "[T = unknown]";
+#endif
+}
+
+/**
+ * @brief Извлечь имя типа из сигнатуры вида "... [with T = Foo]".
+ */
+inline std::string instrumentedTypeName(const char *signature) {
+    const char *begin = std::strstr(signature, "T = ");
+    if (begin == NULL) {
+        return signature;
+    }
+    begin += 4;
+    const char *end = begin + std::strlen(begin);
+    if (end > begin && end[-1] == ']') {
+        --end;
+    }
+    return std::string(begin, end);
+}
+
+inline size_t registerInstrumentedType(const std::string &name) {
+    InstrumentationRegistry &registry = instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    size_t index = InstrumentationMaxTypes - 1;
+    if (registry.typeCount + 1 < InstrumentationMaxTypes) {
+        index = registry.typeCount++;
+        registry.types[index].name = name;
+    } else if (registry.typeCount < InstrumentationMaxTypes) {
+        registry.typeCount = InstrumentationMaxTypes;
+        registry.types[index].name = "<other>";
+    }
+    pthread_mutex_unlock(&registry.mutex);
+    return index;
+}
+
+/**
+ * @brief Номер типа T в реестре (регистрирует тип при первом обращении).
+ */
+template<class T>
+size_t instrumentedTypeIndex() {
+    static const size_t index = registerInstrumentedType(
+            instrumentedTypeName(instrumentedTypeSignature<T>()));
+    return index;
+}
+
+inline ThreadCounters *&currentThreadCounters() {
+    static __thread ThreadCounters *counters = NULL;
+    return counters;
+}
+
+/**
+ * @brief Перенести счетчики завершающегося потока в общий итог и освободить его блок.
+ */
+inline void releaseThreadCounters(void *data) {
+    ThreadCounters *counters = static_cast<ThreadCounters *>(data);
+    InstrumentationRegistry &registry = instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    for (size_t type = 0; type < InstrumentationMaxTypes; ++type) {
+        for (size_t event = 0; event < instrumentation::EventCount; ++event) {
+            registry.retired[type][event] += counters->events[type][event];
+            atomicStoreRelaxed(&counters->events[type][event], size_t(0));
+        }
+    }
+    counters->inUse = false;
+    pthread_mutex_unlock(&registry.mutex);
+    currentThreadCounters() = NULL;
+}
+
+inline pthread_key_t &threadCountersKeyStorage() {
+    static pthread_key_t key;
+    return key;
+}
+
+inline void createThreadCountersKey() {
+    pthread_key_create(&threadCountersKeyStorage(), releaseThreadCounters);
+}
+
+/**
+ * @brief Ключ, по которому при завершении потока освобождается его блок счетчиков.
+ */
+inline pthread_key_t threadCountersKey() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createThreadCountersKey);
+    return threadCountersKeyStorage();
+}
+
+/**
+ * @brief Занять свободный блок счетчиков для текущего потока.
+ */
+inline ThreadCounters *acquireThreadCounters() {
+    InstrumentationRegistry &registry = instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    ThreadCounters *counters = registry.threads;
+    while (counters != NULL && counters->inUse) {
+        counters = counters->next;
+    }
+    if (counters == NULL) {
+        counters = new ThreadCounters();
+        counters->next = registry.threads;
+        registry.threads = counters;
+    }
+    counters->inUse = true;
+    pthread_mutex_unlock(&registry.mutex);
+
+    pthread_setspecific(threadCountersKey(), counters);
+    currentThreadCounters() = counters;
+    return counters;
+}
+
+inline void countEvent(size_t type, instrumentation::Event event) {
+    ThreadCounters *counters = currentThreadCounters();
+    if (counters == NULL) {
+        counters = acquireThreadCounters();
+    }
+    size_t &counter = counters->events[type][event];
+    atomicStoreRelaxed(&counter, counter + 1);
+}
+
+inline void addLiveObjects(size_t type, long delta) {
+    InstrumentedType &counters = instrumentationRegistry().types[type];
+    const long live = atomicFetchAdd(&counters.live, delta) + delta;
+    long peak = atomicLoadRelaxed(&counters.peak);
+    while (live > peak && !atomicCompareExchange(&counters.peak, peak, live)) {
+    }
+}
+
+/**
+ * @brief Суммировать счетчики типа по всем потокам. Вызывается под мьютексом реестра.
+ */
+inline instrumentation::TypeCounters collectTypeCounters(InstrumentationRegistry &registry,
+                                                         size_t type) {
+    instrumentation::TypeCounters result;
+    result.type = registry.types[type].name;
+    for (size_t event = 0; event < instrumentation::EventCount; ++event) {
+        result.events[event] = registry.retired[type][event];
+    }
+    for (ThreadCounters *counters = registry.threads; counters != NULL; counters = counters->next) {
+        for (size_t event = 0; event < instrumentation::EventCount; ++event) {
+            result.events[event] += atomicLoadRelaxed(&counters->events[type][event]);
+        }
+    }
+    result.live = atomicLoadRelaxed(&registry.types[type].live);
+    result.peak = atomicLoadRelaxed(&registry.types[type].peak);
+    return result;
+}
+
+inline void writeJsonString(std::ostream &out, const std::string &value) {
+    out << '"';
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '"' || value[i] == '\\') {
+            out << '\\';
+        }
+        out << value[i];
+    }
+    out << '"';
+}
+
+} // namespace detail
+
+namespace instrumentation {
+
+template<class T>
+void record(Event event, const void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    const size_t type = detail::instrumentedTypeIndex<T>();
+    detail::countEvent(type, event);
+    if (event == Construct) {
+        detail::addLiveObjects(type, 1);
+    } else if (event == Release || event == Delete) {
+        detail::addLiveObjects(type, -1);
+    }
+}
+
+template<class U, class T>
+void recordConversion(const void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    const size_t type = detail::instrumentedTypeIndex<T>();
+    detail::countEvent(type, Convert);
+    detail::addLiveObjects(detail::instrumentedTypeIndex<U>(), -1);
+    detail::addLiveObjects(type, 1);
+}
+
+inline std::vector<TypeCounters> snapshot() {
+    detail::InstrumentationRegistry &registry = detail::instrumentationRegistry();
+    std::vector<TypeCounters> result;
+    pthread_mutex_lock(&registry.mutex);
+    for (size_t type = 0; type < registry.typeCount; ++type) {
+        result.push_back(detail::collectTypeCounters(registry, type));
+    }
+    pthread_mutex_unlock(&registry.mutex);
+    return result;
+}
+
+template<class T>
+TypeCounters counters() {
+    const size_t type = detail::instrumentedTypeIndex<T>();
+    detail::InstrumentationRegistry &registry = detail::instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    const TypeCounters result = detail::collectTypeCounters(registry, type);
+    pthread_mutex_unlock(&registry.mutex);
+    return result;
+}
+
+inline void dumpText(std::ostream &out) {
+    const std::vector<TypeCounters> types = snapshot();
+    for (size_t i = 0; i < types.size(); ++i) {
+        out << types[i].type << ':';
+        for (size_t event = 0; event < EventCount; ++event) {
+            out << ' ' << eventName(Event(event)) << '=' << types[i].events[event];
+        }
+        out << " live=" << types[i].live << " peak=" << types[i].peak << '\n';
+    }
+}
+
+inline void dumpJson(std::ostream &out) {
+    const std::vector<TypeCounters> types = snapshot();
+    out << '[';
+    for (size_t i = 0; i < types.size(); ++i) {
+        out << (i == 0 ? "\n" : ",\n") << "  {\"type\": ";
+        detail::writeJsonString(out, types[i].type);
+        for (size_t event = 0; event < EventCount; ++event) {
+            out << ", \"" << eventName(Event(event)) << "\": " << types[i].events[event];
+        }
+        out << ", \"live\": " << types[i].live << ", \"peak\": " << types[i].peak << '}';
+    }
+    out << (types.empty() ? "]\n" : "\n]\n");
+}
+
+} // namespace instrumentation
+
+} // namespace mem
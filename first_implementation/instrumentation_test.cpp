@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "instrumentation.h"
+
+/**
+ * Проверки счетчиков владения. Цель собирается с -DMEM_INSTRUMENTATION; каждый тест использует
+ * собственные типы, так как счетчики общие для всей программы.
+ */
+
+namespace {
+
+struct Widget {
+    int value;
+};
+
+struct Shape {
+    virtual ~Shape() {}
+};
+
+struct Circle : Shape {};
+
+struct Token {};
+
+typedef mem::instrumentation::TypeCounters TypeCounters;
+
+const size_t ThreadCount = 4;
+const size_t TokensPerThread = 1000;
+
+void *makeTokens(void *) {
+    for (size_t i = 0; i < TokensPerThread; ++i) {
+        mem::UniquePtr<Token> token(mem::makeUnique<Token>());
+    }
+    return NULL;
+}
+
+} // namespace
+
+TEST(Instrumentation, CountsOwnershipEvents) {
+    {
+        mem::UniquePtr<Widget> first(new Widget());
+        mem::UniquePtr<Widget> second(first.move());
+        mem::UniquePtr<Widget> third(mem::makeUnique<Widget>());
+
+        TypeCounters counters = mem::instrumentation::counters<Widget>();
+        EXPECT_EQ(2u, counters.events[mem::instrumentation::Construct]);
+        EXPECT_EQ(1u, counters.events[mem::instrumentation::Move]);
+        EXPECT_EQ(2u, counters.events[mem::instrumentation::Transfer]);
+        EXPECT_EQ(2, counters.live);
+
+        delete second.release();
+        third = mem::makeUnique<Widget>();
+    }
+
+    TypeCounters counters = mem::instrumentation::counters<Widget>();
+    EXPECT_EQ(3u, counters.events[mem::instrumentation::Construct]);
+    EXPECT_EQ(1u, counters.events[mem::instrumentation::Move]);
+    EXPECT_EQ(3u, counters.events[mem::instrumentation::Transfer]);
+    EXPECT_EQ(0u, counters.events[mem::instrumentation::Convert]);
+    EXPECT_EQ(1u, counters.events[mem::instrumentation::Release]);
+    EXPECT_EQ(2u, counters.events[mem::instrumentation::Delete]);
+    EXPECT_EQ(0, counters.live);
+    EXPECT_EQ(2, counters.peak);
+}
+
+TEST(Instrumentation, ConversionMovesLiveObjectsToBaseType) {
+    mem::UniquePtr<Circle> circle(new Circle());
+    mem::UniquePtr<Shape> shape(circle.move());
+
+    EXPECT_EQ(0, mem::instrumentation::counters<Circle>().live);
+    EXPECT_EQ(1, mem::instrumentation::counters<Circle>().peak);
+    EXPECT_EQ(1, mem::instrumentation::counters<Shape>().live);
+    EXPECT_EQ(1u, mem::instrumentation::counters<Shape>().events[mem::instrumentation::Convert]);
+}
+
+TEST(Instrumentation, MergesCountersOfFinishedThreads) {
+    pthread_t threads[ThreadCount];
+    for (size_t i = 0; i < ThreadCount; ++i) {
+        pthread_create(&threads[i], NULL, makeTokens, NULL);
+    }
+    for (size_t i = 0; i < ThreadCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TypeCounters counters = mem::instrumentation::counters<Token>();
+    EXPECT_EQ(ThreadCount * TokensPerThread, counters.events[mem::instrumentation::Construct]);
+    EXPECT_EQ(ThreadCount * TokensPerThread, counters.events[mem::instrumentation::Delete]);
+    EXPECT_EQ(0, counters.live);
+    EXPECT_GE(counters.peak, 1);
+}
+
+TEST(Instrumentation, DumpTextAndJson) {
+    mem::UniquePtr<Widget> widget(new Widget());
+
+    std::ostringstream text;
+    mem::instrumentation::dumpText(text);
+    EXPECT_NE(std::string::npos, text.str().find("Widget: construct="));
+
+    std::ostringstream json;
+    mem::instrumentation::dumpJson(json);
+    EXPECT_EQ('[', json.str()[0]);
+    EXPECT_NE(std::string::npos, json.str().find("Widget\", \"construct\": "));
+    EXPECT_NE(std::string::npos, json.str().find("\"live\": 1"));
+}
+
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
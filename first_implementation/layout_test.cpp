@@ -0,0 +1,73 @@
+#include <memory>
+
+#include "unique_ptr.h"
+#include "allocator_deleter.h"
+#include "object_pool.h"
+#include "atomic_unique_ptr.h"
+#include "compact_unique_ptr.h"
+#include "shared_ptr.h"
+
+/**
+ * Проверки размеров умных указателей на этапе компиляции. Если одно из условий нарушено,
+ * объявление массива отрицательного размера ломает сборку этой цели.
+ */
+#define LAYOUT_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1]
+
+namespace {
+
+struct Foo {
+    int id;
+};
+
+struct SharedFoo : public mem::IntrusiveRefCounted<mem::MultiThreadedRefCount> {
+    int id;
+};
+
+struct StatefulDeleter {
+    void operator()(Foo *ptr) {
+        delete ptr;
+    }
+
+    void *context;
+};
+
+typedef void (*FunctionDeleter)(Foo *);
+
+typedef mem::UniquePtr<Foo> FooPtr;
+typedef mem::UniquePtr<Foo, StatefulDeleter> StatefulFooPtr;
+typedef mem::UniquePtr<Foo, FunctionDeleter> FunctionFooPtr;
+typedef mem::UniquePtr<Foo, mem::Deleter<Foo>, mem::UncheckedAccess> UncheckedFooPtr;
+typedef mem::UniquePtr<Foo, mem::Deleter<Foo>, mem::ThrowingAccess> ThrowingFooPtr;
+typedef mem::ObjectPool<Foo, 1>::Pointer PoolFooPtr;
+typedef mem::CompactUniquePtr<Foo, mem::CompactArena<Foo>, 2> CompactFooPtr;
+typedef mem::SharedPtr<SharedFoo> SharedFooPtr;
+typedef mem::UniquePtr<Foo, mem::AllocatorDeleter<std::allocator<Foo> > > AllocatorFooPtr;
+
+LAYOUT_ASSERT(sizeof(FooPtr) == sizeof(Foo *), unique_ptr_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(FooPtr::RvalueUniquePtr) == sizeof(Foo *), rvalue_unique_ptr_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(UncheckedFooPtr) == sizeof(Foo *), access_policy_costs_nothing);
+LAYOUT_ASSERT(sizeof(ThrowingFooPtr) == sizeof(Foo *), throwing_access_policy_costs_nothing);
+
+LAYOUT_ASSERT(sizeof(StatefulFooPtr) == sizeof(Foo *) + sizeof(void *),
+              stateful_deleter_costs_only_its_state);
+LAYOUT_ASSERT(sizeof(StatefulFooPtr::RvalueUniquePtr) == sizeof(StatefulFooPtr),
+              rvalue_unique_ptr_matches_unique_ptr);
+LAYOUT_ASSERT(sizeof(FunctionFooPtr) == sizeof(Foo *) + sizeof(FunctionDeleter),
+              function_deleter_costs_one_pointer);
+LAYOUT_ASSERT(sizeof(PoolFooPtr) == 2 * sizeof(Foo *), pool_pointer_carries_only_pool);
+LAYOUT_ASSERT(sizeof(mem::ObserverPtr<Foo>) == sizeof(Foo *), observer_ptr_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(mem::AtomicUniquePtr<Foo>) == sizeof(Foo *), atomic_unique_ptr_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(CompactFooPtr) == 4, compact_unique_ptr_is_32_bit);
+LAYOUT_ASSERT(sizeof(CompactFooPtr::RvalueUniquePtr) == 4, rvalue_compact_unique_ptr_is_32_bit);
+LAYOUT_ASSERT(sizeof(AllocatorFooPtr) == sizeof(Foo *), stateless_allocator_costs_nothing);
+LAYOUT_ASSERT(sizeof(AllocatorFooPtr::RvalueUniquePtr) == sizeof(Foo *),
+              rvalue_allocator_pointer_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(SharedFooPtr) == sizeof(SharedFoo *), shared_ptr_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(SharedFooPtr::RvalueSharedPtr) == sizeof(SharedFoo *),
+              rvalue_shared_ptr_is_pointer_sized);
+
+} // namespace
+
+int main() {
+    return 0;
+}
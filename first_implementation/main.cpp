@@ -5,9 +5,28 @@
 #include <array>
 #include <set>
 #include <map>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
+
+#include <pthread.h>
 
 #include "unique_ptr.h"
+#include "make_unique.h"
+#include "allocator_deleter.h"
+#include "object_pool.h"
+#include "ptr_vector.h"
+#include "ptr_algorithm.h"
+#include "ptr_map.h"
+#include "ptr_hash_map.h"
+#include "arena.h"
+#include "compact_unique_ptr.h"
+#include "owned_queue.h"
+#include "atomic_unique_ptr.h"
+#include "deferred_deleter.h"
+#include "epoch_domain.h"
+#include "shared_ptr.h"
+#include "thread_cache.h"
 
 struct Foo {
     Foo(size_t id = 0): id_(id) {}
@@ -128,9 +147,7 @@ TEST(UniquePtr, WorkWithArray) {
 
 struct CmpUniquePtr {
     bool operator() (const mem::UniquePtr<Foo>::RvalueUniquePtr& a, const mem::UniquePtr<Foo>::RvalueUniquePtr& b) const {
-        const mem::UniquePtr<Foo> ca(a);
-        const mem::UniquePtr<Foo> cb(b);
-        return ca->id() < cb->id();
+        return a.borrowConst()->id() < b.borrowConst()->id();
     }
 };
 
@@ -148,6 +165,12 @@ TEST(UniquePtr, WorkWithComparator) {
     CmpUniquePtr cmp;
 
     EXPECT_TRUE(cmp(i.move(), j.move()));
+
+    FooPtr::RvalueUniquePtr a(FooPtr(new Foo(1)).move());
+    FooPtr::RvalueUniquePtr b(FooPtr(new Foo(2)).move());
+    EXPECT_TRUE(cmp(a, b));
+    EXPECT_FALSE(cmp(b, a));
+    EXPECT_EQ(a.borrow()->id(), 1); // comparator does not steal
 }
 
 TEST(UniquePtr, WorkWithSet) {
@@ -166,12 +189,15 @@ TEST(UniquePtr, WorkWithSet) {
 
     delete b2;
 
-//    std::set<mem::UniquePtr<Foo>::RvalueUniquePtr, CmpUniquePtr> data;
-//    mem::UniquePtr<Foo> p1(new Foo(10));
-//    mem::UniquePtr<Foo> p2(new Foo(23));
-//
-//    data.insert(p1.move());
-//    data.insert(p2.move());
+    std::set<mem::UniquePtr<Foo>::RvalueUniquePtr, CmpUniquePtr> data;
+    mem::UniquePtr<Foo> p1(new Foo(23));
+    mem::UniquePtr<Foo> p2(new Foo(10));
+
+    data.insert(p1.move());
+    data.insert(p2.move());
+
+    EXPECT_EQ(data.size(), 2);
+    EXPECT_EQ(data.begin()->borrow()->id(), 10);
 }
 
 TEST(UniquePtr, WorkWithMap) {
@@ -216,6 +242,1643 @@ TEST(UniquePtr, WorkwithRef) {
 }
 
 
+TEST(UniquePtr, BorrowDoesNotTransferOwnership) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    FooPtr p(new Foo(7));
+
+    mem::ObserverPtr<Foo> o1 = p.borrow();
+    mem::ObserverPtr<const Foo> o2 = p.borrowConst();
+    mem::ObserverPtr<const Foo> o3 = o1;
+
+    EXPECT_EQ(o1->id(), 7);
+    EXPECT_EQ((*o2).id(), 7);
+    EXPECT_TRUE(o1 == o3);
+    EXPECT_EQ(p.get(), o1.get());
+
+    std::vector<FooPtr::RvalueUniquePtr> data;
+    data.push_back(p.move());
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(data[0].borrow()->id(), 7);
+    }
+    EXPECT_EQ(data[0].borrow(), o1);
+
+    EXPECT_TRUE(FooPtr().borrow().empty());
+}
+
+TEST(UniquePtr, ConvertDerivedToBase) {
+    struct Base {
+        Base() {
+            counter()++;
+        }
+
+        virtual ~Base() {
+            counter()--;
+        }
+
+        virtual int id() const {
+            return 0;
+        }
+
+        static int &counter() {
+            static int counter = 0;
+            return counter;
+        }
+    };
+
+    struct Derived : public Base {
+        int id() const {
+            return 1;
+        }
+    };
+
+    typedef mem::UniquePtr<Base> BasePtr;
+    typedef mem::UniquePtr<Derived> DerivedPtr;
+    {
+        DerivedPtr d(new Derived());
+        BasePtr b(d.move());
+        EXPECT_TRUE(d.get() == NULL);
+        EXPECT_EQ(b->id(), 1);
+
+        DerivedPtr d2(new Derived());
+        b = d2.move();
+        EXPECT_EQ(Base::counter(), 1);
+
+        std::vector<BasePtr::RvalueUniquePtr> data;
+        DerivedPtr d3(new Derived());
+        data.push_back(d3.move());
+        EXPECT_EQ(data[0].borrow()->id(), 1);
+        EXPECT_EQ(Base::counter(), 2);
+    }
+    EXPECT_EQ(Base::counter(), 0);
+}
+
+TEST(UniquePtr, StatefulDeleterTravelsWithMove) {
+    struct CountingDeleter {
+        CountingDeleter(): counter(NULL) {}
+        explicit CountingDeleter(int *c): counter(c) {}
+
+        void operator()(Foo *ptr) {
+            ++*counter;
+            delete ptr;
+        }
+
+        int *counter;
+    };
+
+    typedef mem::UniquePtr<Foo, CountingDeleter> FooPtr;
+    int deleted = 0;
+    {
+        FooPtr p1(new Foo(1), CountingDeleter(&deleted));
+        std::vector<FooPtr::RvalueUniquePtr> data;
+        data.push_back(p1.move());
+
+        FooPtr p2(data[0]);
+        EXPECT_EQ(p2.getDeleter().counter, &deleted);
+        EXPECT_EQ(deleted, 0);
+    }
+    EXPECT_EQ(deleted, 1);
+}
+
+namespace {
+
+struct NullCountingDeleter {
+    NullCountingDeleter(): calls(NULL) {}
+    explicit NullCountingDeleter(int *c): calls(c) {}
+
+    void operator()(Foo *ptr) {
+        ++*calls;
+        delete ptr;
+    }
+
+    int *calls;
+};
+
+} // namespace
+
+namespace mem {
+
+template<>
+struct DeleterAcceptsNull<NullCountingDeleter> {
+    static const bool value = true;
+};
+
+} // namespace mem
+
+TEST(UniquePtr, ThrowingAccessOnEmpty) {
+    typedef mem::UniquePtr<Foo, mem::Deleter<Foo>, mem::ThrowingAccess> CheckedFooPtr;
+    CheckedFooPtr p(new Foo(7));
+    EXPECT_EQ(p->id(), 7);
+
+    CheckedFooPtr q(p.move());
+    EXPECT_THROW(p->id(), mem::NullAccessError);
+    EXPECT_THROW((*p).id(), mem::NullAccessError);
+    EXPECT_EQ((*q).id(), 7);
+}
+
+TEST(UniquePtr, AccessPoliciesShareRvalue) {
+    typedef mem::UniquePtr<Foo, mem::Deleter<Foo>, mem::UncheckedAccess> UncheckedFooPtr;
+    mem::UniquePtr<Foo> checked(new Foo(3));
+
+    // Политика проверки не входит в RvalueUniquePtr, поэтому владение переходит без преобразований.
+    UncheckedFooPtr unchecked(checked.move());
+    EXPECT_EQ(unchecked->id(), 3);
+
+    checked = unchecked.move();
+    EXPECT_TRUE(unchecked.get() == NULL);
+    EXPECT_EQ(checked->id(), 3);
+}
+
+TEST(UniquePtr, DeleterAcceptingNullIsCalledUnconditionally) {
+    int calls = 0;
+    {
+        mem::UniquePtr<Foo, NullCountingDeleter> empty(NULL, NullCountingDeleter(&calls));
+        mem::UniquePtr<Foo, NullCountingDeleter> full(new Foo(1), NullCountingDeleter(&calls));
+    }
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(PtrVector, PushBackAndIterate) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    mem::PtrVector<Foo> data;
+    for (size_t i = 0; i < 100; ++i) {
+        FooPtr p(new Foo(i));
+        data.push_back(p.move());
+    }
+
+    EXPECT_EQ(data.size(), 100);
+    EXPECT_EQ(data[42].id(), 42);
+
+    size_t expected = 0;
+    typedef mem::PtrVector<Foo>::Iterator It;
+    for (It it = data.begin(); it != data.end(); ++it) {
+        EXPECT_EQ(it->id(), expected++);
+    }
+}
+
+TEST(PtrVector, IteratorIsRandomAccess) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    mem::PtrVector<Foo> data;
+    for (size_t i = 0; i < 10; ++i) {
+        FooPtr p(new Foo(i));
+        data.push_back(p.move());
+    }
+
+    typedef mem::PtrVector<Foo>::Iterator It;
+    typedef mem::PtrVector<Foo>::ConstIterator ConstIt;
+    const It first = data.begin();
+    const It third = 2 + first;
+    EXPECT_EQ(third->id(), 2);
+    EXPECT_TRUE(third == first + 2);
+    EXPECT_TRUE(third > first);
+    EXPECT_TRUE(first < third);
+    EXPECT_TRUE(first <= first && first <= third);
+    EXPECT_TRUE(third >= third && third >= first);
+    EXPECT_FALSE(first > third || third <= first || first >= third);
+
+    const ConstIt last = 9 + ConstIt(first);
+    EXPECT_EQ(last->id(), 9);
+    EXPECT_EQ(std::distance(ConstIt(first), last), 9);
+}
+
+TEST(PtrVector, ReleaseAndErase) {
+    struct Baz {
+        explicit Baz(int id): id(id) {
+            counter()++;
+        }
+
+        ~Baz() {
+            counter()--;
+        }
+
+        static int &counter() {
+            static int counter = 0;
+            return counter;
+        }
+
+        int id;
+    };
+
+    typedef mem::UniquePtr<Baz> BazPtr;
+    {
+        mem::PtrVector<Baz> data;
+        for (int i = 0; i < 5; ++i) {
+            BazPtr p(new Baz(i));
+            data.push_back(p.move());
+        }
+
+        BazPtr released(data.release(1));
+        EXPECT_EQ(released->id, 1);
+        EXPECT_EQ(data.size(), 4);
+        EXPECT_EQ(data[1].id, 2);
+        EXPECT_EQ(Baz::counter(), 5);
+
+        mem::PtrVector<Baz>::Iterator it = data.erase(data.begin());
+        EXPECT_EQ(it->id, 2);
+        EXPECT_EQ(Baz::counter(), 4);
+
+        data.erase(data.begin(), data.begin() + 2);
+        EXPECT_EQ(data.size(), 1);
+        EXPECT_EQ(data.front().id, 4);
+        EXPECT_EQ(Baz::counter(), 2);
+    }
+    EXPECT_EQ(Baz::counter(), 0);
+}
+
+TEST(PtrVector, WorkWithAlgorithms) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    mem::PtrVector<Foo> data;
+    for (size_t i = 0; i < 10; ++i) {
+        FooPtr p(new Foo(i * 10));
+        data.push_back(p.move());
+    }
+
+    const mem::PtrVector<Foo> &cdata = data;
+    EXPECT_EQ(std::distance(cdata.begin(), cdata.end()), 10);
+    EXPECT_EQ((cdata.begin() + 3)->id(), 30);
+}
+
+namespace {
+
+struct Ranked {
+    Ranked(int key, int order):
+    key(key),
+    order(order) {
+        ++alive();
+    }
+
+    ~Ranked() {
+        --alive();
+    }
+
+    static int &alive() {
+        static int alive = 0;
+        return alive;
+    }
+
+    bool operator<(const Ranked &other) const {
+        return key < other.key;
+    }
+
+    bool operator==(const Ranked &other) const {
+        return key == other.key;
+    }
+
+    int key;
+    int order;
+};
+
+typedef mem::UniquePtr<Ranked> RankedPtr;
+
+struct Greater {
+    bool operator()(const Ranked &a, const Ranked &b) const {
+        return b < a;
+    }
+};
+
+struct IsOdd {
+    bool operator()(const Ranked &ranked) const {
+        return ranked.key % 2 != 0;
+    }
+};
+
+struct ThrowingCompare {
+    explicit ThrowingCompare(int left): left(left) {}
+
+    bool operator()(const Ranked &a, const Ranked &b) {
+        if (--left == 0) {
+            throw std::runtime_error("compare");
+        }
+        return a < b;
+    }
+
+    int left;
+};
+
+struct ThrowingOdd {
+    explicit ThrowingOdd(int left): left(left) {}
+
+    bool operator()(const Ranked &ranked) {
+        if (--left == 0) {
+            throw std::runtime_error("predicate");
+        }
+        return ranked.key % 2 != 0;
+    }
+
+    int left;
+};
+
+const int RankedKeys[] = {5, 3, 8, 3, 1, 8, 8, 2, 7, 5};
+const size_t RankedCount = sizeof(RankedKeys) / sizeof(RankedKeys[0]);
+
+} // namespace
+
+TEST(Algo, SortArrayOfUniquePtr) {
+    {
+        RankedPtr data[RankedCount];
+        for (size_t i = 0; i < RankedCount; ++i) {
+            data[i] = mem::makeUnique<Ranked>(RankedKeys[i], int(i));
+        }
+
+        mem::algo::sort(data, data + RankedCount);
+        EXPECT_EQ(Ranked::alive(), int(RankedCount));
+        for (size_t i = 1; i < RankedCount; ++i) {
+            EXPECT_LE(data[i - 1]->key, data[i]->key);
+        }
+
+        mem::algo::sort(data, data + RankedCount, Greater());
+        EXPECT_EQ(data[0]->key, 8);
+        EXPECT_EQ(data[RankedCount - 1]->key, 1);
+    }
+    EXPECT_EQ(Ranked::alive(), 0);
+}
+
+TEST(Algo, StableSortVectorOfRvalue) {
+    std::vector<RankedPtr::RvalueUniquePtr> data;
+    for (size_t i = 0; i < RankedCount; ++i) {
+        data.push_back(mem::makeUnique<Ranked>(RankedKeys[i], int(i)));
+    }
+
+    mem::algo::stableSort(data.begin(), data.end());
+    for (size_t i = 1; i < RankedCount; ++i) {
+        const Ranked &prev = *data[i - 1].borrowConst();
+        const Ranked &next = *data[i].borrowConst();
+        EXPECT_TRUE(prev.key < next.key || (prev.key == next.key && prev.order < next.order));
+    }
+    EXPECT_EQ(Ranked::alive(), int(RankedCount));
+
+    data.clear();
+    EXPECT_EQ(Ranked::alive(), 0);
+}
+
+TEST(Algo, RemoveIfDestroysRemovedInPlace) {
+    std::vector<RankedPtr::RvalueUniquePtr> data;
+    for (size_t i = 0; i < RankedCount; ++i) {
+        data.push_back(mem::makeUnique<Ranked>(RankedKeys[i], int(i)));
+    }
+
+    std::vector<RankedPtr::RvalueUniquePtr>::iterator end =
+            mem::algo::removeIf(data.begin(), data.end(), IsOdd());
+    ASSERT_EQ(end - data.begin(), 4);
+    EXPECT_EQ(Ranked::alive(), 4);
+
+    // Оставшиеся объекты идут в исходном порядке, хвост пуст.
+    const int kept[] = {8, 8, 8, 2};
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(data[i].borrowConst()->key, kept[i]);
+    }
+    EXPECT_TRUE(data.back().borrow().empty());
+    data.erase(end, data.end());
+
+    std::vector<RankedPtr::RvalueUniquePtr>::iterator middle =
+            mem::algo::partition(data.begin(), data.end(), IsOdd());
+    EXPECT_TRUE(middle == data.begin());
+    data.clear();
+    EXPECT_EQ(Ranked::alive(), 0);
+}
+
+TEST(Algo, UniqueDestroysDuplicates) {
+    {
+        RankedPtr data[RankedCount];
+        for (size_t i = 0; i < RankedCount; ++i) {
+            data[i] = mem::makeUnique<Ranked>(RankedKeys[i], int(i));
+        }
+
+        mem::algo::sort(data, data + RankedCount);
+        RankedPtr *end = mem::algo::unique(data, data + RankedCount);
+        ASSERT_EQ(end - data, 6);
+        EXPECT_EQ(Ranked::alive(), 6);
+
+        const int expected[] = {1, 2, 3, 5, 7, 8};
+        for (size_t i = 0; i < 6; ++i) {
+            EXPECT_EQ(data[i]->key, expected[i]);
+        }
+        EXPECT_TRUE(data[6].get() == NULL);
+    }
+    EXPECT_EQ(Ranked::alive(), 0);
+}
+
+TEST(Algo, PtrVectorOverloads) {
+    {
+        mem::PtrVector<Ranked> data;
+        for (size_t i = 0; i < RankedCount; ++i) {
+            data.push_back(mem::makeUnique<Ranked>(RankedKeys[i], int(i)));
+        }
+
+        mem::algo::stableSort(data);
+        EXPECT_EQ(data.front().key, 1);
+        EXPECT_EQ(data[2].order, 1);
+        EXPECT_EQ(data[3].order, 3);
+
+        EXPECT_EQ(mem::algo::unique(data), size_t(4));
+        EXPECT_EQ(data.size(), size_t(6));
+        EXPECT_EQ(Ranked::alive(), 6);
+
+        mem::PtrVector<Ranked>::Iterator middle = mem::algo::partition(data, IsOdd());
+        EXPECT_EQ(middle - data.begin(), 4);
+
+        EXPECT_EQ(mem::algo::removeIf(data, IsOdd()), size_t(4));
+        EXPECT_EQ(data.size(), size_t(2));
+        EXPECT_EQ(Ranked::alive(), 2);
+
+        mem::algo::sort(data, Greater());
+        EXPECT_EQ(data.front().key, 8);
+    }
+    EXPECT_EQ(Ranked::alive(), 0);
+}
+
+TEST(Algo, ThrowingCompareKeepsOwnership) {
+    std::vector<RankedPtr::RvalueUniquePtr> data;
+    std::set<const Ranked *> objects;
+    for (size_t i = 0; i < RankedCount; ++i) {
+        data.push_back(mem::makeUnique<Ranked>(RankedKeys[i], int(i)));
+        objects.insert(data.back().borrowConst().get());
+    }
+
+    EXPECT_THROW(mem::algo::sort(data.begin(), data.end(), ThrowingCompare(12)),
+                 std::runtime_error);
+
+    // Каждый объект по-прежнему принадлежит ровно одному элементу, порядок не изменился.
+    std::set<const Ranked *> after;
+    for (size_t i = 0; i < RankedCount; ++i) {
+        after.insert(data[i].borrowConst().get());
+        EXPECT_EQ(data[i].borrowConst()->order, int(i));
+    }
+    EXPECT_TRUE(after == objects);
+
+    EXPECT_THROW(mem::algo::removeIf(data.begin(), data.end(), ThrowingOdd(6)),
+                 std::runtime_error);
+    after.clear();
+    for (size_t i = 0; i < RankedCount; ++i) {
+        after.insert(data[i].borrowConst().get());
+    }
+    EXPECT_TRUE(after == objects);
+    EXPECT_EQ(Ranked::alive(), int(RankedCount));
+
+    data.clear();
+    EXPECT_EQ(Ranked::alive(), 0);
+}
+
+TEST(PtrMap, LookupDoesNotSteal) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    mem::PtrMap<int, Foo> data;
+
+    FooPtr f1(new Foo(10));
+    FooPtr f2(new Foo(32));
+    EXPECT_TRUE(data.emplace(10, f1.move()).second);
+    EXPECT_TRUE(data.emplace(12, f2.move()).second);
+
+    EXPECT_EQ(data.at(10).id(), 10);
+    EXPECT_EQ(data.at(10).id(), 10);
+    EXPECT_EQ(data.find(12)->second->id(), 32);
+    EXPECT_TRUE(data.get(11) == NULL);
+    EXPECT_THROW(data.at(11), std::out_of_range);
+
+    FooPtr f3(new Foo(99));
+    EXPECT_FALSE(data.emplace(10, f3.move()).second);
+    EXPECT_EQ(data.at(10).id(), 10);
+
+    FooPtr released(data.release(12));
+    EXPECT_EQ(released->id(), 32);
+    EXPECT_FALSE(data.contains(12));
+    EXPECT_TRUE(data.erase(10));
+    EXPECT_TRUE(data.empty());
+}
+
+TEST(PtrHashMap, EmplaceFindErase) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    mem::PtrHashMap<size_t, Foo> data;
+
+    const size_t count = 1000;
+    for (size_t i = 0; i < count; ++i) {
+        FooPtr p(new Foo(i * 7));
+        EXPECT_TRUE(data.emplace(i, p.move()).second);
+    }
+    EXPECT_EQ(data.size(), count);
+
+    for (size_t i = 0; i < count; i += 2) {
+        EXPECT_TRUE(data.erase(i));
+    }
+    EXPECT_EQ(data.size(), count / 2);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 2 == 0) {
+            EXPECT_TRUE(data.get(i) == NULL);
+        } else {
+            EXPECT_EQ(data.at(i).id(), i * 7);
+        }
+    }
+
+    size_t visited = 0;
+    typedef mem::PtrHashMap<size_t, Foo>::Iterator It;
+    for (It it = data.begin(); it != data.end(); ++it) {
+        EXPECT_EQ(it->second->id(), it->first * 7);
+        ++visited;
+    }
+    EXPECT_EQ(visited, count / 2);
+
+    FooPtr released(data.release(1));
+    EXPECT_EQ(released->id(), 7);
+    EXPECT_FALSE(data.contains(1));
+}
+
+TEST(PtrHashMap, StringKeys) {
+    typedef mem::UniquePtr<Foo> FooPtr;
+    mem::PtrHashMap<std::string, Foo> data;
+
+    FooPtr a(new Foo(1));
+    FooPtr b(new Foo(2));
+    data.emplace("alpha", a.move());
+    data.emplace("beta", b.move());
+
+    EXPECT_EQ(data.at("alpha").id(), 1);
+    EXPECT_EQ(data.at("beta").id(), 2);
+    EXPECT_FALSE(data.contains("gamma"));
+}
+
+TEST(MakeUnique, ForwardArguments) {
+    struct Point {
+        Point(): x(0), y(0), z(0) {}
+        Point(int x, int y, int z): x(x), y(y), z(z) {}
+
+        int x, y, z;
+    };
+
+    struct Sum {
+        Sum(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9,
+            const std::string &a10):
+            value(a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + static_cast<int>(a10.size()))
+        {}
+
+        int value;
+    };
+
+    mem::UniquePtr<Foo> foo(mem::makeUnique<Foo>(42));
+    EXPECT_EQ(foo->id(), 42);
+
+    mem::UniquePtr<Point> origin(mem::makeUnique<Point>());
+    mem::UniquePtr<Point> point(mem::makeUnique<Point>(1, 2, 3));
+    EXPECT_EQ(origin->x, 0);
+    EXPECT_EQ(point->z, 3);
+
+    mem::UniquePtr<Sum> sum(mem::makeUnique<Sum>(1, 2, 3, 4, 5, 6, 7, 8, 9, std::string("ten")));
+    EXPECT_EQ(sum->value, 48);
+
+    std::vector<mem::UniquePtr<Foo>::RvalueUniquePtr> data;
+    data.push_back(mem::makeUnique<Foo>(5));
+    EXPECT_EQ(data[0].borrow()->id(), 5);
+}
+
+TEST(MakeUnique, ReturnConcreteHandleAndUpcast) {
+    struct Base {
+        virtual ~Base() {}
+        virtual int id() const = 0;
+    };
+
+    struct Derived : public Base {
+        explicit Derived(int id): id_(id) {}
+        int id() const {
+            return id_;
+        }
+
+        int id_;
+    };
+
+    mem::UniquePtr<Base> base(mem::makeUnique<Derived>(3));
+    EXPECT_EQ(base->id(), 3);
+}
+
+TEST(MakeUnique, WithPolicyDoesNotLeakOnThrow) {
+    struct Bad {
+        Bad(int, int) {
+            throw 1;
+        }
+    };
+
+    mem::ObjectPool<Bad, 1> pool;
+    EXPECT_THROW(mem::makeUniqueWith<Bad>(pool, 1, 2), int);
+    EXPECT_EQ(pool.size(), 0);
+
+    mem::ObjectPool<Foo, 1> fooPool;
+    {
+        mem::ObjectPool<Foo, 1>::Pointer p(mem::makeUniqueWith<Foo>(fooPool, 8));
+        EXPECT_EQ(p->id(), 8);
+        EXPECT_TRUE(fooPool.full());
+    }
+    EXPECT_EQ(fooPool.size(), 0);
+}
+
+namespace {
+
+struct AllocatorStats {
+    size_t allocated;
+    size_t deallocated;
+    size_t destroyed;
+};
+
+// Минимальный аллокатор C++03 с состоянием: считает вызовы в общей статистике.
+template<class T>
+struct CountingAllocator {
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind {
+        typedef CountingAllocator<U> other;
+    };
+
+    explicit CountingAllocator(AllocatorStats *stats): stats(stats) {}
+
+    template<class U>
+    CountingAllocator(const CountingAllocator<U> &other): stats(other.stats) {}
+
+    pointer allocate(size_type n) {
+        stats->allocated += n;
+        return static_cast<pointer>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(pointer ptr, size_type n) {
+        stats->deallocated += n;
+        ::operator delete(ptr);
+    }
+
+    void construct(pointer ptr, const T &value) {
+        new (ptr) T(value);
+    }
+
+    void destroy(pointer ptr) {
+        ++stats->destroyed;
+        ptr->~T();
+    }
+
+    size_type max_size() const {
+        return size_t(-1) / sizeof(T);
+    }
+
+    AllocatorStats *stats;
+};
+
+} // namespace
+
+TEST(AllocateUnique, StatelessAllocatorCostsNothing) {
+    typedef mem::AllocatorDeleter<std::allocator<Foo> > FooDeleter;
+    EXPECT_EQ(sizeof(mem::UniquePtr<Foo, FooDeleter>), sizeof(Foo *));
+
+    mem::UniquePtr<Foo, FooDeleter> foo(mem::allocateUnique<Foo>(std::allocator<char>(), 4));
+    EXPECT_EQ(foo->id(), 4);
+}
+
+TEST(AllocateUnique, DestroyAndDeallocateThroughAllocator) {
+    AllocatorStats stats = {0, 0, 0};
+    typedef mem::AllocatorDeleter<CountingAllocator<Foo> > FooDeleter;
+    EXPECT_EQ(sizeof(mem::UniquePtr<Foo, FooDeleter>), 2 * sizeof(void *));
+    {
+        mem::UniquePtr<Foo, FooDeleter> foo(
+                mem::allocateUnique<Foo>(CountingAllocator<char>(&stats), 9));
+        EXPECT_EQ(foo->id(), 9);
+        EXPECT_EQ(foo.getDeleter().allocator().stats, &stats);
+
+        mem::UniquePtr<Foo, FooDeleter> moved(foo.move());
+        EXPECT_EQ(stats.allocated, 1);
+        EXPECT_EQ(stats.destroyed, 0);
+    }
+    EXPECT_EQ(stats.destroyed, 1);
+    EXPECT_EQ(stats.deallocated, 1);
+}
+
+TEST(AllocateUnique, DeallocateWhenConstructorThrows) {
+    struct Bad {
+        explicit Bad(int) {
+            throw 1;
+        }
+    };
+
+    AllocatorStats stats = {0, 0, 0};
+    EXPECT_THROW(mem::allocateUnique<Bad>(CountingAllocator<Bad>(&stats), 1), int);
+    EXPECT_EQ(stats.allocated, 1);
+    EXPECT_EQ(stats.deallocated, 1);
+    EXPECT_EQ(stats.destroyed, 0);
+}
+
+TEST(ObjectPool, CreateFromPool) {
+    typedef mem::ObjectPool<Foo, 4> FooPool;
+    FooPool pool;
+    {
+        FooPool::Pointer p1(pool.make(10));
+        FooPool::Pointer p2(pool.make());
+
+        EXPECT_EQ(p1->id(), 10);
+        EXPECT_EQ(p2->id(), 0);
+        EXPECT_TRUE(pool.owns(p1.get()));
+        EXPECT_EQ(pool.size(), 2);
+    }
+    EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(ObjectPool, ForwardUpToTenArguments) {
+    struct Sum {
+        Sum(int a1, int a2, int a3, int a4, int a5, int a6, int a7, int a8, int a9,
+            const std::string &a10):
+            value(a1 + a2 + a3 + a4 + a5 + a6 + a7 + a8 + a9 + static_cast<int>(a10.size()))
+        {}
+
+        int value;
+    };
+
+    typedef mem::ObjectPool<Sum, 1> SumPool;
+    SumPool pool;
+    SumPool::Pointer sum(pool.make(1, 2, 3, 4, 5, 6, 7, 8, 9, std::string("ten")));
+    EXPECT_EQ(sum->value, 48);
+    EXPECT_TRUE(pool.owns(sum.get()));
+}
+
+TEST(ObjectPool, ReuseFreedSlot) {
+    typedef mem::ObjectPool<Foo, 2> FooPool;
+    FooPool pool;
+
+    Foo *first = NULL;
+    {
+        FooPool::Pointer p(pool.make(1));
+        first = p.get();
+    }
+    FooPool::Pointer p(pool.make(2));
+
+    EXPECT_EQ(p.get(), first);
+    EXPECT_EQ(p->id(), 2);
+}
+
+TEST(ObjectPool, ThrowWhenExhausted) {
+    typedef mem::ObjectPool<Foo, 2> FooPool;
+    FooPool pool;
+    FooPool::Pointer p1(pool.make(1));
+    {
+        FooPool::Pointer p2(pool.make(2));
+
+        EXPECT_TRUE(pool.full());
+        EXPECT_THROW(pool.make(3), std::bad_alloc);
+    }
+
+    p1 = pool.make(4);
+    EXPECT_EQ(p1->id(), 4);
+    EXPECT_EQ(pool.size(), 1);
+}
+
+TEST(ObjectPool, ReturnSlotWhenConstructorThrows) {
+    struct Bad {
+        Bad(int) {
+            throw 1;
+        }
+    };
+
+    mem::ObjectPool<Bad, 1> pool;
+    EXPECT_THROW(pool.make(0), int);
+    EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(ObjectPool, WorkWithVector) {
+    typedef mem::ObjectPool<Foo, 8> FooPool;
+    FooPool pool;
+    {
+        std::vector<FooPool::RvaluePointer> data;
+        for (size_t i = 0; i < 8; ++i) {
+            data.push_back(pool.make(i));
+        }
+        EXPECT_EQ(pool.size(), 8);
+
+        FooPool::Pointer p5(data[5]);
+        EXPECT_EQ(p5->id(), 5);
+    }
+    EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(Arena, DestructorsRunOnResetInReverseOrder) {
+    struct Tracked {
+        Tracked(std::vector<int> *log, int id): log_(log), id_(id) {}
+        ~Tracked() {
+            log_->push_back(id_);
+        }
+
+        std::vector<int> *log_;
+        int id_;
+    };
+
+    std::vector<int> log;
+    mem::Arena arena;
+    {
+        mem::UniquePtr<Tracked, mem::ArenaDeleter<Tracked> > a(arena.make<Tracked>(&log, 1));
+        mem::UniquePtr<Tracked, mem::ArenaDeleter<Tracked> > b(arena.make<Tracked>(&log, 2));
+        EXPECT_EQ(b->id_, 2);
+    }
+    EXPECT_TRUE(log.empty());
+    EXPECT_EQ(arena.destructorCount(), 2);
+
+    arena.reset();
+    ASSERT_EQ(log.size(), 2);
+    EXPECT_EQ(log[0], 2);
+    EXPECT_EQ(log[1], 1);
+    EXPECT_EQ(arena.destructorCount(), 0);
+    EXPECT_EQ(arena.bytesUsed(), 0);
+}
+
+TEST(Arena, SkipDestructorListForTrivialTypes) {
+    struct Point {
+        Point(double x, double y): x(x), y(y) {}
+
+        double x;
+        double y;
+    };
+
+    mem::Arena arena;
+    mem::UniquePtr<Point, mem::ArenaDeleter<Point> > p(arena.make<Point>(1.0, 2.0));
+    EXPECT_EQ(p->y, 2.0);
+    EXPECT_EQ(reinterpret_cast<size_t>(p.get()) % mem::detail::AlignOf<Point>::value, 0);
+    EXPECT_EQ(arena.destructorCount(), 0);
+    EXPECT_EQ(arena.bytesUsed(), sizeof(Point));
+}
+
+TEST(Arena, ReuseChunksAfterReset) {
+    mem::Arena arena(256);
+    void *first = arena.allocate(64, 8);
+    for (size_t i = 0; i < 16; ++i) {
+        arena.allocate(64, 8);
+    }
+    const size_t reserved = arena.bytesReserved();
+    EXPECT_GE(reserved, 17 * 64);
+
+    arena.reset();
+    EXPECT_EQ(arena.allocate(64, 8), first);
+    for (size_t i = 0; i < 16; ++i) {
+        arena.allocate(64, 8);
+    }
+    EXPECT_EQ(arena.bytesReserved(), reserved);
+}
+
+TEST(Arena, AllocateMoreThanChunkSize) {
+    mem::Arena arena(128);
+    char *big = static_cast<char *>(arena.allocate(1000, 64));
+    EXPECT_EQ(reinterpret_cast<size_t>(big) % 64, 0);
+    for (size_t i = 0; i < 1000; ++i) {
+        big[i] = 'x';
+    }
+
+    mem::UniquePtr<Foo, mem::ArenaDeleter<Foo> > foo(arena.make<Foo>(7));
+    EXPECT_EQ(foo->id(), 7);
+}
+
+namespace {
+
+struct CompactNodes {};
+
+typedef mem::CompactArena<CompactNodes> CompactNodeArena;
+
+struct CompactNode {
+    CompactNode(int value, int *destroyed): value(value), destroyed(destroyed) {}
+
+    virtual ~CompactNode() {
+        ++*destroyed;
+    }
+
+    int value;
+    int *destroyed;
+    mem::CompactUniquePtr<CompactNode, CompactNodeArena, 2> left;
+    mem::CompactUniquePtr<CompactNode, CompactNodeArena, 2> right;
+};
+
+struct CompactLeaf : public CompactNode {
+    CompactLeaf(int value, int *destroyed): CompactNode(value, destroyed) {}
+};
+
+typedef mem::CompactUniquePtr<CompactNode, CompactNodeArena, 2> CompactNodePtr;
+
+} // namespace
+
+TEST(CompactUniquePtr, HalfThePointerSize) {
+    EXPECT_EQ(sizeof(CompactNodePtr), 4);
+    EXPECT_EQ(sizeof(CompactNodePtr::RvalueUniquePtr), 4);
+}
+
+TEST(CompactUniquePtr, MoveTransfersOwnershipAndTag) {
+    CompactNodeArena::reserve(4096);
+    int destroyed = 0;
+    {
+        CompactNodePtr root(CompactNodeArena::make<CompactNode>(1, &destroyed));
+        root->left = CompactNodeArena::make<CompactNode>(2, &destroyed);
+        root->left.setTag(3);
+        EXPECT_EQ(root->left->value, 2);
+        EXPECT_EQ(root->left.tag(), 3);
+        // Смещение 0 занято под NULL, поэтому первый узел лежит по его собственному выравниванию.
+        EXPECT_EQ(reinterpret_cast<char *>(root.get()) - CompactNodeArena::base(),
+                  static_cast<ptrdiff_t>(mem::detail::AlignOf<CompactNode>::value));
+
+        root->right = root->left.move();
+        EXPECT_EQ(root->left.get(), static_cast<CompactNode *>(NULL));
+        EXPECT_EQ(root->left.tag(), 0);
+        EXPECT_EQ(root->right->value, 2);
+        EXPECT_EQ(root->right.tag(), 3);
+        EXPECT_EQ(destroyed, 0);
+
+        // Копия rvalue объекта забирает владение, как у RvalueUniquePtr.
+        CompactNodePtr::RvalueUniquePtr first = root->right.move();
+        CompactNodePtr::RvalueUniquePtr second = first;
+        EXPECT_EQ(first.borrow().get(), static_cast<CompactNode *>(NULL));
+        EXPECT_EQ(second.borrow()->value, 2);
+    }
+    EXPECT_EQ(destroyed, 2);
+    CompactNodeArena::release();
+}
+
+TEST(CompactUniquePtr, ConvertDerivedToBase) {
+    CompactNodeArena::reserve(4096);
+    int destroyed = 0;
+    {
+        mem::CompactUniquePtr<CompactLeaf, CompactNodeArena> leaf(
+                CompactNodeArena::make<CompactLeaf>(5, &destroyed));
+        CompactLeaf *raw = leaf.get();
+
+        CompactNodePtr node(leaf.move());
+        EXPECT_EQ(node.get(), raw);
+        EXPECT_EQ(node.tag(), 0);
+        EXPECT_EQ(node->value, 5);
+    }
+    EXPECT_EQ(destroyed, 1);
+    CompactNodeArena::release();
+}
+
+TEST(CompactUniquePtr, ThrowWhenArenaIsFull) {
+    CompactNodeArena::reserve(64);
+    int destroyed = 0;
+    CompactNodePtr node(CompactNodeArena::make<CompactNode>(1, &destroyed));
+    EXPECT_THROW(CompactNodeArena::make<CompactNode>(2, &destroyed), std::bad_alloc);
+    EXPECT_EQ(destroyed, 0);
+
+    node = CompactNodePtr().move();
+    EXPECT_EQ(destroyed, 1);
+    CompactNodeArena::reset();
+    EXPECT_EQ(CompactNodeArena::bytesUsed(), CompactNodeArena::Alignment);
+    CompactNodeArena::release();
+}
+
+TEST(SpscOwnedQueue, PushPopInOrder) {
+    typedef mem::SpscOwnedQueue<Foo> FooQueue;
+    FooQueue queue(3);
+    EXPECT_EQ(queue.capacity(), 4);
+    EXPECT_TRUE(queue.empty());
+
+    for (size_t i = 0; i < 4; ++i) {
+        queue.push(mem::makeUnique<Foo>(i));
+    }
+
+    FooQueue::RvalueUniquePtr extra(mem::makeUnique<Foo>(4));
+    EXPECT_FALSE(queue.tryPush(extra));
+    EXPECT_EQ(extra.borrow()->id(), 4);
+
+    for (size_t i = 0; i < 4; ++i) {
+        FooQueue::Pointer p(queue.pop());
+        EXPECT_EQ(p->id(), i);
+    }
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.tryPop().borrow().empty());
+
+    EXPECT_TRUE(queue.tryPush(extra));
+    EXPECT_TRUE(extra.borrow().empty());
+    EXPECT_EQ(queue.pop().borrow()->id(), 4);
+}
+
+namespace {
+
+struct CountingFooDeleter {
+    CountingFooDeleter(): counter(NULL) {}
+    explicit CountingFooDeleter(int *c): counter(c) {}
+
+    void operator()(Foo *ptr) {
+        ++*counter;
+        delete ptr;
+    }
+
+    int *counter;
+};
+
+} // namespace
+
+TEST(MpmcOwnedQueue, DestroyLeftoverItems) {
+    typedef mem::MpmcOwnedQueue<Foo, CountingFooDeleter> FooQueue;
+    int deleted = 0;
+    {
+        FooQueue queue(8, CountingFooDeleter(&deleted));
+        for (size_t i = 0; i < 5; ++i) {
+            queue.push(FooQueue::Pointer(new Foo(i), CountingFooDeleter(&deleted)).move());
+        }
+        queue.pop();
+        EXPECT_EQ(deleted, 1);
+    }
+    EXPECT_EQ(deleted, 5);
+}
+
+namespace {
+
+typedef mem::MpmcOwnedQueue<Foo> FooMpmcQueue;
+
+const size_t QueueItemsPerThread = 20000;
+
+struct QueueThreadArgs {
+    FooMpmcQueue *queue;
+    size_t first;
+    size_t sum;
+};
+
+void *produceFoo(void *data) {
+    QueueThreadArgs *args = static_cast<QueueThreadArgs *>(data);
+    for (size_t i = 0; i < QueueItemsPerThread; ++i) {
+        args->queue->push(mem::makeUnique<Foo>(args->first + i));
+    }
+    return NULL;
+}
+
+void *consumeFoo(void *data) {
+    QueueThreadArgs *args = static_cast<QueueThreadArgs *>(data);
+    for (size_t i = 0; i < QueueItemsPerThread; ++i) {
+        FooMpmcQueue::Pointer p(args->queue->pop());
+        args->sum += p->id();
+    }
+    return NULL;
+}
+
+} // namespace
+
+TEST(MpmcOwnedQueue, TransferAcrossThreads) {
+    const size_t threads = 4;
+    FooMpmcQueue queue(64);
+    QueueThreadArgs producers[threads];
+    QueueThreadArgs consumers[threads];
+    pthread_t handles[2 * threads];
+
+    for (size_t i = 0; i < threads; ++i) {
+        QueueThreadArgs producer = {&queue, i * QueueItemsPerThread, 0};
+        QueueThreadArgs consumer = {&queue, 0, 0};
+        producers[i] = producer;
+        consumers[i] = consumer;
+        ASSERT_EQ(pthread_create(&handles[2 * i], NULL, produceFoo, &producers[i]), 0);
+        ASSERT_EQ(pthread_create(&handles[2 * i + 1], NULL, consumeFoo, &consumers[i]), 0);
+    }
+    for (size_t i = 0; i < 2 * threads; ++i) {
+        pthread_join(handles[i], NULL);
+    }
+
+    size_t sum = 0;
+    for (size_t i = 0; i < threads; ++i) {
+        sum += consumers[i].sum;
+    }
+    const size_t total = threads * QueueItemsPerThread;
+    EXPECT_EQ(sum, total * (total - 1) / 2);
+    EXPECT_TRUE(queue.tryPop().borrow().empty());
+}
+
+TEST(AtomicUniquePtr, ExchangeReturnsDisplacedOwner) {
+    typedef mem::AtomicUniquePtr<Foo, CountingFooDeleter> AtomicFooPtr;
+    int deleted = 0;
+    const CountingFooDeleter deleter(&deleted);
+    {
+        AtomicFooPtr atomic(deleter);
+        EXPECT_TRUE(atomic.load().empty());
+
+        atomic.store(AtomicFooPtr::Pointer(new Foo(1), deleter).move());
+        EXPECT_EQ(atomic.load()->id(), 1);
+
+        {
+            AtomicFooPtr::Pointer displaced(atomic.exchange(AtomicFooPtr::Pointer(new Foo(2), deleter).move()));
+            EXPECT_EQ(displaced->id(), 1);
+            EXPECT_EQ(atomic.load()->id(), 2);
+            EXPECT_EQ(deleted, 0);
+        }
+        EXPECT_EQ(deleted, 1);
+
+        atomic.store(AtomicFooPtr::Pointer(new Foo(3), deleter).move());
+        EXPECT_EQ(deleted, 2);
+    }
+    EXPECT_EQ(deleted, 3);
+}
+
+TEST(AtomicUniquePtr, CompareExchange) {
+    typedef mem::AtomicUniquePtr<Foo> AtomicFooPtr;
+    AtomicFooPtr atomic(mem::makeUnique<Foo>(1));
+    mem::ObserverPtr<Foo> expected;
+
+    AtomicFooPtr::RvalueUniquePtr desired(mem::makeUnique<Foo>(2));
+    EXPECT_FALSE(atomic.compareExchange(expected, desired));
+    EXPECT_EQ(expected, atomic.load());
+    EXPECT_EQ(desired.borrow()->id(), 2);
+
+    EXPECT_TRUE(atomic.compareExchange(expected, desired));
+    EXPECT_EQ(atomic.load()->id(), 2);
+    EXPECT_EQ(desired.borrow()->id(), 1);
+}
+
+namespace {
+
+struct Config {
+    explicit Config(size_t version): version(version), twice(2 * version) {}
+
+    // Breaks the invariant so that a read after free is likely to be noticed.
+    ~Config() {
+        twice = 1;
+    }
+
+    size_t version;
+    size_t twice;
+};
+
+typedef mem::AtomicUniquePtr<Config> AtomicConfigPtr;
+
+const size_t ConfigVersions = 2000;
+
+struct ConfigReaderArgs {
+    AtomicConfigPtr *config;
+    size_t broken;
+};
+
+void *readConfig(void *data) {
+    ConfigReaderArgs *args = static_cast<ConfigReaderArgs *>(data);
+    for (;;) {
+        const mem::ObserverPtr<Config> config = args->config->load();
+        if (config->twice != 2 * config->version) {
+            ++args->broken;
+        }
+        if (config->version == ConfigVersions) {
+            return NULL;
+        }
+    }
+}
+
+} // namespace
+
+TEST(AtomicUniquePtr, PublishToConcurrentReaders) {
+    const size_t readers = 3;
+    AtomicConfigPtr config(mem::makeUnique<Config>(0));
+    ConfigReaderArgs args[readers];
+    pthread_t handles[readers];
+    for (size_t i = 0; i < readers; ++i) {
+        ConfigReaderArgs arg = {&config, 0};
+        args[i] = arg;
+        ASSERT_EQ(pthread_create(&handles[i], NULL, readConfig, &args[i]), 0);
+    }
+
+    // Readers may still hold displaced versions, so they are reclaimed only after the join.
+    mem::PtrVector<Config> retired;
+    for (size_t version = 1; version <= ConfigVersions; ++version) {
+        retired.push_back(config.exchange(mem::makeUnique<Config>(version)));
+    }
+
+    for (size_t i = 0; i < readers; ++i) {
+        pthread_join(handles[i], NULL);
+        EXPECT_EQ(args[i].broken, 0);
+    }
+    EXPECT_EQ(retired.size(), ConfigVersions);
+}
+
+namespace {
+
+size_t payloadsDestroyed = 0;
+
+struct Payload {
+    explicit Payload(size_t nodes) {
+        for (size_t i = 0; i < nodes; ++i) {
+            nodes_.push_back(new Foo(i));
+        }
+    }
+
+    ~Payload() {
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            delete nodes_[i];
+        }
+        mem::detail::atomicFetchAdd(&payloadsDestroyed, size_t(1));
+    }
+
+    std::vector<Foo *> nodes_;
+};
+
+typedef mem::UniquePtr<Payload, mem::DeferredDeleter<Payload> > DeferredPayloadPtr;
+
+size_t destroyedPayloads() {
+    return mem::detail::atomicLoad(&payloadsDestroyed);
+}
+
+} // namespace
+
+TEST(DeferredDeleter, DestroyOnFlush) {
+    mem::flushDeferred();
+    const size_t before = destroyedPayloads();
+    {
+        DeferredPayloadPtr p(mem::makeUnique<Payload>(10));
+        DeferredPayloadPtr q(new Payload(10));
+    }
+    EXPECT_EQ(destroyedPayloads(), before);
+
+    mem::flushDeferred();
+    EXPECT_EQ(destroyedPayloads(), before + 2);
+    EXPECT_EQ(mem::deferredPending(), 0);
+}
+
+TEST(DeferredDeleter, BatchSizeAndHighWater) {
+    mem::flushDeferred();
+    mem::setDeferredBatchSize(4);
+    mem::setDeferredHighWater(8);
+    const size_t before = destroyedPayloads();
+
+    for (size_t i = 0; i < 4; ++i) {
+        DeferredPayloadPtr p(new Payload(1));
+    }
+    EXPECT_EQ(mem::deferredPending(), 4);
+    EXPECT_EQ(destroyedPayloads(), before);
+
+    // The third submitted batch crosses the high-water mark and is destroyed by this thread.
+    for (size_t i = 0; i < 8; ++i) {
+        DeferredPayloadPtr p(new Payload(1));
+    }
+    EXPECT_EQ(mem::deferredPending(), 0);
+    EXPECT_EQ(destroyedPayloads(), before + 12);
+
+    mem::setDeferredBatchSize(256);
+    mem::setDeferredHighWater(65536);
+}
+
+TEST(DeferredDeleter, BackgroundReclaimer) {
+    mem::flushDeferred();
+    mem::setDeferredBatchSize(1);
+    const size_t before = destroyedPayloads();
+
+    ASSERT_TRUE(mem::startDeferredReclaimer());
+    EXPECT_FALSE(mem::startDeferredReclaimer());
+    {
+        DeferredPayloadPtr p(new Payload(1));
+    }
+    for (size_t i = 0; i < 10000 && destroyedPayloads() == before; ++i) {
+        mem::detail::threadYield();
+    }
+    EXPECT_EQ(destroyedPayloads(), before + 1);
+
+    mem::stopDeferredReclaimer();
+    mem::setDeferredBatchSize(256);
+}
+
+TEST(DeferredDeleter, OwningThreadDoesNotRunDestructor) {
+    mem::flushDeferred();
+    const size_t before = destroyedPayloads();
+    {
+        DeferredPayloadPtr p(new Payload(20000));
+        DeferredPayloadPtr q(new Payload(1));
+    }
+    EXPECT_EQ(destroyedPayloads(), before);
+
+    mem::flushDeferred();
+    EXPECT_EQ(destroyedPayloads(), before + 2);
+}
+
+TEST(EpochDomain, FreeOnlyAfterReadersLeave) {
+    mem::flushDeferred();
+    const size_t before = destroyedPayloads();
+    mem::EpochDomain domain;
+    {
+        mem::EpochDomain::Guard guard(domain);
+        {
+            mem::UniquePtr<Payload, mem::EpochDeleter<Payload> > p(
+                    new Payload(1), mem::EpochDeleter<Payload>(&domain));
+        }
+        EXPECT_EQ(domain.pending(), 1);
+
+        for (size_t i = 0; i < 4; ++i) {
+            domain.collect();
+        }
+        EXPECT_EQ(domain.pending(), 1);
+        EXPECT_EQ(destroyedPayloads(), before);
+    }
+
+    for (size_t i = 0; i < 3; ++i) {
+        domain.collect();
+    }
+    EXPECT_EQ(domain.pending(), 0);
+    EXPECT_EQ(destroyedPayloads(), before + 1);
+}
+
+namespace {
+
+typedef mem::AtomicUniquePtr<Config, mem::EpochDeleter<Config> > EpochConfigPtr;
+
+struct EpochReaderArgs {
+    mem::EpochDomain *domain;
+    EpochConfigPtr *config;
+    size_t broken;
+};
+
+void *readEpochConfig(void *data) {
+    EpochReaderArgs *args = static_cast<EpochReaderArgs *>(data);
+    for (;;) {
+        mem::EpochDomain::Guard guard(*args->domain);
+        const mem::ObserverPtr<Config> config = args->config->load();
+        if (config->twice != 2 * config->version) {
+            ++args->broken;
+        }
+        if (config->version == ConfigVersions) {
+            return NULL;
+        }
+    }
+}
+
+} // namespace
+
+TEST(EpochDomain, AtomicPointerAdoptsDeleterOfRvalue) {
+    mem::EpochDomain domain;
+    const mem::EpochDeleter<Config> deleter(&domain);
+    {
+        EpochConfigPtr config(EpochConfigPtr::Pointer(new Config(1), deleter).move());
+        EXPECT_EQ(config.getDeleter().domain(), &domain);
+
+        config.exchange(EpochConfigPtr::Pointer(new Config(2), deleter).move());
+        EXPECT_EQ(config.load()->version, size_t(2));
+    }
+    EXPECT_EQ(domain.pending(), 2);
+
+    for (size_t i = 0; i < 3; ++i) {
+        domain.collect();
+    }
+    EXPECT_EQ(domain.pending(), 0);
+}
+
+TEST(EpochDomain, ReclaimWhileReadersRun) {
+    const size_t readers = 4;
+    mem::EpochDomain domain;
+    const mem::EpochDeleter<Config> deleter(&domain);
+    EpochConfigPtr config(deleter);
+    config.store(EpochConfigPtr::Pointer(new Config(0), deleter).move());
+
+    EpochReaderArgs args[readers];
+    pthread_t handles[readers];
+    for (size_t i = 0; i < readers; ++i) {
+        EpochReaderArgs arg = {&domain, &config, 0};
+        args[i] = arg;
+        ASSERT_EQ(pthread_create(&handles[i], NULL, readEpochConfig, &args[i]), 0);
+    }
+
+    // Displaced versions are retired into the domain as soon as exchange() hands them back.
+    for (size_t version = 1; version <= ConfigVersions; ++version) {
+        config.exchange(EpochConfigPtr::Pointer(new Config(version), deleter).move());
+    }
+
+    for (size_t i = 0; i < readers; ++i) {
+        pthread_join(handles[i], NULL);
+        EXPECT_EQ(args[i].broken, 0);
+    }
+
+    for (size_t i = 0; i < 3; ++i) {
+        domain.collect();
+    }
+    EXPECT_EQ(domain.pending(), 0);
+}
+
+namespace {
+
+struct Document : public mem::IntrusiveRefCounted<> {
+    Document(size_t pages, int *destroyed): pages(pages), destroyed(destroyed) {}
+
+    virtual ~Document() {
+        ++*destroyed;
+    }
+
+    size_t pages;
+    int *destroyed;
+};
+
+struct Report : public Document {
+    Report(size_t pages, int *destroyed): Document(pages, destroyed) {}
+};
+
+typedef mem::SharedPtr<Document> DocumentPtr;
+
+} // namespace
+
+TEST(SharedPtr, CopyCountsAndLastOwnerDeletes) {
+    int destroyed = 0;
+    {
+        DocumentPtr first(new Document(3, &destroyed));
+        EXPECT_EQ(first.useCount(), 1);
+        {
+            DocumentPtr second(first);
+            DocumentPtr third;
+            third = second;
+            EXPECT_EQ(first.useCount(), 3);
+            EXPECT_EQ(third->pages, 3);
+        }
+        EXPECT_EQ(first.useCount(), 1);
+        EXPECT_EQ(destroyed, 0);
+
+        first = first;
+        EXPECT_EQ(first.useCount(), 1);
+    }
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(SharedPtr, MoveDoesNotTouchCount) {
+    int destroyed = 0;
+    DocumentPtr first(new Document(1, &destroyed));
+    DocumentPtr second(first);
+
+    DocumentPtr third(second.move());
+    EXPECT_EQ(second.get(), static_cast<Document *>(NULL));
+    EXPECT_EQ(third.useCount(), 2);
+
+    // Копия rvalue объекта забирает ссылку, как у RvalueUniquePtr.
+    DocumentPtr::RvalueSharedPtr rvalue = third.move();
+    DocumentPtr::RvalueSharedPtr stolen = rvalue;
+    EXPECT_EQ(rvalue.borrow().get(), static_cast<Document *>(NULL));
+    EXPECT_EQ(stolen.borrow()->refCount(), 2);
+
+    // Несобранный rvalue объект отпускает свою ссылку.
+    stolen = first.move();
+    EXPECT_EQ(stolen.borrow()->refCount(), 1);
+    EXPECT_EQ(destroyed, 0);
+}
+
+TEST(SharedPtr, UpgradeFromUniqueWithoutReallocation) {
+    int destroyed = 0;
+    {
+        mem::UniquePtr<Report> unique(mem::makeUnique<Report>(7, &destroyed));
+        Report *raw = unique.get();
+
+        DocumentPtr shared(unique.move());
+        EXPECT_EQ(unique.get(), static_cast<Report *>(NULL));
+        EXPECT_EQ(shared.get(), raw);
+        EXPECT_EQ(shared.useCount(), 1);
+
+        shared = mem::makeUnique<Document>(1, &destroyed);
+        EXPECT_EQ(destroyed, 1);
+        EXPECT_EQ(shared->pages, 1);
+    }
+    EXPECT_EQ(destroyed, 2);
+}
+
+namespace {
+
+struct Counter : public mem::IntrusiveRefCounted<mem::MultiThreadedRefCount> {
+    ~Counter() {
+        mem::detail::atomicFetchAdd(&countersDestroyed, size_t(1));
+    }
+
+    static size_t countersDestroyed;
+};
+
+size_t Counter::countersDestroyed = 0;
+
+const size_t CounterCopies = 100000;
+
+void *copyCounter(void *data) {
+    const mem::SharedPtr<Counter> &counter = *static_cast<mem::SharedPtr<Counter> *>(data);
+    for (size_t i = 0; i < CounterCopies; ++i) {
+        mem::SharedPtr<Counter> copy(counter);
+        mem::SharedPtr<Counter> moved(copy.move());
+    }
+    return NULL;
+}
+
+} // namespace
+
+TEST(SharedPtr, AtomicCountAcrossThreads) {
+    const size_t threads = 4;
+    {
+        mem::SharedPtr<Counter> counter(new Counter());
+        pthread_t handles[threads];
+        for (size_t i = 0; i < threads; ++i) {
+            ASSERT_EQ(pthread_create(&handles[i], NULL, copyCounter, &counter), 0);
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            pthread_join(handles[i], NULL);
+        }
+        EXPECT_EQ(counter.useCount(), 1);
+    }
+    EXPECT_EQ(Counter::countersDestroyed, 1);
+}
+
+namespace {
+
+struct Block {
+    explicit Block(size_t id): id(id) {}
+
+    size_t id;
+    char data[256 - sizeof(size_t)];
+};
+
+typedef mem::UniquePtr<Block, mem::ThreadCacheDeleter<Block> > CachedBlockPtr;
+
+struct Left {
+    virtual ~Left() {}
+
+    size_t left;
+};
+
+struct Right {
+    virtual ~Right() {}
+
+    size_t right;
+};
+
+struct Both : public Left, public Right {
+    explicit Both(size_t id) {
+        left = id;
+        right = id;
+    }
+};
+
+void *freeBlocks(void *data) {
+    std::vector<CachedBlockPtr::RvalueUniquePtr> &blocks =
+            *static_cast<std::vector<CachedBlockPtr::RvalueUniquePtr> *>(data);
+    blocks.clear();
+    return NULL;
+}
+
+void *leaveBlock(void *data) {
+    *static_cast<CachedBlockPtr::RvalueUniquePtr *>(data) =
+            mem::ThreadCacheAllocator::make<Block>(size_t(7));
+    return NULL;
+}
+
+} // namespace
+
+TEST(ThreadCacheAllocator, ReuseFreedSlot) {
+    EXPECT_EQ(sizeof(CachedBlockPtr), sizeof(Block *));
+
+    Block *first = NULL;
+    {
+        CachedBlockPtr block(mem::ThreadCacheAllocator::make<Block>(size_t(1)));
+        first = block.get();
+        EXPECT_EQ(block->id, 1);
+        EXPECT_EQ(reinterpret_cast<size_t>(first) % 16, 0);
+    }
+    CachedBlockPtr block(mem::ThreadCacheAllocator::make<Block>(size_t(2)));
+    EXPECT_EQ(block.get(), first);
+
+    mem::ThreadCachePolicy<Foo> policy;
+    mem::UniquePtr<Foo, mem::ThreadCacheDeleter<Foo> > foo(mem::makeUniqueWith<Foo>(policy, 3));
+    EXPECT_EQ(foo->id(), 3);
+}
+
+TEST(ThreadCacheAllocator, FreeThroughSecondBase) {
+    void *slot = NULL;
+    {
+        mem::UniquePtr<Right, mem::ThreadCacheDeleter<Right> > right(
+                mem::ThreadCacheAllocator::make<Both>(size_t(5)));
+        slot = dynamic_cast<void *>(right.get());
+        EXPECT_NE(static_cast<void *>(right.get()), slot);
+        EXPECT_EQ(right->right, 5);
+    }
+    mem::UniquePtr<Both, mem::ThreadCacheDeleter<Both> > both(
+            mem::ThreadCacheAllocator::make<Both>(size_t(6)));
+    EXPECT_EQ(static_cast<void *>(both.get()), slot);
+}
+
+TEST(ThreadCacheAllocator, OwnerCollectsRemoteFrees) {
+    // Пустое кольцо класса: все объекты ниже окажутся в одном блоке.
+    mem::ThreadCacheAllocator::releaseCurrentThread();
+    const size_t slots = mem::detail::ThreadCacheChunkSize - mem::detail::ThreadCacheHeaderSize;
+    const size_t capacity = slots / sizeof(Block);
+    std::vector<CachedBlockPtr::RvalueUniquePtr> blocks;
+    std::set<Block *> addresses;
+    for (size_t i = 0; i < capacity; ++i) {
+        blocks.push_back(mem::ThreadCacheAllocator::make<Block>(i));
+        addresses.insert(blocks.back().borrow().get());
+    }
+
+    pthread_t thread;
+    ASSERT_EQ(pthread_create(&thread, NULL, freeBlocks, &blocks), 0);
+    pthread_join(thread, NULL);
+
+    // Блок исчерпан, поэтому слот берется из списка освобожденных другим потоком.
+    CachedBlockPtr block(mem::ThreadCacheAllocator::make<Block>(size_t(0)));
+    EXPECT_EQ(addresses.count(block.get()), 1);
+}
+
+TEST(ThreadCacheAllocator, AdoptChunkOfFinishedThread) {
+    mem::ThreadCacheAllocator::releaseCurrentThread();
+    const size_t abandoned = mem::ThreadCacheAllocator::abandonedChunks();
+
+    CachedBlockPtr::RvalueUniquePtr left = CachedBlockPtr().move();
+    pthread_t thread;
+    ASSERT_EQ(pthread_create(&thread, NULL, leaveBlock, &left), 0);
+    pthread_join(thread, NULL);
+    EXPECT_EQ(mem::ThreadCacheAllocator::abandonedChunks(), abandoned + 1);
+
+    Block *address = left.borrow().get();
+    EXPECT_EQ(address->id, 7);
+    left = CachedBlockPtr().move();
+
+    // Блок завершившегося потока достается следующему потоку с тем же классом размера.
+    CachedBlockPtr block(mem::ThreadCacheAllocator::make<Block>(size_t(8)));
+    EXPECT_EQ(mem::ThreadCacheAllocator::abandonedChunks(), abandoned);
+    EXPECT_EQ(mem::detail::chunkOf(block.get()), mem::detail::chunkOf(address));
+}
+
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
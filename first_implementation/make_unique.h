@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+#include "preprocessor.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+struct UniqueFactory {
+    /**
+     * @brief Создать RvalueUniquePtr, владеющий уже сконструированным объектом.
+     * @details Единственная точка, где владение появляется: без промежуточного UniquePtr и move().
+     */
+    template<class T, class D>
+    static RvalueUniquePtr<T, D> adopt(T *ptr, const D &deleter) {
+        MEM_INSTRUMENT(T, Construct, ptr, NULL, NULL);
+        return RvalueUniquePtr<T, D>(ptr, deleter);
+    }
+};
+
+/**
+ * @brief Возвращает память в политику выделения, если конструктор объекта бросил исключение.
+ * @tparam P Тип политики выделения памяти.
+ */
+template<class P>
+class AllocationGuard {
+public:
+    AllocationGuard(P &policy, void *memory):
+    policy_(policy),
+    memory_(memory) {
+    }
+
+    ~AllocationGuard() {
+        if (memory_ != NULL) {
+            policy_.deallocate(memory_);
+        }
+    }
+
+    void *get() const {
+        return memory_;
+    }
+
+    void dismiss() {
+        memory_ = NULL;
+    }
+
+private:
+    AllocationGuard(const AllocationGuard &other);
+    AllocationGuard &operator=(const AllocationGuard &other);
+
+    P &policy_; //!< Политика выделения памяти.
+    void *memory_; //!< Выделенная, но еще не занятая объектом память.
+};
+
+} // namespace detail
+
+/**
+ * Семейство фабрик makeUnique / makeUniqueWith для C++03.
+ *
+ * makeUnique<T>(a1, ..., aN) создает объект через new и сразу возвращает RvalueUniquePtr<T>,
+ * без промежуточного UniquePtr. Если конструктор бросает исключение, память освобождает
+ * сам new-expression.
+ *
+ * makeUniqueWith<T>(policy, a1, ..., aN) делает то же самое с памятью из политики выделения.
+ * Политика должна предоставлять:
+ *  - typedef ... Deleter;            функтор, освобождающий объект T;
+ *  - void *allocate();               память под один объект T (или исключение);
+ *  - void deallocate(void *memory);  возврат памяти, если конструктор T бросил исключение;
+ *  - Deleter deleter();              функтор, который будет храниться в умном указателе.
+ * Этим требованиям удовлетворяет, например, ObjectPool<T, N>.
+ *
+ * Аргументы передаются по константной ссылке (ограничение C++03), перегрузки сгенерированы
+ * для 0..MEM_MAKE_UNIQUE_MAX_ARITY аргументов.
+ */
+#define MEM_MAKE_UNIQUE_MAX_ARITY 10
+
+#define MEM_MAKE_UNIQUE(n) \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    typename UniquePtr<T>::RvalueUniquePtr makeUnique(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        return detail::UniqueFactory::adopt(new T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)), \
+                                            Deleter<T>()); \
+    } \
+    \
+    template<class T, class P, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvalueUniquePtr<T, typename P::Deleter> makeUniqueWith( \
+            P &policy, MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        detail::AllocationGuard<P> guard(policy, policy.allocate()); \
+        T *ptr = new (guard.get()) T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+        guard.dismiss(); \
+        return detail::UniqueFactory::adopt(ptr, policy.deleter()); \
+    }
+
+template<class T>
+typename UniquePtr<T>::RvalueUniquePtr makeUnique() {
+    return detail::UniqueFactory::adopt(new T(), Deleter<T>());
+}
+
+template<class T, class P>
+RvalueUniquePtr<T, typename P::Deleter> makeUniqueWith(P &policy) {
+    detail::AllocationGuard<P> guard(policy, policy.allocate());
+    T *ptr = new (guard.get()) T();
+    guard.dismiss();
+    return detail::UniqueFactory::adopt(ptr, policy.deleter());
+}
+
+MEM_MAKE_UNIQUE(1)
+MEM_MAKE_UNIQUE(2)
+MEM_MAKE_UNIQUE(3)
+MEM_MAKE_UNIQUE(4)
+MEM_MAKE_UNIQUE(5)
+MEM_MAKE_UNIQUE(6)
+MEM_MAKE_UNIQUE(7)
+MEM_MAKE_UNIQUE(8)
+MEM_MAKE_UNIQUE(9)
+MEM_MAKE_UNIQUE(10)
+
+#undef MEM_MAKE_UNIQUE
+
+} // namespace mem
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "make_unique.h"
+#include "preprocessor.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+template<class T, size_t N>
+class ObjectPool;
+
+/**
+ * @brief Класс-функтор, возвращающий объект в пул, из которого он был получен.
+ * @tparam T Тип очищаемых данных.
+ * @tparam N Размер пула объектов.
+ */
+template<class T, size_t N>
+class PoolDeleter {
+public:
+    //! Псевдоним для типа пула объектов, размера N.
+    typedef ObjectPool<T, N> PoolType;
+
+    /**
+     * @brief Конструктор по умолчанию. Функтор не привязан ни к одному пулу.
+     */
+    PoolDeleter();
+
+    /**
+     * @brief Конструктор класса.
+     * @param pool Указатель на экземпляр пула объектов, которому принадлежат объекты.
+     */
+    explicit PoolDeleter(PoolType *pool);
+
+    /**
+     * @brief Вызывает деструктор объекта и возвращает его ячейку в пул.
+     * @param ptr Указатель на объект, полученный из пула.
+     */
+    void operator()(T *ptr);
+
+    /**
+     * @brief Получить указатель на пул, к которому привязан функтор.
+     * @return Указатель на экземпляр пула объектов.
+     */
+    PoolType *pool() const;
+
+private:
+    PoolType *pool_; //!< Указатель на экземпляр пула объектов.
+};
+
+/**
+ * @brief Пул объектов фиксированного размера.
+ * @details Память под N объектов хранится внутри самого пула, свободные ячейки связаны в
+ * односвязный список. Выделение и освобождение объекта сводятся к снятию/возврату ячейки из
+ * этого списка, без обращения к глобальному оператору new. Пул должен пережить все умные
+ * указатели, полученные из него.
+ * @tparam T Тип объектов, хранящихся в пуле.
+ * @tparam N Размер пула объектов.
+ */
+template<class T, size_t N>
+class ObjectPool {
+public:
+    //! Псевдоним для типа объектов, хранящихся в пуле.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора, возвращающего объекты в этот пул.
+    typedef PoolDeleter<T, N> Deleter;
+    //! Псевдоним для типа умного указателя на объект из пула.
+    typedef UniquePtr<T, Deleter> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на объект из пула.
+    typedef typename Pointer::RvalueUniquePtr RvaluePointer;
+
+    /**
+     * @brief Конструктор по умолчанию. Все N ячеек пула свободны.
+     */
+    ObjectPool();
+
+    /**
+     * @brief Деструктор класса. Подразумевает, что все объекты уже возвращены в пул.
+     */
+    ~ObjectPool();
+
+    /**
+     * @brief Создать объект в пуле, сконструированный по умолчанию.
+     * @details Если конструктор объекта бросает исключение, ячейка возвращается в пул.
+     * @throw std::bad_alloc Если в пуле не осталось свободных ячеек.
+     * @return Объект класса RvalueUniquePtr, владеющий созданным объектом.
+     */
+    RvaluePointer make();
+
+    /**
+     * @brief Создать объект в пуле от переданных аргументов конструктора.
+     * @details Перегрузки сгенерированы для 1..MEM_MAKE_UNIQUE_MAX_ARITY аргументов, которые
+     * передаются по константной ссылке.
+     * @see make()
+     */
+#define MEM_OBJECT_POOL_MAKE_DECLARATION(n) \
+    template<MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvaluePointer make(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM));
+
+    MEM_OBJECT_POOL_MAKE_DECLARATION(1)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(2)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(3)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(4)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(5)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(6)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(7)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(8)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(9)
+    MEM_OBJECT_POOL_MAKE_DECLARATION(10)
+
+#undef MEM_OBJECT_POOL_MAKE_DECLARATION
+
+    /**
+     * @brief Снять свободную ячейку из пула без конструирования объекта.
+     * @throw std::bad_alloc Если в пуле не осталось свободных ячеек.
+     * @return Указатель на неинициализированную память под один объект типа T.
+     */
+    void *allocate();
+
+    /**
+     * @brief Вернуть ячейку в пул без вызова деструктора.
+     * @param ptr Указатель, полученный от allocate().
+     */
+    void deallocate(void *ptr);
+
+    /**
+     * @brief Вызвать деструктор объекта и вернуть его ячейку в пул.
+     * @param ptr Указатель на объект из этого пула или NULL.
+     */
+    void destroy(ValueType *ptr);
+
+    /**
+     * @brief Получить функтор, возвращающий объекты в этот пул.
+     * @details Вместе с allocate()/deallocate() позволяет использовать пул как политику выделения
+     * в makeUniqueWith().
+     */
+    Deleter deleter();
+
+    /**
+     * @brief Проверить, принадлежит ли указатель памяти этого пула.
+     */
+    bool owns(const void *ptr) const;
+
+    /**
+     * @brief Количество занятых ячеек пула.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Общее количество ячеек пула.
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Проверить, остались ли в пуле свободные ячейки.
+     */
+    bool full() const;
+
+private:
+    /**
+     * @brief Ячейка пула: либо ссылка на следующую свободную ячейку, либо память под объект.
+     * @details Дополнительные члены нужны только для выравнивания памяти под любой тип T.
+     */
+    union Slot {
+        Slot *next;
+        unsigned char storage[sizeof(T)];
+        long double alignLongDouble;
+        long alignLong;
+        void *alignPointer;
+        void (*alignFunction)();
+    };
+
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    ObjectPool(const ObjectPool &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    ObjectPool &operator=(const ObjectPool &other);
+
+    Slot slots_[N]; //!< Память под объекты пула.
+    Slot *freeList_; //!< Список возвращенных в пул ячеек.
+    size_t untouched_; //!< Индекс первой ячейки, которая еще ни разу не выдавалась.
+    size_t size_; //!< Количество занятых ячеек.
+};
+
+/**
+    template<class T, size_t N>
+    class PoolDeleter
+ **/
+template<class T, size_t N>
+PoolDeleter<T, N>::PoolDeleter():
+pool_(NULL) {
+}
+
+template<class T, size_t N>
+PoolDeleter<T, N>::PoolDeleter(PoolType *pool):
+pool_(pool) {
+}
+
+template<class T, size_t N>
+void PoolDeleter<T, N>::operator()(T *ptr) {
+    assert(pool_ != NULL);
+    pool_->destroy(ptr);
+}
+
+template<class T, size_t N>
+typename PoolDeleter<T, N>::PoolType *PoolDeleter<T, N>::pool() const {
+    return pool_;
+}
+
+/**
+    template<class T, size_t N>
+    class ObjectPool
+ **/
+template<class T, size_t N>
+ObjectPool<T, N>::ObjectPool():
+freeList_(NULL),
+untouched_(0),
+size_(0) {
+}
+
+template<class T, size_t N>
+ObjectPool<T, N>::~ObjectPool() {
+    assert(size_ == 0);
+}
+
+template<class T, size_t N>
+typename ObjectPool<T, N>::RvaluePointer ObjectPool<T, N>::make() {
+    return makeUniqueWith<ValueType>(*this);
+}
+
+#define MEM_OBJECT_POOL_MAKE_DEFINITION(n) \
+    template<class T, size_t N> \
+    template<MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    typename ObjectPool<T, N>::RvaluePointer ObjectPool<T, N>::make( \
+            MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        return makeUniqueWith<ValueType>(*this, MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+    }
+
+MEM_OBJECT_POOL_MAKE_DEFINITION(1)
+MEM_OBJECT_POOL_MAKE_DEFINITION(2)
+MEM_OBJECT_POOL_MAKE_DEFINITION(3)
+MEM_OBJECT_POOL_MAKE_DEFINITION(4)
+MEM_OBJECT_POOL_MAKE_DEFINITION(5)
+MEM_OBJECT_POOL_MAKE_DEFINITION(6)
+MEM_OBJECT_POOL_MAKE_DEFINITION(7)
+MEM_OBJECT_POOL_MAKE_DEFINITION(8)
+MEM_OBJECT_POOL_MAKE_DEFINITION(9)
+MEM_OBJECT_POOL_MAKE_DEFINITION(10)
+
+#undef MEM_OBJECT_POOL_MAKE_DEFINITION
+
+template<class T, size_t N>
+void *ObjectPool<T, N>::allocate() {
+    Slot *slot = NULL;
+    if (freeList_ != NULL) {
+        slot = freeList_;
+        freeList_ = slot->next;
+    } else if (untouched_ < N) {
+        slot = &slots_[untouched_++];
+    } else {
+        throw std::bad_alloc();
+    }
+
+    ++size_;
+    return slot->storage;
+}
+
+template<class T, size_t N>
+void ObjectPool<T, N>::deallocate(void *ptr) {
+    assert(owns(ptr));
+    Slot *slot = static_cast<Slot *>(ptr);
+    slot->next = freeList_;
+    freeList_ = slot;
+    --size_;
+}
+
+template<class T, size_t N>
+void ObjectPool<T, N>::destroy(ValueType *ptr) {
+    if (ptr != NULL) {
+        ptr->~ValueType();
+        deallocate(ptr);
+    }
+}
+
+template<class T, size_t N>
+bool ObjectPool<T, N>::owns(const void *ptr) const {
+    const Slot *slot = static_cast<const Slot *>(ptr);
+    return slot >= slots_ && slot < slots_ + N;
+}
+
+template<class T, size_t N>
+size_t ObjectPool<T, N>::size() const {
+    return size_;
+}
+
+template<class T, size_t N>
+size_t ObjectPool<T, N>::capacity() const {
+    return N;
+}
+
+template<class T, size_t N>
+bool ObjectPool<T, N>::full() const {
+    return size_ == N;
+}
+
+template<class T, size_t N>
+typename ObjectPool<T, N>::Deleter ObjectPool<T, N>::deleter() {
+    return Deleter(this);
+}
+
+} // namespace mem
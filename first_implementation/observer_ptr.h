@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+namespace mem {
+
+/**
+ * @brief Невладеющий указатель на объект, которым владеет UniquePtr.
+ * @details Копирование, разыменование и уничтожение ObserverPtr не передают владение и не
+ * вызывают функтор очистки данных: это просто обертка над T*. Наблюдатель не должен
+ * переживать владельца объекта.
+ * @tparam T Тип объекта (T или const T).
+ */
+template<class T>
+class ObserverPtr {
+public:
+    //! Псевдоним для типа объекта, на который указывает наблюдатель.
+    typedef T ValueType;
+
+    /**
+     * @brief Конструктор по умолчанию. Инициализирует указатель NULL.
+     */
+    ObserverPtr();
+
+    /**
+     * @brief Конструктор класса от указателя на объект.
+     * @param ptr Указатель на объект, владение которым остается у другого объекта.
+     */
+    explicit ObserverPtr(ValueType *ptr);
+
+    /**
+     * @brief Конструктор от наблюдателя за объектом совместимого типа.
+     * @details Компилируется только если U * неявно приводится к T * (например, Derived к Base
+     * или T к const T).
+     * @param other Ссылка на другой наблюдатель.
+     */
+    template<class U>
+    ObserverPtr(const ObserverPtr<U> &other);
+
+    /**
+     * @brief Оператор разыменования.
+     * @details Подразумевает, что наблюдатель не пустой.
+     */
+    ValueType &operator*() const;
+
+    /**
+     * @brief Оператор ->
+     * @details Подразумевает, что наблюдатель не пустой.
+     */
+    ValueType *operator->() const;
+
+    /**
+     * @brief Получить указатель на объект.
+     */
+    ValueType *get() const;
+
+    /**
+     * @brief Проверить, что наблюдатель пустой.
+     */
+    bool empty() const;
+
+private:
+    ValueType *data_; //!< Указатель на объект.
+};
+
+template<class T>
+ObserverPtr<T>::ObserverPtr():
+data_(NULL) {
+}
+
+template<class T>
+ObserverPtr<T>::ObserverPtr(ValueType *ptr):
+data_(ptr) {
+}
+
+template<class T>
+template<class U>
+ObserverPtr<T>::ObserverPtr(const ObserverPtr<U> &other):
+data_(other.get()) {
+}
+
+template<class T>
+typename ObserverPtr<T>::ValueType &ObserverPtr<T>::operator*() const {
+    assert(data_ != NULL);
+    return *data_;
+}
+
+template<class T>
+typename ObserverPtr<T>::ValueType *ObserverPtr<T>::operator->() const {
+    assert(data_ != NULL);
+    return data_;
+}
+
+template<class T>
+typename ObserverPtr<T>::ValueType *ObserverPtr<T>::get() const {
+    return data_;
+}
+
+template<class T>
+bool ObserverPtr<T>::empty() const {
+    return data_ == NULL;
+}
+
+template<class T, class U>
+bool operator==(const ObserverPtr<T> &a, const ObserverPtr<U> &b) {
+    return a.get() == b.get();
+}
+
+template<class T, class U>
+bool operator!=(const ObserverPtr<T> &a, const ObserverPtr<U> &b) {
+    return a.get() != b.get();
+}
+
+template<class T, class U>
+bool operator<(const ObserverPtr<T> &a, const ObserverPtr<U> &b) {
+    return a.get() < b.get();
+}
+
+} // namespace mem
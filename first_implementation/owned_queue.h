@@ -0,0 +1,509 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include "atomic.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+/**
+ * @brief Округлить вместимость очереди вверх до степени двойки (не меньше 2).
+ */
+inline size_t queueCapacity(size_t capacity) {
+    size_t result = 2;
+    while (result < capacity) {
+        result *= 2;
+    }
+    return result;
+}
+
+} // namespace detail
+
+/**
+ * @brief Ограниченная lock-free очередь для передачи владения объектами от одного потока-
+ * производителя одному потоку-потребителю.
+ * @details Кольцевой буфер сырых указателей на встроенных атомарных операциях (работает в C++03).
+ * Позиции производителя и потребителя разнесены по разным кэш-линиям, и каждая сторона кэширует
+ * последнюю прочитанную позицию другой стороны, чтобы не читать чужую кэш-линию на каждой
+ * операции. Объекты, оставшиеся в очереди, освобождаются в деструкторе функтором D.
+ * tryPush() и push() может вызывать только один поток, tryPop() и pop() — только один
+ * (возможно, другой) поток.
+ * @tparam T Тип объектов, передаваемых через очередь.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class T, class D = Deleter<T> >
+class SpscOwnedQueue {
+public:
+    //! Псевдоним для типа объектов, передаваемых через очередь.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+    //! Псевдоним для типа умного указателя на элемент очереди.
+    typedef UniquePtr<T, D> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на элемент очереди.
+    typedef typename Pointer::RvalueUniquePtr RvalueUniquePtr;
+
+    /**
+     * @brief Конструктор класса.
+     * @param capacity Вместимость очереди (округляется вверх до степени двойки).
+     */
+    explicit SpscOwnedQueue(size_t capacity);
+
+    /**
+     * @brief Конструктор класса от функтора для очистки данных.
+     * @param capacity Вместимость очереди (округляется вверх до степени двойки).
+     * @param deleter Функтор, которым освобождаются объекты, оставшиеся в очереди.
+     */
+    SpscOwnedQueue(size_t capacity, const Deleter &deleter);
+
+    /**
+     * @brief Деструктор класса. Освобождает объекты, оставшиеся в очереди.
+     */
+    ~SpscOwnedQueue();
+
+    /**
+     * @brief Попытаться добавить объект в очередь.
+     * @details Владение забирается у rvalue только при успехе, поэтому при заполненной очереди
+     * объект остается у вызывающей стороны.
+     * @param rvalue Непустой объект класса RvalueUniquePtr.
+     * @return true, если объект добавлен.
+     */
+    bool tryPush(RvalueUniquePtr &rvalue);
+
+    /**
+     * @brief Добавить объект в очередь, ожидая освобождения места.
+     * @param rvalue Непустой объект класса RvalueUniquePtr, передающий владение.
+     */
+    void push(RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Попытаться извлечь объект из очереди.
+     * @return Объект класса RvalueUniquePtr, владеющий объектом, или пустой, если очередь пуста.
+     */
+    RvalueUniquePtr tryPop();
+
+    /**
+     * @brief Извлечь объект из очереди, ожидая его появления.
+     * @return Объект класса RvalueUniquePtr, владеющий объектом.
+     */
+    RvalueUniquePtr pop();
+
+    /**
+     * @brief Проверить, что очередь пуста.
+     * @details При одновременной работе других потоков результат может сразу устареть.
+     */
+    bool empty() const;
+
+    size_t capacity() const;
+
+    /**
+     * @brief Получить функтор для освобождения данных.
+     */
+    Deleter &getDeleter();
+
+private:
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    SpscOwnedQueue(const SpscOwnedQueue &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    SpscOwnedQueue &operator=(const SpscOwnedQueue &other);
+
+    /**
+     * @brief Добавить указатель в очередь.
+     * @return false, если очередь заполнена.
+     */
+    bool pushRaw(ValueType *ptr);
+
+    /**
+     * @brief Извлечь указатель из очереди.
+     * @return Указатель на объект или NULL, если очередь пуста.
+     */
+    ValueType *popRaw();
+
+    ValueType **buffer_; //!< Кольцевой буфер указателей.
+    size_t mask_; //!< Вместимость очереди минус один.
+    Deleter deleter_; //!< Функтор для освобождения данных.
+
+    char consumerPadding_[detail::CacheLineSize];
+    size_t head_; //!< Позиция следующего извлекаемого элемента (пишет потребитель).
+    size_t cachedTail_; //!< Последнее прочитанное потребителем значение tail_.
+
+    char producerPadding_[detail::CacheLineSize];
+    size_t tail_; //!< Позиция следующего добавляемого элемента (пишет производитель).
+    size_t cachedHead_; //!< Последнее прочитанное производителем значение head_.
+
+    char endPadding_[detail::CacheLineSize];
+};
+
+/**
+ * @brief Ограниченная lock-free очередь для передачи владения объектами между несколькими
+ * производителями и несколькими потребителями.
+ * @details Кольцевой буфер ячеек с порядковыми номерами (схема Д. Вьюкова): поток занимает
+ * позицию одним compare-and-swap, а номер ячейки сообщает, заполнена ли она. Работает на
+ * встроенных атомарных операциях в C++03. Объекты, оставшиеся в очереди, освобождаются
+ * в деструкторе функтором D.
+ * @tparam T Тип объектов, передаваемых через очередь.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class T, class D = Deleter<T> >
+class MpmcOwnedQueue {
+public:
+    //! Псевдоним для типа объектов, передаваемых через очередь.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+    //! Псевдоним для типа умного указателя на элемент очереди.
+    typedef UniquePtr<T, D> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на элемент очереди.
+    typedef typename Pointer::RvalueUniquePtr RvalueUniquePtr;
+
+    /**
+     * @brief Конструктор класса.
+     * @param capacity Вместимость очереди (округляется вверх до степени двойки).
+     */
+    explicit MpmcOwnedQueue(size_t capacity);
+
+    /**
+     * @brief Конструктор класса от функтора для очистки данных.
+     * @param capacity Вместимость очереди (округляется вверх до степени двойки).
+     * @param deleter Функтор, которым освобождаются объекты, оставшиеся в очереди.
+     */
+    MpmcOwnedQueue(size_t capacity, const Deleter &deleter);
+
+    /**
+     * @brief Деструктор класса. Освобождает объекты, оставшиеся в очереди.
+     */
+    ~MpmcOwnedQueue();
+
+    /**
+     * @brief Попытаться добавить объект в очередь.
+     * @details Владение забирается у rvalue только при успехе, поэтому при заполненной очереди
+     * объект остается у вызывающей стороны.
+     * @param rvalue Непустой объект класса RvalueUniquePtr.
+     * @return true, если объект добавлен.
+     */
+    bool tryPush(RvalueUniquePtr &rvalue);
+
+    /**
+     * @brief Добавить объект в очередь, ожидая освобождения места.
+     * @param rvalue Непустой объект класса RvalueUniquePtr, передающий владение.
+     */
+    void push(RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Попытаться извлечь объект из очереди.
+     * @return Объект класса RvalueUniquePtr, владеющий объектом, или пустой, если очередь пуста.
+     */
+    RvalueUniquePtr tryPop();
+
+    /**
+     * @brief Извлечь объект из очереди, ожидая его появления.
+     * @return Объект класса RvalueUniquePtr, владеющий объектом.
+     */
+    RvalueUniquePtr pop();
+
+    size_t capacity() const;
+
+    /**
+     * @brief Получить функтор для освобождения данных.
+     */
+    Deleter &getDeleter();
+
+private:
+    /**
+     * @brief Ячейка очереди.
+     */
+    struct Cell {
+        size_t sequence; //!< Порядковый номер: pos — свободна, pos + 1 — заполнена.
+        ValueType *data; //!< Указатель на объект.
+    };
+
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    MpmcOwnedQueue(const MpmcOwnedQueue &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    MpmcOwnedQueue &operator=(const MpmcOwnedQueue &other);
+
+    /**
+     * @brief Инициализировать порядковые номера ячеек.
+     */
+    void init();
+
+    /**
+     * @brief Добавить указатель в очередь.
+     * @return false, если очередь заполнена.
+     */
+    bool pushRaw(ValueType *ptr);
+
+    /**
+     * @brief Извлечь указатель из очереди.
+     * @return Указатель на объект или NULL, если очередь пуста.
+     */
+    ValueType *popRaw();
+
+    Cell *cells_; //!< Кольцевой буфер ячеек.
+    size_t mask_; //!< Вместимость очереди минус один.
+    Deleter deleter_; //!< Функтор для освобождения данных.
+
+    char enqueuePadding_[detail::CacheLineSize];
+    size_t enqueuePos_; //!< Позиция следующего добавляемого элемента.
+
+    char dequeuePadding_[detail::CacheLineSize];
+    size_t dequeuePos_; //!< Позиция следующего извлекаемого элемента.
+
+    char endPadding_[detail::CacheLineSize];
+};
+
+/** template<class T, class D> class SpscOwnedQueue **/
+
+template<class T, class D>
+SpscOwnedQueue<T, D>::SpscOwnedQueue(size_t capacity):
+buffer_(new ValueType *[detail::queueCapacity(capacity)]),
+mask_(detail::queueCapacity(capacity) - 1),
+deleter_(),
+head_(0),
+cachedTail_(0),
+tail_(0),
+cachedHead_(0) {
+}
+
+template<class T, class D>
+SpscOwnedQueue<T, D>::SpscOwnedQueue(size_t capacity, const Deleter &deleter):
+buffer_(new ValueType *[detail::queueCapacity(capacity)]),
+mask_(detail::queueCapacity(capacity) - 1),
+deleter_(deleter),
+head_(0),
+cachedTail_(0),
+tail_(0),
+cachedHead_(0) {
+}
+
+template<class T, class D>
+SpscOwnedQueue<T, D>::~SpscOwnedQueue() {
+    for (ValueType *ptr = popRaw(); ptr != NULL; ptr = popRaw()) {
+        deleter_(ptr);
+    }
+    delete[] buffer_;
+}
+
+template<class T, class D>
+bool SpscOwnedQueue<T, D>::tryPush(RvalueUniquePtr &rvalue) {
+    if (!pushRaw(rvalue.borrow().get())) {
+        return false;
+    }
+    rvalue.release();
+    return true;
+}
+
+template<class T, class D>
+void SpscOwnedQueue<T, D>::push(RvalueUniquePtr rvalue) {
+    while (!tryPush(rvalue)) {
+        detail::threadYield();
+    }
+}
+
+template<class T, class D>
+typename SpscOwnedQueue<T, D>::RvalueUniquePtr SpscOwnedQueue<T, D>::tryPop() {
+    return Pointer(popRaw(), deleter_).move();
+}
+
+template<class T, class D>
+typename SpscOwnedQueue<T, D>::RvalueUniquePtr SpscOwnedQueue<T, D>::pop() {
+    ValueType *ptr = popRaw();
+    while (ptr == NULL) {
+        detail::threadYield();
+        ptr = popRaw();
+    }
+    return Pointer(ptr, deleter_).move();
+}
+
+template<class T, class D>
+bool SpscOwnedQueue<T, D>::empty() const {
+    return detail::atomicLoad(&head_) == detail::atomicLoad(&tail_);
+}
+
+template<class T, class D>
+size_t SpscOwnedQueue<T, D>::capacity() const {
+    return mask_ + 1;
+}
+
+template<class T, class D>
+typename SpscOwnedQueue<T, D>::Deleter &SpscOwnedQueue<T, D>::getDeleter() {
+    return deleter_;
+}
+
+template<class T, class D>
+bool SpscOwnedQueue<T, D>::pushRaw(ValueType *ptr) {
+    assert(ptr != NULL);
+
+    const size_t tail = tail_;
+    if (tail - cachedHead_ > mask_) {
+        cachedHead_ = detail::atomicLoad(&head_);
+        if (tail - cachedHead_ > mask_) {
+            return false;
+        }
+    }
+
+    buffer_[tail & mask_] = ptr;
+    detail::atomicStore(&tail_, tail + 1);
+    return true;
+}
+
+template<class T, class D>
+typename SpscOwnedQueue<T, D>::ValueType *SpscOwnedQueue<T, D>::popRaw() {
+    const size_t head = head_;
+    if (head == cachedTail_) {
+        cachedTail_ = detail::atomicLoad(&tail_);
+        if (head == cachedTail_) {
+            return NULL;
+        }
+    }
+
+    ValueType *ptr = buffer_[head & mask_];
+    detail::atomicStore(&head_, head + 1);
+    return ptr;
+}
+
+/** template<class T, class D> class MpmcOwnedQueue **/
+
+template<class T, class D>
+MpmcOwnedQueue<T, D>::MpmcOwnedQueue(size_t capacity):
+cells_(new Cell[detail::queueCapacity(capacity)]),
+mask_(detail::queueCapacity(capacity) - 1),
+deleter_(),
+enqueuePos_(0),
+dequeuePos_(0) {
+    init();
+}
+
+template<class T, class D>
+MpmcOwnedQueue<T, D>::MpmcOwnedQueue(size_t capacity, const Deleter &deleter):
+cells_(new Cell[detail::queueCapacity(capacity)]),
+mask_(detail::queueCapacity(capacity) - 1),
+deleter_(deleter),
+enqueuePos_(0),
+dequeuePos_(0) {
+    init();
+}
+
+template<class T, class D>
+MpmcOwnedQueue<T, D>::~MpmcOwnedQueue() {
+    for (ValueType *ptr = popRaw(); ptr != NULL; ptr = popRaw()) {
+        deleter_(ptr);
+    }
+    delete[] cells_;
+}
+
+template<class T, class D>
+bool MpmcOwnedQueue<T, D>::tryPush(RvalueUniquePtr &rvalue) {
+    if (!pushRaw(rvalue.borrow().get())) {
+        return false;
+    }
+    rvalue.release();
+    return true;
+}
+
+template<class T, class D>
+void MpmcOwnedQueue<T, D>::push(RvalueUniquePtr rvalue) {
+    while (!tryPush(rvalue)) {
+        detail::threadYield();
+    }
+}
+
+template<class T, class D>
+typename MpmcOwnedQueue<T, D>::RvalueUniquePtr MpmcOwnedQueue<T, D>::tryPop() {
+    return Pointer(popRaw(), deleter_).move();
+}
+
+template<class T, class D>
+typename MpmcOwnedQueue<T, D>::RvalueUniquePtr MpmcOwnedQueue<T, D>::pop() {
+    ValueType *ptr = popRaw();
+    while (ptr == NULL) {
+        detail::threadYield();
+        ptr = popRaw();
+    }
+    return Pointer(ptr, deleter_).move();
+}
+
+template<class T, class D>
+size_t MpmcOwnedQueue<T, D>::capacity() const {
+    return mask_ + 1;
+}
+
+template<class T, class D>
+typename MpmcOwnedQueue<T, D>::Deleter &MpmcOwnedQueue<T, D>::getDeleter() {
+    return deleter_;
+}
+
+template<class T, class D>
+void MpmcOwnedQueue<T, D>::init() {
+    for (size_t i = 0; i <= mask_; ++i) {
+        cells_[i].sequence = i;
+        cells_[i].data = NULL;
+    }
+}
+
+template<class T, class D>
+bool MpmcOwnedQueue<T, D>::pushRaw(ValueType *ptr) {
+    assert(ptr != NULL);
+
+    Cell *cell = NULL;
+    size_t pos = detail::atomicLoadRelaxed(&enqueuePos_);
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        const size_t sequence = detail::atomicLoad(&cell->sequence);
+        const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+        if (diff == 0) {
+            // При неудаче pos обновляется текущим значением enqueuePos_.
+            if (detail::atomicCompareExchange(&enqueuePos_, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = detail::atomicLoadRelaxed(&enqueuePos_);
+        }
+    }
+
+    cell->data = ptr;
+    detail::atomicStore(&cell->sequence, pos + 1);
+    return true;
+}
+
+template<class T, class D>
+typename MpmcOwnedQueue<T, D>::ValueType *MpmcOwnedQueue<T, D>::popRaw() {
+    Cell *cell = NULL;
+    size_t pos = detail::atomicLoadRelaxed(&dequeuePos_);
+    for (;;) {
+        cell = &cells_[pos & mask_];
+        const size_t sequence = detail::atomicLoad(&cell->sequence);
+        const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos + 1);
+        if (diff == 0) {
+            if (detail::atomicCompareExchange(&dequeuePos_, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = detail::atomicLoadRelaxed(&dequeuePos_);
+        }
+    }
+
+    ValueType *ptr = cell->data;
+    detail::atomicStore(&cell->sequence, pos + mask_ + 1);
+    return ptr;
+}
+
+} // namespace mem
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace mem {
+
+namespace instrumentation {
+
+/**
+ * @brief События владения, которые отмечают точки учета MEM_INSTRUMENT в unique_ptr.h.
+ * @details Общие для счетчиков (instrumentation.h) и журнала передач (ownership_trace.h).
+ */
+enum Event {
+    Construct, //!< Указатель получил владение новым объектом (конструктор от T *, makeUnique()).
+    Move, //!< Вызов UniquePtr::move().
+    Transfer, //!< Передача владения между указателями одного типа объекта хранения.
+    Convert, //!< Передача владения указателю на базовый тип.
+    Release, //!< Отказ от владения через release().
+    Delete, //!< Освобождение объекта функтором очистки.
+    EventCount
+};
+
+/**
+ * @brief Имя события в том виде, в котором оно выводится в отчетах.
+ */
+inline const char *eventName(Event event) {
+    static const char *const names[EventCount] = {
+        "construct", "move", "transfer", "convert", "release", "delete"
+    };
+    return names[event];
+}
+
+} // namespace instrumentation
+
+} // namespace mem
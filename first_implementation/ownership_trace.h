@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cstddef>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "atomic.h"
+#include "ownership_event.h"
+
+/**
+ * Журнал передач владения для разбора после сбоя. Подключается к точкам учета в unique_ptr.h,
+ * если программа собрана с -DMEM_OWNERSHIP_TRACE. Каждый поток пишет события (объект, адреса
+ * указателя-источника и указателя-получателя, вид события, время) в собственный кольцевой буфер
+ * фиксированного размера без блокировок и системных вызовов; старые события затираются новыми.
+ * dumpOwnershipTrace() можно вызывать из обработчика сигнала или из отладчика:
+ * (gdb) call mem::dumpOwnershipTrace(2, 0)
+ */
+
+#ifndef MEM_OWNERSHIP_TRACE_SIZE
+//! Количество последних событий, которые хранит буфер потока. Должно быть степенью двойки.
+#define MEM_OWNERSHIP_TRACE_SIZE 1024
+#endif
+
+namespace mem {
+
+namespace detail {
+
+static const size_t OwnershipTraceSize = MEM_OWNERSHIP_TRACE_SIZE;
+
+typedef char OwnershipTraceSizeIsPowerOfTwo[
+        (OwnershipTraceSize & (OwnershipTraceSize - 1)) == 0 ? 1 : -1];
+
+/**
+ * @brief Событие журнала.
+ * @details Поля пишутся как в seqlock: sequence обнуляется перед записью и получает номер
+ * события после нее, поэтому читатель отличает целую запись от записи, которая сейчас меняется.
+ */
+struct OwnershipTraceRecord {
+    size_t sequence; //!< Номер события, начиная с 1; 0, пока запись изменяется.
+    const void *object; //!< Объект хранения.
+    const void *source; //!< Указатель, отдавший владение (или NULL).
+    const void *destination; //!< Указатель, получивший владение (или NULL).
+    unsigned long timestamp; //!< Такты TSC на x86, иначе наносекунды CLOCK_MONOTONIC.
+    unsigned kind; //!< Вид события (instrumentation::Event).
+};
+
+/**
+ * @brief Кольцевой буфер потока.
+ * @details Буферы не удаляются, чтобы их можно было читать из обработчика сигнала. Буфер
+ * завершившегося потока хранит его историю, пока его не займет новый поток.
+ */
+struct OwnershipTraceBuffer {
+    size_t head; //!< Количество записанных событий.
+    long thread; //!< Идентификатор потока (gettid).
+    int inUse; //!< Занят ли буфер потоком.
+    OwnershipTraceBuffer *next; //!< Следующий буфер.
+    OwnershipTraceRecord records[OwnershipTraceSize]; //!< Последние события.
+};
+
+inline OwnershipTraceBuffer *&ownershipTraceBuffers() {
+    static OwnershipTraceBuffer *buffers = NULL;
+    return buffers;
+}
+
+inline OwnershipTraceBuffer *&currentOwnershipTraceBuffer() {
+    static __thread OwnershipTraceBuffer *buffer = NULL;
+    return buffer;
+}
+
+inline unsigned long ownershipTraceTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return static_cast<unsigned long>(__builtin_ia32_rdtsc());
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<unsigned long>(now.tv_sec) * 1000000000ul +
+            static_cast<unsigned long>(now.tv_nsec);
+#endif
+}
+
+/**
+ * @brief Освободить буфер завершающегося потока, сохранив его историю.
+ */
+inline void releaseOwnershipTraceBuffer(void *buffer) {
+    atomicStore(&static_cast<OwnershipTraceBuffer *>(buffer)->inUse, 0);
+    currentOwnershipTraceBuffer() = NULL;
+}
+
+inline pthread_key_t &ownershipTraceKeyStorage() {
+    static pthread_key_t key;
+    return key;
+}
+
+inline void createOwnershipTraceKey() {
+    pthread_key_create(&ownershipTraceKeyStorage(), releaseOwnershipTraceBuffer);
+}
+
+inline pthread_key_t ownershipTraceKey() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createOwnershipTraceKey);
+    return ownershipTraceKeyStorage();
+}
+
+/**
+ * @brief Занять свободный буфер или добавить новый в список.
+ */
+inline OwnershipTraceBuffer *acquireOwnershipTraceBuffer() {
+    OwnershipTraceBuffer *buffer = atomicLoad(&ownershipTraceBuffers());
+    for (; buffer != NULL; buffer = buffer->next) {
+        int expected = 0;
+        if (atomicLoadRelaxed(&buffer->inUse) == 0 &&
+                atomicCompareExchange(&buffer->inUse, expected, 1)) {
+            break;
+        }
+    }
+
+    if (buffer != NULL) {
+        // История предыдущего потока стирается, чтобы не приписать ее новому.
+        for (size_t i = 0; i < OwnershipTraceSize; ++i) {
+            atomicStoreRelaxed(&buffer->records[i].sequence, size_t(0));
+        }
+        atomicStore(&buffer->head, size_t(0));
+    } else {
+        buffer = new OwnershipTraceBuffer();
+        buffer->inUse = 1;
+        OwnershipTraceBuffer *next = atomicLoad(&ownershipTraceBuffers());
+        do {
+            buffer->next = next;
+        } while (!atomicCompareExchange(&ownershipTraceBuffers(), next, buffer));
+    }
+    atomicStore(&buffer->thread, static_cast<long>(syscall(SYS_gettid)));
+
+    pthread_setspecific(ownershipTraceKey(), buffer);
+    currentOwnershipTraceBuffer() = buffer;
+    return buffer;
+}
+
+/**
+ * @brief Строка вывода на стеке: форматирование без выделения памяти и stdio.
+ */
+class OwnershipTraceLine {
+public:
+    OwnershipTraceLine(): size_(0) {}
+
+    OwnershipTraceLine &append(const char *text) {
+        while (*text != '\0' && size_ < sizeof(data_)) {
+            data_[size_++] = *text++;
+        }
+        return *this;
+    }
+
+    OwnershipTraceLine &append(unsigned long value, unsigned base = 10) {
+        char digits[24];
+        size_t count = 0;
+        do {
+            digits[count++] = "0123456789abcdef"[value % base];
+            value /= base;
+        } while (value != 0);
+        if (base == 16) {
+            append("0x");
+        }
+        while (count > 0 && size_ < sizeof(data_)) {
+            data_[size_++] = digits[--count];
+        }
+        return *this;
+    }
+
+    OwnershipTraceLine &append(const void *ptr) {
+        return append(reinterpret_cast<unsigned long>(ptr), 16);
+    }
+
+    void write(int fd) {
+        const ssize_t written = ::write(fd, data_, size_);
+        (void) written;
+        size_ = 0;
+    }
+
+private:
+    char data_[256];
+    size_t size_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Записать событие в буфер текущего потока.
+ * @details Пустые указатели не записываются.
+ */
+inline void traceOwnership(instrumentation::Event kind, const void *object, const void *source,
+                           const void *destination) {
+    if (object == NULL) {
+        return;
+    }
+    detail::OwnershipTraceBuffer *buffer = detail::currentOwnershipTraceBuffer();
+    if (buffer == NULL) {
+        buffer = detail::acquireOwnershipTraceBuffer();
+    }
+
+    const size_t index = buffer->head;
+    detail::OwnershipTraceRecord &record =
+            buffer->records[index & (detail::OwnershipTraceSize - 1)];
+    detail::atomicStoreRelaxed(&record.sequence, size_t(0));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    detail::atomicStoreRelaxed(&record.object, object);
+    detail::atomicStoreRelaxed(&record.source, source);
+    detail::atomicStoreRelaxed(&record.destination, destination);
+    detail::atomicStoreRelaxed(&record.timestamp, detail::ownershipTraceTimestamp());
+    detail::atomicStoreRelaxed(&record.kind, static_cast<unsigned>(kind));
+    detail::atomicStore(&record.sequence, index + 1);
+    detail::atomicStore(&buffer->head, index + 1);
+}
+
+/**
+ * @brief Вывести журналы всех потоков, от старых событий к новым.
+ * @details Использует только write(2), поэтому безопасна в обработчике сигнала. Запись, которую
+ * поток меняет во время вывода, пропускается.
+ * @param fd Дескриптор, в который выводится журнал.
+ * @param object Если не NULL, выводятся только события этого объекта.
+ */
+inline void dumpOwnershipTrace(int fd, const void *object = NULL) {
+    detail::OwnershipTraceLine line;
+    detail::OwnershipTraceBuffer *buffer = detail::atomicLoad(&detail::ownershipTraceBuffers());
+    for (; buffer != NULL; buffer = buffer->next) {
+        const size_t head = detail::atomicLoad(&buffer->head);
+        line.append("thread ").append(static_cast<unsigned long>(
+                detail::atomicLoadRelaxed(&buffer->thread)));
+        line.append(" events ").append(static_cast<unsigned long>(head)).append("\n").write(fd);
+
+        const size_t size = detail::OwnershipTraceSize;
+        for (size_t i = head > size ? head - size : 0; i < head; ++i) {
+            detail::OwnershipTraceRecord &record = buffer->records[i & (size - 1)];
+            const size_t sequence = detail::atomicLoad(&record.sequence);
+            const void *recordObject = detail::atomicLoadRelaxed(&record.object);
+            const void *source = detail::atomicLoadRelaxed(&record.source);
+            const void *destination = detail::atomicLoadRelaxed(&record.destination);
+            const unsigned long timestamp = detail::atomicLoadRelaxed(&record.timestamp);
+            const unsigned kind = detail::atomicLoadRelaxed(&record.kind);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (sequence != i + 1 || detail::atomicLoadRelaxed(&record.sequence) != sequence ||
+                    kind >= instrumentation::EventCount) {
+                continue;
+            }
+            if (object != NULL && recordObject != object) {
+                continue;
+            }
+
+            line.append("  ").append(static_cast<unsigned long>(sequence)).append(" ");
+            line.append(timestamp).append(" ");
+            line.append(instrumentation::eventName(instrumentation::Event(kind)));
+            line.append(" object=").append(recordObject);
+            line.append(" source=").append(source);
+            line.append(" destination=").append(destination).append("\n").write(fd);
+        }
+    }
+}
+
+} // namespace mem
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "ownership_trace.h"
+
+/**
+ * Проверки журнала передач владения. Цель собирается с -DMEM_OWNERSHIP_TRACE и
+ * MEM_OWNERSHIP_TRACE_SIZE=64, чтобы переполнение буфера проверялось на небольшом числе событий.
+ */
+
+namespace {
+
+struct Foo {
+    int id;
+};
+
+typedef mem::UniquePtr<Foo> FooPtr;
+
+const size_t WrappingEvents = 200;
+
+std::string pointer(const void *ptr) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "0x%lx", reinterpret_cast<unsigned long>(ptr));
+    return text;
+}
+
+std::string event(const char *kind, const void *object, const void *source,
+                  const void *destination) {
+    return std::string(kind) + " object=" + pointer(object) + " source=" + pointer(source) +
+            " destination=" + pointer(destination) + "\n";
+}
+
+/**
+ * @brief Прочитать файл с начала и закрыть его.
+ */
+std::string readAndClose(std::FILE *file) {
+    std::rewind(file);
+    std::string text;
+    char chunk[4096];
+    size_t read = 0;
+    while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, read);
+    }
+    std::fclose(file);
+    return text;
+}
+
+/**
+ * @brief Вывод dumpOwnershipTrace() в виде строки.
+ */
+std::string dumpTrace(const void *object = NULL) {
+    std::FILE *file = std::tmpfile();
+    mem::dumpOwnershipTrace(fileno(file), object);
+    return readAndClose(file);
+}
+
+void *makeManyEvents(void *) {
+    for (size_t i = 0; i < WrappingEvents / 2; ++i) {
+        FooPtr foo(new Foo());
+    }
+    return NULL;
+}
+
+int signalFd = -1;
+
+void dumpOnSignal(int) {
+    mem::dumpOwnershipTrace(signalFd);
+}
+
+} // namespace
+
+TEST(OwnershipTrace, RecordsSourceAndDestination) {
+    Foo *raw = new Foo();
+    FooPtr first(raw);
+    FooPtr second(first.move());
+    delete second.release();
+
+    const std::string trace = dumpTrace(raw);
+    const size_t construct = trace.find(event("construct", raw, NULL, &first));
+    const size_t transfer = trace.find(" destination=" + pointer(&second) + "\n");
+    const size_t release = trace.find(event("release", raw, &second, NULL));
+    EXPECT_NE(std::string::npos, construct);
+    EXPECT_NE(std::string::npos, trace.find("move object=" + pointer(raw) + " source=" +
+                                            pointer(&first)));
+    EXPECT_NE(std::string::npos, transfer);
+    EXPECT_NE(std::string::npos, release);
+    EXPECT_LT(construct, transfer);
+    EXPECT_LT(transfer, release);
+}
+
+TEST(OwnershipTrace, ShowsOwnershipStolenByCopy) {
+    std::vector<FooPtr::RvalueUniquePtr> handles;
+    handles.push_back(mem::makeUnique<Foo>());
+    const Foo *object = handles[0].borrow().get();
+
+    // Копия RvalueUniquePtr молча забирает владение, журнал показывает, кто его забрал.
+    FooPtr::RvalueUniquePtr stolen = handles[0];
+    EXPECT_EQ(NULL, handles[0].borrow().get());
+    EXPECT_NE(std::string::npos,
+              dumpTrace(object).find(event("transfer", object, &handles[0], &stolen)));
+}
+
+TEST(OwnershipTrace, KeepsOnlyLastEventsOfThread) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, makeManyEvents, NULL);
+    pthread_join(thread, NULL);
+
+    const std::string trace = dumpTrace();
+    const size_t header = trace.find(" events 200\n");
+    ASSERT_NE(std::string::npos, header);
+
+    size_t records = 0;
+    size_t line = trace.find('\n', header) + 1;
+    while (line < trace.size() && trace.compare(line, 2, "  ") == 0) {
+        ++records;
+        line = trace.find('\n', line) + 1;
+    }
+    EXPECT_EQ(size_t(MEM_OWNERSHIP_TRACE_SIZE), records);
+    EXPECT_EQ(0, trace.compare(header + 12, 6, "  137 "));
+}
+
+TEST(OwnershipTrace, DumpFromSignalHandler) {
+    FooPtr foo(new Foo());
+
+    std::FILE *file = std::tmpfile();
+    signalFd = fileno(file);
+    std::signal(SIGUSR1, dumpOnSignal);
+    std::raise(SIGUSR1);
+    std::signal(SIGUSR1, SIG_DFL);
+
+    EXPECT_NE(std::string::npos, readAndClose(file).find(pointer(foo.get())));
+}
+
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
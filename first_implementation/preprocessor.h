@@ -0,0 +1,25 @@
+#pragma once
+
+/**
+ * Макросы для генерации перегрузок с 1..10 аргументами в C++03 (makeUnique, makeUniqueWith,
+ * Arena::make, ObjectPool::make и т. п.). Определены один раз здесь и не отменяются через #undef:
+ * заголовок подключается через #pragma once, поэтому повторно они не определяются.
+ *
+ * MEM_PP_REPEAT_n(m) раскрывается в m(1), m(2), ..., m(n). Вместе с MEM_PP_TEMPLATE_PARAM,
+ * MEM_PP_FUNCTION_PARAM и MEM_PP_ARGUMENT дает списки "class A1, ..., class An",
+ * "const A1 &a1, ..., const An &an" и "a1, ..., an".
+ */
+#define MEM_PP_REPEAT_1(m) m(1)
+#define MEM_PP_REPEAT_2(m) MEM_PP_REPEAT_1(m), m(2)
+#define MEM_PP_REPEAT_3(m) MEM_PP_REPEAT_2(m), m(3)
+#define MEM_PP_REPEAT_4(m) MEM_PP_REPEAT_3(m), m(4)
+#define MEM_PP_REPEAT_5(m) MEM_PP_REPEAT_4(m), m(5)
+#define MEM_PP_REPEAT_6(m) MEM_PP_REPEAT_5(m), m(6)
+#define MEM_PP_REPEAT_7(m) MEM_PP_REPEAT_6(m), m(7)
+#define MEM_PP_REPEAT_8(m) MEM_PP_REPEAT_7(m), m(8)
+#define MEM_PP_REPEAT_9(m) MEM_PP_REPEAT_8(m), m(9)
+#define MEM_PP_REPEAT_10(m) MEM_PP_REPEAT_9(m), m(10)
+
+#define MEM_PP_TEMPLATE_PARAM(i) class A##i
+#define MEM_PP_FUNCTION_PARAM(i) const A##i &a##i
+#define MEM_PP_ARGUMENT(i) a##i
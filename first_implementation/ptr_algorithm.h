@@ -0,0 +1,454 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "unique_ptr.h"
+#include "ptr_vector.h"
+
+namespace mem {
+
+namespace detail {
+
+struct UniqueAccess {
+    /**
+     * @brief Получить ссылку на указатель внутри UniquePtr без передачи владения.
+     */
+    template<class T, class D, class C>
+    static T *&slot(UniquePtr<T, D, C> &pointer) {
+        return pointer.storage_.ptr();
+    }
+
+    /**
+     * @brief Получить ссылку на указатель внутри RvalueUniquePtr без передачи владения.
+     */
+    template<class T, class D>
+    static T *&slot(const RvalueUniquePtr<T, D> &pointer) {
+        return pointer.storage_.ptr();
+    }
+
+    /**
+     * @brief Освободить объект умного указателя так же, как это делает его деструктор.
+     */
+    template<class P>
+    static void destroy(P &pointer) {
+        typedef typename P::ValueType ValueType;
+        ValueType *&ptr = slot(pointer);
+        if (ptr != NULL) {
+            MEM_INSTRUMENT(ValueType, Delete, ptr, &pointer, NULL);
+            pointer.storage_.deleter()(ptr);
+            ptr = NULL;
+        }
+    }
+
+    /**
+     * @brief Получить буфер указателей PtrVector.
+     */
+    template<class T, class D>
+    static T **slots(PtrVector<T, D> &vector) {
+        return vector.storage_.ptr();
+    }
+};
+
+/**
+ * @brief Итератор по указателям внутри диапазона UniquePtr или RvalueUniquePtr.
+ * @details Разыменование дает ссылку T *& на указатель внутри умного указателя, поэтому
+ * стандартные алгоритмы переставляют сырые указатели, не вызывая "копирование" с передачей
+ * владения. Функторы очистки остаются на своих местах.
+ * @tparam It Итератор произвольного доступа по UniquePtr<T, D> или RvalueUniquePtr<T, D>.
+ */
+template<class It>
+class SlotIterator {
+public:
+    typedef typename std::iterator_traits<It>::value_type Element;
+
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef typename Element::ValueType *value_type;
+    typedef typename std::iterator_traits<It>::difference_type difference_type;
+    typedef value_type *pointer;
+    typedef value_type &reference;
+
+    SlotIterator():
+    it_() {
+    }
+
+    explicit SlotIterator(It it):
+    it_(it) {
+    }
+
+    reference operator*() const {
+        return UniqueAccess::slot(*it_);
+    }
+
+    reference operator[](difference_type n) const {
+        return UniqueAccess::slot(it_[n]);
+    }
+
+    SlotIterator &operator++() {
+        ++it_;
+        return *this;
+    }
+
+    SlotIterator operator++(int) {
+        return SlotIterator(it_++);
+    }
+
+    SlotIterator &operator--() {
+        --it_;
+        return *this;
+    }
+
+    SlotIterator operator--(int) {
+        return SlotIterator(it_--);
+    }
+
+    SlotIterator &operator+=(difference_type n) {
+        it_ += n;
+        return *this;
+    }
+
+    SlotIterator &operator-=(difference_type n) {
+        it_ -= n;
+        return *this;
+    }
+
+    SlotIterator operator+(difference_type n) const {
+        return SlotIterator(it_ + n);
+    }
+
+    SlotIterator operator-(difference_type n) const {
+        return SlotIterator(it_ - n);
+    }
+
+    difference_type operator-(const SlotIterator &other) const {
+        return it_ - other.it_;
+    }
+
+    bool operator==(const SlotIterator &other) const {
+        return it_ == other.it_;
+    }
+
+    bool operator!=(const SlotIterator &other) const {
+        return it_ != other.it_;
+    }
+
+    bool operator<(const SlotIterator &other) const {
+        return it_ < other.it_;
+    }
+
+    bool operator>(const SlotIterator &other) const {
+        return it_ > other.it_;
+    }
+
+    bool operator<=(const SlotIterator &other) const {
+        return it_ <= other.it_;
+    }
+
+    bool operator>=(const SlotIterator &other) const {
+        return it_ >= other.it_;
+    }
+
+    /**
+     * @brief Получить исходный итератор по умным указателям.
+     */
+    It base() const {
+        return it_;
+    }
+
+private:
+    It it_; //!< Итератор по умным указателям.
+};
+
+/**
+ * @brief Тип объекта хранения умных указателей, на которые указывает итератор It.
+ */
+template<class It>
+struct ElementType {
+    typedef typename std::iterator_traits<It>::value_type::ValueType Type;
+};
+
+/**
+ * @brief Сравнение объектов по указателям: пользовательский функтор получает const T &.
+ */
+template<class T, class Compare>
+class IndirectCompare {
+public:
+    explicit IndirectCompare(Compare compare):
+    compare_(compare) {
+    }
+
+    bool operator()(const T *a, const T *b) {
+        return compare_(*a, *b);
+    }
+
+private:
+    Compare compare_; //!< Пользовательский функтор сравнения.
+};
+
+/**
+ * @brief Предикат над объектом по указателю: пользовательский функтор получает const T &.
+ */
+template<class T, class Predicate>
+class IndirectPredicate {
+public:
+    explicit IndirectPredicate(Predicate predicate):
+    predicate_(predicate) {
+    }
+
+    bool operator()(const T *ptr) {
+        return predicate_(*ptr);
+    }
+
+private:
+    Predicate predicate_; //!< Пользовательский предикат.
+};
+
+template<class T>
+struct Less {
+    bool operator()(const T &a, const T &b) const {
+        return a < b;
+    }
+};
+
+template<class T>
+struct EqualTo {
+    bool operator()(const T &a, const T &b) const {
+        return a == b;
+    }
+};
+
+/**
+ * @brief Отсортировать указатели [first, last) в копии и записать результат обратно.
+ * @details std::sort держит один указатель во временной переменной, и исключение из функтора
+ * сравнения оставило бы его копию в двух ячейках. Копия буфера стоит O(n) и дает строгую гарантию:
+ * при исключении диапазон не меняется.
+ */
+template<class S, class Compare>
+void sortSlots(S first, S last, Compare compare, bool stable) {
+    std::vector<typename std::iterator_traits<S>::value_type> slots(first, last);
+    if (stable) {
+        std::stable_sort(slots.begin(), slots.end(), compare);
+    } else {
+        std::sort(slots.begin(), slots.end(), compare);
+    }
+    std::copy(slots.begin(), slots.end(), first);
+}
+
+/**
+ * @brief Собрать указатели, для которых remove ложен, в начале [first, last) с сохранением
+ * порядка. Остальные указатели не теряются, а оказываются в хвосте.
+ * @return Начало хвоста.
+ */
+template<class S, class Predicate>
+S compactIf(S first, S last, Predicate remove) {
+    S result = first;
+    for (; first != last; ++first) {
+        if (!remove(*first)) {
+            std::iter_swap(result, first);
+            ++result;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Оставить в начале [first, last) первый указатель из каждой группы подряд идущих
+ * равных объектов. Дубликаты оказываются в хвосте.
+ * @return Начало хвоста.
+ */
+template<class S, class Equal>
+S compactUnique(S first, S last, Equal equal) {
+    if (first == last) {
+        return last;
+    }
+
+    S result = first;
+    while (++first != last) {
+        if (!equal(*result, *first) && ++result != first) {
+            std::iter_swap(result, first);
+        }
+    }
+    return ++result;
+}
+
+/**
+ * @brief Освободить объекты умных указателей в [first, last) за один проход.
+ */
+template<class It>
+void destroyRange(It first, It last) {
+    for (; first != last; ++first) {
+        UniqueAccess::destroy(*first);
+    }
+}
+
+} // namespace detail
+
+/**
+ * Алгоритмы над последовательностями объектов во владении: диапазонами UniquePtr<T, D> или
+ * RvalueUniquePtr<T, D> (массивы, std::vector<RvalueUniquePtr>) и PtrVector<T, D>.
+ *
+ * Алгоритмы переставляют сами указатели T *, поэтому работают со скоростью алгоритмов над
+ * массивом сырых указателей: нет "копирований" с передачей владения и временных умных
+ * указателей, которые при std::sort или std::remove_if могли бы освободить элемент. Функторы
+ * очистки остаются на своих местах, поэтому у функторов с состоянием оно должно совпадать у всех
+ * элементов (как у PtrVector). Функторы сравнения и предикаты получают const T &, элементы
+ * диапазона не должны быть пустыми. Если функтор бросает исключение, каждый объект по-прежнему
+ * принадлежит ровно одному элементу, а sort и stableSort оставляют диапазон без изменений.
+ *
+ * removeIf и unique освобождают удаленные объекты одним проходом после перестановки. Для
+ * диапазонов они возвращают новый конец, а элементы после него остаются пустыми; для PtrVector
+ * удаленные элементы стираются, а возвращается их количество.
+ */
+namespace algo {
+
+/**
+ * @brief Отсортировать объекты диапазона по функтору сравнения.
+ */
+template<class It, class Compare>
+void sort(It first, It last, Compare compare) {
+    typedef typename detail::ElementType<It>::Type ValueType;
+    detail::sortSlots(detail::SlotIterator<It>(first), detail::SlotIterator<It>(last),
+                      detail::IndirectCompare<ValueType, Compare>(compare), false);
+}
+
+/**
+ * @brief Отсортировать объекты диапазона по operator<.
+ */
+template<class It>
+void sort(It first, It last) {
+    algo::sort(first, last, detail::Less<typename detail::ElementType<It>::Type>());
+}
+
+/**
+ * @brief Отсортировать объекты диапазона, сохраняя порядок равных.
+ */
+template<class It, class Compare>
+void stableSort(It first, It last, Compare compare) {
+    typedef typename detail::ElementType<It>::Type ValueType;
+    detail::sortSlots(detail::SlotIterator<It>(first), detail::SlotIterator<It>(last),
+                      detail::IndirectCompare<ValueType, Compare>(compare), true);
+}
+
+/**
+ * @brief Отсортировать объекты диапазона по operator<, сохраняя порядок равных.
+ */
+template<class It>
+void stableSort(It first, It last) {
+    algo::stableSort(first, last, detail::Less<typename detail::ElementType<It>::Type>());
+}
+
+/**
+ * @brief Переставить элементы так, чтобы объекты, удовлетворяющие предикату, шли первыми.
+ * @return Итератор на первый элемент второй группы.
+ */
+template<class It, class Predicate>
+It partition(It first, It last, Predicate predicate) {
+    typedef typename detail::ElementType<It>::Type ValueType;
+    return std::partition(detail::SlotIterator<It>(first), detail::SlotIterator<It>(last),
+                          detail::IndirectPredicate<ValueType, Predicate>(predicate)).base();
+}
+
+/**
+ * @brief Удалить объекты, удовлетворяющие предикату, сохранив порядок остальных.
+ * @return Новый конец диапазона, элементы [результат, last) пусты.
+ */
+template<class It, class Predicate>
+It removeIf(It first, It last, Predicate predicate) {
+    typedef typename detail::ElementType<It>::Type ValueType;
+    It end = detail::compactIf(detail::SlotIterator<It>(first), detail::SlotIterator<It>(last),
+                               detail::IndirectPredicate<ValueType, Predicate>(predicate)).base();
+    detail::destroyRange(end, last);
+    return end;
+}
+
+/**
+ * @brief Удалить все объекты, кроме первого, из каждой группы подряд идущих равных.
+ * @return Новый конец диапазона, элементы [результат, last) пусты.
+ */
+template<class It, class Equal>
+It unique(It first, It last, Equal equal) {
+    typedef typename detail::ElementType<It>::Type ValueType;
+    It end = detail::compactUnique(detail::SlotIterator<It>(first), detail::SlotIterator<It>(last),
+                                   detail::IndirectCompare<ValueType, Equal>(equal)).base();
+    detail::destroyRange(end, last);
+    return end;
+}
+
+/**
+ * @brief Удалить подряд идущие объекты, равные по operator==.
+ */
+template<class It>
+It unique(It first, It last) {
+    return algo::unique(first, last, detail::EqualTo<typename detail::ElementType<It>::Type>());
+}
+
+template<class T, class D, class Compare>
+void sort(PtrVector<T, D> &vector, Compare compare) {
+    T **slots = detail::UniqueAccess::slots(vector);
+    detail::sortSlots(slots, slots + vector.size(), detail::IndirectCompare<T, Compare>(compare),
+                      false);
+}
+
+template<class T, class D>
+void sort(PtrVector<T, D> &vector) {
+    algo::sort(vector, detail::Less<T>());
+}
+
+template<class T, class D, class Compare>
+void stableSort(PtrVector<T, D> &vector, Compare compare) {
+    T **slots = detail::UniqueAccess::slots(vector);
+    detail::sortSlots(slots, slots + vector.size(), detail::IndirectCompare<T, Compare>(compare),
+                      true);
+}
+
+template<class T, class D>
+void stableSort(PtrVector<T, D> &vector) {
+    algo::stableSort(vector, detail::Less<T>());
+}
+
+template<class T, class D, class Predicate>
+typename PtrVector<T, D>::Iterator partition(PtrVector<T, D> &vector, Predicate predicate) {
+    T **slots = detail::UniqueAccess::slots(vector);
+    T **middle = std::partition(slots, slots + vector.size(),
+                                detail::IndirectPredicate<T, Predicate>(predicate));
+    return vector.begin() + (middle - slots);
+}
+
+/**
+ * @brief Стереть из вектора объекты, удовлетворяющие предикату.
+ * @return Количество удаленных объектов.
+ */
+template<class T, class D, class Predicate>
+size_t removeIf(PtrVector<T, D> &vector, Predicate predicate) {
+    T **slots = detail::UniqueAccess::slots(vector);
+    T **end = detail::compactIf(slots, slots + vector.size(),
+                                detail::IndirectPredicate<T, Predicate>(predicate));
+    const size_t removed = vector.size() - (end - slots);
+    vector.erase(vector.begin() + (end - slots), vector.end());
+    return removed;
+}
+
+/**
+ * @brief Стереть из вектора подряд идущие равные объекты, кроме первого из каждой группы.
+ * @return Количество удаленных объектов.
+ */
+template<class T, class D, class Equal>
+size_t unique(PtrVector<T, D> &vector, Equal equal) {
+    T **slots = detail::UniqueAccess::slots(vector);
+    T **end = detail::compactUnique(slots, slots + vector.size(),
+                                    detail::IndirectCompare<T, Equal>(equal));
+    const size_t removed = vector.size() - (end - slots);
+    vector.erase(vector.begin() + (end - slots), vector.end());
+    return removed;
+}
+
+template<class T, class D>
+size_t unique(PtrVector<T, D> &vector) {
+    return algo::unique(vector, detail::EqualTo<T>());
+}
+
+} // namespace algo
+
+} // namespace mem
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "unique_ptr.h"
+
+namespace mem {
+
+/**
+ * @brief Функтор хеширования ключей PtrHashMap.
+ * @details Для целочисленных типов и std::string есть специализации. Для других типов ключей
+ * нужно специализировать шаблон или передать свой функтор в PtrHashMap.
+ * @tparam K Тип ключа.
+ */
+template<class K>
+struct Hash;
+
+#define MEM_INTEGRAL_HASH(Type) \
+    template<> \
+    struct Hash<Type> { \
+        size_t operator()(Type key) const { \
+            return static_cast<size_t>(key); \
+        } \
+    }
+
+MEM_INTEGRAL_HASH(bool);
+MEM_INTEGRAL_HASH(char);
+MEM_INTEGRAL_HASH(signed char);
+MEM_INTEGRAL_HASH(unsigned char);
+MEM_INTEGRAL_HASH(short);
+MEM_INTEGRAL_HASH(unsigned short);
+MEM_INTEGRAL_HASH(int);
+MEM_INTEGRAL_HASH(unsigned int);
+MEM_INTEGRAL_HASH(long);
+MEM_INTEGRAL_HASH(unsigned long);
+
+#undef MEM_INTEGRAL_HASH
+
+template<class T>
+struct Hash<T *> {
+    size_t operator()(const T *key) const {
+        return reinterpret_cast<size_t>(key);
+    }
+};
+
+template<>
+struct Hash<std::string> {
+    //! Хеш FNV-1a.
+    size_t operator()(const std::string &key) const {
+        size_t hash = static_cast<size_t>(2166136261UL);
+        for (size_t i = 0; i < key.size(); ++i) {
+            hash ^= static_cast<unsigned char>(key[i]);
+            hash *= static_cast<size_t>(16777619UL);
+        }
+        return hash;
+    }
+};
+
+/**
+ * @brief Хеш-таблица с открытой адресацией, владеющая объектами через сырые указатели.
+ * @details Ячейки хранятся в одном массиве и заполняются линейным пробированием, удаление
+ * выполняется обратным сдвигом, поэтому таблица не копит "надгробий". Пустая ячейка отмечается
+ * нулевым указателем, значит в таблицу нельзя положить NULL. Поиск не забирает владение,
+ * все объекты освобождаются функтором D за один проход по массиву.
+ * @tparam K Тип ключа. Должен быть конструируемым по умолчанию и копируемым.
+ * @tparam T Тип объектов, которыми владеет таблица.
+ * @tparam H Функтор хеширования ключей.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class K, class T, class H = Hash<K>, class D = Deleter<T> >
+class PtrHashMap {
+public:
+    //! Псевдоним для типа ключа.
+    typedef K KeyType;
+    //! Псевдоним для типа объектов, которыми владеет таблица.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора хеширования.
+    typedef H Hasher;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+    //! Псевдоним для типа умного указателя на элемент таблицы.
+    typedef UniquePtr<T, D> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на элемент таблицы.
+    typedef typename Pointer::RvalueUniquePtr RvalueUniquePtr;
+
+    /**
+     * @brief Ячейка таблицы. Поля названы как в std::pair, чтобы итераторы читались как у std::map.
+     */
+    struct Entry {
+        KeyType first; //!< Ключ.
+        ValueType *second; //!< Указатель на объект или NULL для пустой ячейки.
+    };
+
+    /**
+     * @brief Итератор по занятым ячейкам таблицы.
+     * @details Итератор константный: указатель нельзя подменить, но объект доступен для изменения.
+     */
+    class Iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Entry value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Entry *pointer;
+        typedef const Entry &reference;
+
+        Iterator();
+        Iterator(const Entry *entry, const Entry *end);
+
+        reference operator*() const;
+        pointer operator->() const;
+        Iterator &operator++();
+        Iterator operator++(int);
+
+        bool operator==(const Iterator &other) const;
+        bool operator!=(const Iterator &other) const;
+
+    private:
+        /**
+         * @brief Пропустить пустые ячейки.
+         */
+        void skipEmpty();
+
+        const Entry *entry_; //!< Текущая ячейка.
+        const Entry *end_; //!< Ячейка за последней ячейкой таблицы.
+    };
+
+    /**
+     * @brief Конструктор по умолчанию. Создает пустую таблицу без выделения памяти.
+     */
+    PtrHashMap();
+
+    /**
+     * @brief Конструктор класса от функтора для очистки данных.
+     * @param deleter Функтор, которым будут освобождаться все элементы таблицы.
+     */
+    explicit PtrHashMap(const Deleter &deleter);
+
+    /**
+     * @brief Деструктор класса. Освобождает все элементы за один проход.
+     */
+    ~PtrHashMap();
+
+    /**
+     * @brief Добавить элемент, забрав владение у rvalue.
+     * @details Если ключ уже есть в таблице, новый объект освобождается, а старый остается.
+     * @param key Ключ элемента.
+     * @param rvalue Объект класса RvalueUniquePtr, передающий владение. Не должен быть пустым.
+     * @return Пара из итератора на элемент с этим ключом и признака того, что вставка произошла.
+     */
+    std::pair<Iterator, bool> emplace(const KeyType &key, RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Найти элемент по ключу, не забирая владение.
+     * @return Итератор на элемент или end().
+     */
+    Iterator find(const KeyType &key) const;
+
+    /**
+     * @brief Получить указатель на объект по ключу, не забирая владение.
+     * @return Указатель на объект или NULL, если ключа нет.
+     */
+    ValueType *get(const KeyType &key) const;
+
+    /**
+     * @brief Получить ссылку на объект по ключу, не забирая владение.
+     * @throw std::out_of_range Если ключа нет в таблице.
+     */
+    ValueType &at(const KeyType &key) const;
+
+    /**
+     * @brief Проверить наличие ключа в таблице.
+     */
+    bool contains(const KeyType &key) const;
+
+    /**
+     * @brief Извлечь элемент из таблицы, не освобождая объект.
+     * @return Объект класса RvalueUniquePtr, владеющий объектом, или пустой, если ключа нет.
+     */
+    RvalueUniquePtr release(const KeyType &key);
+
+    /**
+     * @brief Удалить элемент, освободив объект.
+     * @return true, если элемент был удален.
+     */
+    bool erase(const KeyType &key);
+
+    /**
+     * @brief Удалить все элементы таблицы, освободив объекты. Память таблицы сохраняется.
+     */
+    void clear();
+
+    /**
+     * @brief Подготовить таблицу к хранению count элементов без перехеширования.
+     * @throw std::bad_alloc Если не удалось выделить память.
+     */
+    void reserve(size_t count);
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    size_t size() const;
+    size_t capacity() const;
+    bool empty() const;
+
+    /**
+     * @brief Получить функтор для освобождения данных.
+     */
+    Deleter &getDeleter();
+
+private:
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    PtrHashMap(const PtrHashMap &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    PtrHashMap &operator=(const PtrHashMap &other);
+
+    /**
+     * @brief Индекс ячейки, с которой начинается поиск ключа.
+     * @details Хеш перемешивается умножением на константу золотого сечения (Fibonacci hashing),
+     * поэтому тождественный хеш целых чисел не портит распределение по ячейкам.
+     */
+    size_t idealSlot(const KeyType &key) const;
+
+    /**
+     * @brief Найти ячейку с ключом или пустую ячейку, на которой поиск остановился.
+     */
+    Entry *lookup(const KeyType &key) const;
+
+    /**
+     * @brief Освободить ячейку index и сдвинуть назад следующие за ней элементы цепочки.
+     */
+    void removeAt(size_t index);
+
+    /**
+     * @brief Перестроить таблицу с новым количеством ячеек (степень двойки).
+     */
+    void rehash(size_t capacity);
+
+    /**
+     * @brief Освободить все объекты таблицы.
+     */
+    void destroyAll();
+
+    //! Массив ячеек и функтор для освобождения данных.
+    detail::PtrStorage<Entry, Deleter> storage_;
+    Hasher hasher_; //!< Функтор хеширования ключей.
+    size_t size_; //!< Количество элементов.
+    size_t capacity_; //!< Количество ячеек (степень двойки или 0).
+    size_t shift_; //!< Сдвиг для получения индекса ячейки из перемешанного хеша.
+};
+
+/**
+    template<class K, class T, class H, class D>
+    class PtrHashMap<K, T, H, D>::Iterator
+ **/
+template<class K, class T, class H, class D>
+PtrHashMap<K, T, H, D>::Iterator::Iterator():
+entry_(NULL),
+end_(NULL) {
+}
+
+template<class K, class T, class H, class D>
+PtrHashMap<K, T, H, D>::Iterator::Iterator(const Entry *entry, const Entry *end):
+entry_(entry),
+end_(end) {
+    skipEmpty();
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator::reference
+        PtrHashMap<K, T, H, D>::Iterator::operator*() const {
+    return *entry_;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator::pointer
+        PtrHashMap<K, T, H, D>::Iterator::operator->() const {
+    return entry_;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator &PtrHashMap<K, T, H, D>::Iterator::operator++() {
+    ++entry_;
+    skipEmpty();
+    return *this;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator PtrHashMap<K, T, H, D>::Iterator::operator++(int) {
+    Iterator it(*this);
+    ++*this;
+    return it;
+}
+
+template<class K, class T, class H, class D>
+bool PtrHashMap<K, T, H, D>::Iterator::operator==(const Iterator &other) const {
+    return entry_ == other.entry_;
+}
+
+template<class K, class T, class H, class D>
+bool PtrHashMap<K, T, H, D>::Iterator::operator!=(const Iterator &other) const {
+    return entry_ != other.entry_;
+}
+
+template<class K, class T, class H, class D>
+void PtrHashMap<K, T, H, D>::Iterator::skipEmpty() {
+    while (entry_ != end_ && entry_->second == NULL) {
+        ++entry_;
+    }
+}
+
+/**
+    template<class K, class T, class H, class D>
+    class PtrHashMap
+ **/
+template<class K, class T, class H, class D>
+PtrHashMap<K, T, H, D>::PtrHashMap():
+storage_(NULL, Deleter()),
+hasher_(),
+size_(0),
+capacity_(0),
+shift_(0) {
+}
+
+template<class K, class T, class H, class D>
+PtrHashMap<K, T, H, D>::PtrHashMap(const Deleter &deleter):
+storage_(NULL, deleter),
+hasher_(),
+size_(0),
+capacity_(0),
+shift_(0) {
+}
+
+template<class K, class T, class H, class D>
+PtrHashMap<K, T, H, D>::~PtrHashMap() {
+    destroyAll();
+    delete[] storage_.ptr();
+}
+
+template<class K, class T, class H, class D>
+std::pair<typename PtrHashMap<K, T, H, D>::Iterator, bool>
+        PtrHashMap<K, T, H, D>::emplace(const KeyType &key, RvalueUniquePtr rvalue) {
+    // Таблица заполняется не более чем на 3/4.
+    if ((size_ + 1) * 4 > capacity_ * 3) {
+        rehash(capacity_ == 0 ? 16 : capacity_ * 2);
+    }
+
+    Entry *entry = lookup(key);
+    Entry *end = storage_.ptr() + capacity_;
+    if (entry->second != NULL) {
+        return std::pair<Iterator, bool>(Iterator(entry, end), false);
+    }
+
+    entry->first = key;
+    entry->second = rvalue.release();
+    assert(entry->second != NULL);
+    ++size_;
+    return std::pair<Iterator, bool>(Iterator(entry, end), true);
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator PtrHashMap<K, T, H, D>::find(const KeyType &key) const {
+    Entry *entry = lookup(key);
+    if (entry == NULL || entry->second == NULL) {
+        return end();
+    }
+    return Iterator(entry, storage_.ptr() + capacity_);
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::ValueType *PtrHashMap<K, T, H, D>::get(const KeyType &key) const {
+    Entry *entry = lookup(key);
+    return entry == NULL ? NULL : entry->second;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::ValueType &PtrHashMap<K, T, H, D>::at(const KeyType &key) const {
+    ValueType *ptr = get(key);
+    if (ptr == NULL) {
+        throw std::out_of_range("mem::PtrHashMap::at");
+    }
+    return *ptr;
+}
+
+template<class K, class T, class H, class D>
+bool PtrHashMap<K, T, H, D>::contains(const KeyType &key) const {
+    return get(key) != NULL;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::RvalueUniquePtr
+        PtrHashMap<K, T, H, D>::release(const KeyType &key) {
+    ValueType *ptr = NULL;
+    Entry *entry = lookup(key);
+    if (entry != NULL && entry->second != NULL) {
+        ptr = entry->second;
+        removeAt(entry - storage_.ptr());
+    }
+    return Pointer(ptr, storage_.deleter()).move();
+}
+
+template<class K, class T, class H, class D>
+bool PtrHashMap<K, T, H, D>::erase(const KeyType &key) {
+    Entry *entry = lookup(key);
+    if (entry == NULL || entry->second == NULL) {
+        return false;
+    }
+
+    ValueType *ptr = entry->second;
+    removeAt(entry - storage_.ptr());
+    storage_.deleter()(ptr);
+    return true;
+}
+
+template<class K, class T, class H, class D>
+void PtrHashMap<K, T, H, D>::clear() {
+    destroyAll();
+    for (size_t i = 0; i < capacity_; ++i) {
+        storage_.ptr()[i].second = NULL;
+    }
+    size_ = 0;
+}
+
+template<class K, class T, class H, class D>
+void PtrHashMap<K, T, H, D>::reserve(size_t count) {
+    size_t capacity = capacity_ == 0 ? 16 : capacity_;
+    while (count * 4 > capacity * 3) {
+        capacity *= 2;
+    }
+    if (capacity != capacity_) {
+        rehash(capacity);
+    }
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator PtrHashMap<K, T, H, D>::begin() const {
+    return Iterator(storage_.ptr(), storage_.ptr() + capacity_);
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Iterator PtrHashMap<K, T, H, D>::end() const {
+    return Iterator(storage_.ptr() + capacity_, storage_.ptr() + capacity_);
+}
+
+template<class K, class T, class H, class D>
+size_t PtrHashMap<K, T, H, D>::size() const {
+    return size_;
+}
+
+template<class K, class T, class H, class D>
+size_t PtrHashMap<K, T, H, D>::capacity() const {
+    return capacity_;
+}
+
+template<class K, class T, class H, class D>
+bool PtrHashMap<K, T, H, D>::empty() const {
+    return size_ == 0;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Deleter &PtrHashMap<K, T, H, D>::getDeleter() {
+    return storage_.deleter();
+}
+
+template<class K, class T, class H, class D>
+size_t PtrHashMap<K, T, H, D>::idealSlot(const KeyType &key) const {
+    size_t golden = static_cast<size_t>(0x9E3779B9UL);
+    if (sizeof(size_t) > 4) {
+        golden = (golden << 16 << 16) | static_cast<size_t>(0x7F4A7C15UL);
+    }
+    return (hasher_(key) * golden) >> shift_;
+}
+
+template<class K, class T, class H, class D>
+typename PtrHashMap<K, T, H, D>::Entry *PtrHashMap<K, T, H, D>::lookup(const KeyType &key) const {
+    if (capacity_ == 0) {
+        return NULL;
+    }
+
+    const size_t mask = capacity_ - 1;
+    Entry *entries = storage_.ptr();
+    for (size_t i = idealSlot(key);; i = (i + 1) & mask) {
+        if (entries[i].second == NULL || entries[i].first == key) {
+            return entries + i;
+        }
+    }
+}
+
+template<class K, class T, class H, class D>
+void PtrHashMap<K, T, H, D>::removeAt(size_t index) {
+    const size_t mask = capacity_ - 1;
+    Entry *entries = storage_.ptr();
+
+    size_t hole = index;
+    for (size_t i = (index + 1) & mask; entries[i].second != NULL; i = (i + 1) & mask) {
+        const size_t ideal = idealSlot(entries[i].first);
+        // Элемент можно сдвинуть в дыру, если его идеальная ячейка не лежит в (hole, i].
+        const bool between = hole <= i ? (hole < ideal && ideal <= i) : (hole < ideal || ideal <= i);
+        if (!between) {
+            entries[hole] = entries[i];
+            hole = i;
+        }
+    }
+
+    entries[hole].second = NULL;
+    --size_;
+}
+
+template<class K, class T, class H, class D>
+void PtrHashMap<K, T, H, D>::rehash(size_t capacity) {
+    Entry *entries = new Entry[capacity];
+    for (size_t i = 0; i < capacity; ++i) {
+        entries[i].second = NULL;
+    }
+
+    Entry *oldEntries = storage_.ptr();
+    const size_t oldCapacity = capacity_;
+
+    size_t bits = 0;
+    while ((static_cast<size_t>(1) << bits) < capacity) {
+        ++bits;
+    }
+
+    storage_.ptr() = entries;
+    capacity_ = capacity;
+    shift_ = sizeof(size_t) * 8 - bits;
+
+    const size_t mask = capacity_ - 1;
+    for (size_t i = 0; i < oldCapacity; ++i) {
+        if (oldEntries[i].second != NULL) {
+            size_t slot = idealSlot(oldEntries[i].first);
+            while (entries[slot].second != NULL) {
+                slot = (slot + 1) & mask;
+            }
+            entries[slot] = oldEntries[i];
+        }
+    }
+
+    delete[] oldEntries;
+}
+
+template<class K, class T, class H, class D>
+void PtrHashMap<K, T, H, D>::destroyAll() {
+    Entry *entries = storage_.ptr();
+    for (size_t i = 0; i < capacity_; ++i) {
+        if (entries[i].second != NULL) {
+            storage_.deleter()(entries[i].second);
+        }
+    }
+}
+
+} // namespace mem
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include "unique_ptr.h"
+
+namespace mem {
+
+/**
+ * @brief Упорядоченный ассоциативный контейнер, владеющий объектами через сырые указатели.
+ * @details В отличие от std::map<K, RvalueUniquePtr>, поиск не забирает владение у контейнера:
+ * find()/get()/at() возвращают доступ к объекту, а владение передается только через release().
+ * Все объекты освобождаются функтором D, переданным в конструктор, за один проход.
+ * @tparam K Тип ключа.
+ * @tparam T Тип объектов, которыми владеет контейнер.
+ * @tparam C Функтор сравнения ключей.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class K, class T, class C = std::less<K>, class D = Deleter<T> >
+class PtrMap {
+public:
+    //! Псевдоним для типа ключа.
+    typedef K KeyType;
+    //! Псевдоним для типа объектов, которыми владеет контейнер.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+    //! Псевдоним для типа умного указателя на элемент контейнера.
+    typedef UniquePtr<T, D> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на элемент контейнера.
+    typedef typename Pointer::RvalueUniquePtr RvalueUniquePtr;
+
+private:
+    typedef std::map<KeyType, ValueType *, C> MapType;
+
+public:
+    /**
+     * @brief Итератор по парам (ключ, указатель на объект).
+     * @details Итератор константный: указатель нельзя подменить, но объект доступен для изменения.
+     */
+    typedef typename MapType::const_iterator Iterator;
+
+    /**
+     * @brief Конструктор по умолчанию. Создает пустой контейнер.
+     */
+    PtrMap();
+
+    /**
+     * @brief Конструктор класса от функтора для очистки данных.
+     * @param deleter Функтор, которым будут освобождаться все элементы контейнера.
+     */
+    explicit PtrMap(const Deleter &deleter);
+
+    /**
+     * @brief Деструктор класса. Освобождает все элементы за один проход.
+     */
+    ~PtrMap();
+
+    /**
+     * @brief Добавить элемент, забрав владение у rvalue.
+     * @details Если ключ уже есть в контейнере, новый объект освобождается, а старый остается.
+     * @param key Ключ элемента.
+     * @param rvalue Объект класса RvalueUniquePtr, передающий владение. Не должен быть пустым.
+     * @return Пара из итератора на элемент с этим ключом и признака того, что вставка произошла.
+     */
+    std::pair<Iterator, bool> emplace(const KeyType &key, RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Найти элемент по ключу, не забирая владение.
+     * @return Итератор на элемент или end().
+     */
+    Iterator find(const KeyType &key) const;
+
+    /**
+     * @brief Получить указатель на объект по ключу, не забирая владение.
+     * @return Указатель на объект или NULL, если ключа нет.
+     */
+    ValueType *get(const KeyType &key) const;
+
+    /**
+     * @brief Получить ссылку на объект по ключу, не забирая владение.
+     * @throw std::out_of_range Если ключа нет в контейнере.
+     */
+    ValueType &at(const KeyType &key) const;
+
+    /**
+     * @brief Проверить наличие ключа в контейнере.
+     */
+    bool contains(const KeyType &key) const;
+
+    /**
+     * @brief Извлечь элемент из контейнера, не освобождая объект.
+     * @return Объект класса RvalueUniquePtr, владеющий объектом, или пустой, если ключа нет.
+     */
+    RvalueUniquePtr release(const KeyType &key);
+
+    /**
+     * @brief Удалить элемент, освободив объект.
+     * @return true, если элемент был удален.
+     */
+    bool erase(const KeyType &key);
+
+    /**
+     * @brief Удалить все элементы контейнера, освободив объекты.
+     */
+    void clear();
+
+    Iterator begin() const;
+    Iterator end() const;
+
+    size_t size() const;
+    bool empty() const;
+
+    /**
+     * @brief Получить функтор для освобождения данных.
+     */
+    Deleter &getDeleter();
+
+private:
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    PtrMap(const PtrMap &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    PtrMap &operator=(const PtrMap &other);
+
+    /**
+     * @brief Освободить все объекты, не трогая узлы std::map.
+     */
+    void destroyAll();
+
+    MapType data_; //!< Ключи и указатели на объекты.
+    Deleter deleter_; //!< Функтор для освобождения данных.
+};
+
+template<class K, class T, class C, class D>
+PtrMap<K, T, C, D>::PtrMap():
+data_(),
+deleter_() {
+}
+
+template<class K, class T, class C, class D>
+PtrMap<K, T, C, D>::PtrMap(const Deleter &deleter):
+data_(),
+deleter_(deleter) {
+}
+
+template<class K, class T, class C, class D>
+PtrMap<K, T, C, D>::~PtrMap() {
+    destroyAll();
+}
+
+template<class K, class T, class C, class D>
+std::pair<typename PtrMap<K, T, C, D>::Iterator, bool>
+        PtrMap<K, T, C, D>::emplace(const KeyType &key, RvalueUniquePtr rvalue) {
+    assert(rvalue.borrow().get() != NULL);
+    std::pair<typename MapType::iterator, bool> result =
+            data_.insert(typename MapType::value_type(key, NULL));
+    if (result.second) {
+        result.first->second = rvalue.release();
+    }
+    return std::pair<Iterator, bool>(result.first, result.second);
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::Iterator PtrMap<K, T, C, D>::find(const KeyType &key) const {
+    return data_.find(key);
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::ValueType *PtrMap<K, T, C, D>::get(const KeyType &key) const {
+    Iterator it = data_.find(key);
+    return it == data_.end() ? NULL : it->second;
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::ValueType &PtrMap<K, T, C, D>::at(const KeyType &key) const {
+    ValueType *ptr = get(key);
+    if (ptr == NULL) {
+        throw std::out_of_range("mem::PtrMap::at");
+    }
+    return *ptr;
+}
+
+template<class K, class T, class C, class D>
+bool PtrMap<K, T, C, D>::contains(const KeyType &key) const {
+    return data_.find(key) != data_.end();
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::RvalueUniquePtr PtrMap<K, T, C, D>::release(const KeyType &key) {
+    ValueType *ptr = NULL;
+    typename MapType::iterator it = data_.find(key);
+    if (it != data_.end()) {
+        ptr = it->second;
+        data_.erase(it);
+    }
+    return Pointer(ptr, deleter_).move();
+}
+
+template<class K, class T, class C, class D>
+bool PtrMap<K, T, C, D>::erase(const KeyType &key) {
+    typename MapType::iterator it = data_.find(key);
+    if (it == data_.end()) {
+        return false;
+    }
+
+    ValueType *ptr = it->second;
+    data_.erase(it);
+    deleter_(ptr);
+    return true;
+}
+
+template<class K, class T, class C, class D>
+void PtrMap<K, T, C, D>::clear() {
+    destroyAll();
+    data_.clear();
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::Iterator PtrMap<K, T, C, D>::begin() const {
+    return data_.begin();
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::Iterator PtrMap<K, T, C, D>::end() const {
+    return data_.end();
+}
+
+template<class K, class T, class C, class D>
+size_t PtrMap<K, T, C, D>::size() const {
+    return data_.size();
+}
+
+template<class K, class T, class C, class D>
+bool PtrMap<K, T, C, D>::empty() const {
+    return data_.empty();
+}
+
+template<class K, class T, class C, class D>
+typename PtrMap<K, T, C, D>::Deleter &PtrMap<K, T, C, D>::getDeleter() {
+    return deleter_;
+}
+
+template<class K, class T, class C, class D>
+void PtrMap<K, T, C, D>::destroyAll() {
+    for (typename MapType::iterator it = data_.begin(); it != data_.end(); ++it) {
+        deleter_(it->second);
+    }
+}
+
+} // namespace mem
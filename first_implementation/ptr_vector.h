@@ -0,0 +1,569 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+#include "unique_ptr.h"
+
+namespace mem {
+
+/**
+ * @brief Вектор, владеющий объектами через сырые указатели.
+ * @details Хранит указатели T* в непрерывном буфере и при росте переносит их побитово
+ * (realloc/memmove), не вызывая конструкторы копирования RvalueUniquePtr. Все объекты
+ * освобождаются одним функтором D, переданным в конструктор: у функторов с состоянием
+ * оно должно совпадать с состоянием функторов добавляемых указателей.
+ * @tparam T Тип объектов, которыми владеет вектор.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class T, class D = Deleter<T> >
+class PtrVector {
+public:
+    //! Псевдоним для типа объектов, которыми владеет вектор.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+    //! Псевдоним для типа умного указателя на элемент вектора.
+    typedef UniquePtr<T, D> Pointer;
+    //! Псевдоним для типа rvalue умного указателя на элемент вектора.
+    typedef typename Pointer::RvalueUniquePtr RvalueUniquePtr;
+
+    /**
+     * @brief Итератор по элементам вектора. Разыменование дает ссылку на объект, а не на указатель.
+     * @tparam V Тип объекта (T или const T).
+     */
+    template<class V>
+    class BasicIterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef ptrdiff_t difference_type;
+        typedef V *pointer;
+        typedef V &reference;
+
+        BasicIterator();
+        explicit BasicIterator(ValueType *const *slot);
+
+        /**
+         * @brief Преобразование неконстантного итератора в константный.
+         */
+        operator BasicIterator<const ValueType>() const;
+
+        reference operator*() const;
+        pointer operator->() const;
+        reference operator[](difference_type n) const;
+
+        BasicIterator &operator++();
+        BasicIterator operator++(int);
+        BasicIterator &operator--();
+        BasicIterator operator--(int);
+        BasicIterator &operator+=(difference_type n);
+        BasicIterator &operator-=(difference_type n);
+        BasicIterator operator+(difference_type n) const;
+        BasicIterator operator-(difference_type n) const;
+        difference_type operator-(const BasicIterator &other) const;
+
+        bool operator==(const BasicIterator &other) const;
+        bool operator!=(const BasicIterator &other) const;
+        bool operator<(const BasicIterator &other) const;
+        bool operator>(const BasicIterator &other) const;
+        bool operator<=(const BasicIterator &other) const;
+        bool operator>=(const BasicIterator &other) const;
+
+        /**
+         * @brief Сдвиг итератора вида n + it.
+         * @details Определен в классе: у вложенного шаблона параметры T, D и V не выводятся
+         * из аргумента свободной функции.
+         */
+        friend BasicIterator operator+(difference_type n, const BasicIterator &it) {
+            return it + n;
+        }
+
+        /**
+         * @brief Получить адрес ячейки вектора, на которую указывает итератор.
+         */
+        ValueType *const *slot() const;
+
+    private:
+        ValueType *const *slot_; //!< Указатель на ячейку вектора.
+    };
+
+    //! Псевдоним для типа итератора по элементам вектора.
+    typedef BasicIterator<ValueType> Iterator;
+    //! Псевдоним для типа константного итератора по элементам вектора.
+    typedef BasicIterator<const ValueType> ConstIterator;
+
+    /**
+     * @brief Конструктор по умолчанию. Создает пустой вектор.
+     */
+    PtrVector();
+
+    /**
+     * @brief Конструктор класса от функтора для очистки данных.
+     * @param deleter Функтор, которым будут освобождаться все элементы вектора.
+     */
+    explicit PtrVector(const Deleter &deleter);
+
+    /**
+     * @brief Деструктор класса. Освобождает все элементы за один проход и сам буфер.
+     */
+    ~PtrVector();
+
+    /**
+     * @brief Добавить элемент в конец вектора, забрав владение у rvalue.
+     * @details Если при расширении буфера не хватило памяти, объект освобождается самим rvalue.
+     * @param rvalue Объект класса RvalueUniquePtr, передающий владение.
+     */
+    void push_back(RvalueUniquePtr rvalue);
+
+    /**
+     * @brief Удалить последний элемент вектора, освободив объект.
+     */
+    void pop_back();
+
+    /**
+     * @brief Извлечь элемент из вектора, не освобождая объект.
+     * @details Последующие элементы сдвигаются на одну позицию.
+     * @param index Индекс элемента.
+     * @return Объект класса RvalueUniquePtr, владеющий извлеченным объектом.
+     */
+    RvalueUniquePtr release(size_t index);
+
+    /**
+     * @brief Удалить элемент, освободив объект.
+     * @param position Итератор на удаляемый элемент.
+     * @return Итератор на элемент, следующий за удаленным.
+     */
+    Iterator erase(Iterator position);
+
+    /**
+     * @brief Удалить элементы из диапазона [first, last), освободив объекты.
+     * @return Итератор на элемент, следующий за удаленными.
+     */
+    Iterator erase(Iterator first, Iterator last);
+
+    /**
+     * @brief Удалить все элементы вектора, освободив объекты. Емкость буфера сохраняется.
+     */
+    void clear();
+
+    /**
+     * @brief Зарезервировать память под capacity элементов.
+     * @throw std::bad_alloc Если не удалось выделить память.
+     */
+    void reserve(size_t capacity);
+
+    ValueType &operator[](size_t index);
+    const ValueType &operator[](size_t index) const;
+
+    ValueType &front();
+    const ValueType &front() const;
+    ValueType &back();
+    const ValueType &back() const;
+
+    /**
+     * @brief Получить указатель на элемент без передачи владения.
+     */
+    ValueType *get(size_t index) const;
+
+    Iterator begin();
+    Iterator end();
+    ConstIterator begin() const;
+    ConstIterator end() const;
+
+    size_t size() const;
+    size_t capacity() const;
+    bool empty() const;
+
+    /**
+     * @brief Обменять содержимое двух векторов.
+     */
+    void swap(PtrVector &other);
+
+    /**
+     * @brief Получить функтор для освобождения данных.
+     */
+    Deleter &getDeleter();
+
+private:
+    /**
+     * @brief Приватный конструктор копирования.
+     */
+    PtrVector(const PtrVector &other);
+
+    /**
+     * @brief Приватный оператор копирования.
+     */
+    PtrVector &operator=(const PtrVector &other);
+
+    /**
+     * @brief Освободить объекты в ячейках [first, last).
+     */
+    void destroyRange(ValueType **first, ValueType **last);
+
+    /**
+     * @brief Сдвинуть хвост вектора на место удаленных ячеек [first, last).
+     */
+    void closeGap(ValueType **first, ValueType **last);
+
+    friend struct detail::UniqueAccess;
+
+    //! Буфер указателей на элементы и функтор для их освобождения.
+    detail::PtrStorage<ValueType *, Deleter> storage_;
+    size_t size_; //!< Количество элементов.
+    size_t capacity_; //!< Емкость буфера.
+};
+
+/**
+    template<class T, class D>
+    template<class V>
+    class PtrVector<T, D>::BasicIterator
+ **/
+template<class T, class D>
+template<class V>
+PtrVector<T, D>::BasicIterator<V>::BasicIterator():
+slot_(NULL) {
+}
+
+template<class T, class D>
+template<class V>
+PtrVector<T, D>::BasicIterator<V>::BasicIterator(ValueType *const *slot):
+slot_(slot) {
+}
+
+template<class T, class D>
+template<class V>
+PtrVector<T, D>::BasicIterator<V>::operator BasicIterator<const ValueType>() const {
+    return BasicIterator<const ValueType>(slot_);
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>::reference
+        PtrVector<T, D>::BasicIterator<V>::operator*() const {
+    return **slot_;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>::pointer
+        PtrVector<T, D>::BasicIterator<V>::operator->() const {
+    return *slot_;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>::reference
+        PtrVector<T, D>::BasicIterator<V>::operator[](difference_type n) const {
+    return *slot_[n];
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        &PtrVector<T, D>::BasicIterator<V>::operator++() {
+    ++slot_;
+    return *this;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        PtrVector<T, D>::BasicIterator<V>::operator++(int) {
+    BasicIterator it(*this);
+    ++slot_;
+    return it;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        &PtrVector<T, D>::BasicIterator<V>::operator--() {
+    --slot_;
+    return *this;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        PtrVector<T, D>::BasicIterator<V>::operator--(int) {
+    BasicIterator it(*this);
+    --slot_;
+    return it;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        &PtrVector<T, D>::BasicIterator<V>::operator+=(difference_type n) {
+    slot_ += n;
+    return *this;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        &PtrVector<T, D>::BasicIterator<V>::operator-=(difference_type n) {
+    slot_ -= n;
+    return *this;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        PtrVector<T, D>::BasicIterator<V>::operator+(difference_type n) const {
+    return BasicIterator(slot_ + n);
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>
+        PtrVector<T, D>::BasicIterator<V>::operator-(difference_type n) const {
+    return BasicIterator(slot_ - n);
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::template BasicIterator<V>::difference_type
+        PtrVector<T, D>::BasicIterator<V>::operator-(const BasicIterator &other) const {
+    return slot_ - other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+bool PtrVector<T, D>::BasicIterator<V>::operator==(const BasicIterator &other) const {
+    return slot_ == other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+bool PtrVector<T, D>::BasicIterator<V>::operator!=(const BasicIterator &other) const {
+    return slot_ != other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+bool PtrVector<T, D>::BasicIterator<V>::operator<(const BasicIterator &other) const {
+    return slot_ < other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+bool PtrVector<T, D>::BasicIterator<V>::operator>(const BasicIterator &other) const {
+    return slot_ > other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+bool PtrVector<T, D>::BasicIterator<V>::operator<=(const BasicIterator &other) const {
+    return slot_ <= other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+bool PtrVector<T, D>::BasicIterator<V>::operator>=(const BasicIterator &other) const {
+    return slot_ >= other.slot_;
+}
+
+template<class T, class D>
+template<class V>
+typename PtrVector<T, D>::ValueType *const *PtrVector<T, D>::BasicIterator<V>::slot() const {
+    return slot_;
+}
+
+/**
+    template<class T, class D>
+    class PtrVector
+ **/
+template<class T, class D>
+PtrVector<T, D>::PtrVector():
+storage_(NULL, Deleter()),
+size_(0),
+capacity_(0) {
+}
+
+template<class T, class D>
+PtrVector<T, D>::PtrVector(const Deleter &deleter):
+storage_(NULL, deleter),
+size_(0),
+capacity_(0) {
+}
+
+template<class T, class D>
+PtrVector<T, D>::~PtrVector() {
+    destroyRange(storage_.ptr(), storage_.ptr() + size_);
+    std::free(storage_.ptr());
+}
+
+template<class T, class D>
+void PtrVector<T, D>::push_back(RvalueUniquePtr rvalue) {
+    if (size_ == capacity_) {
+        reserve(capacity_ == 0 ? 8 : capacity_ * 2);
+    }
+    storage_.ptr()[size_++] = rvalue.release();
+}
+
+template<class T, class D>
+void PtrVector<T, D>::pop_back() {
+    assert(size_ != 0);
+    --size_;
+    destroyRange(storage_.ptr() + size_, storage_.ptr() + size_ + 1);
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::RvalueUniquePtr PtrVector<T, D>::release(size_t index) {
+    assert(index < size_);
+    ValueType **slot = storage_.ptr() + index;
+    ValueType *ptr = *slot;
+    closeGap(slot, slot + 1);
+    return Pointer(ptr, storage_.deleter()).move();
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::Iterator PtrVector<T, D>::erase(Iterator position) {
+    return erase(position, position + 1);
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::Iterator PtrVector<T, D>::erase(Iterator first, Iterator last) {
+    ValueType **begin = storage_.ptr() + (first.slot() - storage_.ptr());
+    ValueType **end = storage_.ptr() + (last.slot() - storage_.ptr());
+    destroyRange(begin, end);
+    closeGap(begin, end);
+    return Iterator(begin);
+}
+
+template<class T, class D>
+void PtrVector<T, D>::clear() {
+    destroyRange(storage_.ptr(), storage_.ptr() + size_);
+    size_ = 0;
+}
+
+template<class T, class D>
+void PtrVector<T, D>::reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+
+    void *buffer = std::realloc(storage_.ptr(), capacity * sizeof(ValueType *));
+    if (buffer == NULL) {
+        throw std::bad_alloc();
+    }
+    storage_.ptr() = static_cast<ValueType **>(buffer);
+    capacity_ = capacity;
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::ValueType &PtrVector<T, D>::operator[](size_t index) {
+    assert(index < size_);
+    return *storage_.ptr()[index];
+}
+
+template<class T, class D>
+const typename PtrVector<T, D>::ValueType &PtrVector<T, D>::operator[](size_t index) const {
+    assert(index < size_);
+    return *storage_.ptr()[index];
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::ValueType &PtrVector<T, D>::front() {
+    return (*this)[0];
+}
+
+template<class T, class D>
+const typename PtrVector<T, D>::ValueType &PtrVector<T, D>::front() const {
+    return (*this)[0];
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::ValueType &PtrVector<T, D>::back() {
+    return (*this)[size_ - 1];
+}
+
+template<class T, class D>
+const typename PtrVector<T, D>::ValueType &PtrVector<T, D>::back() const {
+    return (*this)[size_ - 1];
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::ValueType *PtrVector<T, D>::get(size_t index) const {
+    assert(index < size_);
+    return storage_.ptr()[index];
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::Iterator PtrVector<T, D>::begin() {
+    return Iterator(storage_.ptr());
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::Iterator PtrVector<T, D>::end() {
+    return Iterator(storage_.ptr() + size_);
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::ConstIterator PtrVector<T, D>::begin() const {
+    return ConstIterator(storage_.ptr());
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::ConstIterator PtrVector<T, D>::end() const {
+    return ConstIterator(storage_.ptr() + size_);
+}
+
+template<class T, class D>
+size_t PtrVector<T, D>::size() const {
+    return size_;
+}
+
+template<class T, class D>
+size_t PtrVector<T, D>::capacity() const {
+    return capacity_;
+}
+
+template<class T, class D>
+bool PtrVector<T, D>::empty() const {
+    return size_ == 0;
+}
+
+template<class T, class D>
+void PtrVector<T, D>::swap(PtrVector &other) {
+    detail::PtrStorage<ValueType *, Deleter> storage(storage_);
+    storage_ = other.storage_;
+    other.storage_ = storage;
+
+    size_t size = size_;
+    size_ = other.size_;
+    other.size_ = size;
+
+    size_t capacity = capacity_;
+    capacity_ = other.capacity_;
+    other.capacity_ = capacity;
+}
+
+template<class T, class D>
+typename PtrVector<T, D>::Deleter &PtrVector<T, D>::getDeleter() {
+    return storage_.deleter();
+}
+
+template<class T, class D>
+void PtrVector<T, D>::destroyRange(ValueType **first, ValueType **last) {
+    for (; first != last; ++first) {
+        if (*first != NULL) {
+            storage_.deleter()(*first);
+        }
+    }
+}
+
+template<class T, class D>
+void PtrVector<T, D>::closeGap(ValueType **first, ValueType **last) {
+    ValueType **end = storage_.ptr() + size_;
+    std::memmove(first, last, (end - last) * sizeof(ValueType *));
+    size_ -= last - first;
+}
+
+} // namespace mem
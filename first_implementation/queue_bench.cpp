@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+
+#include <pthread.h>
+
+#include "benchmark.h"
+#include "owned_queue.h"
+#include "ptr_vector.h"
+#include "unique_ptr.h"
+
+/**
+ * Пропускная способность передачи владения между потоками: SpscOwnedQueue, MpmcOwnedQueue и
+ * std::queue<Foo *> под мьютексом (release() у производителя и обертка у потребителя).
+ * P производителей передают объекты одному потребителю. Объекты создаются в главном потоке до
+ * начала замера, поэтому счетчики выделений памяти в benchmark.h не используются из нескольких
+ * потоков.
+ * Аргументы: число объектов на производителя и максимальное число производителей.
+ */
+
+namespace {
+
+struct Foo {
+    Foo(size_t id = 0): id_(id) {}
+
+    size_t id() const {
+        return id_;
+    }
+
+private:
+    size_t id_;
+};
+
+typedef mem::UniquePtr<Foo> FooPtr;
+typedef FooPtr::RvalueUniquePtr RvalueFooPtr;
+
+const size_t QueueCapacity = 1024;
+
+/**
+ * Очередь под мьютексом с тем же интерфейсом, что и у очередей владения.
+ */
+class LockedQueue {
+public:
+    explicit LockedQueue(size_t) {
+        pthread_mutex_init(&mutex_, NULL);
+    }
+
+    ~LockedQueue() {
+        while (!data_.empty()) {
+            delete data_.front();
+            data_.pop();
+        }
+        pthread_mutex_destroy(&mutex_);
+    }
+
+    void push(RvalueFooPtr rvalue) {
+        Foo *ptr = rvalue.release();
+        pthread_mutex_lock(&mutex_);
+        data_.push(ptr);
+        pthread_mutex_unlock(&mutex_);
+    }
+
+    RvalueFooPtr pop() {
+        for (;;) {
+            pthread_mutex_lock(&mutex_);
+            if (!data_.empty()) {
+                Foo *ptr = data_.front();
+                data_.pop();
+                pthread_mutex_unlock(&mutex_);
+                return FooPtr(ptr).move();
+            }
+            pthread_mutex_unlock(&mutex_);
+            mem::detail::threadYield();
+        }
+    }
+
+private:
+    LockedQueue(const LockedQueue &other);
+    LockedQueue &operator=(const LockedQueue &other);
+
+    pthread_mutex_t mutex_;
+    std::queue<Foo *> data_;
+};
+
+template<class Queue>
+struct Context {
+    Queue *queue;
+    pthread_barrier_t *start;
+    mem::PtrVector<Foo> *batches;
+    size_t nextBatch;
+    size_t items;
+    size_t producers;
+};
+
+template<class Queue>
+void *produce(void *data) {
+    Context<Queue> *context = static_cast<Context<Queue> *>(data);
+
+    mem::PtrVector<Foo> &items =
+            context->batches[mem::detail::atomicFetchAdd(&context->nextBatch, size_t(1))];
+
+    pthread_barrier_wait(context->start);
+    while (!items.empty()) {
+        context->queue->push(items.release(items.size() - 1));
+    }
+    return NULL;
+}
+
+template<class Queue>
+void *consume(void *data) {
+    Context<Queue> *context = static_cast<Context<Queue> *>(data);
+
+    size_t sum = 0;
+    pthread_barrier_wait(context->start);
+    for (size_t i = 0; i < context->items * context->producers; ++i) {
+        FooPtr p(context->queue->pop());
+        sum += p->id();
+    }
+    bench::doNotOptimize(sum);
+    return NULL;
+}
+
+template<class Queue>
+void runQueue(const char *name, size_t items, size_t producers) {
+    Queue queue(QueueCapacity);
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, static_cast<unsigned>(producers + 2));
+
+    mem::PtrVector<Foo> *batches = new mem::PtrVector<Foo>[producers];
+    for (size_t i = 0; i < producers; ++i) {
+        batches[i].reserve(items);
+        for (size_t j = 0; j < items; ++j) {
+            batches[i].push_back(FooPtr(new Foo(j)).move());
+        }
+    }
+
+    Context<Queue> context = {&queue, &start, batches, 0, items, producers};
+    pthread_t *threads = new pthread_t[producers + 1];
+    for (size_t i = 0; i < producers; ++i) {
+        pthread_create(&threads[i], NULL, produce<Queue>, &context);
+    }
+    pthread_create(&threads[producers], NULL, consume<Queue>, &context);
+
+    pthread_barrier_wait(&start);
+    const double begin = bench::nowNs();
+    for (size_t i = 0; i <= producers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    const double elapsed = bench::nowNs() - begin;
+
+    delete[] threads;
+    delete[] batches;
+    pthread_barrier_destroy(&start);
+
+    const double total = static_cast<double>(items * producers);
+    std::printf("%-44s %10lu %12.2f %12.2f\n", name, static_cast<unsigned long>(producers),
+                elapsed / total, total / elapsed * 1e3);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t items = bench::iterationsFromArgs(argc, argv, 200000);
+    size_t maxProducers = 4;
+    if (argc > 2 && std::atol(argv[2]) > 0) {
+        maxProducers = static_cast<size_t>(std::atol(argv[2]));
+    }
+
+    std::printf("%-44s %10s %12s %12s\n", "benchmark", "producers", "ns/item", "Mitems/s");
+    runQueue<mem::SpscOwnedQueue<Foo> >("handoff mem::SpscOwnedQueue", items, 1);
+    for (size_t producers = 1; producers <= maxProducers; ++producers) {
+        runQueue<mem::MpmcOwnedQueue<Foo> >("handoff mem::MpmcOwnedQueue", items, producers);
+        runQueue<LockedQueue>("handoff std::queue + pthread_mutex", items, producers);
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <pthread.h>
+
+#include "atomic_unique_ptr.h"
+#include "benchmark.h"
+#include "epoch_domain.h"
+#include "unique_ptr.h"
+
+/**
+ * Чтение разделяемого объекта, который один писатель постоянно заменяет: EpochDomain::Guard с
+ * AtomicUniquePtr<T, EpochDeleter<T> > против указателя под pthread_mutex. Читатели регистрируются
+ * в домене до начала замера, поэтому во время замера память выделяет только поток писателя.
+ * Аргументы: число чтений на поток и максимальное число читателей.
+ */
+
+namespace {
+
+struct Config {
+    explicit Config(size_t version): version(version) {}
+
+    size_t version;
+};
+
+typedef mem::AtomicUniquePtr<Config, mem::EpochDeleter<Config> > EpochConfigPtr;
+
+/**
+ * Общий объект под защитой эпох.
+ */
+class EpochShared {
+public:
+    EpochShared():
+    deleter_(&domain_),
+    config_(deleter_) {
+        config_.store(EpochConfigPtr::Pointer(new Config(0), deleter_).move());
+    }
+
+    void prepareReader() {
+        mem::EpochDomain::Guard guard(domain_);
+    }
+
+    size_t read() {
+        mem::EpochDomain::Guard guard(domain_);
+        return config_.load()->version;
+    }
+
+    void write(size_t version) {
+        config_.exchange(EpochConfigPtr::Pointer(new Config(version), deleter_).move());
+    }
+
+private:
+    mem::EpochDomain domain_;
+    mem::EpochDeleter<Config> deleter_;
+    EpochConfigPtr config_;
+};
+
+/**
+ * Общий объект под мьютексом.
+ */
+class LockedShared {
+public:
+    LockedShared():
+    config_(new Config(0)) {
+        pthread_mutex_init(&mutex_, NULL);
+    }
+
+    ~LockedShared() {
+        pthread_mutex_destroy(&mutex_);
+    }
+
+    void prepareReader() {}
+
+    size_t read() {
+        pthread_mutex_lock(&mutex_);
+        const size_t version = config_->version;
+        pthread_mutex_unlock(&mutex_);
+        return version;
+    }
+
+    void write(size_t version) {
+        mem::UniquePtr<Config> next(new Config(version));
+        pthread_mutex_lock(&mutex_);
+        mem::UniquePtr<Config> displaced(config_.move());
+        config_ = next.move();
+        pthread_mutex_unlock(&mutex_);
+    }
+
+private:
+    pthread_mutex_t mutex_;
+    mem::UniquePtr<Config> config_;
+};
+
+template<class Shared>
+struct Context {
+    Shared *shared;
+    pthread_barrier_t *start;
+    size_t reads;
+    size_t activeReaders;
+    size_t writes;
+};
+
+template<class Shared>
+void *readShared(void *data) {
+    Context<Shared> *context = static_cast<Context<Shared> *>(data);
+    context->shared->prepareReader();
+
+    size_t sum = 0;
+    pthread_barrier_wait(context->start);
+    for (size_t i = 0; i < context->reads; ++i) {
+        sum += context->shared->read();
+    }
+    bench::doNotOptimize(sum);
+    mem::detail::atomicFetchAdd(&context->activeReaders, size_t(-1));
+    return NULL;
+}
+
+template<class Shared>
+void *writeShared(void *data) {
+    Context<Shared> *context = static_cast<Context<Shared> *>(data);
+    pthread_barrier_wait(context->start);
+    while (mem::detail::atomicLoad(&context->activeReaders) != 0) {
+        context->shared->write(++context->writes);
+        mem::detail::threadYield();
+    }
+    return NULL;
+}
+
+template<class Shared>
+void runShared(const char *name, size_t reads, size_t readers) {
+    Shared shared;
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, static_cast<unsigned>(readers + 2));
+
+    Context<Shared> context = {&shared, &start, reads, readers, 0};
+    pthread_t *threads = new pthread_t[readers + 1];
+    for (size_t i = 0; i < readers; ++i) {
+        pthread_create(&threads[i], NULL, readShared<Shared>, &context);
+    }
+    pthread_create(&threads[readers], NULL, writeShared<Shared>, &context);
+
+    pthread_barrier_wait(&start);
+    const double begin = bench::nowNs();
+    for (size_t i = 0; i <= readers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    const double elapsed = bench::nowNs() - begin;
+
+    delete[] threads;
+    pthread_barrier_destroy(&start);
+
+    const double total = static_cast<double>(reads * readers);
+    std::printf("%-44s %10lu %12.2f %12lu\n", name, static_cast<unsigned long>(readers),
+                elapsed / total, static_cast<unsigned long>(context.writes));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t reads = bench::iterationsFromArgs(argc, argv, 1000000);
+    size_t maxReaders = 4;
+    if (argc > 2 && std::atol(argv[2]) > 0) {
+        maxReaders = static_cast<size_t>(std::atol(argv[2]));
+    }
+
+    std::printf("%-44s %10s %12s %12s\n", "benchmark", "readers", "ns/read", "writes");
+    for (size_t readers = 1; readers <= maxReaders; ++readers) {
+        runShared<EpochShared>("read mem::EpochDomain", reads, readers);
+        runShared<LockedShared>("read pthread_mutex", reads, readers);
+    }
+    return 0;
+}
@@ -0,0 +1,593 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include "atomic.h"
+#include "observer_ptr.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+/**
+ * @brief Политика счетчика ссылок для объектов, которые используются одним потоком.
+ * @details Обычные инкремент и декремент, без атомарных инструкций.
+ */
+struct SingleThreadedRefCount {
+    static void increment(size_t &count) {
+        ++count;
+    }
+
+    /**
+     * @return true, если ссылок больше не осталось.
+     */
+    static bool decrement(size_t &count) {
+        return --count == 0;
+    }
+
+    static size_t load(const size_t &count) {
+        return count;
+    }
+};
+
+/**
+ * @brief Политика счетчика ссылок для объектов, которые разделяются между потоками.
+ * @details Инкремент без упорядочивания: новая ссылка появляется только от уже существующей.
+ * Декремент с семантикой acquire-release, чтобы записи всех владельцев были видны деструктору.
+ */
+struct MultiThreadedRefCount {
+    static void increment(size_t &count) {
+        detail::atomicFetchAddRelaxed(&count, size_t(1));
+    }
+
+    /**
+     * @return true, если ссылок больше не осталось.
+     */
+    static bool decrement(size_t &count) {
+        return detail::atomicFetchAdd(&count, size_t(-1)) == 1;
+    }
+
+    static size_t load(const size_t &count) {
+        return detail::atomicLoadRelaxed(&count);
+    }
+};
+
+/**
+ * @brief Базовый класс объектов, которыми владеет SharedPtr.
+ * @details Счетчик ссылок лежит в самом объекте, поэтому SharedPtr не выделяет отдельный блок
+ * управления и занимает один указатель. Объект удаляется через delete, как и Deleter<T>, так
+ * что иерархия, которой владеют через указатель на базу, должна иметь виртуальный деструктор.
+ * Копия объекта начинает с нулевым счетчиком: ссылки относятся к объекту, а не к его значению.
+ * @tparam P Политика счетчика ссылок: SingleThreadedRefCount или MultiThreadedRefCount.
+ */
+template<class P = SingleThreadedRefCount>
+class IntrusiveRefCounted {
+public:
+    //! Псевдоним для типа политики счетчика ссылок.
+    typedef P ThreadingPolicy;
+
+    /**
+     * @brief Добавить ссылку на объект.
+     */
+    void addRef() const;
+
+    /**
+     * @brief Убрать ссылку на объект.
+     * @return true, если это была последняя ссылка и объект пора удалить.
+     */
+    bool releaseRef() const;
+
+    /**
+     * @brief Текущее число ссылок (в многопоточном случае - приблизительное).
+     */
+    size_t refCount() const;
+
+protected:
+    IntrusiveRefCounted();
+    IntrusiveRefCounted(const IntrusiveRefCounted &other);
+    IntrusiveRefCounted &operator=(const IntrusiveRefCounted &other);
+    ~IntrusiveRefCounted();
+
+private:
+    mutable size_t refCount_; //!< Число SharedPtr и RvalueSharedPtr, владеющих объектом.
+};
+
+namespace detail {
+
+/**
+ * @brief Убрать ссылку и удалить объект, если она была последней.
+ */
+template<class T>
+inline void releaseShared(T *ptr) {
+    if (ptr != NULL && ptr->releaseRef()) {
+        delete ptr;
+    }
+}
+
+} // namespace detail
+
+template<class T>
+class SharedPtr;
+
+/**
+ * @brief Класс реализующий сущность rvalue объекта разделяемого умного указателя.
+ * @details Как и RvalueUniquePtr, копия забирает ссылку у оригинала, поэтому передача через
+ * move() не трогает счетчик ссылок. Если ссылку никто не забрал, деструктор отпускает ее.
+ * Обычно используется через псевдоним SharedPtr<T>::RvalueSharedPtr.
+ * @tparam T Тип объекта хранения, производный от IntrusiveRefCounted.
+ */
+template<class T>
+class RvalueSharedPtr {
+public:
+    //! Псевдоним для типа объекта хранения.
+    typedef T ValueType;
+
+    /**
+     * @brief Копирующий конструктор класса. Забирает ссылку у other.
+     * @param other Ссылка на другой объект класса RvalueSharedPtr.
+     */
+    RvalueSharedPtr(const RvalueSharedPtr &other);
+
+    /**
+     * @brief Конструктор от rvalue объекта разделяемого указателя на производный тип.
+     * @param other Ссылка на rvalue объект разделяемого указателя на производный тип.
+     */
+    template<class U>
+    RvalueSharedPtr(const RvalueSharedPtr<U> &other);
+
+    /**
+     * @brief Деструктор класса. Отпускает ссылку, если ее никто не забрал.
+     */
+    ~RvalueSharedPtr();
+
+    /**
+     * @brief Оператор копирования класса. Забирает ссылку у other.
+     * @param other Ссылка на другой объект класса RvalueSharedPtr.
+     * @return Ссылка на этот объект.
+     */
+    RvalueSharedPtr &operator=(const RvalueSharedPtr &other);
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения.
+     * @return Наблюдатель за объектом хранения.
+     */
+    ObserverPtr<ValueType> borrow() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения только для чтения.
+     * @return Наблюдатель за константным объектом хранения.
+     */
+    ObserverPtr<const ValueType> borrowConst() const;
+
+private:
+    template<class U>
+    friend class SharedPtr;
+
+    template<class U>
+    friend class RvalueSharedPtr;
+
+    /**
+     * @brief Приватный конструктор класса, принимающий уже учтенную ссылку.
+     * @param ptr Указатель на объект хранения.
+     */
+    explicit RvalueSharedPtr(ValueType *ptr);
+
+    /**
+     * @brief Отдать ссылку, не трогая счетчик.
+     * @return Указатель на объект хранения.
+     */
+    ValueType *take() const;
+
+    mutable ValueType *ptr_; //!< Указатель на объект хранения.
+};
+
+/**
+ * @brief Класс реализующий сущность разделяемого умного указателя со встроенным в объект
+ * счетчиком ссылок.
+ * @details Копирование добавляет ссылку, move() передает ее без обращения к счетчику.
+ * Владение объектом, созданным через makeUnique, можно передать SharedPtr без повторного
+ * выделения памяти, так как счетчик уже лежит в объекте.
+ * @tparam T Тип объекта хранения, производный от IntrusiveRefCounted.
+ */
+template<class T>
+class SharedPtr {
+public:
+    //! Псевдоним для типа объекта хранения.
+    typedef T ValueType;
+
+    //! Псевдоним для типа rvalue объекта этого умного указателя.
+    typedef mem::RvalueSharedPtr<T> RvalueSharedPtr;
+
+    /**
+     * @brief Конструктор по умолчанию. Создает пустой указатель.
+     */
+    SharedPtr();
+
+    /**
+     * @brief Конструктор класса, добавляющий ссылку на объект.
+     * @param ptr Указатель на объект хранения (может уже принадлежать другим SharedPtr).
+     */
+    explicit SharedPtr(ValueType *ptr);
+
+    /**
+     * @brief Копирующий конструктор класса. Добавляет ссылку.
+     * @param other Ссылка на другой экземпляр класса SharedPtr.
+     */
+    SharedPtr(const SharedPtr &other);
+
+    /**
+     * @brief Конструктор от разделяемого указателя на производный тип. Добавляет ссылку.
+     * @param other Ссылка на экземпляр класса SharedPtr<U>.
+     */
+    template<class U>
+    SharedPtr(const SharedPtr<U> &other);
+
+    /**
+     * @brief Конструктор класса от ссылки на объект RvalueSharedPtr. Счетчик не меняется.
+     * @param rvalue Ссылка на экземпляр класса RvalueSharedPtr.
+     */
+    explicit SharedPtr(const RvalueSharedPtr &rvalue);
+
+    /**
+     * @brief Конструктор от rvalue объекта разделяемого указателя на производный тип.
+     * @param rvalue Ссылка на экземпляр класса RvalueSharedPtr<U>.
+     */
+    template<class U>
+    explicit SharedPtr(const mem::RvalueSharedPtr<U> &rvalue);
+
+    /**
+     * @brief Конструктор, забирающий объект у уникального указателя.
+     * @details Объект остается на месте, счетчик ссылок становится равным 1. Поддерживается
+     * только Deleter<U>: SharedPtr удаляет объект через delete и не хранит функтор очистки.
+     * @param rvalue Ссылка на экземпляр класса RvalueUniquePtr<U>.
+     */
+    template<class U>
+    explicit SharedPtr(const RvalueUniquePtr<U, Deleter<U> > &rvalue);
+
+    /**
+     * @brief Оператор копирования класса. Добавляет ссылку на новый объект и отпускает старый.
+     * @param other Ссылка на другой экземпляр класса SharedPtr.
+     * @return Ссылка на этот объект.
+     */
+    SharedPtr &operator=(const SharedPtr &other);
+
+    /**
+     * @brief Оператор копирования от разделяемого указателя на производный тип.
+     * @param other Ссылка на экземпляр класса SharedPtr<U>.
+     * @return Ссылка на этот объект.
+     */
+    template<class U>
+    SharedPtr &operator=(const SharedPtr<U> &other);
+
+    /**
+     * @brief Оператор копирования от rvalue объекта. Счетчик нового объекта не меняется.
+     * @param rvalue Ссылка на экземпляр класса RvalueSharedPtr.
+     * @return Ссылка на этот объект.
+     */
+    SharedPtr &operator=(const RvalueSharedPtr &rvalue);
+
+    /**
+     * @brief Оператор копирования от rvalue объекта разделяемого указателя на производный тип.
+     * @param rvalue Ссылка на экземпляр класса RvalueSharedPtr<U>.
+     * @return Ссылка на этот объект.
+     */
+    template<class U>
+    SharedPtr &operator=(const mem::RvalueSharedPtr<U> &rvalue);
+
+    /**
+     * @brief Оператор копирования, забирающий объект у уникального указателя.
+     * @param rvalue Ссылка на экземпляр класса RvalueUniquePtr<U>.
+     * @return Ссылка на этот объект.
+     */
+    template<class U>
+    SharedPtr &operator=(const RvalueUniquePtr<U, Deleter<U> > &rvalue);
+
+    /**
+     * @brief Деструктор класса. Отпускает ссылку.
+     */
+    ~SharedPtr();
+
+    /**
+     * @brief Метод для передачи ссылки другому объекту без обращения к счетчику.
+     * @return Объект класса RvalueSharedPtr.
+     */
+    RvalueSharedPtr move();
+
+    /**
+     * @brief Отпустить ссылку и стать пустым.
+     */
+    void reset();
+
+    /**
+     * @brief Оператор разыменования.
+     * @details Подразумевает, что SharedPtr не пуст.
+     * @return Ссылка на объект хранения.
+     */
+    ValueType &operator*() const;
+
+    /**
+     * @brief Оператор ->
+     * @details Подразумевает, что SharedPtr не пуст.
+     */
+    ValueType *operator->() const;
+
+    /**
+     * @brief Получить указатель на объект хранения.
+     */
+    ValueType *get() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения.
+     * @return Наблюдатель за объектом хранения.
+     */
+    ObserverPtr<ValueType> borrow() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения только для чтения.
+     * @return Наблюдатель за константным объектом хранения.
+     */
+    ObserverPtr<const ValueType> borrowConst() const;
+
+    /**
+     * @brief Число ссылок на объект хранения, 0 для пустого указателя.
+     */
+    size_t useCount() const;
+
+private:
+    template<class U>
+    friend class SharedPtr;
+
+    /**
+     * @brief Заменить объект хранения на ptr, уже учтенный в счетчике, и отпустить старый.
+     */
+    void adopt(ValueType *ptr);
+
+    ValueType *ptr_; //!< Указатель на объект хранения.
+};
+
+/**
+    template<class P>
+    class IntrusiveRefCounted
+ **/
+template<class P>
+IntrusiveRefCounted<P>::IntrusiveRefCounted():
+refCount_(0) {
+}
+
+template<class P>
+IntrusiveRefCounted<P>::IntrusiveRefCounted(const IntrusiveRefCounted &):
+refCount_(0) {
+}
+
+template<class P>
+IntrusiveRefCounted<P> &IntrusiveRefCounted<P>::operator=(const IntrusiveRefCounted &) {
+    return *this;
+}
+
+template<class P>
+IntrusiveRefCounted<P>::~IntrusiveRefCounted() {
+}
+
+template<class P>
+void IntrusiveRefCounted<P>::addRef() const {
+    ThreadingPolicy::increment(refCount_);
+}
+
+template<class P>
+bool IntrusiveRefCounted<P>::releaseRef() const {
+    assert(ThreadingPolicy::load(refCount_) != 0);
+    return ThreadingPolicy::decrement(refCount_);
+}
+
+template<class P>
+size_t IntrusiveRefCounted<P>::refCount() const {
+    return ThreadingPolicy::load(refCount_);
+}
+
+/**
+    template<class T>
+    class RvalueSharedPtr
+ **/
+template<class T>
+RvalueSharedPtr<T>::RvalueSharedPtr(ValueType *ptr):
+ptr_(ptr) {
+}
+
+template<class T>
+RvalueSharedPtr<T>::RvalueSharedPtr(const RvalueSharedPtr &other):
+ptr_(other.take()) {
+}
+
+template<class T>
+template<class U>
+RvalueSharedPtr<T>::RvalueSharedPtr(const RvalueSharedPtr<U> &other):
+ptr_(other.take()) {
+}
+
+template<class T>
+RvalueSharedPtr<T>::~RvalueSharedPtr() {
+    detail::releaseShared(ptr_);
+}
+
+template<class T>
+RvalueSharedPtr<T> &RvalueSharedPtr<T>::operator=(const RvalueSharedPtr &other) {
+    if (this == &other) {
+        return *this;
+    }
+    ValueType *old = ptr_;
+    ptr_ = other.take();
+    detail::releaseShared(old);
+
+    return *this;
+}
+
+template<class T>
+ObserverPtr<typename RvalueSharedPtr<T>::ValueType> RvalueSharedPtr<T>::borrow() const {
+    return ObserverPtr<ValueType>(ptr_);
+}
+
+template<class T>
+ObserverPtr<const typename RvalueSharedPtr<T>::ValueType> RvalueSharedPtr<T>::borrowConst() const {
+    return ObserverPtr<const ValueType>(ptr_);
+}
+
+template<class T>
+typename RvalueSharedPtr<T>::ValueType *RvalueSharedPtr<T>::take() const {
+    ValueType *ptr = ptr_;
+    ptr_ = NULL;
+    return ptr;
+}
+
+/**
+    template<class T>
+    class SharedPtr
+ **/
+template<class T>
+SharedPtr<T>::SharedPtr():
+ptr_(NULL) {
+}
+
+template<class T>
+SharedPtr<T>::SharedPtr(ValueType *ptr):
+ptr_(ptr) {
+    if (ptr_ != NULL) {
+        ptr_->addRef();
+    }
+}
+
+template<class T>
+SharedPtr<T>::SharedPtr(const SharedPtr &other):
+ptr_(other.ptr_) {
+    if (ptr_ != NULL) {
+        ptr_->addRef();
+    }
+}
+
+template<class T>
+template<class U>
+SharedPtr<T>::SharedPtr(const SharedPtr<U> &other):
+ptr_(other.ptr_) {
+    if (ptr_ != NULL) {
+        ptr_->addRef();
+    }
+}
+
+template<class T>
+SharedPtr<T>::SharedPtr(const RvalueSharedPtr &rvalue):
+ptr_(rvalue.take()) {
+}
+
+template<class T>
+template<class U>
+SharedPtr<T>::SharedPtr(const mem::RvalueSharedPtr<U> &rvalue):
+ptr_(rvalue.take()) {
+}
+
+template<class T>
+template<class U>
+SharedPtr<T>::SharedPtr(const RvalueUniquePtr<U, Deleter<U> > &rvalue):
+ptr_(UniquePtr<U>(rvalue).release()) {
+    if (ptr_ != NULL) {
+        ptr_->addRef();
+    }
+}
+
+template<class T>
+SharedPtr<T> &SharedPtr<T>::operator=(const SharedPtr &other) {
+    if (other.ptr_ != NULL) {
+        other.ptr_->addRef();
+    }
+    adopt(other.ptr_);
+
+    return *this;
+}
+
+template<class T>
+template<class U>
+SharedPtr<T> &SharedPtr<T>::operator=(const SharedPtr<U> &other) {
+    if (other.ptr_ != NULL) {
+        other.ptr_->addRef();
+    }
+    adopt(other.ptr_);
+
+    return *this;
+}
+
+template<class T>
+SharedPtr<T> &SharedPtr<T>::operator=(const RvalueSharedPtr &rvalue) {
+    adopt(rvalue.take());
+
+    return *this;
+}
+
+template<class T>
+template<class U>
+SharedPtr<T> &SharedPtr<T>::operator=(const mem::RvalueSharedPtr<U> &rvalue) {
+    adopt(rvalue.take());
+
+    return *this;
+}
+
+template<class T>
+template<class U>
+SharedPtr<T> &SharedPtr<T>::operator=(const RvalueUniquePtr<U, Deleter<U> > &rvalue) {
+    return *this = SharedPtr(rvalue).move();
+}
+
+template<class T>
+SharedPtr<T>::~SharedPtr() {
+    detail::releaseShared(ptr_);
+}
+
+template<class T>
+typename SharedPtr<T>::RvalueSharedPtr SharedPtr<T>::move() {
+    ValueType *ptr = ptr_;
+    ptr_ = NULL;
+    return RvalueSharedPtr(ptr);
+}
+
+template<class T>
+void SharedPtr<T>::reset() {
+    adopt(NULL);
+}
+
+template<class T>
+typename SharedPtr<T>::ValueType &SharedPtr<T>::operator*() const {
+    assert(ptr_ != NULL);
+    return *ptr_;
+}
+
+template<class T>
+typename SharedPtr<T>::ValueType *SharedPtr<T>::operator->() const {
+    assert(ptr_ != NULL);
+    return ptr_;
+}
+
+template<class T>
+typename SharedPtr<T>::ValueType *SharedPtr<T>::get() const {
+    return ptr_;
+}
+
+template<class T>
+ObserverPtr<typename SharedPtr<T>::ValueType> SharedPtr<T>::borrow() const {
+    return ObserverPtr<ValueType>(ptr_);
+}
+
+template<class T>
+ObserverPtr<const typename SharedPtr<T>::ValueType> SharedPtr<T>::borrowConst() const {
+    return ObserverPtr<const ValueType>(ptr_);
+}
+
+template<class T>
+size_t SharedPtr<T>::useCount() const {
+    return ptr_ == NULL ? 0 : ptr_->refCount();
+}
+
+template<class T>
+void SharedPtr<T>::adopt(ValueType *ptr) {
+    ValueType *old = ptr_;
+    ptr_ = ptr;
+    detail::releaseShared(old);
+}
+
+} // namespace mem
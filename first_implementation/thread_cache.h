@@ -0,0 +1,567 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "atomic.h"
+#include "make_unique.h"
+#include "preprocessor.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+//! Размер блока, нарезаемого на слоты; блоки выровнены по своему размеру.
+static const size_t ThreadCacheChunkSize = 64 * 1024;
+//! Шаг классов размера и гарантированное выравнивание слотов.
+static const size_t ThreadCacheGranularity = 16;
+//! Наибольший размер объекта.
+static const size_t ThreadCacheMaxSize = 256;
+//! Количество классов размера: 16, 32, ..., 256 байт.
+static const size_t ThreadCacheClasses = ThreadCacheMaxSize / ThreadCacheGranularity;
+
+struct ThreadCache;
+
+/**
+ * @brief Заголовок блока памяти, нарезанного на слоты одного класса размера.
+ * @details Блок выровнен по ThreadCacheChunkSize, поэтому заголовок находится по адресу любого
+ * его слота с обнуленными младшими битами. Первая кэш-линия читается и пишется другими
+ * потоками (remote, owner), остальные поля меняет только поток-владелец.
+ */
+struct ThreadCacheChunk {
+    void *remote; //!< Слоты, освобожденные другими потоками (lock-free стек).
+    ThreadCache *owner; //!< Кэш потока-владельца; NULL, если поток завершился.
+    uint64_t reciprocal; //!< ceil(2^32 / slotSize): номер слота умножением вместо деления.
+    size_t slotSize; //!< Размер слота в байтах.
+    size_t sizeClass; //!< Класс размера.
+    char padding[CacheLineSize - 2 * sizeof(void *) - sizeof(uint64_t) - 2 * sizeof(size_t)];
+
+    void *free; //!< Слоты, освобожденные владельцем.
+    size_t used; //!< Слоты, не вернувшиеся к владельцу (включая еще не собранные из remote).
+    size_t bumped; //!< Слоты, выданные хотя бы раз; остальные еще не тронуты.
+    size_t capacity; //!< Количество слотов.
+    ThreadCacheChunk *prev; //!< Предыдущий блок в кольце класса у владельца.
+    ThreadCacheChunk *next; //!< Следующий блок в кольце класса у владельца или в пуле.
+};
+
+//! Смещение первого слота от начала блока.
+static const size_t ThreadCacheHeaderSize =
+        (sizeof(ThreadCacheChunk) + CacheLineSize - 1) / CacheLineSize * CacheLineSize;
+
+/**
+ * @brief Кэш потока: кольцо блоков для каждого класса размера.
+ */
+struct ThreadCache {
+    ThreadCacheChunk *current[ThreadCacheClasses]; //!< Блок, из которого идет выделение.
+};
+
+/**
+ * @brief Центральный пул блоков, общий для всех потоков.
+ */
+struct ThreadCacheCentral {
+    pthread_mutex_t mutex; //!< Защищает все поля пула.
+    ThreadCacheChunk *empty; //!< Пустые блоки любого класса.
+    ThreadCacheChunk *abandoned[ThreadCacheClasses]; //!< Блоки завершившихся потоков с объектами.
+    size_t emptyCount; //!< Количество пустых блоков.
+    size_t abandonedCount; //!< Количество брошенных блоков.
+};
+
+inline ThreadCacheCentral &threadCacheCentral() {
+    static ThreadCacheCentral central = {PTHREAD_MUTEX_INITIALIZER, NULL, {NULL}, 0, 0};
+    return central;
+}
+
+inline ThreadCache *&currentThreadCache() {
+    static __thread ThreadCache *cache = NULL;
+    return cache;
+}
+
+inline ThreadCacheChunk *chunkOf(const void *ptr) {
+    return reinterpret_cast<ThreadCacheChunk *>(
+            reinterpret_cast<size_t>(ptr) & ~(ThreadCacheChunkSize - 1));
+}
+
+/**
+ * @brief Начало слота, в котором лежит ptr.
+ * @details ptr может указывать внутрь объекта (базовый подобъект при множественном
+ * наследовании). Умножение на reciprocal дает точное частное, так как смещение меньше 2^16,
+ * а размер слота не больше 2^8.
+ */
+inline void *slotOf(ThreadCacheChunk *chunk, const void *ptr) {
+    char *slots = reinterpret_cast<char *>(chunk) + ThreadCacheHeaderSize;
+    const uint64_t offset = static_cast<uint64_t>(static_cast<const char *>(ptr) - slots);
+    const size_t index = static_cast<size_t>((offset * chunk->reciprocal) >> 32);
+    return slots + index * chunk->slotSize;
+}
+
+inline void pushSlot(void *&list, void *slot) {
+    *static_cast<void **>(slot) = list;
+    list = slot;
+}
+
+inline void *popSlot(void *&list) {
+    void *slot = list;
+    list = *static_cast<void **>(slot);
+    return slot;
+}
+
+/**
+ * @brief Подготовить блок к выдаче слотов класса sizeClass.
+ */
+inline void initChunk(ThreadCacheChunk *chunk, size_t sizeClass, ThreadCache *owner) {
+    const size_t slotSize = (sizeClass + 1) * ThreadCacheGranularity;
+    chunk->remote = NULL;
+    chunk->owner = owner;
+    chunk->reciprocal = ((static_cast<uint64_t>(1) << 32) + slotSize - 1) / slotSize;
+    chunk->slotSize = slotSize;
+    chunk->sizeClass = sizeClass;
+    chunk->free = NULL;
+    chunk->used = 0;
+    chunk->bumped = 0;
+    chunk->capacity = (ThreadCacheChunkSize - ThreadCacheHeaderSize) / slotSize;
+    chunk->prev = chunk;
+    chunk->next = chunk;
+}
+
+/**
+ * @brief Забрать слоты, освобожденные другими потоками, в список владельца.
+ * @return Количество забранных слотов.
+ */
+inline size_t collectRemote(ThreadCacheChunk *chunk) {
+    if (atomicLoadRelaxed(&chunk->remote) == NULL) {
+        return 0;
+    }
+    void *list = atomicExchange(&chunk->remote, static_cast<void *>(NULL));
+    size_t count = 0;
+    while (list != NULL) {
+        pushSlot(chunk->free, popSlot(list));
+        ++count;
+    }
+    chunk->used -= count;
+    return count;
+}
+
+/**
+ * @brief Выдать слот блока: из свободных, из нетронутых или из освобожденных другими потоками.
+ * @return NULL, если свободных слотов нет.
+ */
+inline void *chunkAllocate(ThreadCacheChunk *chunk) {
+    void *slot = NULL;
+    if (chunk->free != NULL) {
+        slot = popSlot(chunk->free);
+    } else if (chunk->bumped < chunk->capacity) {
+        slot = reinterpret_cast<char *>(chunk) + ThreadCacheHeaderSize +
+                chunk->bumped++ * chunk->slotSize;
+    } else if (collectRemote(chunk) != 0) {
+        slot = popSlot(chunk->free);
+    } else {
+        return NULL;
+    }
+    ++chunk->used;
+    return slot;
+}
+
+/**
+ * @brief Вставить блок в кольцо класса и сделать его текущим.
+ */
+inline void linkChunk(ThreadCache *cache, ThreadCacheChunk *chunk) {
+    ThreadCacheChunk *&current = cache->current[chunk->sizeClass];
+    if (current == NULL) {
+        chunk->prev = chunk;
+        chunk->next = chunk;
+    } else {
+        chunk->prev = current->prev;
+        chunk->next = current;
+        current->prev->next = chunk;
+        current->prev = chunk;
+    }
+    current = chunk;
+}
+
+inline void unlinkChunk(ThreadCache *cache, ThreadCacheChunk *chunk) {
+    ThreadCacheChunk *&current = cache->current[chunk->sizeClass];
+    if (chunk->next == chunk) {
+        current = NULL;
+    } else {
+        chunk->prev->next = chunk->next;
+        chunk->next->prev = chunk->prev;
+        if (current == chunk) {
+            current = chunk->next;
+        }
+    }
+}
+
+/**
+ * @brief Взять блок класса sizeClass: брошенный другим потоком, пустой из пула или новый.
+ */
+inline ThreadCacheChunk *acquireChunk(ThreadCache *cache, size_t sizeClass) {
+    ThreadCacheCentral &central = threadCacheCentral();
+    pthread_mutex_lock(&central.mutex);
+    ThreadCacheChunk *chunk = central.abandoned[sizeClass];
+    if (chunk != NULL) {
+        central.abandoned[sizeClass] = chunk->next;
+        --central.abandonedCount;
+        pthread_mutex_unlock(&central.mutex);
+        // Слоты, освобожденные после ухода владельца, заберет chunkAllocate().
+        atomicStore(&chunk->owner, cache);
+        return chunk;
+    }
+    chunk = central.empty;
+    if (chunk != NULL) {
+        central.empty = chunk->next;
+        --central.emptyCount;
+    }
+    pthread_mutex_unlock(&central.mutex);
+
+    if (chunk == NULL) {
+        void *memory = NULL;
+        if (posix_memalign(&memory, ThreadCacheChunkSize, ThreadCacheChunkSize) != 0) {
+            throw std::bad_alloc();
+        }
+        chunk = static_cast<ThreadCacheChunk *>(memory);
+    }
+    initChunk(chunk, sizeClass, NULL);
+    atomicStore(&chunk->owner, cache);
+    return chunk;
+}
+
+/**
+ * @brief Вернуть пустой блок в центральный пул.
+ */
+inline void releaseChunk(ThreadCacheChunk *chunk) {
+    atomicStore(&chunk->owner, static_cast<ThreadCache *>(NULL));
+    ThreadCacheCentral &central = threadCacheCentral();
+    pthread_mutex_lock(&central.mutex);
+    chunk->next = central.empty;
+    central.empty = chunk;
+    ++central.emptyCount;
+    pthread_mutex_unlock(&central.mutex);
+}
+
+/**
+ * @brief Отдать блок с живыми объектами в пул: его возьмет следующий поток того же класса.
+ */
+inline void abandonChunk(ThreadCacheChunk *chunk) {
+    atomicStore(&chunk->owner, static_cast<ThreadCache *>(NULL));
+    ThreadCacheCentral &central = threadCacheCentral();
+    pthread_mutex_lock(&central.mutex);
+    chunk->next = central.abandoned[chunk->sizeClass];
+    central.abandoned[chunk->sizeClass] = chunk;
+    ++central.abandonedCount;
+    pthread_mutex_unlock(&central.mutex);
+}
+
+/**
+ * @brief Вернуть все блоки кэша в центральный пул и удалить кэш.
+ */
+inline void releaseThreadCache(void *data) {
+    ThreadCache *cache = static_cast<ThreadCache *>(data);
+    for (size_t sizeClass = 0; sizeClass < ThreadCacheClasses; ++sizeClass) {
+        while (cache->current[sizeClass] != NULL) {
+            ThreadCacheChunk *chunk = cache->current[sizeClass];
+            unlinkChunk(cache, chunk);
+            collectRemote(chunk);
+            if (chunk->used == 0) {
+                releaseChunk(chunk);
+            } else {
+                abandonChunk(chunk);
+            }
+        }
+    }
+    delete cache;
+    currentThreadCache() = NULL;
+}
+
+inline pthread_key_t &threadCacheKeyStorage() {
+    static pthread_key_t key;
+    return key;
+}
+
+inline void createThreadCacheKey() {
+    pthread_key_create(&threadCacheKeyStorage(), releaseThreadCache);
+}
+
+/**
+ * @brief Ключ, по которому кэш потока возвращается в пул при завершении потока.
+ */
+inline pthread_key_t threadCacheKey() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createThreadCacheKey);
+    return threadCacheKeyStorage();
+}
+
+inline ThreadCache *acquireThreadCache() {
+    ThreadCache *cache = new ThreadCache();
+    pthread_setspecific(threadCacheKey(), cache);
+    currentThreadCache() = cache;
+    return cache;
+}
+
+/**
+ * @brief Медленный путь выделения: обойти кольцо блоков класса, затем взять новый блок.
+ */
+inline void *threadCacheAllocateSlow(ThreadCache *cache, size_t sizeClass) {
+    ThreadCacheChunk *const first = cache->current[sizeClass];
+    if (first != NULL) {
+        ThreadCacheChunk *chunk = first;
+        do {
+            void *slot = chunkAllocate(chunk);
+            if (slot != NULL) {
+                cache->current[sizeClass] = chunk;
+                return slot;
+            }
+            chunk = chunk->next;
+        } while (chunk != first);
+    }
+
+    ThreadCacheChunk *chunk = acquireChunk(cache, sizeClass);
+    linkChunk(cache, chunk);
+    void *slot = chunkAllocate(chunk);
+    if (slot == NULL) {
+        // Брошенный блок, в котором все слоты еще заняты: взять следующий.
+        return threadCacheAllocateSlow(cache, sizeClass);
+    }
+    return slot;
+}
+
+} // namespace detail
+
+template<class T>
+struct ThreadCacheDeleter;
+
+template<class T>
+struct ThreadCachePolicy;
+
+/**
+ * @brief Аллокатор небольших объектов (до 256 байт) с кэшем в каждом потоке.
+ * @details Память берется блоками по 64 КиБ, каждый блок нарезан на слоты одного класса
+ * размера (шаг 16 байт) и принадлежит одному потоку. Выделение и освобождение в потоке-владельце
+ * не используют ни блокировок, ни атомарных операций: это список свободных слотов блока.
+ * Объект, освобожденный другим потоком, кладется одной атомарной операцией в список remote его
+ * блока, и владелец забирает такой список целиком, когда в блоке кончаются слоты.
+ * Память возвращается в центральный пул блоками: блок, в котором не осталось объектов,
+ * отдается в пул сразу, а блоки завершившегося потока - при его завершении (блоки с живыми
+ * объектами переходят к следующему потоку, которому нужен тот же класс размера).
+ * Блоки не возвращаются системе. Все функции статические: аллокатор один на процесс.
+ */
+class ThreadCacheAllocator {
+public:
+    //! Наибольший размер объекта.
+    static const size_t MaxSize = detail::ThreadCacheMaxSize;
+    //! Гарантированное выравнивание объектов.
+    static const size_t Alignment = detail::ThreadCacheGranularity;
+
+    /**
+     * @brief Выделить память под объект размером не больше MaxSize.
+     * @throw std::bad_alloc, если система не выделила новый блок.
+     */
+    static void *allocate(size_t size);
+
+    /**
+     * @brief Вернуть память объекта. Может вызываться из любого потока.
+     * @param ptr Указатель на начало объекта или на любой его подобъект.
+     */
+    static void deallocate(const void *ptr);
+
+    /**
+     * @brief Создать объект в памяти текущего потока.
+     * @details Аргументы передаются по константной ссылке (C++03). Если конструктор бросает
+     * исключение, память возвращается в кэш потока.
+     * @return Объект класса RvalueUniquePtr с функтором ThreadCacheDeleter.
+     */
+    template<class T>
+    static RvalueUniquePtr<T, ThreadCacheDeleter<T> > make();
+
+#define MEM_THREAD_CACHE_MAKE_DECLARATION(n) \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    static RvalueUniquePtr<T, ThreadCacheDeleter<T> > make( \
+            MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM));
+
+    MEM_THREAD_CACHE_MAKE_DECLARATION(1)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(2)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(3)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(4)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(5)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(6)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(7)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(8)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(9)
+    MEM_THREAD_CACHE_MAKE_DECLARATION(10)
+
+#undef MEM_THREAD_CACHE_MAKE_DECLARATION
+
+    /**
+     * @brief Вернуть блоки текущего потока в центральный пул, как при его завершении.
+     * @details Для пулов потоков, которые переключаются между нагрузками. Следующее выделение
+     * в этом потоке создаст новый кэш.
+     */
+    static void releaseCurrentThread();
+
+    /**
+     * @brief Количество пустых блоков в центральном пуле.
+     */
+    static size_t centralChunks();
+
+    /**
+     * @brief Количество блоков завершившихся потоков, в которых остались живые объекты.
+     */
+    static size_t abandonedChunks();
+
+private:
+    ThreadCacheAllocator();
+};
+
+/**
+ * @brief Класс-функтор, возвращающий объект в ThreadCacheAllocator.
+ * @details Не хранит состояния. Размер объекта берется из заголовка блока, поэтому функтор
+ * для базового типа корректно освобождает объект производного типа.
+ * @tparam T Тип объекта.
+ */
+template<class T>
+struct ThreadCacheDeleter {
+    ThreadCacheDeleter() {}
+
+    /**
+     * @brief Конструктор от функтора для производного типа.
+     */
+    template<class U>
+    ThreadCacheDeleter(const ThreadCacheDeleter<U> &) {}
+
+    void operator()(T *ptr) {
+        ptr->~T();
+        ThreadCacheAllocator::deallocate(ptr);
+    }
+};
+
+/**
+ * @brief Политика выделения памяти для makeUniqueWith (см. make_unique.h).
+ * @details makeUniqueWith<T>(policy, a1, ..., aN) с этой политикой равносилен
+ * ThreadCacheAllocator::make<T>(a1, ..., aN). Тип T проверяется на этапе компиляции: размер не
+ * больше MaxSize, выравнивание не больше Alignment.
+ * @tparam T Тип объекта.
+ */
+template<class T>
+struct ThreadCachePolicy {
+    typedef ThreadCacheDeleter<T> Deleter;
+
+    void *allocate() {
+        typedef char SizeFits[sizeof(T) <= ThreadCacheAllocator::MaxSize ? 1 : -1];
+        typedef char AlignmentFits[
+                detail::AlignOf<T>::value <= ThreadCacheAllocator::Alignment ? 1 : -1];
+        (void) sizeof(SizeFits);
+        (void) sizeof(AlignmentFits);
+        return ThreadCacheAllocator::allocate(sizeof(T));
+    }
+
+    void deallocate(void *memory) {
+        ThreadCacheAllocator::deallocate(memory);
+    }
+
+    Deleter deleter() const {
+        return Deleter();
+    }
+};
+
+/**
+    class ThreadCacheAllocator
+ **/
+inline void *ThreadCacheAllocator::allocate(size_t size) {
+    assert(size <= MaxSize);
+    const size_t sizeClass = size == 0 ? 0 : (size - 1) / detail::ThreadCacheGranularity;
+
+    detail::ThreadCache *cache = detail::currentThreadCache();
+    if (cache == NULL) {
+        cache = detail::acquireThreadCache();
+    }
+    detail::ThreadCacheChunk *chunk = cache->current[sizeClass];
+    if (chunk != NULL && chunk->free != NULL) {
+        ++chunk->used;
+        return detail::popSlot(chunk->free);
+    }
+    return detail::threadCacheAllocateSlow(cache, sizeClass);
+}
+
+inline void ThreadCacheAllocator::deallocate(const void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    detail::ThreadCacheChunk *chunk = detail::chunkOf(ptr);
+    void *slot = detail::slotOf(chunk, ptr);
+
+    // Владелец меняется только самим владельцем, поэтому совпадение с кэшем потока надежно;
+    // в остальных случаях слот уходит в remote, который переживает смену владельца.
+    detail::ThreadCache *cache = detail::currentThreadCache();
+    if (cache != NULL && detail::atomicLoadRelaxed(&chunk->owner) == cache) {
+        detail::pushSlot(chunk->free, slot);
+        if (--chunk->used == 0 && cache->current[chunk->sizeClass] != chunk) {
+            detail::unlinkChunk(cache, chunk);
+            detail::releaseChunk(chunk);
+        }
+        return;
+    }
+
+    void *head = detail::atomicLoadRelaxed(&chunk->remote);
+    do {
+        *static_cast<void **>(slot) = head;
+    } while (!detail::atomicCompareExchange(&chunk->remote, head, slot));
+}
+
+template<class T>
+RvalueUniquePtr<T, ThreadCacheDeleter<T> > ThreadCacheAllocator::make() {
+    ThreadCachePolicy<T> policy;
+    return makeUniqueWith<T>(policy);
+}
+
+#define MEM_THREAD_CACHE_MAKE_DEFINITION(n) \
+    template<class T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    RvalueUniquePtr<T, ThreadCacheDeleter<T> > ThreadCacheAllocator::make( \
+            MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        ThreadCachePolicy<T> policy; \
+        return makeUniqueWith<T>(policy, MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+    }
+
+MEM_THREAD_CACHE_MAKE_DEFINITION(1)
+MEM_THREAD_CACHE_MAKE_DEFINITION(2)
+MEM_THREAD_CACHE_MAKE_DEFINITION(3)
+MEM_THREAD_CACHE_MAKE_DEFINITION(4)
+MEM_THREAD_CACHE_MAKE_DEFINITION(5)
+MEM_THREAD_CACHE_MAKE_DEFINITION(6)
+MEM_THREAD_CACHE_MAKE_DEFINITION(7)
+MEM_THREAD_CACHE_MAKE_DEFINITION(8)
+MEM_THREAD_CACHE_MAKE_DEFINITION(9)
+MEM_THREAD_CACHE_MAKE_DEFINITION(10)
+
+#undef MEM_THREAD_CACHE_MAKE_DEFINITION
+
+inline void ThreadCacheAllocator::releaseCurrentThread() {
+    detail::ThreadCache *cache = detail::currentThreadCache();
+    if (cache != NULL) {
+        pthread_setspecific(detail::threadCacheKey(), NULL);
+        detail::releaseThreadCache(cache);
+    }
+}
+
+inline size_t ThreadCacheAllocator::centralChunks() {
+    detail::ThreadCacheCentral &central = detail::threadCacheCentral();
+    pthread_mutex_lock(&central.mutex);
+    const size_t count = central.emptyCount;
+    pthread_mutex_unlock(&central.mutex);
+    return count;
+}
+
+inline size_t ThreadCacheAllocator::abandonedChunks() {
+    detail::ThreadCacheCentral &central = detail::threadCacheCentral();
+    pthread_mutex_lock(&central.mutex);
+    const size_t count = central.abandonedCount;
+    pthread_mutex_unlock(&central.mutex);
+    return count;
+}
+
+} // namespace mem
@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include <pthread.h>
+
+#include "benchmark.h"
+#include "thread_cache.h"
+#include "unique_ptr.h"
+
+/**
+ * Масштабирование mem::ThreadCacheAllocator и glibc malloc с числом потоков (1, 2, 4, ...).
+ * Объекты трех размеров (32, 96 и 224 байта) создаются пакетами в UniquePtr на базовый тип.
+ * "local": поток создает пакет и сам его освобождает. "remote": потоки создают пакеты, затем
+ * каждый освобождает пакет соседа, так что все освобождения идут из чужого потока.
+ * Память выделяется в потоках мимо operator new, поэтому счетчики benchmark.h не используются.
+ * Аргументы: число объектов на поток и максимальное число потоков.
+ */
+
+namespace {
+
+struct Object {
+    explicit Object(size_t id): id(id) {}
+
+    virtual ~Object() {}
+
+    size_t id;
+};
+
+template<size_t Size>
+struct Sized : public Object {
+    explicit Sized(size_t id): Object(id) {
+        payload[0] = static_cast<char>(id);
+    }
+
+    char payload[Size - sizeof(Object)];
+};
+
+template<class T>
+struct MallocDeleter {
+    MallocDeleter() {}
+
+    template<class U>
+    MallocDeleter(const MallocDeleter<U> &) {}
+
+    void operator()(T *ptr) {
+        ptr->~T();
+        std::free(ptr);
+    }
+};
+
+struct MallocBackend {
+    typedef mem::UniquePtr<Object, MallocDeleter<Object> > Pointer;
+
+    template<class T>
+    static Pointer::RvalueUniquePtr make(size_t id) {
+        void *memory = std::malloc(sizeof(T));
+        if (memory == NULL) {
+            throw std::bad_alloc();
+        }
+        return Pointer(new (memory) T(id)).move();
+    }
+};
+
+struct ThreadCacheBackend {
+    typedef mem::UniquePtr<Object, mem::ThreadCacheDeleter<Object> > Pointer;
+
+    template<class T>
+    static Pointer::RvalueUniquePtr make(size_t id) {
+        return mem::ThreadCacheAllocator::make<T>(id);
+    }
+};
+
+const size_t BatchSize = 64;
+
+template<class Backend>
+struct Context {
+    typedef std::vector<typename Backend::Pointer::RvalueUniquePtr> Batch;
+
+    pthread_barrier_t *round;
+    Batch *batches;
+    size_t nextThread;
+    size_t threads;
+    size_t items;
+    bool remote;
+};
+
+template<class Backend>
+void fill(typename Context<Backend>::Batch &batch, size_t round) {
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const size_t id = round * BatchSize + i;
+        switch (i % 3) {
+        case 0:
+            batch[i] = Backend::template make<Sized<32> >(id);
+            break;
+        case 1:
+            batch[i] = Backend::template make<Sized<96> >(id);
+            break;
+        default:
+            batch[i] = Backend::template make<Sized<224> >(id);
+            break;
+        }
+    }
+}
+
+template<class Backend>
+void clear(typename Context<Backend>::Batch &batch) {
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i] = typename Backend::Pointer().move();
+    }
+}
+
+template<class Backend>
+void *work(void *data) {
+    Context<Backend> *context = static_cast<Context<Backend> *>(data);
+    const size_t thread = mem::detail::atomicFetchAdd(&context->nextThread, size_t(1));
+    typename Context<Backend>::Batch &own = context->batches[thread];
+    typename Context<Backend>::Batch &neighbour =
+            context->batches[(thread + 1) % context->threads];
+
+    pthread_barrier_wait(context->round);
+    for (size_t round = 0; round < context->items / BatchSize; ++round) {
+        fill<Backend>(own, round);
+        if (context->remote) {
+            pthread_barrier_wait(context->round);
+            clear<Backend>(neighbour);
+            pthread_barrier_wait(context->round);
+        } else {
+            clear<Backend>(own);
+        }
+    }
+    return NULL;
+}
+
+template<class Backend>
+void runThreads(const char *name, size_t items, size_t threads, bool remote) {
+    pthread_barrier_t round;
+    pthread_barrier_init(&round, NULL, static_cast<unsigned>(threads + 1));
+
+    typename Context<Backend>::Batch empty(BatchSize, typename Backend::Pointer().move());
+    std::vector<typename Context<Backend>::Batch> batches(threads, empty);
+    Context<Backend> context = {&round, &batches[0], 0, threads, items, remote};
+
+    // Главный поток участвует в барьерах раундов, чтобы рабочие потоки не ждали лишнего.
+    std::vector<pthread_t> handles(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        pthread_create(&handles[i], NULL, work<Backend>, &context);
+    }
+    pthread_barrier_wait(&round);
+    const double begin = bench::nowNs();
+    if (remote) {
+        for (size_t i = 0; i < 2 * (items / BatchSize); ++i) {
+            pthread_barrier_wait(&round);
+        }
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        pthread_join(handles[i], NULL);
+    }
+    const double elapsed = bench::nowNs() - begin;
+    pthread_barrier_destroy(&round);
+
+    const double perThread = static_cast<double>(items / BatchSize * BatchSize);
+    std::printf("%-44s %10lu %12.2f %12.2f\n", name, static_cast<unsigned long>(threads),
+                elapsed / perThread, perThread * static_cast<double>(threads) / elapsed * 1e3);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t items = bench::iterationsFromArgs(argc, argv, 200000);
+    size_t maxThreads = 32;
+    if (argc > 2 && std::atol(argv[2]) > 0) {
+        maxThreads = static_cast<size_t>(std::atol(argv[2]));
+    }
+
+    std::printf("%-44s %10s %12s %12s\n", "benchmark", "threads", "ns/object", "Mobjects/s");
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        runThreads<MallocBackend>("local glibc malloc", items, threads, false);
+        runThreads<ThreadCacheBackend>("local mem::ThreadCacheAllocator", items, threads, false);
+    }
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        runThreads<MallocBackend>("remote glibc malloc", items, threads, true);
+        runThreads<ThreadCacheBackend>("remote mem::ThreadCacheAllocator", items, threads, true);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include "unique_ptr.h"
+
+/**
+ * Доступ к объекту через UniquePtr с политикой UncheckedAccess. Файл компилируется с -O2 дважды:
+ * как есть и с UNCHECKED_ACCESS_RAW_POINTER, когда FooHandle - сырой указатель. Тест
+ * unchecked_access_test сравнивает дизассемблер двух объектных файлов: он должен совпадать.
+ * Функции объявлены extern "C", чтобы имена символов не зависели от типа FooHandle.
+ */
+
+struct Foo {
+    int value;
+    Foo *next;
+};
+
+#ifdef UNCHECKED_ACCESS_RAW_POINTER
+typedef Foo *FooHandle;
+#else
+typedef mem::UniquePtr<Foo, mem::Deleter<Foo>, mem::UncheckedAccess> FooHandle;
+#endif
+
+extern "C" int uncheckedArrow(const FooHandle &ptr) {
+    return ptr->value;
+}
+
+extern "C" int uncheckedDereference(const FooHandle &ptr) {
+    return (*ptr).value;
+}
+
+extern "C" void uncheckedStore(FooHandle &ptr, int value) {
+    ptr->value = value;
+}
+
+extern "C" Foo *uncheckedChain(const FooHandle &ptr) {
+    return ptr->next->next;
+}
+
+extern "C" int uncheckedSum(const FooHandle *first, const FooHandle *last) {
+    int sum = 0;
+    for (; first != last; ++first) {
+        sum += (*first)->value;
+    }
+    return sum;
+}
@@ -1,85 +1,354 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <stdexcept>
+
+#include "observer_ptr.h"
+
+#ifdef MEM_INSTRUMENTATION
+#include "instrumentation.h"
+
+//! Учесть событие владения объектом типа T в счетчиках (см. instrumentation.h).
+#define MEM_COUNT_OWNERSHIP(T, event, ptr) \
+    ::mem::instrumentation::record<T>(::mem::instrumentation::event, ptr)
+//! Учесть передачу владения от указателя на U указателю на T.
+#define MEM_COUNT_CONVERSION(U, T, ptr) ::mem::instrumentation::recordConversion<U, T>(ptr)
+#else
+#define MEM_COUNT_OWNERSHIP(T, event, ptr) ((void) 0)
+#define MEM_COUNT_CONVERSION(U, T, ptr) ((void) 0)
+#endif
+
+#ifdef MEM_OWNERSHIP_TRACE
+#include "ownership_trace.h"
+
+//! Записать событие владения в журнал потока (см. ownership_trace.h).
+#define MEM_TRACE_OWNERSHIP(event, ptr, source, destination) \
+    ::mem::traceOwnership(::mem::instrumentation::event, ptr, source, destination)
+#else
+#define MEM_TRACE_OWNERSHIP(event, ptr, source, destination) ((void) 0)
+#endif
+
+/**
+ * Точки учета владения: ptr - объект хранения, source и destination - адреса указателей,
+ * отдающего и получающего владение (NULL, если такого нет). Без MEM_INSTRUMENTATION и
+ * MEM_OWNERSHIP_TRACE раскрываются в пустоту.
+ */
+#if defined(MEM_INSTRUMENTATION) || defined(MEM_OWNERSHIP_TRACE)
+#define MEM_INSTRUMENT(T, event, ptr, source, destination) \
+    (MEM_COUNT_OWNERSHIP(T, event, ptr), MEM_TRACE_OWNERSHIP(event, ptr, source, destination))
+#define MEM_INSTRUMENT_CONVERT(U, T, ptr, source, destination) \
+    (MEM_COUNT_CONVERSION(U, T, ptr), MEM_TRACE_OWNERSHIP(Convert, ptr, source, destination))
+#else
+#define MEM_INSTRUMENT(T, event, ptr, source, destination)
+#define MEM_INSTRUMENT_CONVERT(U, T, ptr, source, destination)
+#endif
 
 namespace mem {
 
+namespace detail {
+
+/**
+ * @brief Метафункция, проверяющая, является ли тип классом.
+ * @details Нужна для выбора способа хранения функтора очистки данных в PtrStorage.
+ * @tparam T Проверяемый тип.
+ */
+template<class T>
+class IsClass {
+    template<class C>
+    static char test(int C::*);
+
+    template<class C>
+    static long test(...);
+
+public:
+    static const bool value = sizeof(test<T>(0)) == sizeof(char);
+};
+
+/**
+ * @brief Хранилище указателя на объект и функтора для его очистки.
+ * @details Если функтор является классом, хранилище наследуется от него, поэтому функтор без
+ * состояния не занимает памяти (empty base optimization) и sizeof(PtrStorage) == sizeof(T *).
+ * Функтор с состоянием хранится так же и занимает ровно столько, сколько его состояние.
+ * @tparam T Тип объекта хранения.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class T, class D, bool = IsClass<D>::value>
+class PtrStorage : private D {
+public:
+    PtrStorage(T *ptr, const D &deleter):
+    D(deleter),
+    ptr_(ptr) {
+    }
+
+    T *&ptr() {
+        return ptr_;
+    }
+
+    T *ptr() const {
+        return ptr_;
+    }
+
+    D &deleter() {
+        return *this;
+    }
+
+    const D &deleter() const {
+        return *this;
+    }
+
+private:
+    T *ptr_; //!< Указатель на экземпляр объекта хранения.
+};
+
+/**
+ * @brief Хранилище указателя на объект и функтора, не являющегося классом (указателя на функцию).
+ */
+template<class T, class D>
+class PtrStorage<T, D, false> {
+public:
+    PtrStorage(T *ptr, const D &deleter):
+    deleter_(deleter),
+    ptr_(ptr) {
+    }
+
+    T *&ptr() {
+        return ptr_;
+    }
+
+    T *ptr() const {
+        return ptr_;
+    }
+
+    D &deleter() {
+        return deleter_;
+    }
+
+    const D &deleter() const {
+        return deleter_;
+    }
+
+private:
+    D deleter_; //!< Функтор для освобождения данных.
+    T *ptr_; //!< Указатель на экземпляр объекта хранения.
+};
+
+/**
+ * @brief Фабрика, создающая RvalueUniquePtr напрямую от указателя (см. make_unique.h).
+ */
+struct UniqueFactory;
+
+/**
+ * @brief Доступ алгоритмов mem::algo к указателю внутри умного указателя (см. ptr_algorithm.h).
+ */
+struct UniqueAccess;
+
+} // namespace detail
+
 /**
  * @brief Класс-функтор для очистки данных.
  * @tparam T Тип очищаемых данных.
  */
 template<class T>
 struct Deleter {
+    Deleter() {}
+
+    /**
+     * @brief Конструктор от функтора для производного типа (Deleter<Derived> -> Deleter<Base>).
+     */
+    template<class U>
+    Deleter(const Deleter<U> &) {}
+
     void operator()(T *ptr) {
         delete ptr;
     }
 };
 
+/**
+ * @brief Признак функтора очистки, который сам принимает NULL (как delete или std::free).
+ * @details Для таких функторов деструкторы UniquePtr и RvalueUniquePtr вызывают функтор без
+ * проверки указателя на NULL. Специализируется для своих функторов.
+ * @tparam D Тип функтора для очистки данных.
+ */
+template<class D>
+struct DeleterAcceptsNull {
+    static const bool value = false;
+};
+
+template<class T>
+struct DeleterAcceptsNull<Deleter<T> > {
+    static const bool value = true;
+};
+
+/**
+ * @brief Исключение политики ThrowingAccess: разыменование пустого UniquePtr.
+ */
+class NullAccessError : public std::logic_error {
+public:
+    NullAccessError():
+    std::logic_error("mem::UniquePtr: access through a null pointer") {
+    }
+};
+
+/**
+ * @brief Политика проверки доступа: assert в operator* и operator->, без проверки с NDEBUG.
+ */
+struct AssertAccess {
+    template<class T>
+    static void check(const T *ptr) {
+        assert(ptr != NULL);
+        (void) ptr;
+    }
+};
+
+/**
+ * @brief Политика проверки доступа: NullAccessError при разыменовании пустого указателя в любой
+ * сборке.
+ */
+struct ThrowingAccess {
+    template<class T>
+    static void check(const T *ptr) {
+        if (ptr == NULL) {
+            throw NullAccessError();
+        }
+    }
+};
+
+/**
+ * @brief Политика без проверок: operator* и operator-> компилируются в то же, что и доступ через
+ * сырой указатель (см. unchecked_access_test.cpp).
+ * @details Политика по умолчанию не переключается для отдельной единицы трансляции: класс с членом
+ * UniquePtr<T> или inline-функция из общего заголовка получили бы разные определения под одним
+ * именем (нарушение ODR без диагностики). Горячий путь называет UniquePtr<T, D, UncheckedAccess>
+ * явно, владение с UniquePtr<T, D> передается через общий RvalueUniquePtr<T, D>.
+ */
+struct UncheckedAccess {
+    template<class T>
+    static void check(const T *) {}
+};
+
+template<class T, class D, class C>
+class UniquePtr;
+
+/**
+ * @brief Класс реализующий сущность rvalue объекта уникального умного указателя.
+ * @details Данный объект нельзя разыменовать или/и обратиться к его внутренним членам.
+ * Его единственная задача быть сконструированным от другого умного уникального указателя,
+ * передавая управление другому. Если этого не произойдет и вызовется его деструктор он просто
+ * затрет данные которые он хранит. Обычно используется через псевдоним
+ * UniquePtr<T, D>::RvalueUniquePtr.
+ * @tparam T Тип объекта, который хранит умный указатель
+ * @tparam D Тип функтора для очистки данных
+ */
+template<class T, class D = Deleter<T> >
+class RvalueUniquePtr {
+public:
+    //! Псевдоним для типа объекта хранения.
+    typedef T ValueType;
+    //! Псевдоним для типа функтора очистки данных.
+    typedef D Deleter;
+
+    /**
+     * @brief Копирующий конструктор класса.
+     * @param other Ссылка на другой объект класса RvalueUniquePtr.
+     */
+    RvalueUniquePtr(const RvalueUniquePtr &other);
+
+    /**
+     * @brief Конструктор от rvalue объекта умного указателя на производный тип.
+     * @details Указатель U * неявно приводится к T *, поэтому для несвязанных типов конструктор
+     * не компилируется. Функтор D конструируется от функтора E.
+     * @param other Ссылка на rvalue объект умного указателя на производный тип.
+     */
+    template<class U, class E>
+    RvalueUniquePtr(const RvalueUniquePtr<U, E> &other);
+
+    /**
+     * @brief Деструктор для класса для очистки ресурсов.
+     */
+    ~RvalueUniquePtr();
+
+    /**
+     * @brief Оператор копирования класса.
+     * @param other Ссылка на другой объект класса RvalueUniquePtr.
+     * @return Возвращает ссылку на объект, сконструированный от переданного объекта.
+     */
+    RvalueUniquePtr &operator=(const RvalueUniquePtr &other);
+
+    /**
+     * @brief Метод для отказа от владения объектом хранения без его освобождения.
+     * @return Указатель на объект хранения.
+     */
+    ValueType *release();
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения.
+     * @details Владение остается у RvalueUniquePtr, функтор очистки данных не вызывается.
+     * @return Наблюдатель за объектом хранения.
+     */
+    ObserverPtr<ValueType> borrow() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения только для чтения.
+     * @return Наблюдатель за константным объектом хранения.
+     */
+    ObserverPtr<const ValueType> borrowConst() const;
+
+    /**
+     * @brief Получить функтор для освобождения данных, переходящий вместе с владением.
+     * @details Нужен владельцам, которые забирают объект через release() (например,
+     * AtomicUniquePtr), чтобы не потерять состояние функтора.
+     * @return Константная ссылка на функтор.
+     */
+    const Deleter &getDeleter() const;
+
+private:
+    //! Делаем все классы UniquePtr и RvalueUniquePtr друзьями этого класса.
+    template<class U, class E, class F>
+    friend class UniquePtr;
+
+    template<class U, class E>
+    friend class RvalueUniquePtr;
+
+    friend struct detail::UniqueFactory;
+
+    friend struct detail::UniqueAccess;
+
+    /**
+     * @brief Приватный конструктор класса.
+     * @param ptr Указатель на созданный объект хранения.
+     * @param deleter Функтор для освобождения данных, переходящий вместе с владением.
+     */
+    RvalueUniquePtr(ValueType *ptr, const Deleter &deleter);
+
+    /**
+     * @brief Метод для зануления указателя на экземпляр объекта хранения.
+     */
+    void freeData() const;
+
+    //! Указатель на экземпляр объекта хранения и функтор для освобождения данных.
+    mutable detail::PtrStorage<ValueType, Deleter> storage_;
+};
+
 /**
  * @brief Класс реализующий сущность уникального умного указателя
  * @tparam T Тип объекта, который будет хранить умный указатель
- * @tparam N Размер пула объектов
+ * @tparam D Тип функтора для очистки данных (например, PoolDeleter для объектов из ObjectPool)
+ * @tparam C Политика проверки доступа в operator* и operator-> (AssertAccess, ThrowingAccess,
+ * UncheckedAccess). На хранение и передачу владения не влияет.
  */
-template<class T, class D = Deleter<T> >
+template<class T, class D = Deleter<T>, class C = AssertAccess>
 class UniquePtr {
 public:
     //! Псевдоним для типа объекта от которого будет сконструирован умный указатель.
     typedef T ValueType;
-    //! Псевдоним для типа пула объектов, размера N.
+    //! Псевдоним для типа функтора очистки данных.
     typedef D Deleter;
+    //! Псевдоним для типа политики проверки доступа.
+    typedef C AccessPolicy;
 
-    /**
-     * @brief Внутренний класс умного указателя реализующий сущность rvalue объекта.
-     * @details Данный объект нельзя разыменовать или/и обратиться к его внутренним членам.
-     * Его единственная задача быть сконструированным от другого умного уникального указателя,
-     * передавая управление другому. Если этого не произойдет и вызовется его деструктор он просто
-     * затрет данные которые он хранит.
-     */
-    class RvalueUniquePtr {
-    public:
-        /**
-         * @brief Копирующий конструктор класса.
-         * @param other Ссылка на другой объект класса RvalueUniquePtr.
-         */
-        RvalueUniquePtr(const RvalueUniquePtr &other);
-
-        /**
-         * @brief Деструктор для класса для очистки ресурсов.
-         */
-        ~RvalueUniquePtr();
-
-        /**
-         * @brief Оператор копирования класса.
-         * @param other Ссылка на другой объект класса RvalueUniquePtr.
-         * @return Возвращает ссылку на объект, сконструированный от переданного объекта.
-         */
-        RvalueUniquePtr &operator=(const RvalueUniquePtr &other);
-
-        /**
-         *
-         * @return
-         */
-        ValueType *release();
-
-    private:
-        //! Делаем класс UniquePtr другом этого класса.
-        friend class UniquePtr<ValueType>;
-
-        /**
-         * @brief Приватный конструктор класса.
-         * @param poolObj Указатель на экземпляр пула объектов.
-         * @param ptr Указатель на созданный объект хранения.
-         */
-        RvalueUniquePtr(ValueType *ptr);
-
-        /**
-         * @brief Метод для зануления указателя на экземпляр объекта хранения.
-         */
-        void freeData() const;
-
-        mutable ValueType *data_; //!< Указатель на экземпляр объекта хранения.
-        Deleter deleter_; //!< Функтор для освобождения данных
-    };
+    //! Псевдоним для типа rvalue объекта этого умного указателя.
+    typedef mem::RvalueUniquePtr<T, D> RvalueUniquePtr;
 
     /**
      * @brief Конструктор по умолчанию. Инициализирует членены класса NULL.
@@ -87,19 +356,35 @@ public:
     UniquePtr();
 
     /**
-     * @brief Конструктор класса, принимающий указатели на экземпляры пула объектов и объекта
-     * хранения.
-     * @param poolObj Указатель на экземпляр пула объектов.
+     * @brief Конструктор класса, принимающий указатель на экземпляр объекта хранения.
      * @param ptr Указатель на экземпляр объекта хранения.
      */
     UniquePtr(ValueType *ptr);
 
+    /**
+     * @brief Конструктор класса, принимающий указатель на экземпляр объекта хранения и функтор
+     * для его освобождения.
+     * @details Используется для функторов с состоянием (например, PoolDeleter).
+     * @param ptr Указатель на экземпляр объекта хранения.
+     * @param deleter Функтор для освобождения данных.
+     */
+    UniquePtr(ValueType *ptr, const Deleter &deleter);
+
     /**
      * @brief Конструктор класса от ссылки на объект RvalueUniquePtr.
      * @param rvalue Ссылка на экземпляр класса RvalueUniquePtr.
      */
     explicit UniquePtr(const RvalueUniquePtr &rvalue);
 
+    /**
+     * @brief Конструктор класса от rvalue объекта умного указателя на производный тип.
+     * @details Преобразование UniquePtr<Derived> в UniquePtr<Base> без release() и повторной
+     * обертки. Для несвязанных типов не компилируется.
+     * @param rvalue Ссылка на экземпляр класса RvalueUniquePtr<U, E>.
+     */
+    template<class U, class E>
+    explicit UniquePtr(const mem::RvalueUniquePtr<U, E> &rvalue);
+
     /**
      * @brief Копирующий оператор класса от ссылки на экземпляр класса RvalueUniquePtr.
      * @param rvalue Ссылка на экземпляр класса RvalueUniquePtr.
@@ -107,6 +392,14 @@ public:
      */
     UniquePtr &operator=(const RvalueUniquePtr &rvalue);
 
+    /**
+     * @brief Оператор копирования от rvalue объекта умного указателя на производный тип.
+     * @param rvalue Ссылка на экземпляр класса RvalueUniquePtr<U, E>.
+     * @return Ссылку на этот объект.
+     */
+    template<class U, class E>
+    UniquePtr &operator=(const mem::RvalueUniquePtr<U, E> &rvalue);
+
     /**
      * @brief Деструктор класса для очистки ресурсов.
      */
@@ -119,8 +412,18 @@ public:
      */
     RvalueUniquePtr move();
 
+    /**
+     * @brief Метод для отказа от владения объектом хранения без его освобождения.
+     * @return Указатель на объект хранения.
+     */
     ValueType *release();
 
+    /**
+     * @brief Получить функтор для освобождения данных.
+     * @return Ссылка на функтор.
+     */
+    Deleter &getDeleter();
+
     /**
      * @brief Оператор разыменования.
      * @details Подразумевает, что UniquePtr не перемещен(moved).
@@ -159,154 +462,252 @@ public:
      */
     ValueType *get() const;
 
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения.
+     * @details В отличие от move(), владение остается у UniquePtr.
+     * @return Наблюдатель за объектом хранения.
+     */
+    ObserverPtr<ValueType> borrow() const;
+
+    /**
+     * @brief Получить невладеющий доступ к объекту хранения только для чтения.
+     * @return Наблюдатель за константным объектом хранения.
+     */
+    ObserverPtr<const ValueType> borrowConst() const;
+
 private:
     /**
      * @brief Приватный конструктор копирования.
      * @param other Ссылка на другой экземпляр класса UniquePtr.
      */
-    UniquePtr(const UniquePtr<ValueType> &other);
+    UniquePtr(const UniquePtr &other);
 
     /**
      * @brief Приватный оператор копирования.
      * @param other Ссылка на другой экземпляр класса UniquePtr.
      * @return Ссылку на новый объект класса UniquePtr, сконструированного от переданного экземпляра.
      */
-    UniquePtr<ValueType> &operator=(const UniquePtr<ValueType> &other);
+    UniquePtr &operator=(const UniquePtr &other);
 
     /**
      * @brief Метод для зануления указателя на экземпляр объекта хранения.
      */
     void freeData() const;
 
-    mutable ValueType *data_; //!< Указатель на экземпляр объекта хранения.
-    Deleter deleter_; //!< Функтор для освобождения данных
+    friend struct detail::UniqueAccess;
+
+    //! Указатель на экземпляр объекта хранения и функтор для освобождения данных.
+    mutable detail::PtrStorage<ValueType, Deleter> storage_;
 };
 
+/**
+    template<class T, class D>
+    class RvalueUniquePtr
+ **/
+template<class T, class D>
+RvalueUniquePtr<T, D>::RvalueUniquePtr(ValueType *ptr, const Deleter &deleter):
+storage_(ptr, deleter) {
+}
+
 template<class T, class D>
-UniquePtr<T, D>::RvalueUniquePtr::RvalueUniquePtr(ValueType *ptr):
-data_(ptr),
-deleter_() {
+RvalueUniquePtr<T, D>::RvalueUniquePtr(const RvalueUniquePtr &other):
+storage_(other.storage_) {
+    MEM_INSTRUMENT(ValueType, Transfer, storage_.ptr(), &other, this);
+    other.freeData();
 }
 
 template<class T, class D>
-UniquePtr<T, D>::RvalueUniquePtr::RvalueUniquePtr(const RvalueUniquePtr &other):
-data_(other.data_),
-deleter_() {
+template<class U, class E>
+RvalueUniquePtr<T, D>::RvalueUniquePtr(const RvalueUniquePtr<U, E> &other):
+storage_(other.storage_.ptr(), Deleter(other.storage_.deleter())) {
+    MEM_INSTRUMENT_CONVERT(U, ValueType, storage_.ptr(), &other, this);
     other.freeData();
 }
 
 template<class T, class D>
-UniquePtr<T, D>::RvalueUniquePtr::~RvalueUniquePtr() {
-    if (data_ != NULL) {
-        deleter_(data_);
+RvalueUniquePtr<T, D>::~RvalueUniquePtr() {
+    if (DeleterAcceptsNull<Deleter>::value || storage_.ptr() != NULL) {
+        MEM_INSTRUMENT(ValueType, Delete, storage_.ptr(), this, NULL);
+        storage_.deleter()(storage_.ptr());
     }
 }
 
 template<class T, class D>
-typename UniquePtr<T, D>::ValueType *UniquePtr<T, D>::RvalueUniquePtr::release() {
-    ValueType *ptr = data_;
-    data_ = NULL;
+typename RvalueUniquePtr<T, D>::ValueType *RvalueUniquePtr<T, D>::release() {
+    ValueType *ptr = storage_.ptr();
+    MEM_INSTRUMENT(ValueType, Release, ptr, this, NULL);
+    storage_.ptr() = NULL;
     return ptr;
 }
 
 template<class T, class D>
-typename UniquePtr<T, D>::RvalueUniquePtr
-        &UniquePtr<T, D>::RvalueUniquePtr::operator=(const RvalueUniquePtr &other) {
-    data_ = other.data_;
+RvalueUniquePtr<T, D> &RvalueUniquePtr<T, D>::operator=(const RvalueUniquePtr &other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (storage_.ptr() != NULL) {
+        MEM_INSTRUMENT(ValueType, Delete, storage_.ptr(), this, NULL);
+        storage_.deleter()(storage_.ptr());
+    }
+    storage_ = other.storage_;
+    MEM_INSTRUMENT(ValueType, Transfer, storage_.ptr(), &other, this);
     other.freeData();
 
     return *this;
 }
 
 template<class T, class D>
-void UniquePtr<T, D>::RvalueUniquePtr::freeData() const {
-    data_ = NULL;
+ObserverPtr<typename RvalueUniquePtr<T, D>::ValueType> RvalueUniquePtr<T, D>::borrow() const {
+    return ObserverPtr<ValueType>(storage_.ptr());
 }
 
 template<class T, class D>
-UniquePtr<T, D>::UniquePtr():
-data_(NULL),
-deleter_() {
+ObserverPtr<const typename RvalueUniquePtr<T, D>::ValueType>
+        RvalueUniquePtr<T, D>::borrowConst() const {
+    return ObserverPtr<const ValueType>(storage_.ptr());
 }
 
 template<class T, class D>
-UniquePtr<T, D>::UniquePtr(ValueType *ptr):
-data_(ptr),
-deleter_() {
+const typename RvalueUniquePtr<T, D>::Deleter &RvalueUniquePtr<T, D>::getDeleter() const {
+    return storage_.deleter();
 }
 
 template<class T, class D>
-UniquePtr<T, D>::UniquePtr(const RvalueUniquePtr &rvalue):
-data_(rvalue.data_){
+void RvalueUniquePtr<T, D>::freeData() const {
+    storage_.ptr() = NULL;
+}
+
+/**
+    template<class T, class D, class C>
+    class UniquePtr
+ **/
+template<class T, class D, class C>
+UniquePtr<T, D, C>::UniquePtr():
+storage_(NULL, Deleter()) {
+}
+
+template<class T, class D, class C>
+UniquePtr<T, D, C>::UniquePtr(ValueType *ptr):
+storage_(ptr, Deleter()) {
+    MEM_INSTRUMENT(ValueType, Construct, ptr, NULL, this);
+}
+
+template<class T, class D, class C>
+UniquePtr<T, D, C>::UniquePtr(ValueType *ptr, const Deleter &deleter):
+storage_(ptr, deleter) {
+    MEM_INSTRUMENT(ValueType, Construct, ptr, NULL, this);
+}
+
+template<class T, class D, class C>
+UniquePtr<T, D, C>::UniquePtr(const RvalueUniquePtr &rvalue):
+storage_(rvalue.storage_) {
+    MEM_INSTRUMENT(ValueType, Transfer, storage_.ptr(), &rvalue, this);
     rvalue.freeData();
 }
 
-template<class T, class D>
-UniquePtr<T, D> &UniquePtr<T, D>::operator=(const RvalueUniquePtr &rvalue) {
-    data_ = rvalue.data_;
+template<class T, class D, class C>
+template<class U, class E>
+UniquePtr<T, D, C>::UniquePtr(const mem::RvalueUniquePtr<U, E> &rvalue):
+storage_(rvalue.storage_.ptr(), Deleter(rvalue.storage_.deleter())) {
+    MEM_INSTRUMENT_CONVERT(U, ValueType, storage_.ptr(), &rvalue, this);
+    rvalue.freeData();
+}
+
+template<class T, class D, class C>
+UniquePtr<T, D, C> &UniquePtr<T, D, C>::operator=(const RvalueUniquePtr &rvalue) {
+    if (storage_.ptr() != NULL && storage_.ptr() != rvalue.storage_.ptr()) {
+        MEM_INSTRUMENT(ValueType, Delete, storage_.ptr(), this, NULL);
+        storage_.deleter()(storage_.ptr());
+    }
+    storage_ = rvalue.storage_;
+    MEM_INSTRUMENT(ValueType, Transfer, storage_.ptr(), &rvalue, this);
     rvalue.freeData();
 
     return *this;
 }
 
-template<class T, class D>
-UniquePtr<T, D>::~UniquePtr() {
-    if (data_ != NULL) {
-        deleter_(data_);
+template<class T, class D, class C>
+template<class U, class E>
+UniquePtr<T, D, C> &UniquePtr<T, D, C>::operator=(const mem::RvalueUniquePtr<U, E> &rvalue) {
+    return *this = RvalueUniquePtr(rvalue);
+}
+
+template<class T, class D, class C>
+UniquePtr<T, D, C>::~UniquePtr() {
+    if (DeleterAcceptsNull<Deleter>::value || storage_.ptr() != NULL) {
+        MEM_INSTRUMENT(ValueType, Delete, storage_.ptr(), this, NULL);
+        storage_.deleter()(storage_.ptr());
     }
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::RvalueUniquePtr UniquePtr<T, D>::move() {
-    RvalueUniquePtr rvalue(data_);
-    data_ = NULL;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::RvalueUniquePtr UniquePtr<T, D, C>::move() {
+    RvalueUniquePtr rvalue(storage_.ptr(), storage_.deleter());
+    MEM_INSTRUMENT(ValueType, Move, storage_.ptr(), this, &rvalue);
+    storage_.ptr() = NULL;
     return rvalue;
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType *UniquePtr<T, D>::release() {
-    ValueType *ptr = data_;
-    data_ = NULL;
-    return data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType *UniquePtr<T, D, C>::release() {
+    ValueType *ptr = storage_.ptr();
+    MEM_INSTRUMENT(ValueType, Release, ptr, this, NULL);
+    storage_.ptr() = NULL;
+    return ptr;
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType &UniquePtr<T, D>::operator*() {
-    assert(data_ != NULL);
-    return *data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::Deleter &UniquePtr<T, D, C>::getDeleter() {
+    return storage_.deleter();
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType& UniquePtr<T, D>::operator*() const {
-    assert(data_ != NULL);
-    return *data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType &UniquePtr<T, D, C>::operator*() {
+    AccessPolicy::check(storage_.ptr());
+    return *storage_.ptr();
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType* UniquePtr<T, D>::operator->() {
-    assert(data_ != NULL);
-    return data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType& UniquePtr<T, D, C>::operator*() const {
+    AccessPolicy::check(storage_.ptr());
+    return *storage_.ptr();
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType* UniquePtr<T, D>::operator->() const {
-    assert(data_ != NULL);
-    return data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType* UniquePtr<T, D, C>::operator->() {
+    AccessPolicy::check(storage_.ptr());
+    return storage_.ptr();
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType *UniquePtr<T, D>::get() {
-    return data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType* UniquePtr<T, D, C>::operator->() const {
+    AccessPolicy::check(storage_.ptr());
+    return storage_.ptr();
 }
 
-template<class T, class D>
-typename UniquePtr<T, D>::ValueType *UniquePtr<T, D>::get() const {
-    return data_;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType *UniquePtr<T, D, C>::get() {
+    return storage_.ptr();
 }
 
-template<class T, class D>
-void UniquePtr<T, D>::freeData() const {
-    data_ = NULL;
+template<class T, class D, class C>
+typename UniquePtr<T, D, C>::ValueType *UniquePtr<T, D, C>::get() const {
+    return storage_.ptr();
+}
+
+template<class T, class D, class C>
+ObserverPtr<typename UniquePtr<T, D, C>::ValueType> UniquePtr<T, D, C>::borrow() const {
+    return ObserverPtr<ValueType>(storage_.ptr());
+}
+
+template<class T, class D, class C>
+ObserverPtr<const typename UniquePtr<T, D, C>::ValueType> UniquePtr<T, D, C>::borrowConst() const {
+    return ObserverPtr<const ValueType>(storage_.ptr());
+}
+
+template<class T, class D, class C>
+void UniquePtr<T, D, C>::freeData() const {
+    storage_.ptr() = NULL;
 }
 
 } // namespace mem
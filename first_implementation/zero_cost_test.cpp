@@ -0,0 +1,143 @@
+#include <cstddef>
+#include <new>
+
+#ifndef ZERO_COST_RAW_POINTER
+#include "instrumentation.h"
+#include "ownership_event.h"
+#include "ownership_trace.h"
+#include "unique_ptr.h"
+#include "make_unique.h"
+#endif
+
+/**
+ * Все операции, в которых стоят точки учета MEM_INSTRUMENT, и их эквиваленты на сырых указателях,
+ * написанные вручную без точек учета. Файл компилируется с -O2 -DNDEBUG -fno-exceptions дважды:
+ * как есть и с ZERO_COST_RAW_POINTER. Тест zero_cost_test сравнивает дизассемблер двух объектных
+ * файлов: без MEM_INSTRUMENTATION и MEM_OWNERSHIP_TRACE он должен совпадать, поэтому точка учета,
+ * которая оставляет после себя хотя бы одну инструкцию, ломает тест. Исключения выключены, потому
+ * что в C++03 деструкторы UniquePtr не noexcept и их площадки очистки отличали бы код независимо
+ * от точек учета. Заголовки журнала и счетчиков подключаются только в первый вариант: само их
+ * подключение тоже не должно порождать код. Ядра объявлены extern "C", RvalueUniquePtr не выходит
+ * за их пределы (см. codegen_test.cpp).
+ */
+
+struct Base {
+    int value;
+};
+
+struct Derived : Base {};
+
+#ifdef ZERO_COST_RAW_POINTER
+typedef Base *BaseHandle;
+typedef Base *BaseRvalue;
+typedef Derived *DerivedHandle;
+
+template<class T>
+T *moveOut(T *&ptr) {
+    T *result = ptr;
+    ptr = NULL;
+    return result;
+}
+
+template<class T>
+void assign(T *&target, T *ptr) {
+    if (target != NULL && target != ptr) {
+        delete target;
+    }
+    target = ptr;
+}
+
+/**
+ * Порядок проверок подобран так, чтобы компилятор расставил их как в UniquePtr::operator= от
+ * RvalueUniquePtr<U, E>: на результат он не влияет.
+ */
+template<class T, class U>
+void assign(T *&target, U *ptr) {
+    T *converted = ptr;
+    if (target != converted && target != NULL) {
+        delete target;
+    }
+    target = converted;
+}
+
+template<class T>
+T *releaseOf(T *&ptr) {
+    return moveOut(ptr);
+}
+
+template<class T>
+void dispose(T *&ptr) {
+    delete ptr;
+}
+
+inline Base *makeBase() {
+    return new Base();
+}
+#else
+typedef mem::UniquePtr<Base> BaseHandle;
+typedef BaseHandle::RvalueUniquePtr BaseRvalue;
+typedef mem::UniquePtr<Derived> DerivedHandle;
+
+template<class T>
+typename mem::UniquePtr<T>::RvalueUniquePtr moveOut(mem::UniquePtr<T> &ptr) {
+    return ptr.move();
+}
+
+template<class T, class U, class E>
+void assign(mem::UniquePtr<T> &target, const mem::RvalueUniquePtr<U, E> &rvalue) {
+    target = rvalue;
+}
+
+template<class P>
+typename P::ValueType *releaseOf(P &ptr) {
+    return ptr.release();
+}
+
+template<class T, class D>
+void dispose(mem::RvalueUniquePtr<T, D> &rvalue) {
+    mem::UniquePtr<T, D> ptr(rvalue);
+}
+
+inline BaseRvalue makeBase() {
+    return mem::makeUnique<Base>();
+}
+#endif
+
+extern "C" void zeroCostMake(BaseHandle &target, int value) {
+    BaseHandle ptr(new Base());
+    ptr->value = value;
+    assign(target, moveOut(ptr));
+}
+
+extern "C" void zeroCostMakeUnique(BaseHandle &target) {
+    assign(target, makeBase());
+}
+
+extern "C" int zeroCostTransfer(BaseHandle &target, BaseHandle &source) {
+    BaseHandle local(moveOut(source));
+    assign(target, moveOut(local));
+    return target->value;
+}
+
+extern "C" void zeroCostConvert(BaseHandle &target, DerivedHandle &source) {
+    BaseHandle converted(moveOut(source));
+    assign(target, moveOut(converted));
+}
+
+extern "C" void zeroCostAssignDerived(BaseHandle &target, DerivedHandle &source) {
+    assign(target, moveOut(source));
+}
+
+extern "C" Base *zeroCostRelease(BaseHandle &ptr) {
+    return releaseOf(ptr);
+}
+
+extern "C" Base *zeroCostReleaseRvalue(BaseHandle &ptr) {
+    BaseRvalue rvalue(moveOut(ptr));
+    return releaseOf(rvalue);
+}
+
+extern "C" void zeroCostDestroy(BaseHandle &ptr) {
+    BaseRvalue rvalue(moveOut(ptr));
+    dispose(rvalue);
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "preprocessor.h"
+
+namespace mem {
+
+// Returns the object to a standard C++03 allocator: destroy(), then deallocate() of one element.
+// The allocator is a private base, so a stateless one (std::allocator) takes no space and
+// UniquePtr<T, AllocatorDeleter<A> > stays pointer-sized. There is no conversion to the deleter
+// of a base type: the allocator of the base would deallocate a block of the wrong size
+template<typename A>
+struct AllocatorDeleter : private A {
+    typedef A Allocator;
+    typedef typename A::value_type ValueType;
+
+    AllocatorDeleter();
+    explicit AllocatorDeleter(const Allocator &allocator);
+
+    void operator()(void *ptr);
+
+    Allocator &allocator();
+    const Allocator &allocator() const;
+};
+
+namespace detail {
+
+template<typename T, typename A>
+struct AllocatorRebind {
+    typedef typename A::template rebind<T>::other Allocator;
+    typedef AllocatorDeleter<Allocator> Deleter;
+    typedef typename UniquePtr<T, Deleter>::RvalueType RvalueType;
+};
+
+// Memory for one object from an allocator; given back unless the object built in it is adopted
+template<typename A>
+struct AllocatorSlot {
+    explicit AllocatorSlot(const A &allocator);
+    ~AllocatorSlot();
+
+    template<typename T>
+    typename UniquePtr<T, AllocatorDeleter<A> >::RvalueType adopt(T *object);
+
+    A allocator;
+    typename A::pointer data;
+
+private:
+    AllocatorSlot(const AllocatorSlot &);
+    AllocatorSlot &operator=(const AllocatorSlot &);
+};
+
+} // namespace detail
+
+// allocateUnique<T>(allocator, a1, ..., aN): takes memory for one T from a copy of allocator
+// rebound to T and constructs T in it with placement new (construct() of a C++03 allocator can only
+// copy). If the constructor throws, the memory goes back to the allocator. Arguments are forwarded
+// by const reference (C++03)
+#define MEM_ALLOCATE_UNIQUE(n) \
+    template<typename T, typename A, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    typename detail::AllocatorRebind<T, A>::RvalueType allocateUnique( \
+            const A &allocator, MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        typedef typename detail::AllocatorRebind<T, A>::Allocator Allocator; \
+        detail::AllocatorSlot<Allocator> slot((Allocator(allocator))); \
+        return slot.adopt(new (slot.data) T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT))); \
+    }
+
+template<typename T, typename A>
+typename detail::AllocatorRebind<T, A>::RvalueType allocateUnique(const A &allocator) {
+    typedef typename detail::AllocatorRebind<T, A>::Allocator Allocator;
+    detail::AllocatorSlot<Allocator> slot((Allocator(allocator)));
+    return slot.adopt(new (slot.data) T());
+}
+
+MEM_ALLOCATE_UNIQUE(1)
+MEM_ALLOCATE_UNIQUE(2)
+MEM_ALLOCATE_UNIQUE(3)
+MEM_ALLOCATE_UNIQUE(4)
+MEM_ALLOCATE_UNIQUE(5)
+MEM_ALLOCATE_UNIQUE(6)
+MEM_ALLOCATE_UNIQUE(7)
+MEM_ALLOCATE_UNIQUE(8)
+MEM_ALLOCATE_UNIQUE(9)
+MEM_ALLOCATE_UNIQUE(10)
+
+#undef MEM_ALLOCATE_UNIQUE
+
+/**
+    template<typename A>
+    struct AllocatorDeleter
+ **/
+template<typename A>
+AllocatorDeleter<A>::AllocatorDeleter():
+A() {
+}
+
+template<typename A>
+AllocatorDeleter<A>::AllocatorDeleter(const Allocator &allocator):
+A(allocator) {
+}
+
+template<typename A>
+void AllocatorDeleter<A>::operator()(void *ptr) {
+    typename A::pointer object = static_cast<ValueType *>(ptr);
+    Allocator::destroy(object);
+    Allocator::deallocate(object, 1);
+}
+
+template<typename A>
+typename AllocatorDeleter<A>::Allocator &AllocatorDeleter<A>::allocator() {
+    return *this;
+}
+
+template<typename A>
+const typename AllocatorDeleter<A>::Allocator &AllocatorDeleter<A>::allocator() const {
+    return *this;
+}
+
+/**
+    template<typename A>
+    struct detail::AllocatorSlot
+ **/
+template<typename A>
+detail::AllocatorSlot<A>::AllocatorSlot(const A &allocator):
+allocator(allocator),
+data(this->allocator.allocate(1)) {
+}
+
+template<typename A>
+detail::AllocatorSlot<A>::~AllocatorSlot() {
+    if (data != NULL) {
+        allocator.deallocate(data, 1);
+    }
+}
+
+template<typename A>
+template<typename T>
+typename UniquePtr<T, AllocatorDeleter<A> >::RvalueType
+        detail::AllocatorSlot<A>::adopt(T *object) {
+    data = NULL;
+    return UniquePtr<T, AllocatorDeleter<A> >(object, AllocatorDeleter<A>(allocator)).move();
+}
+
+} // namespace mem
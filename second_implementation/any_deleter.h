@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+template<bool>
+struct AnyDeleterStateFits;
+
+template<>
+struct AnyDeleterStateFits<true> {};
+
+} // namespace detail
+
+// Carries any cleanup strategy in a single deleter type: a function pointer plus up to N bytes of
+// inline state (an fd, a pool pointer, an arena handle), without allocating. Handles with different
+// strategies share one UniquePtr<T, AnyDeleter> type, and destruction is one indirect call.
+// UniquePtr<T, AnyDeleter> stores detail::TypedAnyDeleter<T, N>, so its RvalueType still names T:
+// converting between handles of unrelated types does not compile. The function receives the
+// stored T * as is, so a handle that already uses AnyDeleter cannot be converted to another type
+// either (that does not compile); converting a typed handle, UniquePtr<U>::RvalueType, to
+// UniquePtr<T, AnyDeleter> casts back to U before deleting and works for any base T of U.
+template<std::size_t N = 2 * sizeof(void *)>
+struct BasicAnyDeleter {
+    typedef void ValueType;
+    typedef void (*DestroyFunction)(void *data, void *state);
+
+    BasicAnyDeleter();
+
+    // Calls functor(static_cast<T *>(data)). The functor is copied bytewise and never destroyed,
+    // so it must be trivially copyable and trivially destructible. The handle must store a T *:
+    // pass the deleter to UniquePtr<T, AnyDeleter> or to a base of T at the same address
+    template<typename T, typename F>
+    static BasicAnyDeleter of(const F &functor);
+
+    void operator()(void *ptr);
+
+protected:
+    explicit BasicAnyDeleter(DestroyFunction destroy);
+
+private:
+    template<typename T, typename F>
+    static void invoke(void *data, void *state);
+
+    DestroyFunction destroy_;
+    union {
+        char bytes[N];
+        void *pointer;
+        double number;
+        long integer;
+    } state_;
+};
+
+typedef BasicAnyDeleter<> AnyDeleter;
+
+namespace detail {
+
+// The deleter of UniquePtr<T, BasicAnyDeleter<N> >: the same state, with ValueType T
+template<typename T, std::size_t N>
+struct TypedAnyDeleter : public BasicAnyDeleter<N> {
+    typedef T ValueType;
+
+    TypedAnyDeleter() {}
+
+    TypedAnyDeleter(const BasicAnyDeleter<N> &deleter): BasicAnyDeleter<N>(deleter) {}
+
+    // Adopts handles created with the default deleter, e.g. makeUnique<U>() for a U derived from T
+    template<typename U>
+    TypedAnyDeleter(const Deleter<U> &): BasicAnyDeleter<N>(&deleteObject<U>) {}
+
+private:
+    // Rejects conversions between AnyDeleter handles of different types: the stored function
+    // expects the address of a U
+    template<typename U>
+    TypedAnyDeleter(const TypedAnyDeleter<U, N> &);
+
+    template<typename U>
+    static void deleteObject(void *data, void *) {
+        delete static_cast<U *>(static_cast<T *>(data));
+    }
+};
+
+template<typename T, std::size_t N>
+struct HandleDeleter<T, BasicAnyDeleter<N> > {
+    typedef TypedAnyDeleter<T, N> Type;
+};
+
+} // namespace detail
+
+template<std::size_t N>
+BasicAnyDeleter<N>::BasicAnyDeleter():
+destroy_(NULL) {
+}
+
+template<std::size_t N>
+BasicAnyDeleter<N>::BasicAnyDeleter(DestroyFunction destroy):
+destroy_(destroy) {
+}
+
+template<std::size_t N>
+template<typename T, typename F>
+BasicAnyDeleter<N> BasicAnyDeleter<N>::of(const F &functor) {
+    (void) sizeof(detail::AnyDeleterStateFits<(sizeof(F) <= N)>);
+
+    BasicAnyDeleter deleter;
+    deleter.destroy_ = &invoke<T, F>;
+    new (deleter.state_.bytes) F(functor);
+    return deleter;
+}
+
+template<std::size_t N>
+void BasicAnyDeleter<N>::operator()(void *ptr) {
+    assert(destroy_ != NULL);
+    destroy_(ptr, state_.bytes);
+}
+
+template<std::size_t N>
+template<typename T, typename F>
+void BasicAnyDeleter<N>::invoke(void *data, void *state) {
+    (*static_cast<F *>(state))(static_cast<T *>(data));
+}
+
+} // namespace mem
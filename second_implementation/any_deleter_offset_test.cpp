@@ -0,0 +1,51 @@
+#include <cassert>
+#include <cstddef>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "any_deleter.h"
+
+// Converting a typed handle to UniquePtr<T, AnyDeleter> must delete the object through its own
+// type, whatever the offset of the base T: the deleter casts the stored T * back to Derived *.
+// The types are not polymorphic, so a deleter that got the address wrong could not be rescued by a
+// virtual destructor.
+
+const void *destroyed = NULL;
+
+struct First {
+    int first;
+};
+
+struct Second {
+    int second;
+};
+
+struct Derived : First, Second {
+    ~Derived() {
+        destroyed = this;
+    }
+};
+
+template<typename T>
+void convertAndDestroy() {
+    const void *address = NULL;
+    {
+        mem::UniquePtr<Derived> derived(mem::makeUnique<Derived>());
+        Derived *raw = derived.get();
+        address = raw;
+
+        mem::UniquePtr<T, mem::AnyDeleter> converted(derived.move());
+        assert(converted.get() == static_cast<T *>(raw));
+    }
+    assert(destroyed == address);
+}
+
+int main() {
+    // First is the primary base, at the address of the object
+    convertAndDestroy<First>();
+
+    // Second is at a nonzero offset: the deleter must undo it
+    convertAndDestroy<Second>();
+
+    return 0;
+}
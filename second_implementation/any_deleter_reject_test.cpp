@@ -0,0 +1,26 @@
+#include <string>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "any_deleter.h"
+
+// Must not compile: UniquePtr<T, AnyDeleter> keeps T in its RvalueType, so a handle cannot take
+// ownership from the rvalue of an unrelated type (ANY_DELETER_REJECT_UNRELATED) or from another
+// AnyDeleter handle of a different type (ANY_DELETER_REJECT_BASE)
+
+struct Foo {
+    virtual ~Foo() {}
+};
+
+struct Bar : Foo {};
+
+int main() {
+#if defined(ANY_DELETER_REJECT_UNRELATED)
+    mem::UniquePtr<std::string, mem::AnyDeleter> str(mem::makeUnique<std::string>());
+    mem::UniquePtr<Foo, mem::AnyDeleter> foo(str.move());
+#elif defined(ANY_DELETER_REJECT_BASE)
+    mem::UniquePtr<Bar, mem::AnyDeleter> bar(mem::makeUnique<Bar>());
+    mem::UniquePtr<Foo, mem::AnyDeleter> foo(bar.move());
+#endif
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "benchmark.h"
+#include "unique_ptr.h"
+
+/**
+ * Микробенчмарки mem::UniquePtr (реализация через UniquePtr<void, D>) против сырого указателя,
+ * std::auto_ptr и, в сборке C++11, std::unique_ptr. Число итераций задается первым аргументом.
+ */
+
+#if __cplusplus < 201703L
+#define BENCH_HAS_AUTO_PTR 1
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+#if __cplusplus >= 201103L
+#define BENCH_HAS_STD_UNIQUE_PTR 1
+#include <utility>
+#endif
+
+namespace {
+
+struct Foo {
+    Foo(size_t id = 0): id_(id) {}
+
+    size_t id() const {
+        return id_;
+    }
+
+private:
+    size_t id_;
+};
+
+typedef mem::UniquePtr<Foo> FooPtr;
+typedef FooPtr::RvalueType RvalueFooPtr;
+
+/**
+    Construct / destroy
+ **/
+struct RawConstructDestroy {
+    void operator()(size_t n) const {
+        for (size_t i = 0; i < n; ++i) {
+            Foo *p = new Foo(i);
+            bench::doNotOptimize(p);
+            delete p;
+        }
+    }
+};
+
+struct MemConstructDestroy {
+    void operator()(size_t n) const {
+        for (size_t i = 0; i < n; ++i) {
+            FooPtr p(new Foo(i));
+            bench::doNotOptimize(p);
+        }
+    }
+};
+
+#ifdef BENCH_HAS_AUTO_PTR
+struct AutoConstructDestroy {
+    void operator()(size_t n) const {
+        for (size_t i = 0; i < n; ++i) {
+            std::auto_ptr<Foo> p(new Foo(i));
+            bench::doNotOptimize(p);
+        }
+    }
+};
+#endif
+
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+struct StdConstructDestroy {
+    void operator()(size_t n) const {
+        for (size_t i = 0; i < n; ++i) {
+            std::unique_ptr<Foo> p(new Foo(i));
+            bench::doNotOptimize(p);
+        }
+    }
+};
+#endif
+
+/**
+    move() round-trip: ownership goes to a second handle and comes back
+ **/
+struct RawMoveRoundTrip {
+    void operator()(size_t n) const {
+        Foo *p = new Foo(1);
+        for (size_t i = 0; i < n; ++i) {
+            Foo *q = p;
+            p = NULL;
+            bench::doNotOptimize(q);
+            p = q;
+            bench::clobberMemory();
+        }
+        delete p;
+    }
+};
+
+struct MemMoveRoundTrip {
+    void operator()(size_t n) const {
+        RvalueFooPtr p(FooPtr(new Foo(1)).move());
+        for (size_t i = 0; i < n; ++i) {
+            FooPtr q(p);
+            bench::doNotOptimize(q);
+            p = q.move();
+            bench::clobberMemory();
+        }
+    }
+};
+
+#ifdef BENCH_HAS_AUTO_PTR
+struct AutoMoveRoundTrip {
+    void operator()(size_t n) const {
+        std::auto_ptr<Foo> p(new Foo(1));
+        for (size_t i = 0; i < n; ++i) {
+            std::auto_ptr<Foo> q(p);
+            bench::doNotOptimize(q);
+            p = q;
+            bench::clobberMemory();
+        }
+    }
+};
+#endif
+
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+struct StdMoveRoundTrip {
+    void operator()(size_t n) const {
+        std::unique_ptr<Foo> p(new Foo(1));
+        for (size_t i = 0; i < n; ++i) {
+            std::unique_ptr<Foo> q(std::move(p));
+            bench::doNotOptimize(q);
+            p = std::move(q);
+            bench::clobberMemory();
+        }
+    }
+};
+#endif
+
+/**
+    push_back into std::vector (reserved), std::list and std::map, then destroy the container
+ **/
+struct RawVectorPushBack {
+    void operator()(size_t n) const {
+        std::vector<Foo *> data;
+        data.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            data.push_back(new Foo(i));
+        }
+        for (size_t i = 0; i < data.size(); ++i) {
+            delete data[i];
+        }
+    }
+};
+
+struct MemVectorPushBack {
+    void operator()(size_t n) const {
+        std::vector<RvalueFooPtr> data;
+        data.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            FooPtr p(new Foo(i));
+            data.push_back(p.move());
+        }
+    }
+};
+
+struct RawListPushBack {
+    void operator()(size_t n) const {
+        std::list<Foo *> data;
+        for (size_t i = 0; i < n; ++i) {
+            data.push_back(new Foo(i));
+        }
+        for (std::list<Foo *>::iterator it = data.begin(); it != data.end(); ++it) {
+            delete *it;
+        }
+    }
+};
+
+struct MemListPushBack {
+    void operator()(size_t n) const {
+        std::list<RvalueFooPtr> data;
+        for (size_t i = 0; i < n; ++i) {
+            FooPtr p(new Foo(i));
+            data.push_back(p.move());
+        }
+    }
+};
+
+struct RawMapInsert {
+    void operator()(size_t n) const {
+        std::map<size_t, Foo *> data;
+        for (size_t i = 0; i < n; ++i) {
+            data.insert(std::pair<size_t, Foo *>(i, new Foo(i)));
+        }
+        for (std::map<size_t, Foo *>::iterator it = data.begin(); it != data.end(); ++it) {
+            delete it->second;
+        }
+    }
+};
+
+struct MemMapInsert {
+    void operator()(size_t n) const {
+        std::map<size_t, RvalueFooPtr> data;
+        for (size_t i = 0; i < n; ++i) {
+            FooPtr p(new Foo(i));
+            data.insert(std::pair<size_t, RvalueFooPtr>(i, p.move()));
+        }
+    }
+};
+
+/**
+    Dereference in a tight loop
+ **/
+struct RawDereference {
+    void operator()(size_t n) const {
+        Foo *p = new Foo(3);
+        size_t sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(p);
+            sum += p->id();
+        }
+        bench::doNotOptimize(sum);
+        delete p;
+    }
+};
+
+struct MemDereference {
+    void operator()(size_t n) const {
+        FooPtr p(new Foo(3));
+        size_t sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(p);
+            sum += p->id();
+        }
+        bench::doNotOptimize(sum);
+    }
+};
+
+#ifdef BENCH_HAS_AUTO_PTR
+struct AutoDereference {
+    void operator()(size_t n) const {
+        std::auto_ptr<Foo> p(new Foo(3));
+        size_t sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(p);
+            sum += p->id();
+        }
+        bench::doNotOptimize(sum);
+    }
+};
+#endif
+
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+struct StdDereference {
+    void operator()(size_t n) const {
+        std::unique_ptr<Foo> p(new Foo(3));
+        size_t sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bench::doNotOptimize(p);
+            sum += p->id();
+        }
+        bench::doNotOptimize(sum);
+    }
+};
+#endif
+
+/**
+    Vector growth: push_back without reserve, every reallocation relocates the handles
+ **/
+struct RawVectorGrowth {
+    void operator()(size_t n) const {
+        std::vector<Foo *> data;
+        for (size_t i = 0; i < n; ++i) {
+            data.push_back(new Foo(i));
+        }
+        for (size_t i = 0; i < data.size(); ++i) {
+            delete data[i];
+        }
+    }
+};
+
+struct MemVectorGrowth {
+    void operator()(size_t n) const {
+        std::vector<RvalueFooPtr> data;
+        for (size_t i = 0; i < n; ++i) {
+            FooPtr p(new Foo(i));
+            data.push_back(p.move());
+        }
+    }
+};
+
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+struct StdVectorGrowth {
+    void operator()(size_t n) const {
+        std::vector<std::unique_ptr<Foo> > data;
+        for (size_t i = 0; i < n; ++i) {
+            data.push_back(std::unique_ptr<Foo>(new Foo(i)));
+        }
+    }
+};
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t n = bench::iterationsFromArgs(argc, argv, 1000000);
+
+    std::printf("iterations: %lu\n", static_cast<unsigned long>(n));
+    std::printf("sizeof(Foo *) = %lu, sizeof(mem::UniquePtr<Foo>) = %lu, "
+                "sizeof(RvalueType) = %lu\n\n",
+                static_cast<unsigned long>(sizeof(Foo *)),
+                static_cast<unsigned long>(sizeof(FooPtr)),
+                static_cast<unsigned long>(sizeof(RvalueFooPtr)));
+    bench::printHeader();
+
+    bench::run("construct/destroy raw", n, RawConstructDestroy());
+    bench::run("construct/destroy mem::UniquePtr", n, MemConstructDestroy());
+#ifdef BENCH_HAS_AUTO_PTR
+    bench::run("construct/destroy std::auto_ptr", n, AutoConstructDestroy());
+#endif
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+    bench::run("construct/destroy std::unique_ptr", n, StdConstructDestroy());
+#endif
+
+    bench::run("move round-trip raw", n, RawMoveRoundTrip());
+    bench::run("move round-trip mem::UniquePtr", n, MemMoveRoundTrip());
+#ifdef BENCH_HAS_AUTO_PTR
+    bench::run("move round-trip std::auto_ptr", n, AutoMoveRoundTrip());
+#endif
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+    bench::run("move round-trip std::unique_ptr", n, StdMoveRoundTrip());
+#endif
+
+    bench::run("vector push_back raw", n, RawVectorPushBack());
+    bench::run("vector push_back mem::UniquePtr", n, MemVectorPushBack());
+    bench::run("list push_back raw", n, RawListPushBack());
+    bench::run("list push_back mem::UniquePtr", n, MemListPushBack());
+    bench::run("map insert raw", n, RawMapInsert());
+    bench::run("map insert mem::UniquePtr", n, MemMapInsert());
+
+    bench::run("dereference raw", n, RawDereference());
+    bench::run("dereference mem::UniquePtr", n, MemDereference());
+#ifdef BENCH_HAS_AUTO_PTR
+    bench::run("dereference std::auto_ptr", n, AutoDereference());
+#endif
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+    bench::run("dereference std::unique_ptr", n, StdDereference());
+#endif
+
+    bench::run("vector growth raw", n, RawVectorGrowth());
+    bench::run("vector growth mem::UniquePtr", n, MemVectorGrowth());
+#ifdef BENCH_HAS_STD_UNIQUE_PTR
+    bench::run("vector growth std::unique_ptr", n, StdVectorGrowth());
+#endif
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include <string>
+
+#include "unique_ptr.h"
+
+// Must not compile: an rvalue lends its object only as the stored type or one of its bases, not as
+// an unrelated type.
+
+struct Widget {
+    virtual ~Widget() {}
+};
+
+int main() {
+    mem::UniquePtr<Widget>::RvalueType rvalue(mem::UniquePtr<Widget>(new Widget()).move());
+    rvalue.borrow<std::string>();
+    return 0;
+}
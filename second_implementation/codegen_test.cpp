@@ -0,0 +1,110 @@
+#include <new>
+
+#include "unique_ptr.h"
+
+// Hot UniquePtr operations next to their raw pointer equivalents. The file is compiled with -O2
+// -DNDEBUG twice: as is and with CODEGEN_RAW_POINTER, where FooHandle is a plain pointer and the
+// operations are spelled out by hand. codegen_test requires the disassembly of both objects to
+// match, so an extra instruction, call or vtable load in any kernel fails it. Kernels are
+// extern "C" so that symbol names do not depend on FooHandle. The rvalue never leaves a kernel:
+// by value it is passed in memory, not in a register like T *
+
+struct Foo {
+    int value;
+};
+
+struct Base {
+    virtual ~Base() {}
+    int value;
+};
+
+#ifdef CODEGEN_RAW_POINTER
+typedef Foo *FooHandle;
+typedef Foo *FooRvalue;
+typedef Base *BaseHandle;
+
+template<typename T>
+T *moveOut(T *&ptr) {
+    T *result = ptr;
+    ptr = NULL;
+    return result;
+}
+
+template<typename T>
+T *getOf(T *ptr) {
+    return ptr;
+}
+
+template<typename T>
+T *releaseOf(T *&ptr) {
+    return moveOut(ptr);
+}
+
+template<typename T>
+void destroy(T *&ptr) {
+    delete ptr;
+}
+#else
+typedef mem::UniquePtr<Foo> FooHandle;
+typedef FooHandle::RvalueType FooRvalue;
+typedef mem::UniquePtr<Base> BaseHandle;
+
+template<typename T>
+typename mem::UniquePtr<T>::RvalueType moveOut(mem::UniquePtr<T> &ptr) {
+    return ptr.move();
+}
+
+template<typename T>
+T *getOf(mem::UniquePtr<T> &ptr) {
+    return ptr.get();
+}
+
+template<typename T>
+T *releaseOf(mem::UniquePtr<T> &ptr) {
+    return ptr.release();
+}
+
+template<typename T>
+void destroy(mem::UniquePtr<T> &ptr) {
+    ptr.~UniquePtr();
+}
+#endif
+
+extern "C" Foo *codegenGet(FooHandle &ptr) {
+    return getOf(ptr);
+}
+
+extern "C" int codegenArrow(FooHandle &ptr) {
+    return ptr->value;
+}
+
+extern "C" int codegenDereference(FooHandle &ptr) {
+    return (*ptr).value;
+}
+
+extern "C" void codegenStore(FooHandle &ptr, int value) {
+    ptr->value = value;
+}
+
+extern "C" Foo *codegenRelease(FooHandle &ptr) {
+    return releaseOf(ptr);
+}
+
+extern "C" int codegenMoveRoundTrip(FooHandle &ptr) {
+    FooRvalue rvalue(moveOut(ptr));
+    FooHandle local(rvalue);
+    ptr = moveOut(local);
+    return ptr->value;
+}
+
+extern "C" void codegenMoveInto(void *memory, FooHandle &source) {
+    new (memory) FooHandle(moveOut(source));
+}
+
+extern "C" void codegenDestroy(FooHandle &ptr) {
+    destroy(ptr);
+}
+
+extern "C" void codegenDestroyPolymorphic(BaseHandle &ptr) {
+    destroy(ptr);
+}
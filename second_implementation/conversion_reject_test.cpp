@@ -0,0 +1,17 @@
+#include "unique_ptr.h"
+
+// Must not compile: UniquePtr<Foo> cannot take ownership from the rvalue of an unrelated type.
+
+struct Foo {
+    virtual ~Foo() {}
+};
+
+struct Bar {
+    virtual ~Bar() {}
+};
+
+int main() {
+    mem::UniquePtr<Bar> bar(new Bar());
+    mem::UniquePtr<Foo> foo(bar.move());
+    return 0;
+}
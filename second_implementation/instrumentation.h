@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "ownership_event.h"
+
+// Per-type ownership counters. They are wired into UniquePtr and makeUnique() only when the whole
+// program is built with -DMEM_INSTRUMENTATION; otherwise the hooks in unique_ptr.h expand to nothing
+// and the generated code is the same as without them (checked by zero_cost_test).
+// Event counts go to a per-thread block without synchronization and are summed up by snapshot().
+// Live and peak counts are shared, since an object may be created and freed on different threads.
+
+#ifndef MEM_INSTRUMENTATION_MAX_TYPES
+// Types beyond this limit are counted together under "<other>"
+#define MEM_INSTRUMENTATION_MAX_TYPES 256
+#endif
+
+namespace mem {
+
+namespace instrumentation {
+
+struct TypeCounters {
+    std::string type;
+    std::size_t events[EventCount];
+    long live;
+    long peak;
+};
+
+// Null pointers are not counted
+template<typename T>
+void record(Event event, const void *data);
+
+template<typename U, typename T>
+void recordConversion(const void *data);
+
+inline std::vector<TypeCounters> snapshot();
+
+template<typename T>
+TypeCounters counters();
+
+inline void dumpText(std::ostream &out);
+inline void dumpJson(std::ostream &out);
+
+} // namespace instrumentation
+
+namespace detail {
+
+static const std::size_t InstrumentationMaxTypes = MEM_INSTRUMENTATION_MAX_TYPES;
+
+struct InstrumentedType {
+    std::string name;
+    long live;
+    long peak;
+};
+
+// Written by the owning thread only. On thread exit the counts move to the registry and the block
+// is reused by the next thread
+struct ThreadCounters {
+    std::size_t events[InstrumentationMaxTypes][instrumentation::EventCount];
+    bool inUse;
+    ThreadCounters *next;
+};
+
+struct InstrumentationRegistry {
+    pthread_mutex_t mutex; // guards type registration, the block list and retired
+    std::size_t typeCount;
+    InstrumentedType types[InstrumentationMaxTypes];
+    ThreadCounters *threads;
+    std::size_t retired[InstrumentationMaxTypes][instrumentation::EventCount];
+};
+
+inline InstrumentationRegistry *newInstrumentationRegistry() {
+    InstrumentationRegistry *registry = new InstrumentationRegistry();
+    pthread_mutex_init(&registry->mutex, NULL);
+    return registry;
+}
+
+// Never destroyed: exiting threads still report to it
+inline InstrumentationRegistry &instrumentationRegistry() {
+    static InstrumentationRegistry *registry = newInstrumentationRegistry();
+    return *registry;
+}
+
+// Unlike typeid this also works for incomplete types
+template<typename T>
+const char *instrumentedTypeSignature() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __PRETTY_FUNCTION__;
+#else
+    return "[T = unknown]";
+#endif
+}
+
+inline std::string instrumentedTypeName(const char *signature) {
+    const char *begin = std::strstr(signature, "T = ");
+    if (begin == NULL) {
+        return signature;
+    }
+    begin += 4;
+    const char *end = begin + std::strlen(begin);
+    if (end > begin && end[-1] == ']') {
+        --end;
+    }
+    return std::string(begin, end);
+}
+
+inline std::size_t registerInstrumentedType(const std::string &name) {
+    InstrumentationRegistry &registry = instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    std::size_t index = InstrumentationMaxTypes - 1;
+    if (registry.typeCount + 1 < InstrumentationMaxTypes) {
+        index = registry.typeCount++;
+        registry.types[index].name = name;
+    } else if (registry.typeCount < InstrumentationMaxTypes) {
+        registry.typeCount = InstrumentationMaxTypes;
+        registry.types[index].name = "<other>";
+    }
+    pthread_mutex_unlock(&registry.mutex);
+    return index;
+}
+
+template<typename T>
+std::size_t instrumentedTypeIndex() {
+    static const std::size_t index = registerInstrumentedType(
+            instrumentedTypeName(instrumentedTypeSignature<T>()));
+    return index;
+}
+
+inline ThreadCounters *&currentThreadCounters() {
+    static __thread ThreadCounters *counters = NULL;
+    return counters;
+}
+
+inline void releaseThreadCounters(void *data) {
+    ThreadCounters *counters = static_cast<ThreadCounters *>(data);
+    InstrumentationRegistry &registry = instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    for (std::size_t type = 0; type < InstrumentationMaxTypes; ++type) {
+        for (std::size_t event = 0; event < instrumentation::EventCount; ++event) {
+            registry.retired[type][event] += counters->events[type][event];
+            __atomic_store_n(&counters->events[type][event], 0, __ATOMIC_RELAXED);
+        }
+    }
+    counters->inUse = false;
+    pthread_mutex_unlock(&registry.mutex);
+    currentThreadCounters() = NULL;
+}
+
+inline pthread_key_t &threadCountersKeyStorage() {
+    static pthread_key_t key;
+    return key;
+}
+
+inline void createThreadCountersKey() {
+    pthread_key_create(&threadCountersKeyStorage(), releaseThreadCounters);
+}
+
+inline pthread_key_t threadCountersKey() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createThreadCountersKey);
+    return threadCountersKeyStorage();
+}
+
+inline ThreadCounters *acquireThreadCounters() {
+    InstrumentationRegistry &registry = instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    ThreadCounters *counters = registry.threads;
+    while (counters != NULL && counters->inUse) {
+        counters = counters->next;
+    }
+    if (counters == NULL) {
+        counters = new ThreadCounters();
+        counters->next = registry.threads;
+        registry.threads = counters;
+    }
+    counters->inUse = true;
+    pthread_mutex_unlock(&registry.mutex);
+
+    pthread_setspecific(threadCountersKey(), counters);
+    currentThreadCounters() = counters;
+    return counters;
+}
+
+inline void countEvent(std::size_t type, instrumentation::Event event) {
+    ThreadCounters *counters = currentThreadCounters();
+    if (counters == NULL) {
+        counters = acquireThreadCounters();
+    }
+    std::size_t &counter = counters->events[type][event];
+    __atomic_store_n(&counter, counter + 1, __ATOMIC_RELAXED);
+}
+
+inline void addLiveObjects(std::size_t type, long delta) {
+    InstrumentedType &counters = instrumentationRegistry().types[type];
+    const long live = __atomic_add_fetch(&counters.live, delta, __ATOMIC_RELAXED);
+    long peak = __atomic_load_n(&counters.peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&counters.peak, &peak, live, false,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Called with the registry mutex held
+inline instrumentation::TypeCounters collectTypeCounters(InstrumentationRegistry &registry,
+                                                         std::size_t type) {
+    instrumentation::TypeCounters result;
+    result.type = registry.types[type].name;
+    for (std::size_t event = 0; event < instrumentation::EventCount; ++event) {
+        result.events[event] = registry.retired[type][event];
+    }
+    for (ThreadCounters *counters = registry.threads; counters != NULL; counters = counters->next) {
+        for (std::size_t event = 0; event < instrumentation::EventCount; ++event) {
+            result.events[event] += __atomic_load_n(&counters->events[type][event], __ATOMIC_RELAXED);
+        }
+    }
+    result.live = __atomic_load_n(&registry.types[type].live, __ATOMIC_RELAXED);
+    result.peak = __atomic_load_n(&registry.types[type].peak, __ATOMIC_RELAXED);
+    return result;
+}
+
+inline void writeJsonString(std::ostream &out, const std::string &value) {
+    out << '"';
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '"' || value[i] == '\\') {
+            out << '\\';
+        }
+        out << value[i];
+    }
+    out << '"';
+}
+
+} // namespace detail
+
+namespace instrumentation {
+
+template<typename T>
+void record(Event event, const void *data) {
+    if (data == NULL) {
+        return;
+    }
+    const std::size_t type = detail::instrumentedTypeIndex<T>();
+    detail::countEvent(type, event);
+    if (event == Construct) {
+        detail::addLiveObjects(type, 1);
+    } else if (event == Release || event == Delete) {
+        detail::addLiveObjects(type, -1);
+    }
+}
+
+template<typename U, typename T>
+void recordConversion(const void *data) {
+    if (data == NULL) {
+        return;
+    }
+    const std::size_t type = detail::instrumentedTypeIndex<T>();
+    detail::countEvent(type, Convert);
+    detail::addLiveObjects(detail::instrumentedTypeIndex<U>(), -1);
+    detail::addLiveObjects(type, 1);
+}
+
+inline std::vector<TypeCounters> snapshot() {
+    detail::InstrumentationRegistry &registry = detail::instrumentationRegistry();
+    std::vector<TypeCounters> result;
+    pthread_mutex_lock(&registry.mutex);
+    for (std::size_t type = 0; type < registry.typeCount; ++type) {
+        result.push_back(detail::collectTypeCounters(registry, type));
+    }
+    pthread_mutex_unlock(&registry.mutex);
+    return result;
+}
+
+template<typename T>
+TypeCounters counters() {
+    const std::size_t type = detail::instrumentedTypeIndex<T>();
+    detail::InstrumentationRegistry &registry = detail::instrumentationRegistry();
+    pthread_mutex_lock(&registry.mutex);
+    const TypeCounters result = detail::collectTypeCounters(registry, type);
+    pthread_mutex_unlock(&registry.mutex);
+    return result;
+}
+
+// One line per type: "<type>: construct=N move=N ... live=N peak=N"
+inline void dumpText(std::ostream &out) {
+    const std::vector<TypeCounters> types = snapshot();
+    for (std::size_t i = 0; i < types.size(); ++i) {
+        out << types[i].type << ':';
+        for (std::size_t event = 0; event < EventCount; ++event) {
+            out << ' ' << eventName(Event(event)) << '=' << types[i].events[event];
+        }
+        out << " live=" << types[i].live << " peak=" << types[i].peak << '\n';
+    }
+}
+
+// A JSON array with one object per type
+inline void dumpJson(std::ostream &out) {
+    const std::vector<TypeCounters> types = snapshot();
+    out << '[';
+    for (std::size_t i = 0; i < types.size(); ++i) {
+        out << (i == 0 ? "\n" : ",\n") << "  {\"type\": ";
+        detail::writeJsonString(out, types[i].type);
+        for (std::size_t event = 0; event < EventCount; ++event) {
+            out << ", \"" << eventName(Event(event)) << "\": " << types[i].events[event];
+        }
+        out << ", \"live\": " << types[i].live << ", \"peak\": " << types[i].peak << '}';
+    }
+    out << (types.empty() ? "]\n" : "\n]\n");
+}
+
+} // namespace instrumentation
+
+} // namespace mem
@@ -0,0 +1,115 @@
+#include <cassert>
+#include <sstream>
+#include <string>
+
+#include <pthread.h>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "instrumentation.h"
+
+// Built with -DMEM_INSTRUMENTATION. Counters are global, so every test uses its own types
+
+namespace {
+
+struct Widget {
+    int value;
+};
+
+struct Shape {
+    virtual ~Shape() {}
+};
+
+struct Circle : Shape {};
+
+struct Token {};
+
+typedef mem::instrumentation::TypeCounters TypeCounters;
+
+const std::size_t ThreadCount = 4;
+const std::size_t TokensPerThread = 1000;
+
+void *makeTokens(void *) {
+    for (std::size_t i = 0; i < TokensPerThread; ++i) {
+        mem::UniquePtr<Token> token(mem::makeUnique<Token>());
+    }
+    return NULL;
+}
+
+} // namespace
+
+void test1() {
+    {
+        mem::UniquePtr<Widget> first(new Widget());
+        mem::UniquePtr<Widget> second(first.move());
+        mem::UniquePtr<Widget> third(mem::makeUnique<Widget>());
+
+        TypeCounters counters = mem::instrumentation::counters<Widget>();
+        assert(counters.events[mem::instrumentation::Construct] == 2);
+        assert(counters.events[mem::instrumentation::Move] == 1);
+        assert(counters.events[mem::instrumentation::Transfer] == 2);
+        assert(counters.live == 2);
+
+        delete second.release();
+        third = mem::makeUnique<Widget>();
+    }
+
+    TypeCounters counters = mem::instrumentation::counters<Widget>();
+    assert(counters.events[mem::instrumentation::Construct] == 3);
+    assert(counters.events[mem::instrumentation::Move] == 1);
+    assert(counters.events[mem::instrumentation::Transfer] == 3);
+    assert(counters.events[mem::instrumentation::Convert] == 0);
+    assert(counters.events[mem::instrumentation::Release] == 1);
+    assert(counters.events[mem::instrumentation::Delete] == 2);
+    assert(counters.live == 0);
+    assert(counters.peak == 2);
+}
+
+void test2() {
+    mem::UniquePtr<Circle> circle(new Circle());
+    mem::UniquePtr<Shape> shape(circle.move());
+
+    assert(mem::instrumentation::counters<Circle>().live == 0);
+    assert(mem::instrumentation::counters<Circle>().peak == 1);
+    assert(mem::instrumentation::counters<Shape>().live == 1);
+    assert(mem::instrumentation::counters<Shape>().events[mem::instrumentation::Convert] == 1);
+}
+
+void test3() {
+    pthread_t threads[ThreadCount];
+    for (std::size_t i = 0; i < ThreadCount; ++i) {
+        pthread_create(&threads[i], NULL, makeTokens, NULL);
+    }
+    for (std::size_t i = 0; i < ThreadCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TypeCounters counters = mem::instrumentation::counters<Token>();
+    assert(counters.events[mem::instrumentation::Construct] == ThreadCount * TokensPerThread);
+    assert(counters.events[mem::instrumentation::Delete] == ThreadCount * TokensPerThread);
+    assert(counters.live == 0);
+    assert(counters.peak >= 1);
+}
+
+void test4() {
+    mem::UniquePtr<Widget> widget(new Widget());
+
+    std::ostringstream text;
+    mem::instrumentation::dumpText(text);
+    assert(text.str().find("Widget: construct=") != std::string::npos);
+
+    std::ostringstream json;
+    mem::instrumentation::dumpJson(json);
+    assert(json.str()[0] == '[');
+    assert(json.str().find("Widget\", \"construct\": ") != std::string::npos);
+    assert(json.str().find("\"live\": 1") != std::string::npos);
+}
+
+int main(void) {
+    test1();
+    test2();
+    test3();
+    test4();
+
+    return 0;
+}
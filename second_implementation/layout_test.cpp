@@ -0,0 +1,47 @@
+#include <memory>
+
+#include "unique_ptr.h"
+#include "any_deleter.h"
+#include "allocator_deleter.h"
+
+/**
+ * Размер UniquePtr должен совпадать с размером сырого указателя (плюс состояние удалителя, если
+ * оно есть). Нарушенное условие превращается в массив отрицательного размера и ошибку компиляции.
+ */
+#define LAYOUT_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1]
+
+namespace {
+
+struct Widget {
+    int id;
+};
+
+struct StatefulDeleter {
+    void operator()(void *ptr) {
+        delete static_cast<Widget *>(ptr);
+    }
+
+    void *context;
+};
+
+typedef mem::UniquePtr<Widget> WidgetPtr;
+typedef mem::UniquePtr<Widget, StatefulDeleter> StatefulWidgetPtr;
+
+LAYOUT_ASSERT(sizeof(WidgetPtr) == sizeof(Widget *), unique_ptr_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(WidgetPtr::RvalueType) == sizeof(Widget *), rvalue_is_pointer_sized);
+
+LAYOUT_ASSERT(sizeof(StatefulWidgetPtr) == sizeof(Widget *) + sizeof(void *),
+              stateful_deleter_costs_only_its_state);
+LAYOUT_ASSERT(sizeof(StatefulWidgetPtr::RvalueType) == sizeof(StatefulWidgetPtr),
+              rvalue_matches_unique_ptr);
+LAYOUT_ASSERT(sizeof(mem::ObserverPtr<Widget>) == sizeof(Widget *), observer_is_pointer_sized);
+LAYOUT_ASSERT(sizeof(mem::UniquePtr<Widget, mem::AnyDeleter>) == 4 * sizeof(void *),
+              any_deleter_costs_function_and_inline_state);
+LAYOUT_ASSERT(sizeof(mem::UniquePtr<Widget, mem::AllocatorDeleter<std::allocator<Widget> > >) ==
+              sizeof(Widget *), stateless_allocator_costs_nothing);
+
+} // namespace
+
+int main() {
+    return 0;
+}
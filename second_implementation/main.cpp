@@ -1,7 +1,13 @@
 #include <iostream>
 #include "unique_ptr.h"
+#include "make_unique.h"
+#include "any_deleter.h"
+#include "slab_allocator.h"
+#include "poly_collection.h"
+#include "allocator_deleter.h"
 #include <string>
 #include <vector>
+#include <stdexcept>
 #include <cassert>
 
 struct Widget {
@@ -15,7 +21,7 @@ struct Widget {
 
     virtual void draw() = 0;
 
-    const std::string& id() {
+    const std::string& id() const {
         return id_;
     }
 
@@ -42,11 +48,15 @@ typedef mem::UniquePtr<Widget>::RvalueType RvalueSmartWidgetPtr;
 typedef mem::UniquePtr<Widget> SmartWidgetPtr;
 typedef std::vector<RvalueSmartWidgetPtr> Widgets;
 
+mem::UniquePtr<Button>::RvalueType makeButton(const std::string &widgetId) {
+    return mem::makeUnique<Button>(widgetId);
+}
+
 RvalueSmartWidgetPtr makeWidget(const std::string &widgetType, const std::string &widgetId) {
     if (widgetType == "Button") {
-        return SmartWidgetPtr(new Button(widgetId)).move();
+        return makeButton(widgetId);
     } else if (widgetType == "Window") {
-        return SmartWidgetPtr(new Window(widgetId)).move();
+        return mem::makeUnique<Window>(widgetId);
     } else {
         return SmartWidgetPtr();
     }
@@ -54,7 +64,7 @@ RvalueSmartWidgetPtr makeWidget(const std::string &widgetType, const std::string
 
 void drawWidgets(const Widgets &widgets) {
     for (size_t i = 0; i < widgets.size(); ++i) {
-        SmartWidgetPtr(widgets[i])->draw();
+        widgets[i].borrow<Widget>()->draw();
     }
 }
 
@@ -79,9 +89,333 @@ void test2() {
     assert(w2.get() != NULL);
 }
 
+void test3() {
+    Widgets widgets;
+    widgets.push_back(makeWidget("Button", "btn1"));
+
+    drawWidgets(widgets);
+    drawWidgets(widgets);
+
+    SmartWidgetPtr w(widgets[0]);
+    assert(w.get() != NULL);
+    assert(w.borrow().get() == w.get());
+    assert(w.borrowConst()->id() == "btn1");
+}
+
+void test4() {
+    mem::UniquePtr<Button> button(makeButton("btn1"));
+    Button *raw = button.get();
+
+    SmartWidgetPtr widget(button.move());
+    assert(button.get() == NULL);
+    assert(widget.get() == raw);
+
+    widget = makeButton("btn2");
+    widget = mem::UniquePtr<Window>(new Window("main window")).move();
+    widget->draw();
+}
+
+struct CountingDestroy {
+    explicit CountingDestroy(int *counter): counter_(counter) {}
+
+    void operator()(Widget *widget) {
+        ++*counter_;
+        delete widget;
+    }
+
+    int *counter_;
+};
+
+void destroyInPlace(Window *window) {
+    window->~Window();
+}
+
+void test5() {
+    typedef mem::UniquePtr<Widget, mem::AnyDeleter> AnyWidgetPtr;
+    typedef std::vector<AnyWidgetPtr::RvalueType> AnyWidgets;
+
+    int destroyed = 0;
+    union {
+        char bytes[sizeof(Window)];
+        void *align;
+    } storage;
+
+    {
+        AnyWidgets widgets;
+        widgets.push_back(makeButton("btn1"));
+        widgets.push_back(AnyWidgetPtr(new Button("btn2"),
+                                       mem::AnyDeleter::of<Widget>(CountingDestroy(&destroyed))).move());
+        widgets.push_back(AnyWidgetPtr(new (storage.bytes) Window("main window"),
+                                       mem::AnyDeleter::of<Window>(&destroyInPlace)).move());
+
+        for (size_t i = 0; i < widgets.size(); ++i) {
+            widgets[i].borrow<Widget>()->draw();
+        }
+
+        AnyWidgetPtr window(widgets[2]);
+        assert(static_cast<void *>(window.get()) == storage.bytes);
+
+        // The typed conversion deletes through Button whatever the offset of Widget
+        AnyWidgetPtr button(makeButton("btn3"));
+        button->draw();
+    }
+    assert(destroyed == 1);
+}
+
+typedef mem::UniquePtr<Widget, mem::SlabDeleter<Widget> > SlabWidgetPtr;
+typedef std::vector<SlabWidgetPtr::RvalueType> SlabWidgets;
+
+SlabWidgetPtr::RvalueType makeSlabWidget(mem::SlabAllocator &slabs, const std::string &widgetType,
+                                         const std::string &widgetId) {
+    if (widgetType == "Button") {
+        return slabs.make<Button>(widgetId);
+    } else if (widgetType == "Window") {
+        return slabs.make<Window>(widgetId);
+    } else {
+        return SlabWidgetPtr();
+    }
+}
+
+void test6() {
+    mem::SlabAllocator slabs;
+    void *buttons[2];
+
+    {
+        SlabWidgets widgets;
+        widgets.push_back(makeSlabWidget(slabs, "Button", "btn1"));
+        widgets.push_back(makeSlabWidget(slabs, "Window", "main window"));
+        widgets.push_back(makeSlabWidget(slabs, "Button", "btn2"));
+
+        for (size_t i = 0; i < widgets.size(); ++i) {
+            widgets[i].borrow<Widget>()->draw();
+        }
+
+        // Buttons are neighbours in their slab even though a window was created in between
+        buttons[0] = dynamic_cast<void *>(widgets[0].borrow<Widget>().get());
+        buttons[1] = dynamic_cast<void *>(widgets[2].borrow<Widget>().get());
+        assert(static_cast<char *>(buttons[1]) ==
+               static_cast<char *>(buttons[0]) + mem::SlabAllocator::slotSize(sizeof(Button)));
+        assert(slabs.count<Button>() == 2);
+        assert(slabs.count<Window>() == 1);
+    }
+    // Handles of Widget still return every object to the slab of its dynamic type
+    assert(slabs.count<Button>() == 0);
+    assert(slabs.count<Window>() == 0);
+
+    SlabWidgetPtr reused(slabs.make<Button>("btn3"));
+    void *address = dynamic_cast<void *>(reused.get());
+    assert(address == buttons[0] || address == buttons[1]);
+}
+
+struct CollectIds {
+    void operator()(Widget &widget) {
+        ids.push_back(widget.id());
+    }
+
+    std::vector<std::string> ids;
+};
+
+struct ToolButton : public Button {
+    ToolButton(const std::string &id): Button(id) {}
+};
+
+void test7() {
+    mem::PolyCollection<Widget> widgets;
+    widgets.insert(makeButton("btn1"));
+    widgets.insert(mem::makeUnique<Window>("main window"));
+    widgets.insert(makeButton("btn2"));
+
+    assert(widgets.size() == 3);
+    assert(widgets.count<Button>() == 2);
+    assert(widgets.count<Window>() == 1);
+
+    // Grouped by type: both buttons come before the window that was inserted between them
+    const CollectIds all = widgets.forEach(CollectIds());
+    assert(all.ids.size() == 3);
+    assert(all.ids[0] == "btn1" && all.ids[1] == "btn2" && all.ids[2] == "main window");
+
+    const CollectIds buttons = widgets.forEach<Button>(CollectIds());
+    assert(buttons.ids.size() == 2);
+
+    // A ToolButton inserted as a Button would be sliced: rejected in every build
+    bool rejected = false;
+    try {
+        widgets.insert(mem::UniquePtr<Button>(new ToolButton("tool1")).move());
+    } catch (const std::invalid_argument &) {
+        rejected = true;
+    }
+    assert(rejected);
+    assert(widgets.count<Button>() == 2);
+
+    widgets.clear();
+    assert(widgets.empty());
+}
+
+struct AllocatorStats {
+    size_t allocated;
+    size_t deallocated;
+    size_t destroyed;
+};
+
+// A minimal stateful C++03 allocator that counts its calls
+template<typename T>
+struct CountingAllocator {
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U>
+    struct rebind {
+        typedef CountingAllocator<U> other;
+    };
+
+    explicit CountingAllocator(AllocatorStats *stats): stats(stats) {}
+
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U> &other): stats(other.stats) {}
+
+    pointer allocate(size_type n) {
+        stats->allocated += n;
+        return static_cast<pointer>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(pointer ptr, size_type n) {
+        stats->deallocated += n;
+        ::operator delete(ptr);
+    }
+
+    void construct(pointer ptr, const T &value) {
+        new (ptr) T(value);
+    }
+
+    void destroy(pointer ptr) {
+        ++stats->destroyed;
+        ptr->~T();
+    }
+
+    size_type max_size() const {
+        return size_t(-1) / sizeof(T);
+    }
+
+    AllocatorStats *stats;
+};
+
+struct ThrowingWidget : public Widget {
+    explicit ThrowingWidget(const std::string &id): Widget(id) {
+        throw 1;
+    }
+
+    void draw() {}
+};
+
+void test8() {
+    typedef mem::AllocatorDeleter<std::allocator<Button> > ButtonDeleter;
+    mem::UniquePtr<Button, ButtonDeleter> button(mem::allocateUnique<Button>(std::allocator<char>(),
+                                                                             "btn1"));
+    assert(sizeof(button) == sizeof(Button *));
+    button->draw();
+
+    AllocatorStats stats = {0, 0, 0};
+    {
+        typedef mem::AllocatorDeleter<CountingAllocator<Window> > WindowDeleter;
+        mem::UniquePtr<Window, WindowDeleter>::RvalueType rvalue =
+                mem::allocateUnique<Window>(CountingAllocator<char>(&stats), "main window");
+        mem::UniquePtr<Window, WindowDeleter> window(rvalue);
+        assert(window.getDeleter().allocator().stats == &stats);
+        window->draw();
+        assert(stats.allocated == 1 && stats.destroyed == 0);
+    }
+    // Destroyed and deallocated through the allocator, not with delete
+    assert(stats.destroyed == 1 && stats.deallocated == 1);
+
+    bool thrown = false;
+    try {
+        mem::allocateUnique<ThrowingWidget>(CountingAllocator<char>(&stats), "broken");
+    } catch (int) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(stats.allocated == 2 && stats.deallocated == 2 && stats.destroyed == 1);
+}
+
+// Allocation policy for makeUniqueWith: memory from operator new, counted in AllocatorStats
+template<typename T>
+struct CountingPolicyDeleter {
+    typedef T ValueType;
+
+    explicit CountingPolicyDeleter(AllocatorStats *stats = NULL): stats(stats) {}
+
+    void operator()(void *ptr) {
+        ++stats->destroyed;
+        static_cast<T *>(ptr)->~T();
+        ++stats->deallocated;
+        ::operator delete(ptr);
+    }
+
+    AllocatorStats *stats;
+};
+
+template<typename T>
+struct CountingPolicy {
+    typedef CountingPolicyDeleter<T> Deleter;
+
+    explicit CountingPolicy(AllocatorStats *stats): stats(stats) {}
+
+    void *allocate() {
+        ++stats->allocated;
+        return ::operator new(sizeof(T));
+    }
+
+    void deallocate(void *memory) {
+        ++stats->deallocated;
+        ::operator delete(memory);
+    }
+
+    Deleter deleter() {
+        return Deleter(stats);
+    }
+
+    AllocatorStats *stats;
+};
+
+void test9() {
+    AllocatorStats stats = {0, 0, 0};
+    {
+        CountingPolicy<Button> policy(&stats);
+        mem::UniquePtr<Button, CountingPolicy<Button>::Deleter> button(
+                mem::makeUniqueWith<Button>(policy, "btn2"));
+        assert(button.getDeleter().stats == &stats);
+        button->draw();
+        assert(stats.allocated == 1 && stats.destroyed == 0);
+    }
+    assert(stats.destroyed == 1 && stats.deallocated == 1);
+
+    // The memory goes back to the policy when the constructor throws
+    CountingPolicy<ThrowingWidget> throwingPolicy(&stats);
+    bool thrown = false;
+    try {
+        mem::makeUniqueWith<ThrowingWidget>(throwingPolicy, "broken");
+    } catch (int) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(stats.allocated == 2 && stats.deallocated == 2 && stats.destroyed == 1);
+}
+
 int main(void) {
 
     test2();
+    test3();
+    test4();
+    test5();
+    test6();
+    test7();
+    test8();
+    test9();
 
     return 0;
 }
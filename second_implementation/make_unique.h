@@ -0,0 +1,102 @@
+#pragma once
+
+#include <new>
+
+#include "preprocessor.h"
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+// The only place an RvalueType is created straight from a new-expression
+struct UniqueFactory {
+    template<typename T>
+    static typename UniquePtr<T>::RvalueType adopt(T *data) {
+        MEM_INSTRUMENT(T, Construct, data, NULL, NULL);
+        return typename UniquePtr<T>::RvalueType(data, typename UniquePtr<T>::DeleterType());
+    }
+
+    template<typename T, typename D>
+    static typename UniquePtr<T, D>::RvalueType adopt(T *data, const D &deleter) {
+        MEM_INSTRUMENT(T, Construct, data, NULL, NULL);
+        return typename UniquePtr<T, D>::RvalueType(data, deleter);
+    }
+};
+
+// Gives the memory back to the allocation policy unless dismissed, i.e. if the constructor threw
+template<typename P>
+struct AllocationGuard {
+    AllocationGuard(P &policy, void *memory): policy(policy), memory(memory) {}
+
+    ~AllocationGuard() {
+        if (memory != NULL) {
+            policy.deallocate(memory);
+        }
+    }
+
+    void dismiss() {
+        memory = NULL;
+    }
+
+    P &policy;
+    void *memory;
+
+private:
+    AllocationGuard(const AllocationGuard &);
+    AllocationGuard &operator=(const AllocationGuard &);
+};
+
+} // namespace detail
+
+// makeUnique<T>(a1, ..., aN): constructs T with new and returns UniquePtr<T>::RvalueType directly,
+// without a temporary UniquePtr<T>. Arguments are forwarded by const reference (C++03).
+//
+// makeUniqueWith<T>(policy, a1, ..., aN) does the same with memory from an allocation policy,
+// which provides:
+//  - typedef ... Deleter;            destroys T and frees its memory, ValueType is T;
+//  - void *allocate();               memory for one T (or an exception);
+//  - void deallocate(void *memory);  takes the memory back if the constructor of T throws;
+//  - Deleter deleter();              the deleter stored in the returned handle.
+#define MEM_MAKE_UNIQUE(n) \
+    template<typename T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    typename UniquePtr<T>::RvalueType makeUnique(MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        return detail::UniqueFactory::adopt(new T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT))); \
+    } \
+    \
+    template<typename T, typename P, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    typename UniquePtr<T, typename P::Deleter>::RvalueType makeUniqueWith( \
+            P &policy, MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        detail::AllocationGuard<P> guard(policy, policy.allocate()); \
+        T *data = new (guard.memory) T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)); \
+        guard.dismiss(); \
+        return detail::UniqueFactory::adopt(data, policy.deleter()); \
+    }
+
+template<typename T>
+typename UniquePtr<T>::RvalueType makeUnique() {
+    return detail::UniqueFactory::adopt(new T());
+}
+
+template<typename T, typename P>
+typename UniquePtr<T, typename P::Deleter>::RvalueType makeUniqueWith(P &policy) {
+    detail::AllocationGuard<P> guard(policy, policy.allocate());
+    T *data = new (guard.memory) T();
+    guard.dismiss();
+    return detail::UniqueFactory::adopt(data, policy.deleter());
+}
+
+MEM_MAKE_UNIQUE(1)
+MEM_MAKE_UNIQUE(2)
+MEM_MAKE_UNIQUE(3)
+MEM_MAKE_UNIQUE(4)
+MEM_MAKE_UNIQUE(5)
+MEM_MAKE_UNIQUE(6)
+MEM_MAKE_UNIQUE(7)
+MEM_MAKE_UNIQUE(8)
+MEM_MAKE_UNIQUE(9)
+MEM_MAKE_UNIQUE(10)
+
+#undef MEM_MAKE_UNIQUE
+
+} // namespace mem
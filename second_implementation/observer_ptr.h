@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mem {
+
+template<typename T>
+struct ObserverPtr {
+public:
+    typedef T ValueType;
+    typedef ValueType *PointType;
+
+    ObserverPtr();
+    explicit ObserverPtr(PointType data);
+
+    template<typename U>
+    ObserverPtr(const ObserverPtr<U> &other);
+
+    ValueType &operator*() const;
+    PointType operator->() const;
+
+    PointType get() const;
+    bool empty() const;
+
+private:
+    PointType data_;
+};
+
+/**
+    template<typename T>
+    struct ObserverPtr
+ **/
+template<typename T>
+ObserverPtr<T>::ObserverPtr():
+data_(NULL) {
+}
+
+template<typename T>
+ObserverPtr<T>::ObserverPtr(PointType data):
+data_(data) {
+}
+
+template<typename T>
+template<typename U>
+ObserverPtr<T>::ObserverPtr(const ObserverPtr<U> &other):
+data_(other.get()) {
+}
+
+template<typename T>
+typename ObserverPtr<T>::ValueType &ObserverPtr<T>::operator*() const {
+    return *data_;
+}
+
+template<typename T>
+typename ObserverPtr<T>::PointType ObserverPtr<T>::operator->() const {
+    return data_;
+}
+
+template<typename T>
+typename ObserverPtr<T>::PointType ObserverPtr<T>::get() const {
+    return data_;
+}
+
+template<typename T>
+bool ObserverPtr<T>::empty() const {
+    return data_ == NULL;
+}
+
+template<typename T, typename U>
+bool operator==(const ObserverPtr<T> &a, const ObserverPtr<U> &b) {
+    return a.get() == b.get();
+}
+
+template<typename T, typename U>
+bool operator!=(const ObserverPtr<T> &a, const ObserverPtr<U> &b) {
+    return a.get() != b.get();
+}
+
+} // namespace mem
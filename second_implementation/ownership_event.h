@@ -0,0 +1,28 @@
+#pragma once
+
+namespace mem {
+
+namespace instrumentation {
+
+// Ownership events reported by the MEM_INSTRUMENT hooks in unique_ptr.h. Shared by the counters
+// (instrumentation.h) and the transfer trace (ownership_trace.h)
+enum Event {
+    Construct, // a handle adopted a new object (constructor from a pointer, makeUnique())
+    Move,
+    Transfer, // ownership passed between handles of the same type
+    Convert, // ownership passed to a handle of a base type
+    Release,
+    Delete,
+    EventCount
+};
+
+inline const char *eventName(Event event) {
+    static const char *const names[EventCount] = {
+        "construct", "move", "transfer", "convert", "release", "delete"
+    };
+    return names[event];
+}
+
+} // namespace instrumentation
+
+} // namespace mem
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstddef>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ownership_event.h"
+
+// Ownership transfer trace for post-mortem analysis, wired into the hooks in unique_ptr.h when the
+// program is built with -DMEM_OWNERSHIP_TRACE. Every thread writes its events (object, source and
+// destination handle, kind, timestamp) into its own fixed-size ring buffer, without locks or
+// syscalls; old events are overwritten. dumpOwnershipTrace() only uses write(2), so it can be
+// called from a signal handler or a debugger: (gdb) call mem::dumpOwnershipTrace(2, 0)
+
+#ifndef MEM_OWNERSHIP_TRACE_SIZE
+// Events kept per thread, must be a power of two
+#define MEM_OWNERSHIP_TRACE_SIZE 1024
+#endif
+
+namespace mem {
+
+namespace detail {
+
+static const std::size_t OwnershipTraceSize = MEM_OWNERSHIP_TRACE_SIZE;
+
+typedef char OwnershipTraceSizeIsPowerOfTwo[
+        (OwnershipTraceSize & (OwnershipTraceSize - 1)) == 0 ? 1 : -1];
+
+// Written seqlock-style: sequence is zeroed before the fields change and set to the event number
+// afterwards, so a reader can skip a record that is being overwritten
+struct OwnershipTraceRecord {
+    std::size_t sequence;
+    const void *object;
+    const void *source;
+    const void *destination;
+    unsigned long timestamp; // TSC ticks on x86, CLOCK_MONOTONIC nanoseconds elsewhere
+    unsigned kind;
+};
+
+// Never freed so that a signal handler can walk the list. The buffer of a finished thread keeps
+// its history until another thread takes it over
+struct OwnershipTraceBuffer {
+    std::size_t head;
+    long thread;
+    int inUse;
+    OwnershipTraceBuffer *next;
+    OwnershipTraceRecord records[OwnershipTraceSize];
+};
+
+inline OwnershipTraceBuffer *&ownershipTraceBuffers() {
+    static OwnershipTraceBuffer *buffers = NULL;
+    return buffers;
+}
+
+inline OwnershipTraceBuffer *&currentOwnershipTraceBuffer() {
+    static __thread OwnershipTraceBuffer *buffer = NULL;
+    return buffer;
+}
+
+inline unsigned long ownershipTraceTimestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return static_cast<unsigned long>(__builtin_ia32_rdtsc());
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<unsigned long>(now.tv_sec) * 1000000000ul +
+            static_cast<unsigned long>(now.tv_nsec);
+#endif
+}
+
+inline void releaseOwnershipTraceBuffer(void *buffer) {
+    __atomic_store_n(&static_cast<OwnershipTraceBuffer *>(buffer)->inUse, 0, __ATOMIC_RELEASE);
+    currentOwnershipTraceBuffer() = NULL;
+}
+
+inline pthread_key_t &ownershipTraceKeyStorage() {
+    static pthread_key_t key;
+    return key;
+}
+
+inline void createOwnershipTraceKey() {
+    pthread_key_create(&ownershipTraceKeyStorage(), releaseOwnershipTraceBuffer);
+}
+
+inline pthread_key_t ownershipTraceKey() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createOwnershipTraceKey);
+    return ownershipTraceKeyStorage();
+}
+
+inline OwnershipTraceBuffer *acquireOwnershipTraceBuffer() {
+    OwnershipTraceBuffer *buffer = __atomic_load_n(&ownershipTraceBuffers(), __ATOMIC_ACQUIRE);
+    for (; buffer != NULL; buffer = buffer->next) {
+        int expected = 0;
+        if (__atomic_load_n(&buffer->inUse, __ATOMIC_RELAXED) == 0 &&
+                __atomic_compare_exchange_n(&buffer->inUse, &expected, 1, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    if (buffer != NULL) {
+        // Drop the previous owner's history so it is not attributed to this thread
+        for (std::size_t i = 0; i < OwnershipTraceSize; ++i) {
+            __atomic_store_n(&buffer->records[i].sequence, 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&buffer->head, 0, __ATOMIC_RELEASE);
+    } else {
+        buffer = new OwnershipTraceBuffer();
+        buffer->inUse = 1;
+        OwnershipTraceBuffer *next = __atomic_load_n(&ownershipTraceBuffers(), __ATOMIC_ACQUIRE);
+        do {
+            buffer->next = next;
+        } while (!__atomic_compare_exchange_n(&ownershipTraceBuffers(), &next, buffer, false,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    }
+    __atomic_store_n(&buffer->thread, static_cast<long>(syscall(SYS_gettid)), __ATOMIC_RELEASE);
+
+    pthread_setspecific(ownershipTraceKey(), buffer);
+    currentOwnershipTraceBuffer() = buffer;
+    return buffer;
+}
+
+// Formats on the stack, without allocation or stdio
+class OwnershipTraceLine {
+public:
+    OwnershipTraceLine(): size_(0) {}
+
+    OwnershipTraceLine &append(const char *text) {
+        while (*text != '\0' && size_ < sizeof(data_)) {
+            data_[size_++] = *text++;
+        }
+        return *this;
+    }
+
+    OwnershipTraceLine &append(unsigned long value, unsigned base = 10) {
+        char digits[24];
+        std::size_t count = 0;
+        do {
+            digits[count++] = "0123456789abcdef"[value % base];
+            value /= base;
+        } while (value != 0);
+        if (base == 16) {
+            append("0x");
+        }
+        while (count > 0 && size_ < sizeof(data_)) {
+            data_[size_++] = digits[--count];
+        }
+        return *this;
+    }
+
+    OwnershipTraceLine &append(const void *ptr) {
+        return append(reinterpret_cast<unsigned long>(ptr), 16);
+    }
+
+    void write(int fd) {
+        const ssize_t written = ::write(fd, data_, size_);
+        (void) written;
+        size_ = 0;
+    }
+
+private:
+    char data_[256];
+    std::size_t size_;
+};
+
+} // namespace detail
+
+// Appends an event to the current thread's buffer. Null objects are not recorded
+inline void traceOwnership(instrumentation::Event kind, const void *object, const void *source,
+                           const void *destination) {
+    if (object == NULL) {
+        return;
+    }
+    detail::OwnershipTraceBuffer *buffer = detail::currentOwnershipTraceBuffer();
+    if (buffer == NULL) {
+        buffer = detail::acquireOwnershipTraceBuffer();
+    }
+
+    const std::size_t index = buffer->head;
+    detail::OwnershipTraceRecord &record =
+            buffer->records[index & (detail::OwnershipTraceSize - 1)];
+    __atomic_store_n(&record.sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&record.object, object, __ATOMIC_RELAXED);
+    __atomic_store_n(&record.source, source, __ATOMIC_RELAXED);
+    __atomic_store_n(&record.destination, destination, __ATOMIC_RELAXED);
+    __atomic_store_n(&record.timestamp, detail::ownershipTraceTimestamp(), __ATOMIC_RELAXED);
+    __atomic_store_n(&record.kind, static_cast<unsigned>(kind), __ATOMIC_RELAXED);
+    __atomic_store_n(&record.sequence, index + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&buffer->head, index + 1, __ATOMIC_RELEASE);
+}
+
+// Writes every thread's trace to fd, oldest events first; if object is not NULL, only its events.
+// Async-signal-safe. A record being overwritten during the dump is skipped
+inline void dumpOwnershipTrace(int fd, const void *object = NULL) {
+    detail::OwnershipTraceLine line;
+    detail::OwnershipTraceBuffer *buffer =
+            __atomic_load_n(&detail::ownershipTraceBuffers(), __ATOMIC_ACQUIRE);
+    for (; buffer != NULL; buffer = buffer->next) {
+        const std::size_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        line.append("thread ").append(static_cast<unsigned long>(
+                __atomic_load_n(&buffer->thread, __ATOMIC_RELAXED)));
+        line.append(" events ").append(static_cast<unsigned long>(head)).append("\n").write(fd);
+
+        const std::size_t size = detail::OwnershipTraceSize;
+        for (std::size_t i = head > size ? head - size : 0; i < head; ++i) {
+            detail::OwnershipTraceRecord &record = buffer->records[i & (size - 1)];
+            const std::size_t sequence = __atomic_load_n(&record.sequence, __ATOMIC_ACQUIRE);
+            const void *recordObject = __atomic_load_n(&record.object, __ATOMIC_RELAXED);
+            const void *source = __atomic_load_n(&record.source, __ATOMIC_RELAXED);
+            const void *destination = __atomic_load_n(&record.destination, __ATOMIC_RELAXED);
+            const unsigned long timestamp = __atomic_load_n(&record.timestamp, __ATOMIC_RELAXED);
+            const unsigned kind = __atomic_load_n(&record.kind, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (sequence != i + 1 ||
+                    __atomic_load_n(&record.sequence, __ATOMIC_RELAXED) != sequence ||
+                    kind >= instrumentation::EventCount) {
+                continue;
+            }
+            if (object != NULL && recordObject != object) {
+                continue;
+            }
+
+            line.append("  ").append(static_cast<unsigned long>(sequence)).append(" ");
+            line.append(timestamp).append(" ");
+            line.append(instrumentation::eventName(instrumentation::Event(kind)));
+            line.append(" object=").append(recordObject);
+            line.append(" source=").append(source);
+            line.append(" destination=").append(destination).append("\n").write(fd);
+        }
+    }
+}
+
+} // namespace mem
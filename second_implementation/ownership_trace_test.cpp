@@ -0,0 +1,138 @@
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "ownership_trace.h"
+
+// Built with -DMEM_OWNERSHIP_TRACE and MEM_OWNERSHIP_TRACE_SIZE=64, so wrapping is cheap to test
+
+namespace {
+
+struct Foo {
+    int id;
+};
+
+typedef mem::UniquePtr<Foo> FooPtr;
+
+const std::size_t WrappingEvents = 200;
+
+std::string pointer(const void *ptr) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "0x%lx", reinterpret_cast<unsigned long>(ptr));
+    return text;
+}
+
+std::string event(const char *kind, const void *object, const void *source,
+                  const void *destination) {
+    return std::string(kind) + " object=" + pointer(object) + " source=" + pointer(source) +
+            " destination=" + pointer(destination) + "\n";
+}
+
+std::string readAndClose(std::FILE *file) {
+    std::rewind(file);
+    std::string text;
+    char chunk[4096];
+    std::size_t read = 0;
+    while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, read);
+    }
+    std::fclose(file);
+    return text;
+}
+
+std::string dumpTrace(const void *object = NULL) {
+    std::FILE *file = std::tmpfile();
+    mem::dumpOwnershipTrace(fileno(file), object);
+    return readAndClose(file);
+}
+
+void *makeManyEvents(void *) {
+    for (std::size_t i = 0; i < WrappingEvents / 2; ++i) {
+        FooPtr foo(new Foo());
+    }
+    return NULL;
+}
+
+int signalFd = -1;
+
+void dumpOnSignal(int) {
+    mem::dumpOwnershipTrace(signalFd);
+}
+
+} // namespace
+
+void test1() {
+    Foo *raw = new Foo();
+    FooPtr first(raw);
+    FooPtr second(first.move());
+    delete second.release();
+
+    const std::string trace = dumpTrace(raw);
+    const std::size_t construct = trace.find(event("construct", raw, NULL, &first));
+    const std::size_t transfer = trace.find(" destination=" + pointer(&second) + "\n");
+    const std::size_t release = trace.find(event("release", raw, &second, NULL));
+    assert(construct != std::string::npos);
+    assert(trace.find("move object=" + pointer(raw) + " source=" + pointer(&first)) !=
+           std::string::npos);
+    assert(transfer != std::string::npos);
+    assert(release != std::string::npos);
+    assert(construct < transfer && transfer < release);
+}
+
+// A copy of an rvalue silently takes ownership; the trace shows who took it
+void test2() {
+    std::vector<FooPtr::RvalueType> handles;
+    handles.push_back(mem::makeUnique<Foo>());
+    const Foo *object = handles[0].borrow<Foo>().get();
+
+    FooPtr::RvalueType stolen = handles[0];
+    assert(handles[0].borrow<Foo>().get() == NULL);
+    assert(dumpTrace(object).find(event("transfer", object, &handles[0], &stolen)) !=
+           std::string::npos);
+}
+
+void test3() {
+    pthread_t thread;
+    pthread_create(&thread, NULL, makeManyEvents, NULL);
+    pthread_join(thread, NULL);
+
+    const std::string trace = dumpTrace();
+    const std::size_t header = trace.find(" events 200\n");
+    assert(header != std::string::npos);
+
+    std::size_t records = 0;
+    std::size_t line = trace.find('\n', header) + 1;
+    while (line < trace.size() && trace.compare(line, 2, "  ") == 0) {
+        ++records;
+        line = trace.find('\n', line) + 1;
+    }
+    assert(records == MEM_OWNERSHIP_TRACE_SIZE);
+    assert(trace.compare(header + 12, 6, "  137 ") == 0);
+}
+
+void test4() {
+    FooPtr foo(new Foo());
+
+    std::FILE *file = std::tmpfile();
+    signalFd = fileno(file);
+    std::signal(SIGUSR1, dumpOnSignal);
+    std::raise(SIGUSR1);
+    std::signal(SIGUSR1, SIG_DFL);
+
+    assert(readAndClose(file).find(pointer(foo.get())) != std::string::npos);
+}
+
+int main(void) {
+    test1();
+    test2();
+    test3();
+    test4();
+
+    return 0;
+}
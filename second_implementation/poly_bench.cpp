@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <vector>
+
+#include "benchmark.h"
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "poly_collection.h"
+
+/**
+ * Вызов виртуального draw() на миллионе виджетов трех типов, перемешанных случайно:
+ * std::vector владеющих указателей на базу против mem::PolyCollection, где объекты сгруппированы
+ * по типу. Первый аргумент задает число виджетов, второй - число проходов.
+ */
+
+namespace {
+
+struct Widget {
+    virtual ~Widget() {}
+    virtual size_t draw() const = 0;
+};
+
+struct Button : public Widget {
+    explicit Button(size_t id): id_(id) {}
+
+    size_t draw() const {
+        return id_ + 1;
+    }
+
+private:
+    size_t id_;
+};
+
+struct Label : public Widget {
+    explicit Label(size_t id): id_(id), width_(id % 80) {}
+
+    size_t draw() const {
+        return id_ ^ width_;
+    }
+
+private:
+    size_t id_;
+    size_t width_;
+};
+
+struct Window : public Widget {
+    explicit Window(size_t id): id_(id) {
+        for (size_t i = 0; i < sizeof(title_); ++i) {
+            title_[i] = static_cast<char>('a' + (id + i) % 26);
+        }
+    }
+
+    size_t draw() const {
+        return id_ * 2 + static_cast<size_t>(title_[0]);
+    }
+
+private:
+    size_t id_;
+    char title_[40];
+};
+
+typedef mem::UniquePtr<Widget>::RvalueType WidgetPtr;
+
+struct SumDraw {
+    SumDraw(): sum(0) {}
+
+    void operator()(const Widget &widget) {
+        sum += widget.draw();
+    }
+
+    size_t sum;
+};
+
+// Qualified call: resolved at compile time, so it can be inlined
+template<typename T>
+struct SumStaticDraw {
+    SumStaticDraw(): sum(0) {}
+
+    void operator()(const T &widget) {
+        sum += widget.T::draw();
+    }
+
+    size_t sum;
+};
+
+struct VectorDraw {
+    explicit VectorDraw(const std::vector<WidgetPtr> &widgets): widgets_(&widgets) {}
+
+    void operator()(size_t n) const {
+        const std::vector<WidgetPtr> &widgets = *widgets_;
+        size_t sum = 0;
+        for (size_t pass = 0; pass < n / widgets.size(); ++pass) {
+            for (size_t i = 0; i < widgets.size(); ++i) {
+                sum += widgets[i].borrow<Widget>()->draw();
+            }
+        }
+        bench::doNotOptimize(sum);
+    }
+
+private:
+    const std::vector<WidgetPtr> *widgets_;
+};
+
+struct PolyDraw {
+    explicit PolyDraw(mem::PolyCollection<Widget> &widgets): widgets_(&widgets) {}
+
+    void operator()(size_t n) const {
+        size_t sum = 0;
+        for (size_t pass = 0; pass < n / widgets_->size(); ++pass) {
+            sum += widgets_->forEach(SumDraw()).sum;
+        }
+        bench::doNotOptimize(sum);
+    }
+
+private:
+    mem::PolyCollection<Widget> *widgets_;
+};
+
+struct PolyStaticDraw {
+    explicit PolyStaticDraw(mem::PolyCollection<Widget> &widgets): widgets_(&widgets) {}
+
+    void operator()(size_t n) const {
+        size_t sum = 0;
+        for (size_t pass = 0; pass < n / widgets_->size(); ++pass) {
+            sum += widgets_->forEach<Button>(SumStaticDraw<Button>()).sum;
+            sum += widgets_->forEach<Label>(SumStaticDraw<Label>()).sum;
+            sum += widgets_->forEach<Window>(SumStaticDraw<Window>()).sum;
+        }
+        bench::doNotOptimize(sum);
+    }
+
+private:
+    mem::PolyCollection<Widget> *widgets_;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t count = bench::iterationsFromArgs(argc, argv, 1000000);
+    const size_t passes = bench::iterationsFromArgs(argc - 1, argv + 1, 10);
+
+    std::vector<WidgetPtr> vector;
+    mem::PolyCollection<Widget> collection;
+    vector.reserve(count);
+    size_t random = 12345;
+    for (size_t i = 0; i < count; ++i) {
+        random = random * 1103515245 + 12345;
+        switch ((random >> 16) % 3) {
+        case 0:
+            vector.push_back(mem::makeUnique<Button>(i));
+            collection.insert(mem::makeUnique<Button>(i));
+            break;
+        case 1:
+            vector.push_back(mem::makeUnique<Label>(i));
+            collection.insert(mem::makeUnique<Label>(i));
+            break;
+        default:
+            vector.push_back(mem::makeUnique<Window>(i));
+            collection.insert(mem::makeUnique<Window>(i));
+            break;
+        }
+    }
+
+    std::printf("widgets: %lu, passes: %lu\n\n", static_cast<unsigned long>(count),
+                static_cast<unsigned long>(passes));
+    bench::printHeader();
+    bench::run("draw std::vector<RvalueType>", count * passes, VectorDraw(vector));
+    bench::run("draw PolyCollection::forEach", count * passes, PolyDraw(collection));
+    bench::run("draw PolyCollection::forEach<Derived>", count * passes,
+               PolyStaticDraw(collection));
+
+    return 0;
+}
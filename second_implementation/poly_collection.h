@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <typeinfo>
+#include <vector>
+
+#include "unique_ptr.h"
+
+namespace mem {
+
+namespace detail {
+
+template<typename Base>
+struct PolySegment {
+    virtual ~PolySegment() {}
+
+    virtual const std::type_info &type() const = 0;
+    // Base subobject of the first element, NULL if the segment is empty
+    virtual Base *data() = 0;
+    virtual std::size_t size() const = 0;
+    virtual std::size_t stride() const = 0;
+    virtual void clear() = 0;
+};
+
+template<typename Base, typename Derived>
+struct PolyTypedSegment : public PolySegment<Base> {
+    const std::type_info &type() const {
+        return typeid(Derived);
+    }
+
+    Base *data() {
+        return objects.empty() ? NULL : static_cast<Base *>(&objects[0]);
+    }
+
+    std::size_t size() const {
+        return objects.size();
+    }
+
+    std::size_t stride() const {
+        return sizeof(Derived);
+    }
+
+    void clear() {
+        objects.clear();
+    }
+
+    std::vector<Derived> objects;
+};
+
+} // namespace detail
+
+// Owns objects of types derived from Base, stored by value in one contiguous segment per
+// concrete type. forEach() walks segment by segment, so the virtual calls made on a run of
+// elements all go to the same target and the branch predictor gets them right;
+// forEach<Derived>() hands out Derived & and lets the compiler resolve the calls statically.
+// Element order is by type, not by insertion.
+// insert() does not take over the object: C++03 has no move, so it copies the object into its
+// segment and destroys the original. Elements must therefore be copy constructible, and an element
+// lives at a different address than the object that was inserted
+template<typename Base>
+class PolyCollection {
+public:
+    PolyCollection();
+    ~PolyCollection();
+
+    // Copies the object owned by rvalue, e.g. insert(makeUnique<Button>("ok")), and destroys it.
+    // Throws std::invalid_argument (the object is still destroyed) if its dynamic type is not
+    // E::ValueType, since the copy would slice it
+    template<typename E>
+    void insert(const UniquePtr<void, E> &rvalue);
+
+    // Calls f(Base &) on every element, one segment after another; returns f like std::for_each
+    template<typename F>
+    F forEach(F f);
+
+    // Calls f(Derived &) on the elements of the Derived segment only
+    template<typename Derived, typename F>
+    F forEach(F f);
+
+    std::size_t size() const;
+
+    template<typename Derived>
+    std::size_t count() const;
+
+    bool empty() const;
+    void clear();
+
+private:
+    typedef detail::PolySegment<Base> Segment;
+
+    PolyCollection(const PolyCollection &);
+    PolyCollection &operator=(const PolyCollection &);
+
+    template<typename Derived>
+    detail::PolyTypedSegment<Base, Derived> *findSegment() const;
+
+    template<typename Derived>
+    detail::PolyTypedSegment<Base, Derived> &segmentOf();
+
+    std::vector<Segment *> segments_;
+};
+
+template<typename Base>
+PolyCollection<Base>::PolyCollection() {
+}
+
+template<typename Base>
+PolyCollection<Base>::~PolyCollection() {
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+        delete segments_[i];
+    }
+}
+
+template<typename Base>
+template<typename E>
+void PolyCollection<Base>::insert(const UniquePtr<void, E> &rvalue) {
+    typedef typename E::ValueType Derived;
+
+    // Destroys the original with its own deleter, also if the copy throws
+    UniquePtr<Derived, E> owner(rvalue);
+    if (owner.get() == NULL) {
+        return;
+    }
+    if (typeid(*owner.get()) != typeid(Derived)) {
+        throw std::invalid_argument("PolyCollection::insert: the object would be sliced");
+    }
+    segmentOf<Derived>().objects.push_back(*owner);
+}
+
+template<typename Base>
+template<typename F>
+F PolyCollection<Base>::forEach(F f) {
+    for (std::size_t segment = 0; segment < segments_.size(); ++segment) {
+        Segment &objects = *segments_[segment];
+        char *data = reinterpret_cast<char *>(objects.data());
+        const std::size_t size = objects.size();
+        const std::size_t stride = objects.stride();
+        for (std::size_t i = 0; i < size; ++i) {
+            f(*reinterpret_cast<Base *>(data + i * stride));
+        }
+    }
+    return f;
+}
+
+template<typename Base>
+template<typename Derived, typename F>
+F PolyCollection<Base>::forEach(F f) {
+    detail::PolyTypedSegment<Base, Derived> *segment = findSegment<Derived>();
+    if (segment != NULL) {
+        std::vector<Derived> &objects = segment->objects;
+        for (std::size_t i = 0; i < objects.size(); ++i) {
+            f(objects[i]);
+        }
+    }
+    return f;
+}
+
+template<typename Base>
+std::size_t PolyCollection<Base>::size() const {
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+        size += segments_[i]->size();
+    }
+    return size;
+}
+
+template<typename Base>
+template<typename Derived>
+std::size_t PolyCollection<Base>::count() const {
+    detail::PolyTypedSegment<Base, Derived> *segment = findSegment<Derived>();
+    return segment == NULL ? 0 : segment->size();
+}
+
+template<typename Base>
+bool PolyCollection<Base>::empty() const {
+    return size() == 0;
+}
+
+// Keeps the segments, so refilling the collection does not allocate them again
+template<typename Base>
+void PolyCollection<Base>::clear() {
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+        segments_[i]->clear();
+    }
+}
+
+template<typename Base>
+template<typename Derived>
+detail::PolyTypedSegment<Base, Derived> *PolyCollection<Base>::findSegment() const {
+    for (std::size_t i = 0; i < segments_.size(); ++i) {
+        if (segments_[i]->type() == typeid(Derived)) {
+            return static_cast<detail::PolyTypedSegment<Base, Derived> *>(segments_[i]);
+        }
+    }
+    return NULL;
+}
+
+template<typename Base>
+template<typename Derived>
+detail::PolyTypedSegment<Base, Derived> &PolyCollection<Base>::segmentOf() {
+    detail::PolyTypedSegment<Base, Derived> *segment = findSegment<Derived>();
+    if (segment == NULL) {
+        segments_.reserve(segments_.size() + 1);
+        segment = new detail::PolyTypedSegment<Base, Derived>();
+        segments_.push_back(segment);
+    }
+    return *segment;
+}
+
+} // namespace mem
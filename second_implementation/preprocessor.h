@@ -0,0 +1,22 @@
+#pragma once
+
+// Macros that generate C++03 overloads taking 1..10 arguments (makeUnique, makeUniqueWith,
+// allocateUnique, SlabAllocator::make). They are defined once, here, and never #undef'd: the
+// header is guarded by #pragma once, so nothing would define them again.
+// MEM_PP_REPEAT_n(m) expands to m(1), m(2), ..., m(n); with MEM_PP_TEMPLATE_PARAM,
+// MEM_PP_FUNCTION_PARAM and MEM_PP_ARGUMENT it yields "typename A1, ..., typename An",
+// "const A1 &a1, ..., const An &an" and "a1, ..., an"
+#define MEM_PP_REPEAT_1(m) m(1)
+#define MEM_PP_REPEAT_2(m) MEM_PP_REPEAT_1(m), m(2)
+#define MEM_PP_REPEAT_3(m) MEM_PP_REPEAT_2(m), m(3)
+#define MEM_PP_REPEAT_4(m) MEM_PP_REPEAT_3(m), m(4)
+#define MEM_PP_REPEAT_5(m) MEM_PP_REPEAT_4(m), m(5)
+#define MEM_PP_REPEAT_6(m) MEM_PP_REPEAT_5(m), m(6)
+#define MEM_PP_REPEAT_7(m) MEM_PP_REPEAT_6(m), m(7)
+#define MEM_PP_REPEAT_8(m) MEM_PP_REPEAT_7(m), m(8)
+#define MEM_PP_REPEAT_9(m) MEM_PP_REPEAT_8(m), m(9)
+#define MEM_PP_REPEAT_10(m) MEM_PP_REPEAT_9(m), m(10)
+
+#define MEM_PP_TEMPLATE_PARAM(i) typename A##i
+#define MEM_PP_FUNCTION_PARAM(i) const A##i &a##i
+#define MEM_PP_ARGUMENT(i) a##i
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <typeinfo>
+#include <vector>
+
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "preprocessor.h"
+
+namespace mem {
+
+class SlabAllocator;
+
+// Returns an object to the slab of its dynamic type, so a handle converted to a base still frees
+// into the right slab. T must be polymorphic and have a virtual destructor
+template<typename T>
+struct SlabDeleter {
+    typedef T ValueType;
+
+    SlabDeleter();
+    explicit SlabDeleter(SlabAllocator *allocator);
+
+    template<typename U>
+    SlabDeleter(const SlabDeleter<U> &other);
+
+    void operator()(void *ptr);
+
+    SlabAllocator *allocator() const;
+
+private:
+    SlabAllocator *allocator_;
+};
+
+// One slab per concrete type: objects of the same type are carved out of the same chunks of
+// equally sized slots, so iterating over many of them touches contiguous memory instead of
+// wherever global new put them. Freed slots go to the free list of their slab and are reused
+// first; chunks are returned to the system only by the destructor.
+// Not thread-safe. The allocator must outlive every handle created from it
+class SlabAllocator {
+public:
+    explicit SlabAllocator(std::size_t objectsPerChunk = 64);
+    ~SlabAllocator();
+
+    // make<T>(a1, ..., aN): constructs T in the slab of T. Arguments are forwarded by const
+    // reference (C++03). If the constructor throws, the slot goes back to the slab
+    template<typename T>
+    typename UniquePtr<T, SlabDeleter<T> >::RvalueType make();
+
+#define MEM_SLAB_MAKE(n) \
+    template<typename T, MEM_PP_REPEAT_##n(MEM_PP_TEMPLATE_PARAM)> \
+    typename UniquePtr<T, SlabDeleter<T> >::RvalueType make( \
+            MEM_PP_REPEAT_##n(MEM_PP_FUNCTION_PARAM)) { \
+        Slot slot(*this, slabOf<T>()); \
+        return adopt(new (slot.data) T(MEM_PP_REPEAT_##n(MEM_PP_ARGUMENT)), slot); \
+    }
+
+    MEM_SLAB_MAKE(1)
+    MEM_SLAB_MAKE(2)
+    MEM_SLAB_MAKE(3)
+    MEM_SLAB_MAKE(4)
+    MEM_SLAB_MAKE(5)
+    MEM_SLAB_MAKE(6)
+    MEM_SLAB_MAKE(7)
+    MEM_SLAB_MAKE(8)
+    MEM_SLAB_MAKE(9)
+    MEM_SLAB_MAKE(10)
+
+#undef MEM_SLAB_MAKE
+
+    // Destroys the object and returns its slot to the slab of typeid(*object)
+    template<typename T>
+    void destroy(T *object);
+
+    // Number of live objects in the slab of T
+    template<typename T>
+    std::size_t count() const;
+
+    // Distance between two neighbouring objects of this size in a slab
+    static std::size_t slotSize(std::size_t objectSize);
+
+private:
+    struct Slab {
+        const std::type_info *type;
+        std::size_t slotSize;
+        void *free; // singly linked through the first word of each free slot
+        char *next; // unused part of the last chunk
+        char *end;
+        std::size_t live;
+    };
+
+    // A slot taken from a slab; given back unless the object built in it is adopted
+    struct Slot {
+        Slot(SlabAllocator &allocator, Slab &slab);
+        ~Slot();
+
+        Slab *slab;
+        void *data;
+    };
+
+    union MaxAlign {
+        long double number;
+        long integer;
+        void *pointer;
+        void (*function)();
+    };
+
+    SlabAllocator(const SlabAllocator &);
+    SlabAllocator &operator=(const SlabAllocator &);
+
+    template<typename T>
+    Slab &slabOf();
+
+    template<typename T>
+    typename UniquePtr<T, SlabDeleter<T> >::RvalueType adopt(T *object, Slot &slot);
+
+    Slab *findSlab(const std::type_info &type) const;
+    void *allocate(Slab &slab);
+    static void deallocate(Slab &slab, void *data);
+
+    std::size_t objectsPerChunk_;
+    std::vector<Slab *> slabs_;
+    std::vector<void *> chunks_;
+};
+
+/**
+    template<typename T>
+    struct SlabDeleter
+ **/
+template<typename T>
+SlabDeleter<T>::SlabDeleter():
+allocator_(NULL) {
+}
+
+template<typename T>
+SlabDeleter<T>::SlabDeleter(SlabAllocator *allocator):
+allocator_(allocator) {
+}
+
+template<typename T>
+template<typename U>
+SlabDeleter<T>::SlabDeleter(const SlabDeleter<U> &other):
+allocator_(other.allocator()) {
+}
+
+template<typename T>
+void SlabDeleter<T>::operator()(void *ptr) {
+    assert(allocator_ != NULL);
+    allocator_->destroy(static_cast<T *>(ptr));
+}
+
+template<typename T>
+SlabAllocator *SlabDeleter<T>::allocator() const {
+    return allocator_;
+}
+
+/**
+    class SlabAllocator
+ **/
+inline SlabAllocator::SlabAllocator(std::size_t objectsPerChunk):
+objectsPerChunk_(objectsPerChunk == 0 ? 1 : objectsPerChunk) {
+}
+
+inline SlabAllocator::~SlabAllocator() {
+    for (std::size_t i = 0; i < chunks_.size(); ++i) {
+        ::operator delete(chunks_[i]);
+    }
+    for (std::size_t i = 0; i < slabs_.size(); ++i) {
+        delete slabs_[i];
+    }
+}
+
+template<typename T>
+typename UniquePtr<T, SlabDeleter<T> >::RvalueType SlabAllocator::make() {
+    Slot slot(*this, slabOf<T>());
+    return adopt(new (slot.data) T(), slot);
+}
+
+template<typename T>
+void SlabAllocator::destroy(T *object) {
+    Slab *slab = findSlab(typeid(*object));
+    assert(slab != NULL);
+    void *data = dynamic_cast<void *>(object);
+    object->~T();
+    deallocate(*slab, data);
+}
+
+template<typename T>
+std::size_t SlabAllocator::count() const {
+    Slab *slab = findSlab(typeid(T));
+    return slab == NULL ? 0 : slab->live;
+}
+
+inline std::size_t SlabAllocator::slotSize(std::size_t objectSize) {
+    const std::size_t size = objectSize < sizeof(void *) ? sizeof(void *) : objectSize;
+    return (size + sizeof(MaxAlign) - 1) / sizeof(MaxAlign) * sizeof(MaxAlign);
+}
+
+inline SlabAllocator::Slot::Slot(SlabAllocator &allocator, Slab &slab):
+slab(&slab),
+data(allocator.allocate(slab)) {
+}
+
+inline SlabAllocator::Slot::~Slot() {
+    if (data != NULL) {
+        deallocate(*slab, data);
+    }
+}
+
+template<typename T>
+SlabAllocator::Slab &SlabAllocator::slabOf() {
+    Slab *slab = findSlab(typeid(T));
+    if (slab == NULL) {
+        slabs_.reserve(slabs_.size() + 1);
+        slab = new Slab();
+        slab->type = &typeid(T);
+        slab->slotSize = slotSize(sizeof(T));
+        slabs_.push_back(slab);
+    }
+    return *slab;
+}
+
+template<typename T>
+typename UniquePtr<T, SlabDeleter<T> >::RvalueType SlabAllocator::adopt(T *object, Slot &slot) {
+    slot.data = NULL;
+    return UniquePtr<T, SlabDeleter<T> >(object, SlabDeleter<T>(this)).move();
+}
+
+// A linear scan: a hierarchy has a handful of concrete types, and comparing type_info pointers
+// first is cheaper than hashing names
+inline SlabAllocator::Slab *SlabAllocator::findSlab(const std::type_info &type) const {
+    for (std::size_t i = 0; i < slabs_.size(); ++i) {
+        if (slabs_[i]->type == &type) {
+            return slabs_[i];
+        }
+    }
+    for (std::size_t i = 0; i < slabs_.size(); ++i) {
+        if (*slabs_[i]->type == type) {
+            return slabs_[i];
+        }
+    }
+    return NULL;
+}
+
+inline void *SlabAllocator::allocate(Slab &slab) {
+    if (slab.free != NULL) {
+        void *data = slab.free;
+        slab.free = *static_cast<void **>(data);
+        ++slab.live;
+        return data;
+    }
+    if (slab.next == slab.end) {
+        chunks_.push_back(NULL);
+        char *chunk = static_cast<char *>(::operator new(slab.slotSize * objectsPerChunk_));
+        chunks_.back() = chunk;
+        slab.next = chunk;
+        slab.end = chunk + slab.slotSize * objectsPerChunk_;
+    }
+    void *data = slab.next;
+    slab.next += slab.slotSize;
+    ++slab.live;
+    return data;
+}
+
+inline void SlabAllocator::deallocate(Slab &slab, void *data) {
+    *static_cast<void **>(data) = slab.free;
+    slab.free = data;
+    --slab.live;
+}
+
+} // namespace mem
@@ -0,0 +1,150 @@
+#include <cstdio>
+#include <vector>
+
+#include "benchmark.h"
+#include "unique_ptr.h"
+#include "make_unique.h"
+#include "slab_allocator.h"
+
+/**
+ * Обход иерархии виджетов, созданных глобальным new вперемешку с другими выделениями, против
+ * виджетов из mem::SlabAllocator, где объекты одного типа лежат подряд. Первый аргумент задает
+ * число вызовов draw(), второй - число виджетов.
+ */
+
+namespace {
+
+struct Widget {
+    virtual ~Widget() {}
+    virtual size_t draw() const = 0;
+};
+
+struct Button : public Widget {
+    explicit Button(size_t id): id_(id), pressed_(false) {}
+
+    size_t draw() const {
+        return id_ + (pressed_ ? 1 : 0);
+    }
+
+private:
+    size_t id_;
+    bool pressed_;
+};
+
+struct Window : public Widget {
+    explicit Window(size_t id): id_(id) {
+        for (size_t i = 0; i < sizeof(title_); ++i) {
+            title_[i] = static_cast<char>('a' + (id + i) % 26);
+        }
+    }
+
+    size_t draw() const {
+        return id_ * 2 + static_cast<size_t>(title_[id_ % sizeof(title_)]);
+    }
+
+private:
+    size_t id_;
+    char title_[40];
+};
+
+typedef mem::UniquePtr<Widget>::RvalueType HeapWidget;
+typedef mem::UniquePtr<Widget, mem::SlabDeleter<Widget> >::RvalueType SlabWidget;
+
+// Other allocations of the program that end up between the widgets
+struct Noise {
+    std::vector<char *> blocks;
+
+    void allocate(size_t i) {
+        blocks.push_back(new char[16 + (i * 37) % 240]);
+    }
+
+    ~Noise() {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            delete[] blocks[i];
+        }
+    }
+};
+
+template<typename W>
+struct DrawWidgets {
+    explicit DrawWidgets(const std::vector<W> &widgets): widgets_(&widgets) {}
+
+    void operator()(size_t n) const {
+        const std::vector<W> &widgets = *widgets_;
+        size_t sum = 0;
+        for (size_t i = 0, j = 0; i < n; ++i) {
+            sum += widgets[j].template borrow<Widget>()->draw();
+            if (++j == widgets.size()) {
+                j = 0;
+            }
+        }
+        bench::doNotOptimize(sum);
+    }
+
+private:
+    const std::vector<W> *widgets_;
+};
+
+/**
+    Construct / destroy
+ **/
+struct HeapConstructDestroy {
+    void operator()(size_t n) const {
+        for (size_t i = 0; i < n; ++i) {
+            mem::UniquePtr<Widget> widget(mem::makeUnique<Button>(i));
+            bench::doNotOptimize(widget);
+        }
+    }
+};
+
+struct SlabConstructDestroy {
+    explicit SlabConstructDestroy(mem::SlabAllocator &slabs): slabs_(&slabs) {}
+
+    void operator()(size_t n) const {
+        for (size_t i = 0; i < n; ++i) {
+            mem::UniquePtr<Widget, mem::SlabDeleter<Widget> > widget(slabs_->make<Button>(i));
+            bench::doNotOptimize(widget);
+        }
+    }
+
+private:
+    mem::SlabAllocator *slabs_;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const size_t n = bench::iterationsFromArgs(argc, argv, 10000000);
+    const size_t count = bench::iterationsFromArgs(argc - 1, argv + 1, 100000);
+
+    std::printf("draw() calls: %lu, widgets: %lu\n", static_cast<unsigned long>(n),
+                static_cast<unsigned long>(count));
+    std::printf("sizeof(Button) = %lu, sizeof(Window) = %lu\n\n",
+                static_cast<unsigned long>(sizeof(Button)),
+                static_cast<unsigned long>(sizeof(Window)));
+
+    mem::SlabAllocator slabs(1024);
+    Noise noise;
+    std::vector<HeapWidget> heapWidgets;
+    std::vector<SlabWidget> slabWidgets;
+    heapWidgets.reserve(count);
+    slabWidgets.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 2 == 0) {
+            heapWidgets.push_back(mem::makeUnique<Button>(i));
+            slabWidgets.push_back(slabs.make<Button>(i));
+        } else {
+            heapWidgets.push_back(mem::makeUnique<Window>(i));
+            slabWidgets.push_back(slabs.make<Window>(i));
+        }
+        noise.allocate(i);
+    }
+
+    bench::printHeader();
+    bench::run("draw global new", n, DrawWidgets<HeapWidget>(heapWidgets));
+    bench::run("draw mem::SlabAllocator", n, DrawWidgets<SlabWidget>(slabWidgets));
+    bench::run("construct/destroy global new", n, HeapConstructDestroy());
+    bench::run("construct/destroy mem::SlabAllocator", n, SlabConstructDestroy(slabs));
+
+    return 0;
+}
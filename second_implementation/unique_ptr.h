@@ -1,16 +1,71 @@
 #pragma once
 
+#include <cstddef>
 #include <new>
 
+#include "observer_ptr.h"
+
+#ifdef MEM_INSTRUMENTATION
+#include "instrumentation.h"
+
+#define MEM_COUNT_OWNERSHIP(T, event, data) \
+    ::mem::instrumentation::record<T>(::mem::instrumentation::event, data)
+#define MEM_COUNT_CONVERSION(U, T, data) ::mem::instrumentation::recordConversion<U, T>(data)
+#else
+#define MEM_COUNT_OWNERSHIP(T, event, data) ((void) 0)
+#define MEM_COUNT_CONVERSION(U, T, data) ((void) 0)
+#endif
+
+#ifdef MEM_OWNERSHIP_TRACE
+#include "ownership_trace.h"
+
+#define MEM_TRACE_OWNERSHIP(event, data, source, destination) \
+    ::mem::traceOwnership(::mem::instrumentation::event, data, source, destination)
+#else
+#define MEM_TRACE_OWNERSHIP(event, data, source, destination) ((void) 0)
+#endif
+
+// Ownership event hooks: data is the stored object, source and destination are the handles giving
+// up and taking ownership (NULL if there is none). They expand to nothing unless
+// MEM_INSTRUMENTATION or MEM_OWNERSHIP_TRACE is defined
+#if defined(MEM_INSTRUMENTATION) || defined(MEM_OWNERSHIP_TRACE)
+#define MEM_INSTRUMENT(T, event, data, source, destination) \
+    (MEM_COUNT_OWNERSHIP(T, event, data), MEM_TRACE_OWNERSHIP(event, data, source, destination))
+#define MEM_INSTRUMENT_CONVERT(U, T, data, source, destination) \
+    (MEM_COUNT_CONVERSION(U, T, data), MEM_TRACE_OWNERSHIP(Convert, data, source, destination))
+#else
+#define MEM_INSTRUMENT(T, event, data, source, destination)
+#define MEM_INSTRUMENT_CONVERT(U, T, data, source, destination)
+#endif
+
 namespace mem {
 
 struct PlugClass {};
 
+namespace detail {
+
+struct UniqueFactory;
+
+// The deleter stored by UniquePtr<T, D>, and so by its RvalueType. It is D, except for deleters
+// that erase the type (AnyDeleter): any_deleter.h gives them T back, so that handles of unrelated
+// types do not share one RvalueType
+template<typename T, typename D>
+struct HandleDeleter {
+    typedef D Type;
+};
+
+} // namespace detail
+
 template<typename T>
 struct Deleter {
     typedef T ValueType;
     typedef ValueType *Pointer;
 
+    Deleter() {}
+
+    template<typename U>
+    Deleter(const Deleter<U> &) {}
+
     void operator()(void *ptr) {
         delete static_cast<Pointer>(ptr);
     }
@@ -30,32 +85,62 @@ public:
 
     UniquePtr(const SelfType &other);
     UniquePtr &operator=(const SelfType &other);
-    virtual ~UniquePtr();
+    ~UniquePtr();
+
+    // Conversion from the rvalue of a derived type: E::ValueType * must convert to D::ValueType *
+    template<typename E>
+    UniquePtr(const UniquePtr<void, E> &other);
+
+    template<typename E>
+    UniquePtr &operator=(const UniquePtr<void, E> &other);
 
     PointType release();
+    DeleterType &getDeleter();
+
+    // A non-owning view as U, a base of D::ValueType (or the type itself, possibly const)
+    template<typename U>
+    ObserverPtr<U> borrow() const;
 
 protected:
     UniquePtr(PointType data = NULL);
+    UniquePtr(PointType data, const DeleterType &deleter);
     PointType releaseData() const;
     PointType get();
 
+    template<typename U, typename E>
+    static PointType convertData(const UniquePtr<void, E> &other);
+
 private:
+    template<typename, typename, typename>
+    friend struct UniquePtr;
+
+    friend struct detail::UniqueFactory;
+
     void destroyData();
 
     mutable PointType data_;
 };
 
 template<typename T, typename D>
-struct UniquePtr<T, D> : public UniquePtr<void, D> {
+struct UniquePtr<T, D> : public UniquePtr<void, typename detail::HandleDeleter<T, D>::Type> {
 public:
     typedef T ValueType;
     typedef ValueType *PointType;
-    typedef D DeleterType;
+    typedef typename detail::HandleDeleter<T, D>::Type DeleterType;
     typedef UniquePtr<void, DeleterType> RvalueType;
 
     UniquePtr(PointType data = NULL);
+    UniquePtr(PointType data, const DeleterType &deleter);
     UniquePtr(const RvalueType &rvalue);
 
+    template<typename E>
+    UniquePtr(const UniquePtr<void, E> &rvalue);
+
+    UniquePtr &operator=(const RvalueType &rvalue);
+
+    template<typename E>
+    UniquePtr &operator=(const UniquePtr<void, E> &rvalue);
+
     RvalueType move();
 
     ValueType &operator*();
@@ -64,11 +149,18 @@ public:
     PointType release();
     PointType get();
 
+    ObserverPtr<ValueType> borrow() const;
+    ObserverPtr<const ValueType> borrowConst() const;
+
 private:
     typedef UniquePtr<void, DeleterType> DataType;
 
     UniquePtr(const UniquePtr<ValueType, DeleterType> &other);
     UniquePtr<ValueType, DeleterType> operator=(const UniquePtr<ValueType, DeleterType> &other);
+
+    // Rejects implicit stealing from an lvalue UniquePtr<U, E>: only its move() result converts
+    template<typename U, typename E>
+    UniquePtr(const UniquePtr<U, E> &other);
 };
 
 /**
@@ -81,18 +173,44 @@ UniquePtr<void, D>::UniquePtr(SelfType::PointType data):
 data_(data) {
 }
 
+template<typename D>
+UniquePtr<void, D>::UniquePtr(PointType data, const DeleterType &deleter):
+DeleterType(deleter),
+data_(data) {
+}
+
 template<typename D>
 UniquePtr<void, D>::UniquePtr(const SelfType &other):
+DeleterType(other),
 data_(other.releaseData()) {
+    MEM_INSTRUMENT(typename D::ValueType, Transfer, data_, &other, this);
 }
 
 template<typename D>
 UniquePtr<void, D> &UniquePtr<void, D>::operator=(const SelfType &other) {
-    destroyData();
-    data_ = other.releaseData();
+    if (this != &other) {
+        destroyData();
+        DeleterType::operator=(other);
+        data_ = other.releaseData();
+        MEM_INSTRUMENT(typename D::ValueType, Transfer, data_, &other, this);
+    }
     return *this;
 }
 
+template<typename D>
+template<typename E>
+UniquePtr<void, D>::UniquePtr(const UniquePtr<void, E> &other):
+DeleterType(static_cast<const E &>(other)),
+data_(convertData<typename DeleterType::ValueType>(other)) {
+    MEM_INSTRUMENT_CONVERT(typename E::ValueType, typename D::ValueType, data_, &other, this);
+}
+
+template<typename D>
+template<typename E>
+UniquePtr<void, D> &UniquePtr<void, D>::operator=(const UniquePtr<void, E> &other) {
+    return *this = SelfType(other);
+}
+
 template<typename D>
 UniquePtr<void, D>::~UniquePtr() {
     destroyData();
@@ -100,7 +218,21 @@ UniquePtr<void, D>::~UniquePtr() {
 
 template<typename D>
 typename UniquePtr<void, D>::PointType UniquePtr<void, D>::release() {
-    return releaseData();
+    PointType data = releaseData();
+    MEM_INSTRUMENT(typename D::ValueType, Release, data, this, NULL);
+    return data;
+}
+
+template<typename D>
+typename UniquePtr<void, D>::DeleterType &UniquePtr<void, D>::getDeleter() {
+    return *this;
+}
+
+template<typename D>
+template<typename U>
+ObserverPtr<U> UniquePtr<void, D>::borrow() const {
+    typename D::ValueType *typed = static_cast<typename D::ValueType *>(data_);
+    return ObserverPtr<U>(typed);
 }
 
 template<typename D>
@@ -110,9 +242,17 @@ typename UniquePtr<void, D>::PointType UniquePtr<void, D>::releaseData() const {
     return ptr;
 }
 
+template<typename D>
+template<typename U, typename E>
+typename UniquePtr<void, D>::PointType UniquePtr<void, D>::convertData(const UniquePtr<void, E> &other) {
+    U *data = static_cast<typename E::ValueType *>(other.releaseData());
+    return data;
+}
+
 template<typename D>
 void UniquePtr<void, D>::destroyData() {
     if (data_ != NULL) {
+        MEM_INSTRUMENT(typename D::ValueType, Delete, data_, this, NULL);
         DeleterType::operator()(data_);
     }
 }
@@ -124,11 +264,18 @@ typename UniquePtr<void, D>::PointType UniquePtr<void, D>::get() {
 
 /**
     template<typename T, typename D>
-    struct UniquePtr<T, D> : public UniquePtr<void, D>
+    struct UniquePtr<T, D> : public UniquePtr<void, detail::HandleDeleter<T, D>::Type>
  **/
 template<typename T, typename D>
 UniquePtr<T, D>::UniquePtr(PointType data):
 DataType(data) {
+    MEM_INSTRUMENT(typename DeleterType::ValueType, Construct, data, NULL, this);
+}
+
+template<typename T, typename D>
+UniquePtr<T, D>::UniquePtr(PointType data, const DeleterType &deleter):
+DataType(data, deleter) {
+    MEM_INSTRUMENT(typename DeleterType::ValueType, Construct, data, NULL, this);
 }
 
 template<typename T, typename D>
@@ -137,8 +284,32 @@ DataType(rvalue) {
 }
 
 template<typename T, typename D>
-UniquePtr<void, D> UniquePtr<T, D>::move() {
-    return static_cast<RvalueType>(*this);
+template<typename E>
+UniquePtr<T, D>::UniquePtr(const UniquePtr<void, E> &rvalue):
+DataType(DataType::template convertData<ValueType>(rvalue), DeleterType(static_cast<const E &>(rvalue))) {
+    MEM_INSTRUMENT_CONVERT(typename E::ValueType, typename DeleterType::ValueType, get(), &rvalue, this);
+}
+
+template<typename T, typename D>
+UniquePtr<T, D> &UniquePtr<T, D>::operator=(const RvalueType &rvalue) {
+    DataType::operator=(rvalue);
+    return *this;
+}
+
+template<typename T, typename D>
+template<typename E>
+UniquePtr<T, D> &UniquePtr<T, D>::operator=(const UniquePtr<void, E> &rvalue) {
+    DataType::operator=(RvalueType(DataType::template convertData<ValueType>(rvalue),
+                                   DeleterType(static_cast<const E &>(rvalue))));
+    MEM_INSTRUMENT_CONVERT(typename E::ValueType, typename DeleterType::ValueType, get(), &rvalue, this);
+    return *this;
+}
+
+template<typename T, typename D>
+typename UniquePtr<T, D>::RvalueType UniquePtr<T, D>::move() {
+    RvalueType rvalue(DataType::releaseData(), DataType::getDeleter());
+    MEM_INSTRUMENT(typename DeleterType::ValueType, Move, rvalue.data_, this, &rvalue);
+    return rvalue;
 }
 
 template<typename T, typename D>
@@ -161,4 +332,14 @@ typename UniquePtr<T, D>::PointType UniquePtr<T, D>::get() {
     return static_cast<PointType>(DataType::get());
 }
 
+template<typename T, typename D>
+ObserverPtr<typename UniquePtr<T, D>::ValueType> UniquePtr<T, D>::borrow() const {
+    return DataType::template borrow<ValueType>();
+}
+
+template<typename T, typename D>
+ObserverPtr<const typename UniquePtr<T, D>::ValueType> UniquePtr<T, D>::borrowConst() const {
+    return DataType::template borrow<const ValueType>();
+}
+
 } // namespace mem
@@ -0,0 +1,138 @@
+#include <cstddef>
+#include <new>
+
+#ifndef ZERO_COST_RAW_POINTER
+#include "instrumentation.h"
+#include "ownership_event.h"
+#include "ownership_trace.h"
+#include "unique_ptr.h"
+#include "make_unique.h"
+#endif
+
+// Every operation that carries a MEM_INSTRUMENT hook next to a hand-written raw pointer equivalent
+// without hooks. The file is compiled with -O2 -DNDEBUG -fno-exceptions twice: as is and with
+// ZERO_COST_RAW_POINTER; zero_cost_test requires the disassembly of both objects to match when
+// neither MEM_INSTRUMENTATION nor MEM_OWNERSHIP_TRACE is defined, so a hook that leaves a single
+// instruction behind fails it. Exceptions are off because C++03 UniquePtr destructors are not
+// noexcept and their cleanup pads would differ regardless of the hooks. The trace and counter
+// headers are included into the UniquePtr build only: including them must not emit code either.
+// Kernels are extern "C" and keep rvalues inside, as in codegen_test.cpp
+
+struct Base {
+    int value;
+};
+
+struct Derived : Base {};
+
+#ifdef ZERO_COST_RAW_POINTER
+typedef Base *BaseHandle;
+typedef Base *BaseRvalue;
+typedef Derived *DerivedHandle;
+
+template<typename T>
+T *moveOut(T *&ptr) {
+    T *result = ptr;
+    ptr = NULL;
+    return result;
+}
+
+template<typename T, typename U>
+void assign(T *&target, U *ptr) {
+    T *converted = ptr;
+    if (target != NULL) {
+        delete target;
+    }
+    target = converted;
+}
+
+template<typename T>
+T *releaseOf(T *&ptr) {
+    return moveOut(ptr);
+}
+
+template<typename T>
+void *releaseRvalue(T *&ptr) {
+    return moveOut(ptr);
+}
+
+template<typename T>
+void dispose(T *&ptr) {
+    delete ptr;
+}
+
+inline Base *makeBase() {
+    return new Base();
+}
+#else
+typedef mem::UniquePtr<Base> BaseHandle;
+typedef BaseHandle::RvalueType BaseRvalue;
+typedef mem::UniquePtr<Derived> DerivedHandle;
+
+template<typename T>
+typename mem::UniquePtr<T>::RvalueType moveOut(mem::UniquePtr<T> &ptr) {
+    return ptr.move();
+}
+
+template<typename T, typename E>
+void assign(mem::UniquePtr<T> &target, const mem::UniquePtr<void, E> &rvalue) {
+    target = rvalue;
+}
+
+template<typename T>
+T *releaseOf(mem::UniquePtr<T> &ptr) {
+    return ptr.release();
+}
+
+template<typename D>
+void *releaseRvalue(mem::UniquePtr<void, D> &rvalue) {
+    return rvalue.release();
+}
+
+template<typename D>
+void dispose(mem::UniquePtr<void, D> &rvalue) {
+    mem::UniquePtr<typename D::ValueType, D> ptr(rvalue);
+}
+
+inline BaseRvalue makeBase() {
+    return mem::makeUnique<Base>();
+}
+#endif
+
+extern "C" void zeroCostMake(BaseHandle &target, int value) {
+    BaseHandle ptr(new Base());
+    ptr->value = value;
+    assign(target, moveOut(ptr));
+}
+
+extern "C" void zeroCostMakeUnique(BaseHandle &target) {
+    assign(target, makeBase());
+}
+
+extern "C" int zeroCostTransfer(BaseHandle &target, BaseHandle &source) {
+    BaseHandle local(moveOut(source));
+    assign(target, moveOut(local));
+    return target->value;
+}
+
+extern "C" void zeroCostConvert(BaseHandle &target, DerivedHandle &source) {
+    BaseHandle converted(moveOut(source));
+    assign(target, moveOut(converted));
+}
+
+extern "C" void zeroCostAssignDerived(BaseHandle &target, DerivedHandle &source) {
+    assign(target, moveOut(source));
+}
+
+extern "C" Base *zeroCostRelease(BaseHandle &ptr) {
+    return releaseOf(ptr);
+}
+
+extern "C" void *zeroCostReleaseRvalue(BaseHandle &ptr) {
+    BaseRvalue rvalue(moveOut(ptr));
+    return releaseRvalue(rvalue);
+}
+
+extern "C" void zeroCostDestroy(BaseHandle &ptr) {
+    BaseRvalue rvalue(moveOut(ptr));
+    dispose(rvalue);
+}